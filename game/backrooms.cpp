@@ -7,6 +7,8 @@
 #include "backrooms_camera.h"
 #include "backrooms_model.h"
 #include "backrooms_frame_graph.h"
+#include "backrooms_streaming.h"
+#include "backrooms_texture_pool.h"
 
 #include <future>
 
@@ -37,11 +39,13 @@ void GameInit()
     AudioSourceSetPitch(&State.TestSource, 0.9f);
 
     AudioSourceLoad(&State.TestSource, "data/sfx/ambiance0.mp3", AudioSourceType_MP3);
-    GpuMeshLoad(&State.Helmet, "data/models/Sponza.gltf");
+    StreamingInit(STREAMING_DEFAULT_BUDGET);
+    GpuMeshLoad(&State.Helmet, "data/models/Sponza.gltf", true);
+    UploadFlush();
 
     FrameGraphInit(&State.FrameGraph);
     NoClipCameraInit(&State.Camera);
-    State.FrameGraph.Scene.Meshes.push_back(State.Helmet);
+    FrameGraphAddMesh(&State.FrameGraph, State.Helmet);
 
     AudioSourcePlay(&State.TestSource);
 
@@ -60,6 +64,11 @@ void GameUpdate()
     State.FrameGraph.Scene.Camera.Projection = State.Camera.Projection;
     State.FrameGraph.Scene.Camera.View = State.Camera.View;
 
+    // NOTE(milo): Projection[1][1] is 1 / tan(fov / 2), which turns the angular size of a bounding sphere into pixels.
+    f32 ProjectionScale = State.Camera.Projection.Elements[1][1] * State.Camera.Height * 0.5f;
+    GpuMeshRequestMips(&State.Helmet, State.Camera.Position, State.Camera.Front, ProjectionScale);
+    StreamingUpdate();
+
     FrameGraphUpdate(&State.FrameGraph);
     FrameGraphRender(&State.FrameGraph);
 }
@@ -75,6 +84,8 @@ void GameResize(i32 Width, i32 Height)
 void GameExit()
 {
     GpuMeshFree(&State.Helmet);
+    StreamingExit();
+    TexturePoolExit();
     FrameGraphFree(&State.FrameGraph);
 
     AudioSourceStop(&State.TestSource);
@@ -0,0 +1,938 @@
+#include "backrooms_accessor.h"
+#include "backrooms_logger.h"
+
+#include <emmintrin.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define MESHOPT_VERTEX_HEADER 0xA0
+#define MESHOPT_INDEX_HEADER 0xE0
+#define MESHOPT_SEQUENCE_HEADER 0xD0
+#define MESHOPT_VERTEX_BLOCK_SIZE_BYTES 8192
+#define MESHOPT_VERTEX_BLOCK_MAX_SIZE 256
+#define MESHOPT_BYTE_GROUP_SIZE 16
+#define MESHOPT_BYTE_GROUP_DECODE_LIMIT 24
+#define MESHOPT_TAIL_MAX_SIZE 32
+
+struct accessor_stream
+{
+    const u8* Data;
+    u64 Available;
+    u64 Stride;
+    u64 Count;
+    u32 ComponentCount;
+    cgltf_component_type ComponentType;
+    bool Normalized;
+};
+
+u32 AccessorComponentSize(cgltf_component_type Type)
+{
+    switch (Type)
+    {
+        case cgltf_component_type_r_8:
+        case cgltf_component_type_r_8u:
+            return 1;
+        case cgltf_component_type_r_16:
+        case cgltf_component_type_r_16u:
+            return 2;
+        case cgltf_component_type_r_32u:
+        case cgltf_component_type_r_32f:
+            return 4;
+    }
+
+    assert(0);
+    return 0;
+}
+
+u32 AccessorComponentCount(cgltf_type Type)
+{
+    switch (Type)
+    {
+        case cgltf_type_scalar:
+            return 1;
+        case cgltf_type_vec2:
+            return 2;
+        case cgltf_type_vec3:
+            return 3;
+        case cgltf_type_vec4:
+        case cgltf_type_mat2:
+            return 4;
+        case cgltf_type_mat3:
+            return 9;
+        case cgltf_type_mat4:
+            return 16;
+    }
+
+    assert(0);
+    return 0;
+}
+
+// NOTE(milo): Every lane past ComponentCount holds garbage from the next element, the store only writes the lanes that exist.
+inline __m128 AccessorConvertElement(const u8* Source, cgltf_component_type Type, bool Normalized)
+{
+    const __m128i Zero = _mm_setzero_si128();
+
+    switch (Type)
+    {
+        case cgltf_component_type_r_32f: {
+            return _mm_loadu_ps((const f32*)Source);
+        }
+        case cgltf_component_type_r_8u: {
+            i32 Word;
+            memcpy(&Word, Source, sizeof(i32));
+            __m128i Value = _mm_cvtsi32_si128(Word);
+            Value = _mm_unpacklo_epi16(_mm_unpacklo_epi8(Value, Zero), Zero);
+            __m128 Result = _mm_cvtepi32_ps(Value);
+            return Normalized ? _mm_mul_ps(Result, _mm_set1_ps(1.0f / 255.0f)) : Result;
+        }
+        case cgltf_component_type_r_8: {
+            i32 Word;
+            memcpy(&Word, Source, sizeof(i32));
+            __m128i Value = _mm_cvtsi32_si128(Word);
+            Value = _mm_unpacklo_epi8(Value, Value);
+            Value = _mm_srai_epi32(_mm_unpacklo_epi16(Value, Value), 24);
+            __m128 Result = _mm_cvtepi32_ps(Value);
+            return Normalized ? _mm_max_ps(_mm_mul_ps(Result, _mm_set1_ps(1.0f / 127.0f)), _mm_set1_ps(-1.0f)) : Result;
+        }
+        case cgltf_component_type_r_16u: {
+            __m128i Value = _mm_loadl_epi64((const __m128i*)Source);
+            Value = _mm_unpacklo_epi16(Value, Zero);
+            __m128 Result = _mm_cvtepi32_ps(Value);
+            return Normalized ? _mm_mul_ps(Result, _mm_set1_ps(1.0f / 65535.0f)) : Result;
+        }
+        case cgltf_component_type_r_16: {
+            __m128i Value = _mm_loadl_epi64((const __m128i*)Source);
+            Value = _mm_srai_epi32(_mm_unpacklo_epi16(Value, Value), 16);
+            __m128 Result = _mm_cvtepi32_ps(Value);
+            return Normalized ? _mm_max_ps(_mm_mul_ps(Result, _mm_set1_ps(1.0f / 32767.0f)), _mm_set1_ps(-1.0f)) : Result;
+        }
+        case cgltf_component_type_r_32u: {
+            // NOTE(milo): SSE2 only converts signed integers, the halves are converted apart so values past 2^31 stay positive.
+            __m128i Value = _mm_loadu_si128((const __m128i*)Source);
+            __m128 High = _mm_cvtepi32_ps(_mm_srli_epi32(Value, 16));
+            __m128 Low = _mm_cvtepi32_ps(_mm_and_si128(Value, _mm_set1_epi32(0xFFFF)));
+            return _mm_add_ps(_mm_mul_ps(High, _mm_set1_ps(65536.0f)), Low);
+        }
+    }
+
+    return _mm_setzero_ps();
+}
+
+inline void AccessorStoreElement(f32* Destination, __m128 Value, u32 ComponentCount)
+{
+    switch (ComponentCount)
+    {
+        case 1: {
+            _mm_store_ss(Destination, Value);
+            break;
+        }
+        case 2: {
+            _mm_storel_pi((__m64*)Destination, Value);
+            break;
+        }
+        case 3: {
+            _mm_storel_pi((__m64*)Destination, Value);
+            _mm_store_ss(Destination + 2, _mm_movehl_ps(Value, Value));
+            break;
+        }
+        default: {
+            _mm_storeu_ps(Destination, Value);
+            break;
+        }
+    }
+}
+
+void AccessorDecodeStream(accessor_stream* Stream, u8* Destination, u32 DestinationStride, u32 DestinationComponents)
+{
+    u32 ComponentSize = AccessorComponentSize(Stream->ComponentType);
+    u32 ElementSize = ComponentSize * Stream->ComponentCount;
+    u32 Components = Stream->ComponentCount < DestinationComponents ? Stream->ComponentCount : DestinationComponents;
+    assert(Components <= 4);
+
+    // NOTE(milo): Elements close to the end of the buffer go through a scratch copy so the wide loads never read past it.
+    u64 LoadSize = ComponentSize * 4;
+    u64 SafeCount = 0;
+    if (Stream->Available >= LoadSize) {
+        SafeCount = (Stream->Available - LoadSize) / (Stream->Stride ? Stream->Stride : 1) + 1;
+    }
+    if (SafeCount > Stream->Count) {
+        SafeCount = Stream->Count;
+    }
+
+    for (u64 Index = 0; Index < SafeCount; Index++) {
+        __m128 Value = AccessorConvertElement(Stream->Data + Index * Stream->Stride, Stream->ComponentType, Stream->Normalized);
+        AccessorStoreElement((f32*)(Destination + Index * DestinationStride), Value, Components);
+    }
+
+    alignas(16) u8 Scratch[16] = {};
+    for (u64 Index = SafeCount; Index < Stream->Count; Index++) {
+        memcpy(Scratch, Stream->Data + Index * Stream->Stride, ElementSize);
+        __m128 Value = AccessorConvertElement(Scratch, Stream->ComponentType, Stream->Normalized);
+        AccessorStoreElement((f32*)(Destination + Index * DestinationStride), Value, Components);
+    }
+}
+
+const u8* AccessorViewData(cgltf_buffer_view* View)
+{
+    if (View->data) {
+        return (const u8*)View->data;
+    }
+    if (!View->buffer->data) {
+        return NULL;
+    }
+    return (const u8*)View->buffer->data + View->offset;
+}
+
+u64 AccessorAvailableBytes(cgltf_buffer_view* View, u64 Offset)
+{
+    u64 Size = View->data ? View->size : View->buffer->size - View->offset;
+    return Size > Offset ? Size - Offset : 0;
+}
+
+// NOTE(milo): The last element starts at (Count - 1) * Stride and must end inside the view, compared without overflowing on bad counts.
+bool AccessorFits(u64 Available, u64 Count, u64 Stride, u64 ElementSize)
+{
+    if (Count == 0) {
+        return true;
+    }
+    if (ElementSize > Available) {
+        return false;
+    }
+    return Stride == 0 || Count - 1 <= (Available - ElementSize) / Stride;
+}
+
+// NOTE(milo): The sparse views are optional in a malformed file, both must exist and hold Count elements past their offset.
+bool AccessorSparseData(cgltf_accessor* Accessor, const u8** IndexData, const u8** ValueData, u64 ValueSize)
+{
+    cgltf_accessor_sparse* Sparse = &Accessor->sparse;
+    if (!Sparse->indices_buffer_view || !Sparse->values_buffer_view) {
+        LogError("Sparse accessor is missing its indices or values buffer view.");
+        return false;
+    }
+
+    *IndexData = AccessorViewData(Sparse->indices_buffer_view);
+    *ValueData = AccessorViewData(Sparse->values_buffer_view);
+    if (!*IndexData || !*ValueData) {
+        LogError("Sparse accessor references a buffer view without data.");
+        return false;
+    }
+
+    u64 IndexBytes = (u64)Sparse->count * AccessorComponentSize(Sparse->indices_component_type);
+    u64 ValueBytes = (u64)Sparse->count * ValueSize;
+    if (AccessorAvailableBytes(Sparse->indices_buffer_view, Sparse->indices_byte_offset) < IndexBytes ||
+        AccessorAvailableBytes(Sparse->values_buffer_view, Sparse->values_byte_offset) < ValueBytes) {
+        LogError("Sparse accessor buffer views are too small for %llu elements.", (unsigned long long)Sparse->count);
+        return false;
+    }
+
+    *IndexData += Sparse->indices_byte_offset;
+    *ValueData += Sparse->values_byte_offset;
+    return true;
+}
+
+u32 AccessorReadSparseIndex(const u8* Data, cgltf_component_type Type, u64 Index)
+{
+    switch (Type)
+    {
+        case cgltf_component_type_r_8u: {
+            return Data[Index];
+        }
+        case cgltf_component_type_r_16u: {
+            u16 Value;
+            memcpy(&Value, Data + Index * sizeof(u16), sizeof(u16));
+            return Value;
+        }
+        case cgltf_component_type_r_32u: {
+            u32 Value;
+            memcpy(&Value, Data + Index * sizeof(u32), sizeof(u32));
+            return Value;
+        }
+    }
+
+    return 0;
+}
+
+bool AccessorDecodeFloats(cgltf_accessor* Accessor, void* Destination, u32 DestinationStride, u32 DestinationComponents)
+{
+    u32 ComponentCount = AccessorComponentCount(Accessor->type);
+    u32 Components = ComponentCount < DestinationComponents ? ComponentCount : DestinationComponents;
+    if (ComponentCount > 4) {
+        LogError("Accessor decode only supports scalar and vector types.");
+        return false;
+    }
+
+    CODE_BLOCK("Dense")
+    {
+        if (Accessor->buffer_view) {
+            const u8* Data = AccessorViewData(Accessor->buffer_view);
+            if (!Data) {
+                LogError("Accessor references a buffer view without data.");
+                return false;
+            }
+
+            u64 Available = AccessorAvailableBytes(Accessor->buffer_view, Accessor->offset);
+            if (!AccessorFits(Available, Accessor->count, Accessor->stride, AccessorComponentSize(Accessor->component_type) * ComponentCount)) {
+                LogError("Accessor with %llu elements overruns its buffer view.", (unsigned long long)Accessor->count);
+                return false;
+            }
+
+            accessor_stream Stream;
+            Stream.Data = Data + Accessor->offset;
+            Stream.Available = Available;
+            Stream.Stride = Accessor->stride;
+            Stream.Count = Accessor->count;
+            Stream.ComponentCount = ComponentCount;
+            Stream.ComponentType = Accessor->component_type;
+            Stream.Normalized = Accessor->normalized;
+            AccessorDecodeStream(&Stream, (u8*)Destination, DestinationStride, DestinationComponents);
+        } else {
+            for (u64 Index = 0; Index < Accessor->count; Index++) {
+                memset((u8*)Destination + Index * DestinationStride, 0, Components * sizeof(f32));
+            }
+        }
+    }
+
+    CODE_BLOCK("Sparse")
+    {
+        if (Accessor->is_sparse) {
+            cgltf_accessor_sparse* Sparse = &Accessor->sparse;
+            const u8* IndexData;
+            const u8* ValueData;
+            if (!AccessorSparseData(Accessor, &IndexData, &ValueData, AccessorComponentSize(Accessor->component_type) * ComponentCount)) {
+                return false;
+            }
+
+            std::vector<f32> Values(Sparse->count * Components);
+
+            accessor_stream Stream;
+            Stream.Data = ValueData;
+            Stream.Available = AccessorAvailableBytes(Sparse->values_buffer_view, Sparse->values_byte_offset);
+            Stream.Stride = AccessorComponentSize(Accessor->component_type) * ComponentCount;
+            Stream.Count = Sparse->count;
+            Stream.ComponentCount = ComponentCount;
+            Stream.ComponentType = Accessor->component_type;
+            Stream.Normalized = Accessor->normalized;
+            AccessorDecodeStream(&Stream, (u8*)Values.data(), Components * sizeof(f32), Components);
+
+            for (u64 SparseIndex = 0; SparseIndex < Sparse->count; SparseIndex++) {
+                u32 Target = AccessorReadSparseIndex(IndexData, Sparse->indices_component_type, SparseIndex);
+                if (Target >= Accessor->count) {
+                    LogError("Sparse accessor index %u is out of range.", Target);
+                    return false;
+                }
+                memcpy((u8*)Destination + (u64)Target * DestinationStride, &Values[SparseIndex * Components], Components * sizeof(f32));
+            }
+        }
+    }
+
+    return true;
+}
+
+bool AccessorDecodeIndices(cgltf_accessor* Accessor, u32* Destination)
+{
+    if (!Accessor->buffer_view) {
+        memset(Destination, 0, Accessor->count * sizeof(u32));
+    } else {
+        const u8* Data = AccessorViewData(Accessor->buffer_view);
+        if (!Data) {
+            LogError("Index accessor references a buffer view without data.");
+            return false;
+        }
+        Data += Accessor->offset;
+
+        u64 Count = Accessor->count;
+        u64 Stride = Accessor->stride;
+        if (!AccessorFits(AccessorAvailableBytes(Accessor->buffer_view, Accessor->offset), Count, Stride, AccessorComponentSize(Accessor->component_type))) {
+            LogError("Index accessor with %llu elements overruns its buffer view.", (unsigned long long)Count);
+            return false;
+        }
+
+        switch (Accessor->component_type)
+        {
+            case cgltf_component_type_r_8u: {
+                for (u64 Index = 0; Index < Count; Index++) {
+                    Destination[Index] = Data[Index * Stride];
+                }
+                break;
+            }
+            case cgltf_component_type_r_16u: {
+                u64 Index = 0;
+                if (Stride == sizeof(u16)) {
+                    const __m128i Zero = _mm_setzero_si128();
+                    for (; Index + 8 <= Count; Index += 8) {
+                        __m128i Value = _mm_loadu_si128((const __m128i*)(Data + Index * sizeof(u16)));
+                        _mm_storeu_si128((__m128i*)(Destination + Index), _mm_unpacklo_epi16(Value, Zero));
+                        _mm_storeu_si128((__m128i*)(Destination + Index + 4), _mm_unpackhi_epi16(Value, Zero));
+                    }
+                }
+                for (; Index < Count; Index++) {
+                    u16 Value;
+                    memcpy(&Value, Data + Index * Stride, sizeof(u16));
+                    Destination[Index] = Value;
+                }
+                break;
+            }
+            case cgltf_component_type_r_32u: {
+                if (Stride == sizeof(u32)) {
+                    memcpy(Destination, Data, Count * sizeof(u32));
+                } else {
+                    for (u64 Index = 0; Index < Count; Index++) {
+                        memcpy(&Destination[Index], Data + Index * Stride, sizeof(u32));
+                    }
+                }
+                break;
+            }
+            default: {
+                LogError("Index accessors must use an unsigned component type.");
+                return false;
+            }
+        }
+    }
+
+    if (Accessor->is_sparse) {
+        cgltf_accessor_sparse* Sparse = &Accessor->sparse;
+        const u8* IndexData;
+        const u8* ValueData;
+        if (!AccessorSparseData(Accessor, &IndexData, &ValueData, AccessorComponentSize(Accessor->component_type))) {
+            return false;
+        }
+
+        for (u64 SparseIndex = 0; SparseIndex < Sparse->count; SparseIndex++) {
+            u32 Target = AccessorReadSparseIndex(IndexData, Sparse->indices_component_type, SparseIndex);
+            if (Target >= Accessor->count) {
+                LogError("Sparse accessor index %u is out of range.", Target);
+                return false;
+            }
+            Destination[Target] = AccessorReadSparseIndex(ValueData, Accessor->component_type, SparseIndex);
+        }
+    }
+
+    return true;
+}
+
+//~ NOTE(milo): Vertex codec
+
+const u8* MeshoptDecodeBytesGroup(const u8* Data, u8* Buffer, u32 Bitslog2)
+{
+    switch (Bitslog2)
+    {
+        case 0: {
+            memset(Buffer, 0, MESHOPT_BYTE_GROUP_SIZE);
+            return Data;
+        }
+        case 1: {
+            const u8* Variable = Data + 4;
+            for (u32 ByteIndex = 0; ByteIndex < 4; ByteIndex++) {
+                u8 Byte = Data[ByteIndex];
+                for (u32 Shift = 0; Shift < 4; Shift++) {
+                    u8 Encoded = (Byte >> (6 - Shift * 2)) & 3;
+                    bool Escape = Encoded == 3;
+                    *Buffer++ = Escape ? *Variable : Encoded;
+                    Variable += Escape;
+                }
+            }
+            return Variable;
+        }
+        case 2: {
+            const u8* Variable = Data + 8;
+            for (u32 ByteIndex = 0; ByteIndex < 8; ByteIndex++) {
+                u8 Byte = Data[ByteIndex];
+                for (u32 Shift = 0; Shift < 2; Shift++) {
+                    u8 Encoded = (Byte >> (4 - Shift * 4)) & 15;
+                    bool Escape = Encoded == 15;
+                    *Buffer++ = Escape ? *Variable : Encoded;
+                    Variable += Escape;
+                }
+            }
+            return Variable;
+        }
+        default: {
+            memcpy(Buffer, Data, MESHOPT_BYTE_GROUP_SIZE);
+            return Data + MESHOPT_BYTE_GROUP_SIZE;
+        }
+    }
+}
+
+const u8* MeshoptDecodeBytes(const u8* Data, const u8* DataEnd, u8* Buffer, u32 BufferSize)
+{
+    assert(BufferSize % MESHOPT_BYTE_GROUP_SIZE == 0);
+
+    u32 HeaderSize = (BufferSize / MESHOPT_BYTE_GROUP_SIZE + 3) / 4;
+    if ((u64)(DataEnd - Data) < HeaderSize) {
+        return NULL;
+    }
+
+    const u8* Header = Data;
+    Data += HeaderSize;
+
+    for (u32 Offset = 0; Offset < BufferSize; Offset += MESHOPT_BYTE_GROUP_SIZE) {
+        if ((u64)(DataEnd - Data) < MESHOPT_BYTE_GROUP_DECODE_LIMIT) {
+            return NULL;
+        }
+
+        u32 HeaderOffset = Offset / MESHOPT_BYTE_GROUP_SIZE;
+        u32 Bitslog2 = (Header[HeaderOffset / 4] >> ((HeaderOffset % 4) * 2)) & 3;
+        Data = MeshoptDecodeBytesGroup(Data, Buffer + Offset, Bitslog2);
+    }
+
+    return Data;
+}
+
+const u8* MeshoptDecodeVertexBlock(const u8* Data, const u8* DataEnd, u8* VertexData, u32 VertexCount, u32 VertexSize, u8* LastVertex)
+{
+    u8 Buffer[MESHOPT_VERTEX_BLOCK_MAX_SIZE];
+    u8 Transposed[MESHOPT_VERTEX_BLOCK_SIZE_BYTES];
+
+    u32 VertexCountAligned = (VertexCount + MESHOPT_BYTE_GROUP_SIZE - 1) & ~(MESHOPT_BYTE_GROUP_SIZE - 1);
+
+    for (u32 ByteIndex = 0; ByteIndex < VertexSize; ByteIndex++) {
+        Data = MeshoptDecodeBytes(Data, DataEnd, Buffer, VertexCountAligned);
+        if (!Data) {
+            return NULL;
+        }
+
+        u32 VertexOffset = ByteIndex;
+        u8 Previous = LastVertex[ByteIndex];
+        for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
+            u8 Delta = Buffer[VertexIndex];
+            u8 Value = (u8)(-(Delta & 1) ^ (Delta >> 1)) + Previous;
+
+            Transposed[VertexOffset] = Value;
+            Previous = Value;
+            VertexOffset += VertexSize;
+        }
+
+        LastVertex[ByteIndex] = Previous;
+    }
+
+    memcpy(VertexData, Transposed, VertexCount * VertexSize);
+    return Data;
+}
+
+bool MeshoptDecodeVertexBuffer(u8* Destination, u32 VertexCount, u32 VertexSize, const u8* Buffer, u64 BufferSize)
+{
+    if (VertexSize == 0 || VertexSize > 256 || VertexSize % 4 != 0) {
+        return false;
+    }
+    if (BufferSize < 1 + VertexSize) {
+        return false;
+    }
+
+    const u8* Data = Buffer;
+    const u8* DataEnd = Buffer + BufferSize;
+
+    u8 Header = *Data++;
+    if ((Header & 0xF0) != MESHOPT_VERTEX_HEADER || (Header & 0x0F) > 0) {
+        return false;
+    }
+
+    u8 LastVertex[256];
+    memcpy(LastVertex, DataEnd - VertexSize, VertexSize);
+
+    u32 BlockSize = MESHOPT_VERTEX_BLOCK_SIZE_BYTES / VertexSize;
+    BlockSize &= ~(MESHOPT_BYTE_GROUP_SIZE - 1);
+    BlockSize = BlockSize < MESHOPT_VERTEX_BLOCK_MAX_SIZE ? BlockSize : MESHOPT_VERTEX_BLOCK_MAX_SIZE;
+
+    u32 VertexOffset = 0;
+    while (VertexOffset < VertexCount) {
+        u32 Count = VertexCount - VertexOffset < BlockSize ? VertexCount - VertexOffset : BlockSize;
+
+        Data = MeshoptDecodeVertexBlock(Data, DataEnd, Destination + VertexOffset * VertexSize, Count, VertexSize, LastVertex);
+        if (!Data) {
+            return false;
+        }
+
+        VertexOffset += Count;
+    }
+
+    u32 TailSize = VertexSize < MESHOPT_TAIL_MAX_SIZE ? MESHOPT_TAIL_MAX_SIZE : VertexSize;
+    return (u64)(DataEnd - Data) == TailSize;
+}
+
+//~ NOTE(milo): Index codec
+
+u32 MeshoptDecodeVByte(const u8*& Data)
+{
+    u8 Lead = *Data++;
+    if (Lead < 128) {
+        return Lead;
+    }
+
+    u32 Result = Lead & 127;
+    u32 Shift = 7;
+    for (u32 Index = 0; Index < 4; Index++) {
+        u8 Group = *Data++;
+        Result |= u32(Group & 127) << Shift;
+        Shift += 7;
+
+        if (Group < 128) {
+            break;
+        }
+    }
+
+    return Result;
+}
+
+u32 MeshoptDecodeIndex(const u8*& Data, u32 Last)
+{
+    u32 Value = MeshoptDecodeVByte(Data);
+    u32 Delta = (Value >> 1) ^ -i32(Value & 1);
+    return Last + Delta;
+}
+
+inline void MeshoptPushEdge(u32 Fifo[16][2], u32 A, u32 B, u32& Offset)
+{
+    Fifo[Offset][0] = A;
+    Fifo[Offset][1] = B;
+    Offset = (Offset + 1) & 15;
+}
+
+inline void MeshoptPushVertex(u32 Fifo[16], u32 V, u32& Offset, i32 Condition = 1)
+{
+    Fifo[Offset] = V;
+    Offset = (Offset + Condition) & 15;
+}
+
+inline void MeshoptWriteTriangle(u8* Destination, u64 Offset, u32 IndexSize, u32 A, u32 B, u32 C)
+{
+    if (IndexSize == 2) {
+        u16* Output = (u16*)Destination + Offset;
+        Output[0] = (u16)A;
+        Output[1] = (u16)B;
+        Output[2] = (u16)C;
+    } else {
+        u32* Output = (u32*)Destination + Offset;
+        Output[0] = A;
+        Output[1] = B;
+        Output[2] = C;
+    }
+}
+
+bool MeshoptDecodeIndexBuffer(u8* Destination, u64 IndexCount, u32 IndexSize, const u8* Buffer, u64 BufferSize)
+{
+    if (IndexCount % 3 != 0 || (IndexSize != 2 && IndexSize != 4)) {
+        return false;
+    }
+    if (BufferSize < 1 + IndexCount / 3 + 16) {
+        return false;
+    }
+    if ((Buffer[0] & 0xF0) != MESHOPT_INDEX_HEADER) {
+        return false;
+    }
+
+    i32 Version = Buffer[0] & 0x0F;
+    if (Version > 1) {
+        return false;
+    }
+
+    u32 EdgeFifo[16][2];
+    memset(EdgeFifo, -1, sizeof(EdgeFifo));
+    u32 VertexFifo[16];
+    memset(VertexFifo, -1, sizeof(VertexFifo));
+
+    u32 EdgeFifoOffset = 0;
+    u32 VertexFifoOffset = 0;
+    u32 Next = 0;
+    u32 Last = 0;
+    i32 FecMax = Version >= 1 ? 13 : 15;
+
+    const u8* Code = Buffer + 1;
+    const u8* Data = Code + IndexCount / 3;
+    const u8* DataSafeEnd = Buffer + BufferSize - 16;
+    const u8* CodeAuxTable = DataSafeEnd;
+
+    for (u64 Index = 0; Index < IndexCount; Index += 3) {
+        if (Data > DataSafeEnd) {
+            return false;
+        }
+
+        u8 CodeTri = *Code++;
+
+        if (CodeTri < 0xF0) {
+            i32 Fe = CodeTri >> 4;
+            u32 A = EdgeFifo[(EdgeFifoOffset - 1 - Fe) & 15][0];
+            u32 B = EdgeFifo[(EdgeFifoOffset - 1 - Fe) & 15][1];
+
+            i32 Fec = CodeTri & 15;
+            if (Fec < FecMax) {
+                u32 Cf = VertexFifo[(VertexFifoOffset - 1 - Fec) & 15];
+                u32 C = (Fec == 0) ? Next : Cf;
+                i32 Fec0 = Fec == 0;
+                Next += Fec0;
+
+                MeshoptWriteTriangle(Destination, Index, IndexSize, A, B, C);
+                MeshoptPushVertex(VertexFifo, C, VertexFifoOffset, Fec0);
+                MeshoptPushEdge(EdgeFifo, C, B, EdgeFifoOffset);
+                MeshoptPushEdge(EdgeFifo, A, C, EdgeFifoOffset);
+            } else {
+                // NOTE(milo): fec 13 and 14 are deltas of -1 and +1 from the last free index.
+                u32 C = (Fec != 15) ? Last + (Fec - (Fec ^ 3)) : MeshoptDecodeIndex(Data, Last);
+                Last = C;
+
+                MeshoptWriteTriangle(Destination, Index, IndexSize, A, B, C);
+                MeshoptPushVertex(VertexFifo, C, VertexFifoOffset);
+                MeshoptPushEdge(EdgeFifo, C, B, EdgeFifoOffset);
+                MeshoptPushEdge(EdgeFifo, A, C, EdgeFifoOffset);
+            }
+        } else if (CodeTri < 0xFE) {
+            u8 CodeAux = CodeAuxTable[CodeTri & 15];
+            i32 Feb = CodeAux >> 4;
+            i32 Fec = CodeAux & 15;
+
+            u32 A = Next++;
+
+            u32 Bf = VertexFifo[(VertexFifoOffset - Feb) & 15];
+            u32 B = (Feb == 0) ? Next : Bf;
+            i32 Feb0 = Feb == 0;
+            Next += Feb0;
+
+            u32 Cf = VertexFifo[(VertexFifoOffset - Fec) & 15];
+            u32 C = (Fec == 0) ? Next : Cf;
+            i32 Fec0 = Fec == 0;
+            Next += Fec0;
+
+            MeshoptWriteTriangle(Destination, Index, IndexSize, A, B, C);
+            MeshoptPushVertex(VertexFifo, A, VertexFifoOffset);
+            MeshoptPushVertex(VertexFifo, B, VertexFifoOffset, Feb0);
+            MeshoptPushVertex(VertexFifo, C, VertexFifoOffset, Fec0);
+            MeshoptPushEdge(EdgeFifo, B, A, EdgeFifoOffset);
+            MeshoptPushEdge(EdgeFifo, C, B, EdgeFifoOffset);
+            MeshoptPushEdge(EdgeFifo, A, C, EdgeFifoOffset);
+        } else {
+            u8 CodeAux = *Data++;
+
+            i32 Fea = CodeTri == 0xFE ? 0 : 15;
+            i32 Feb = CodeAux >> 4;
+            i32 Fec = CodeAux & 15;
+
+            if (CodeAux == 0) {
+                Next = 0;
+            }
+
+            u32 A = (Fea == 0) ? Next++ : 0;
+            u32 B = (Feb == 0) ? Next++ : VertexFifo[(VertexFifoOffset - Feb) & 15];
+            u32 C = (Fec == 0) ? Next++ : VertexFifo[(VertexFifoOffset - Fec) & 15];
+
+            if (Fea == 15) {
+                Last = A = MeshoptDecodeIndex(Data, Last);
+            }
+            if (Feb == 15) {
+                Last = B = MeshoptDecodeIndex(Data, Last);
+            }
+            if (Fec == 15) {
+                Last = C = MeshoptDecodeIndex(Data, Last);
+            }
+
+            MeshoptWriteTriangle(Destination, Index, IndexSize, A, B, C);
+            MeshoptPushVertex(VertexFifo, A, VertexFifoOffset);
+            MeshoptPushVertex(VertexFifo, B, VertexFifoOffset, (Feb == 0) | (Feb == 15));
+            MeshoptPushVertex(VertexFifo, C, VertexFifoOffset, (Fec == 0) | (Fec == 15));
+            MeshoptPushEdge(EdgeFifo, B, A, EdgeFifoOffset);
+            MeshoptPushEdge(EdgeFifo, C, B, EdgeFifoOffset);
+            MeshoptPushEdge(EdgeFifo, A, C, EdgeFifoOffset);
+        }
+    }
+
+    return Data == DataSafeEnd;
+}
+
+bool MeshoptDecodeIndexSequence(u8* Destination, u64 IndexCount, u32 IndexSize, const u8* Buffer, u64 BufferSize)
+{
+    if (IndexSize != 2 && IndexSize != 4) {
+        return false;
+    }
+    if (BufferSize < 1 + IndexCount + 4) {
+        return false;
+    }
+    if ((Buffer[0] & 0xF0) != MESHOPT_SEQUENCE_HEADER || (Buffer[0] & 0x0F) > 1) {
+        return false;
+    }
+
+    const u8* Data = Buffer + 1;
+    const u8* DataSafeEnd = Buffer + BufferSize - 4;
+
+    u32 Last[2] = { 0, 0 };
+    for (u64 Index = 0; Index < IndexCount; Index++) {
+        if (Data >= DataSafeEnd) {
+            return false;
+        }
+
+        u32 Value = MeshoptDecodeVByte(Data);
+        u32 Current = Value & 1;
+        Value >>= 1;
+
+        u32 Delta = (Value >> 1) ^ -i32(Value & 1);
+        u32 Result = Last[Current] + Delta;
+        Last[Current] = Result;
+
+        if (IndexSize == 2) {
+            ((u16*)Destination)[Index] = (u16)Result;
+        } else {
+            ((u32*)Destination)[Index] = Result;
+        }
+    }
+
+    return Data == DataSafeEnd;
+}
+
+//~ NOTE(milo): Filters
+
+void MeshoptFilterOctahedral8(i8* Data, u64 Count)
+{
+    for (u64 Index = 0; Index < Count; Index++) {
+        f32 X = Data[Index * 4 + 0];
+        f32 Y = Data[Index * 4 + 1];
+        f32 Z = (f32)Data[Index * 4 + 2] - fabsf(X) - fabsf(Y);
+
+        f32 T = Z >= 0.0f ? 0.0f : Z;
+        X += X >= 0.0f ? T : -T;
+        Y += Y >= 0.0f ? T : -T;
+
+        f32 Scale = 127.0f / sqrtf(X * X + Y * Y + Z * Z);
+        Data[Index * 4 + 0] = (i8)(i32)(X * Scale + (X >= 0.0f ? 0.5f : -0.5f));
+        Data[Index * 4 + 1] = (i8)(i32)(Y * Scale + (Y >= 0.0f ? 0.5f : -0.5f));
+        Data[Index * 4 + 2] = (i8)(i32)(Z * Scale + (Z >= 0.0f ? 0.5f : -0.5f));
+    }
+}
+
+void MeshoptFilterOctahedral16(i16* Data, u64 Count)
+{
+    for (u64 Index = 0; Index < Count; Index++) {
+        f32 X = Data[Index * 4 + 0];
+        f32 Y = Data[Index * 4 + 1];
+        f32 Z = (f32)Data[Index * 4 + 2] - fabsf(X) - fabsf(Y);
+
+        f32 T = Z >= 0.0f ? 0.0f : Z;
+        X += X >= 0.0f ? T : -T;
+        Y += Y >= 0.0f ? T : -T;
+
+        f32 Scale = 32767.0f / sqrtf(X * X + Y * Y + Z * Z);
+        Data[Index * 4 + 0] = (i16)(i32)(X * Scale + (X >= 0.0f ? 0.5f : -0.5f));
+        Data[Index * 4 + 1] = (i16)(i32)(Y * Scale + (Y >= 0.0f ? 0.5f : -0.5f));
+        Data[Index * 4 + 2] = (i16)(i32)(Z * Scale + (Z >= 0.0f ? 0.5f : -0.5f));
+    }
+}
+
+void MeshoptFilterQuaternion(i16* Data, u64 Count)
+{
+    const f32 Scale = 1.0f / sqrtf(2.0f);
+
+    for (u64 Index = 0; Index < Count; Index++) {
+        i16* Quat = Data + Index * 4;
+
+        // NOTE(milo): The low two bits of w hold the index of the dropped component, the rest hold the scale.
+        i32 ScaleFactor = Quat[3] | 3;
+        f32 ScaleStep = Scale / (f32)ScaleFactor;
+
+        f32 X = (f32)Quat[0] * ScaleStep;
+        f32 Y = (f32)Quat[1] * ScaleStep;
+        f32 Z = (f32)Quat[2] * ScaleStep;
+
+        f32 WW = 1.0f - X * X - Y * Y - Z * Z;
+        f32 W = sqrtf(WW >= 0.0f ? WW : 0.0f);
+
+        i32 XF = (i32)(X * 32767.0f + (X >= 0.0f ? 0.5f : -0.5f));
+        i32 YF = (i32)(Y * 32767.0f + (Y >= 0.0f ? 0.5f : -0.5f));
+        i32 ZF = (i32)(Z * 32767.0f + (Z >= 0.0f ? 0.5f : -0.5f));
+        i32 WF = (i32)(W * 32767.0f + 0.5f);
+
+        i32 Component = Quat[3] & 3;
+        Quat[(Component + 1) & 3] = (i16)XF;
+        Quat[(Component + 2) & 3] = (i16)YF;
+        Quat[(Component + 3) & 3] = (i16)ZF;
+        Quat[(Component + 0) & 3] = (i16)WF;
+    }
+}
+
+void MeshoptFilterExponential(u32* Data, u64 Count)
+{
+    for (u64 Index = 0; Index < Count; Index++) {
+        u32 Value = Data[Index];
+
+        i32 Mantissa = (i32)(Value << 8) >> 8;
+        i32 Exponent = (i32)Value >> 24;
+
+        union { f32 F; u32 U; } Result;
+        Result.U = (u32)(Exponent + 127) << 23;
+        Result.F = Result.F * (f32)Mantissa;
+
+        Data[Index] = Result.U;
+    }
+}
+
+bool MeshoptDecompressBufferViews(cgltf_data* Data)
+{
+    for (cgltf_size ViewIndex = 0; ViewIndex < Data->buffer_views_count; ViewIndex++) {
+        cgltf_buffer_view* View = &Data->buffer_views[ViewIndex];
+        if (!View->has_meshopt_compression || View->data) {
+            continue;
+        }
+
+        cgltf_meshopt_compression* Compression = &View->meshopt_compression;
+        if (!Compression->buffer || !Compression->buffer->data) {
+            LogError("EXT_meshopt_compression buffer view %u has no source data.", (u32)ViewIndex);
+            return false;
+        }
+
+        const u8* Source = (const u8*)Compression->buffer->data + Compression->offset;
+        u64 Size = Compression->count * Compression->stride;
+        u8* Destination = (u8*)malloc(Size);
+
+        bool Success = false;
+        switch (Compression->mode)
+        {
+            case cgltf_meshopt_compression_mode_attributes: {
+                Success = MeshoptDecodeVertexBuffer(Destination, (u32)Compression->count, (u32)Compression->stride, Source, Compression->size);
+                break;
+            }
+            case cgltf_meshopt_compression_mode_triangles: {
+                Success = MeshoptDecodeIndexBuffer(Destination, Compression->count, (u32)Compression->stride, Source, Compression->size);
+                break;
+            }
+            case cgltf_meshopt_compression_mode_indices: {
+                Success = MeshoptDecodeIndexSequence(Destination, Compression->count, (u32)Compression->stride, Source, Compression->size);
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+
+        if (!Success) {
+            LogError("Failed to decode EXT_meshopt_compression buffer view %u.", (u32)ViewIndex);
+            free(Destination);
+            return false;
+        }
+
+        switch (Compression->filter)
+        {
+            case cgltf_meshopt_compression_filter_octahedral: {
+                if (Compression->stride == 4) {
+                    MeshoptFilterOctahedral8((i8*)Destination, Compression->count);
+                } else {
+                    MeshoptFilterOctahedral16((i16*)Destination, Compression->count);
+                }
+                break;
+            }
+            case cgltf_meshopt_compression_filter_quaternion: {
+                MeshoptFilterQuaternion((i16*)Destination, Compression->count);
+                break;
+            }
+            case cgltf_meshopt_compression_filter_exponential: {
+                MeshoptFilterExponential((u32*)Destination, Size / sizeof(u32));
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+
+        // NOTE(milo): cgltf_free releases this and the accessor readers prefer it over the raw buffer.
+        View->data = Destination;
+    }
+
+    return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "backrooms_common.h"
+
+#include <cgltf/cgltf.h>
+
+//~ NOTE(milo): Accessor decode
+bool AccessorDecodeFloats(cgltf_accessor* Accessor, void* Destination, u32 DestinationStride, u32 DestinationComponents);
+bool AccessorDecodeIndices(cgltf_accessor* Accessor, u32* Destination);
+
+//~ NOTE(milo): EXT_meshopt_compression
+bool MeshoptDecompressBufferViews(cgltf_data* Data);
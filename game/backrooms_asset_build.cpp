@@ -0,0 +1,292 @@
+#include "backrooms_asset_build.h"
+#include "backrooms_hash.h"
+#include "backrooms_platform.h"
+#include "backrooms_logger.h"
+#include "backrooms_job.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+
+struct asset_manifest_entry
+{
+    u64 Key;
+    u64 OutputHash;
+};
+
+struct asset_build_context
+{
+    asset_graph* Graph;
+    std::unordered_map<std::string, asset_manifest_entry>* Manifest;
+    const u32* Order;
+    const std::vector<u32>* Dependencies; // NOTE(milo): Per step, the steps producing its inputs.
+
+    asset_step_result* Results;
+    asset_manifest_entry* Entries;
+};
+
+bool AssetCopyFile(const char* Source, const char* Destination)
+{
+    FILE* Input = fopen(Source, "rb");
+    if (!Input) {
+        return false;
+    }
+
+    FILE* Output = fopen(Destination, "wb");
+    if (!Output) {
+        fclose(Input);
+        return false;
+    }
+
+    bool Success = true;
+    u8 Buffer[64 * 1024];
+    size_t Read;
+    while ((Read = fread(Buffer, 1, sizeof(Buffer), Input)) > 0) {
+        if (fwrite(Buffer, 1, Read, Output) != Read) {
+            Success = false;
+            break;
+        }
+    }
+
+    fclose(Input);
+    fclose(Output);
+    return Success;
+}
+
+void AssetManifestLoad(std::unordered_map<std::string, asset_manifest_entry>* Manifest)
+{
+    FILE* File = fopen(ASSET_MANIFEST_PATH, "r");
+    if (!File) {
+        return;
+    }
+
+    u32 Version = 0;
+    if (fscanf(File, "backrooms-manifest %u\n", &Version) != 1 || Version != ASSET_MANIFEST_VERSION) {
+        LogWarn("Ignoring asset manifest with an unknown version.");
+        fclose(File);
+        return;
+    }
+
+    char Line[1024];
+    while (fgets(Line, sizeof(Line), File)) {
+        asset_manifest_entry Entry;
+        char Output[1024];
+        if (sscanf(Line, "%llx %llx %1023[^\n]", &Entry.Key, &Entry.OutputHash, Output) == 3) {
+            (*Manifest)[Output] = Entry;
+        }
+    }
+
+    fclose(File);
+}
+
+void AssetManifestSave(const std::unordered_map<std::string, asset_manifest_entry>& Manifest)
+{
+    FILE* File = fopen(ASSET_MANIFEST_PATH, "w");
+    if (!File) {
+        LogError("Failed to write asset manifest: %s", ASSET_MANIFEST_PATH);
+        return;
+    }
+
+    fprintf(File, "backrooms-manifest %u\n", ASSET_MANIFEST_VERSION);
+    for (auto& Entry : Manifest) {
+        fprintf(File, "%016llx %016llx %s\n", Entry.second.Key, Entry.second.OutputHash, Entry.first.c_str());
+    }
+
+    fclose(File);
+}
+
+bool AssetStepKey(const asset_step* Step, u64* Key)
+{
+    u64 Hash = HashString(Step->Tool);
+    Hash = HashCombine(Hash, Step->ToolVersion);
+    Hash = HashCombine(Hash, HashString(Step->Settings));
+    Hash = HashCombine(Hash, HashString(Step->Output));
+
+    for (const std::string& Input : Step->Inputs) {
+        u64 InputHash;
+        if (!HashFile(Input.c_str(), &InputHash)) {
+            LogError("Missing input %s for asset %s", Input.c_str(), Step->Output.c_str());
+            return false;
+        }
+        Hash = HashCombine(Hash, HashString(Input));
+        Hash = HashCombine(Hash, InputHash);
+    }
+
+    *Key = Hash;
+    return true;
+}
+
+void AssetBuildSteps(void* Data, u32 Start, u32 End)
+{
+    asset_build_context* Context = (asset_build_context*)Data;
+
+    for (u32 OrderIndex = Start; OrderIndex < End; OrderIndex++) {
+        u32 StepIndex = Context->Order[OrderIndex];
+        const asset_step* Step = &Context->Graph->Steps[StepIndex];
+        asset_step_result* Result = &Context->Results[StepIndex];
+        asset_manifest_entry* Entry = &Context->Entries[StepIndex];
+
+        *Result = AssetStepResult_Failed;
+
+        // NOTE(milo): Producers always sit at an earlier level, so their results are final. A failed one leaves a stale or missing
+        // output on disk that must not be keyed or cooked against.
+        bool DependencyFailed = false;
+        for (u32 Producer : Context->Dependencies[StepIndex]) {
+            if (Context->Results[Producer] == AssetStepResult_Failed) {
+                LogError("Skipping asset %s, its input %s failed to build", Step->Output.c_str(), Context->Graph->Steps[Producer].Output.c_str());
+                DependencyFailed = true;
+                break;
+            }
+        }
+        if (DependencyFailed || !AssetStepKey(Step, &Entry->Key)) {
+            continue;
+        }
+
+        CODE_BLOCK("Up to date")
+        {
+            auto Previous = Context->Manifest->find(Step->Output);
+            u64 OutputHash;
+            if (Previous != Context->Manifest->end() && Previous->second.Key == Entry->Key &&
+                HashFile(Step->Output.c_str(), &OutputHash) && OutputHash == Previous->second.OutputHash) {
+                Entry->OutputHash = OutputHash;
+                *Result = AssetStepResult_UpToDate;
+                continue;
+            }
+        }
+
+        std::string CachePath = std::string(ASSET_CACHE_DIRECTORY) + "/" + HashToString(Entry->Key);
+
+        CODE_BLOCK("Cache")
+        {
+            if (AssetCopyFile(CachePath.c_str(), Step->Output.c_str()) && HashFile(Step->Output.c_str(), &Entry->OutputHash)) {
+                *Result = AssetStepResult_CacheHit;
+                continue;
+            }
+        }
+
+        CODE_BLOCK("Cook")
+        {
+            if (!Step->Cook(Step) || !HashFile(Step->Output.c_str(), &Entry->OutputHash)) {
+                LogError("Failed to cook asset: %s", Step->Output.c_str());
+                continue;
+            }
+
+            if (!AssetCopyFile(Step->Output.c_str(), CachePath.c_str())) {
+                LogWarn("Failed to store %s in the asset cache.", Step->Output.c_str());
+            }
+            *Result = AssetStepResult_Cooked;
+        }
+    }
+}
+
+void AssetGraphAdd(asset_graph* Graph, const asset_step& Step)
+{
+    Graph->Steps.push_back(Step);
+}
+
+asset_build_stats AssetGraphBuild(asset_graph* Graph)
+{
+    f32 StartTime = PlatformTimerGet();
+    u32 StepCount = (u32)Graph->Steps.size();
+
+    asset_build_stats Stats = {};
+    Stats.Total = StepCount;
+
+    PlatformCreateDirectory(ASSET_CACHE_DIRECTORY);
+
+    std::unordered_map<std::string, asset_manifest_entry> Manifest;
+    AssetManifestLoad(&Manifest);
+
+    // NOTE(milo): A step goes one level after the deepest step producing one of its inputs, each level is built in parallel.
+    std::vector<u32> Levels(StepCount, 0);
+    std::vector<std::vector<u32>> Dependencies(StepCount);
+    u32 LevelCount = StepCount > 0 ? 1 : 0;
+    CODE_BLOCK("Dependency levels")
+    {
+        std::unordered_map<std::string, u32> Producers;
+        for (u32 StepIndex = 0; StepIndex < StepCount; StepIndex++) {
+            Producers[Graph->Steps[StepIndex].Output] = StepIndex;
+        }
+
+        for (u32 StepIndex = 0; StepIndex < StepCount; StepIndex++) {
+            for (const std::string& Input : Graph->Steps[StepIndex].Inputs) {
+                auto Producer = Producers.find(Input);
+                if (Producer != Producers.end()) {
+                    Dependencies[StepIndex].push_back(Producer->second);
+                }
+            }
+        }
+
+        // NOTE(milo): Relaxing StepCount times settles any acyclic graph, a level past that means a cycle.
+        for (u32 Pass = 0; Pass < StepCount; Pass++) {
+            bool Changed = false;
+            for (u32 StepIndex = 0; StepIndex < StepCount; StepIndex++) {
+                for (const std::string& Input : Graph->Steps[StepIndex].Inputs) {
+                    auto Producer = Producers.find(Input);
+                    if (Producer != Producers.end() && Levels[StepIndex] <= Levels[Producer->second]) {
+                        Levels[StepIndex] = Levels[Producer->second] + 1;
+                        Changed = true;
+                    }
+                }
+            }
+            if (!Changed) {
+                break;
+            }
+        }
+
+        for (u32 StepIndex = 0; StepIndex < StepCount; StepIndex++) {
+            if (Levels[StepIndex] >= StepCount) {
+                LogError("Asset build graph has a cycle through %s", Graph->Steps[StepIndex].Output.c_str());
+                Stats.Failed = StepCount;
+                return Stats;
+            }
+            LevelCount = Levels[StepIndex] + 1 > LevelCount ? Levels[StepIndex] + 1 : LevelCount;
+        }
+    }
+
+    std::vector<asset_step_result> Results(StepCount, AssetStepResult_Failed);
+    std::vector<asset_manifest_entry> Entries(StepCount);
+
+    asset_build_context Context;
+    Context.Graph = Graph;
+    Context.Manifest = &Manifest;
+    Context.Dependencies = Dependencies.data();
+    Context.Results = Results.data();
+    Context.Entries = Entries.data();
+
+    for (u32 Level = 0; Level < LevelCount; Level++) {
+        std::vector<u32> Order;
+        for (u32 StepIndex = 0; StepIndex < StepCount; StepIndex++) {
+            if (Levels[StepIndex] == Level) {
+                Order.push_back(StepIndex);
+            }
+        }
+
+        Context.Order = Order.data();
+        job_counter Counter = {};
+        JobParallelFor((u32)Order.size(), 1, AssetBuildSteps, &Context, &Counter);
+        JobWait(&Counter);
+    }
+
+    for (u32 StepIndex = 0; StepIndex < StepCount; StepIndex++) {
+        switch (Results[StepIndex]) {
+            case AssetStepResult_UpToDate: Stats.UpToDate++; break;
+            case AssetStepResult_CacheHit: Stats.CacheHits++; break;
+            case AssetStepResult_Cooked: Stats.Cooked++; break;
+            case AssetStepResult_Failed: Stats.Failed++; break;
+        }
+
+        if (Results[StepIndex] != AssetStepResult_Failed) {
+            Manifest[Graph->Steps[StepIndex].Output] = Entries[StepIndex];
+        } else {
+            Manifest.erase(Graph->Steps[StepIndex].Output);
+        }
+    }
+
+    AssetManifestSave(Manifest);
+
+    Stats.Seconds = PlatformTimerGet() - StartTime;
+    LogInfo("Asset build: %u up to date, %u from cache, %u cooked, %u failed in %.2fs", Stats.UpToDate, Stats.CacheHits, Stats.Cooked, Stats.Failed, Stats.Seconds);
+    return Stats;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "backrooms_common.h"
+
+#include <string>
+#include <vector>
+
+#define ASSET_CACHE_DIRECTORY "data/.cache"
+#define ASSET_MANIFEST_PATH "data/.cache/manifest.txt"
+#define ASSET_MANIFEST_VERSION 1
+
+struct asset_step;
+typedef bool (*PFN_AssetCook)(const asset_step* Step);
+
+enum asset_step_result
+{
+    AssetStepResult_UpToDate,
+    AssetStepResult_CacheHit,
+    AssetStepResult_Cooked,
+    AssetStepResult_Failed
+};
+
+// NOTE(milo): Everything that can change an output has to be part of the step: the tool and its version, the settings and the inputs.
+struct asset_step
+{
+    std::string Tool;
+    u32 ToolVersion;
+    std::string Settings;
+    std::vector<std::string> Inputs;
+    std::string Output;
+    PFN_AssetCook Cook;
+};
+
+struct asset_graph
+{
+    std::vector<asset_step> Steps;
+};
+
+struct asset_build_stats
+{
+    u32 Total;
+    u32 UpToDate;
+    u32 CacheHits;
+    u32 Cooked;
+    u32 Failed;
+    f32 Seconds;
+};
+
+//~ NOTE(milo): Asset build graph
+void AssetGraphAdd(asset_graph* Graph, const asset_step& Step);
+asset_build_stats AssetGraphBuild(asset_graph* Graph);
@@ -0,0 +1,385 @@
+#include "backrooms_atlas.h"
+#include "backrooms_asset_build.h"
+#include "backrooms_pack.h"
+#include "backrooms_logger.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb/stb_image.h>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imgui/imstb_rectpack.h>
+
+//~ NOTE(milo): Layout files
+
+std::string AtlasLayoutPath(const std::string& MeshPath)
+{
+    return MeshPath + ATLAS_EXTENSION;
+}
+
+const char* AtlasRoleName(texture_role Role)
+{
+    switch (Role) {
+        case TextureRole_Albedo: return "albedo";
+        case TextureRole_Normal: return "normal";
+        case TextureRole_PBR: return "pbr";
+    }
+    return "unknown";
+}
+
+std::string AtlasPagePath(const std::string& LayoutPath, u32 Page, texture_role Role)
+{
+    return LayoutPath + "." + std::to_string(Page) + "." + AtlasRoleName(Role) + COOKED_TEXTURE_EXTENSION;
+}
+
+const std::string& AtlasSourcePath(const atlas_source& Source, texture_role Role)
+{
+    switch (Role) {
+        case TextureRole_Normal: return Source.Normal;
+        case TextureRole_PBR: return Source.PBR;
+        default: return Source.Albedo;
+    }
+}
+
+std::vector<std::string> AtlasSplitLines(const char* Data, u64 Size)
+{
+    std::vector<std::string> Lines;
+    std::string Line;
+    for (u64 Index = 0; Index < Size; Index++) {
+        if (Data[Index] == '\n') {
+            Lines.push_back(Line);
+            Line.clear();
+        } else if (Data[Index] != '\r') {
+            Line += Data[Index];
+        }
+    }
+    if (!Line.empty()) {
+        Lines.push_back(Line);
+    }
+    return Lines;
+}
+
+// NOTE(milo): A header line, then one line with the page and rect of every entry followed by its albedo, normal and PBR paths.
+bool AtlasWriteLayout(const char* Path, const atlas_layout* Layout)
+{
+    FILE* File = fopen(Path, "wb");
+    if (!File) {
+        LogError("Failed to open atlas layout for writing: %s", Path);
+        return false;
+    }
+
+    fprintf(File, "atlas %u %u %zu\n", ATLAS_VERSION, Layout->PageCount, Layout->Entries.size());
+    for (const atlas_entry& Entry : Layout->Entries) {
+        fprintf(File, "%u %u %u %u %u\n", Entry.Page, Entry.X, Entry.Y, Entry.Width, Entry.Height);
+        fprintf(File, "%s\n%s\n%s\n", Entry.Source.Albedo.c_str(), Entry.Source.Normal.c_str(), Entry.Source.PBR.c_str());
+    }
+
+    bool Written = ferror(File) == 0;
+    fclose(File);
+    return Written;
+}
+
+bool AtlasLoadLayout(const char* Path, atlas_layout* Layout)
+{
+    u64 Size;
+    char* Data = (char*)PackReadFile(Path, &Size);
+    if (!Data) {
+        return false;
+    }
+    std::vector<std::string> Lines = AtlasSplitLines(Data, Size);
+    free(Data);
+
+    u32 Version = 0, EntryCount = 0;
+    if (Lines.empty() || sscanf(Lines[0].c_str(), "atlas %u %u %u", &Version, &Layout->PageCount, &EntryCount) != 3 || Version != ATLAS_VERSION) {
+        LogError("Invalid atlas layout: %s", Path);
+        return false;
+    }
+
+    if (Lines.size() < 1 + (size_t)EntryCount * 4) {
+        LogError("Truncated atlas layout: %s", Path);
+        return false;
+    }
+
+    Layout->Entries.resize(EntryCount);
+    for (u32 EntryIndex = 0; EntryIndex < EntryCount; EntryIndex++) {
+        atlas_entry* Entry = &Layout->Entries[EntryIndex];
+        const std::string* Line = &Lines[1 + EntryIndex * 4];
+        if (sscanf(Line[0].c_str(), "%u %u %u %u %u", &Entry->Page, &Entry->X, &Entry->Y, &Entry->Width, &Entry->Height) != 5) {
+            LogError("Invalid entry %u in atlas layout: %s", EntryIndex, Path);
+            Layout->Entries.clear();
+            return false;
+        }
+        Entry->Source.Albedo = Line[1];
+        Entry->Source.Normal = Line[2];
+        Entry->Source.PBR = Line[3];
+    }
+    return true;
+}
+
+const atlas_entry* AtlasFind(const atlas_layout* Layout, const atlas_source& Source)
+{
+    for (const atlas_entry& Entry : Layout->Entries) {
+        if (Entry.Source.Albedo == Source.Albedo && Entry.Source.Normal == Source.Normal && Entry.Source.PBR == Source.PBR) {
+            return &Entry;
+        }
+    }
+    return NULL;
+}
+
+bool AtlasPageHasRole(const atlas_layout* Layout, u32 Page, texture_role Role)
+{
+    for (const atlas_entry& Entry : Layout->Entries) {
+        if (Entry.Page == Page && !AtlasSourcePath(Entry.Source, Role).empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE(milo): Offset in XY and scale in ZW, the shader maps the wrapped UV of the material into the entry with them.
+hmm_vec4 AtlasEntryRect(const atlas_entry* Entry)
+{
+    return HMM_Vec4((f32)Entry->X / ATLAS_SIZE, (f32)Entry->Y / ATLAS_SIZE, (f32)Entry->Width / ATLAS_SIZE, (f32)Entry->Height / ATLAS_SIZE);
+}
+
+//~ NOTE(milo): Atlas cooking
+
+// NOTE(milo): Only small materials whose textures all have the same size go in the atlas, the rest keep their own textures.
+bool AtlasSourceSize(const atlas_source& Source, i32* Width, i32* Height)
+{
+    const std::string* Paths[] = { &Source.Albedo, &Source.Normal, &Source.PBR };
+
+    *Width = 0;
+    *Height = 0;
+    for (const std::string* Path : Paths) {
+        if (Path->empty()) {
+            continue;
+        }
+
+        i32 ImageWidth, ImageHeight, Channels;
+        if (!stbi_info(Path->c_str(), &ImageWidth, &ImageHeight, &Channels)) {
+            return false;
+        }
+        if (*Width != 0 && (ImageWidth != *Width || ImageHeight != *Height)) {
+            return false;
+        }
+        *Width = ImageWidth;
+        *Height = ImageHeight;
+    }
+
+    return *Width > 0 && *Width <= ATLAS_MAX_ENTRY_SIZE && *Height <= ATLAS_MAX_ENTRY_SIZE && (*Width % 4) == 0 && (*Height % 4) == 0;
+}
+
+// NOTE(milo): Packs in units of ATLAS_ALIGNMENT so every entry lands aligned, pages are added until everything fits.
+bool AtlasPack(atlas_layout* Layout)
+{
+    const i32 Cells = ATLAS_SIZE / ATLAS_ALIGNMENT;
+
+    std::vector<stbrp_rect> Remaining(Layout->Entries.size());
+    for (u32 EntryIndex = 0; EntryIndex < Layout->Entries.size(); EntryIndex++) {
+        atlas_entry* Entry = &Layout->Entries[EntryIndex];
+        Remaining[EntryIndex] = {};
+        Remaining[EntryIndex].id = (i32)EntryIndex;
+        Remaining[EntryIndex].w = (Entry->Width + 2 * ATLAS_GUTTER + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT;
+        Remaining[EntryIndex].h = (Entry->Height + 2 * ATLAS_GUTTER + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT;
+    }
+
+    std::vector<stbrp_node> Nodes(Cells);
+    Layout->PageCount = 0;
+    while (!Remaining.empty()) {
+        stbrp_context Context;
+        stbrp_init_target(&Context, Cells, Cells, Nodes.data(), Cells);
+        stbrp_pack_rects(&Context, Remaining.data(), (i32)Remaining.size());
+
+        std::vector<stbrp_rect> Unpacked;
+        for (stbrp_rect& Rect : Remaining) {
+            if (!Rect.was_packed) {
+                Unpacked.push_back(Rect);
+                continue;
+            }
+            atlas_entry* Entry = &Layout->Entries[Rect.id];
+            Entry->Page = Layout->PageCount;
+            Entry->X = Rect.x * ATLAS_ALIGNMENT + ATLAS_GUTTER;
+            Entry->Y = Rect.y * ATLAS_ALIGNMENT + ATLAS_GUTTER;
+        }
+
+        if (Unpacked.size() == Remaining.size()) {
+            LogError("Atlas entry does not fit in an empty page.");
+            return false;
+        }
+        Remaining = std::move(Unpacked);
+        Layout->PageCount++;
+    }
+    return true;
+}
+
+// NOTE(milo): The settings hold the albedo, normal and PBR paths of every source, one per line.
+bool AtlasCookLayout(const asset_step* Step)
+{
+    std::vector<std::string> Lines = AtlasSplitLines(Step->Settings.data(), Step->Settings.size());
+
+    atlas_layout Layout = {};
+    for (size_t LineIndex = 0; LineIndex + 2 < Lines.size(); LineIndex += 3) {
+        atlas_entry Entry = {};
+        Entry.Source.Albedo = Lines[LineIndex + 0];
+        Entry.Source.Normal = Lines[LineIndex + 1];
+        Entry.Source.PBR = Lines[LineIndex + 2];
+
+        i32 Width, Height;
+        if (!AtlasSourceSize(Entry.Source, &Width, &Height)) {
+            LogError("Atlas source %s changed size while cooking.", Entry.Source.Albedo.c_str());
+            return false;
+        }
+        Entry.Width = (u32)Width;
+        Entry.Height = (u32)Height;
+        Layout.Entries.push_back(Entry);
+    }
+
+    if (!AtlasPack(&Layout)) {
+        return false;
+    }
+
+    LogInfo("Packed %zu atlas entries into %u pages.", Layout.Entries.size(), Layout.PageCount);
+    return AtlasWriteLayout(Step->Output.c_str(), &Layout);
+}
+
+// NOTE(milo): Fills the entry and its gutter, the gutter repeats the image so wrapped UVs filter across the seam like a tiled texture.
+void AtlasBlitEntry(u8* Page, const atlas_entry* Entry, const u8* Image)
+{
+    i32 Width = (i32)Entry->Width;
+    i32 Height = (i32)Entry->Height;
+
+    for (i32 Y = -ATLAS_GUTTER; Y < Height + ATLAS_GUTTER; Y++) {
+        i32 SourceY = ((Y % Height) + Height) % Height;
+        u8* Row = Page + ((size_t)(Entry->Y + Y) * ATLAS_SIZE + (Entry->X - ATLAS_GUTTER)) * 4;
+
+        for (i32 X = -ATLAS_GUTTER; X < Width + ATLAS_GUTTER; X++) {
+            i32 SourceX = ((X % Width) + Width) % Width;
+            memcpy(Row + (X + ATLAS_GUTTER) * 4, Image + ((size_t)SourceY * Width + SourceX) * 4, 4);
+        }
+    }
+}
+
+// NOTE(milo): The settings are the page and the role, the first input is the layout.
+bool AtlasCookPage(const asset_step* Step)
+{
+    u32 PageIndex, Role;
+    if (sscanf(Step->Settings.c_str(), "%u %u", &PageIndex, &Role) != 2) {
+        return false;
+    }
+
+    atlas_layout Layout = {};
+    if (!AtlasLoadLayout(Step->Inputs[0].c_str(), &Layout)) {
+        return false;
+    }
+
+    // NOTE(milo): Space no entry uses holds a neutral value for the role, it is never sampled.
+    u8 Neutral[4] = { 0, 0, 0, 255 };
+    if (Role == TextureRole_Normal) {
+        Neutral[0] = 128; Neutral[1] = 128; Neutral[2] = 255;
+    } else if (Role == TextureRole_PBR) {
+        Neutral[1] = 255;
+    }
+
+    std::vector<u8> Page((size_t)ATLAS_SIZE * ATLAS_SIZE * 4);
+    for (size_t Texel = 0; Texel < (size_t)ATLAS_SIZE * ATLAS_SIZE; Texel++) {
+        memcpy(&Page[Texel * 4], Neutral, 4);
+    }
+
+    for (const atlas_entry& Entry : Layout.Entries) {
+        const std::string& Path = AtlasSourcePath(Entry.Source, (texture_role)Role);
+        if (Entry.Page != PageIndex || Path.empty()) {
+            continue;
+        }
+
+        i32 Width = 0, Height = 0, Channels = 0;
+        u8* Image = stbi_load(Path.c_str(), &Width, &Height, &Channels, STBI_rgb_alpha);
+        if (!Image || Width != (i32)Entry.Width || Height != (i32)Entry.Height) {
+            LogError("Failed to load atlas source: %s", Path.c_str());
+            if (Image) stbi_image_free(Image);
+            return false;
+        }
+
+        AtlasBlitEntry(Page.data(), &Entry, Image);
+        stbi_image_free(Image);
+    }
+
+    return TextureCookPixels(Page.data(), ATLAS_SIZE, ATLAS_SIZE, Step->Output.c_str(), (texture_role)Role, ATLAS_MIP_COUNT);
+}
+
+// NOTE(milo): Two passes, the layout decides how many pages there are and the pages are cooked from it. Both go through the asset graph,
+// so an unchanged set of sources costs a hash of the inputs.
+void AtlasCookMesh(const std::string& MeshPath, const std::vector<atlas_source>& Sources)
+{
+    std::string LayoutPath = AtlasLayoutPath(MeshPath);
+
+    asset_step Layout;
+    Layout.Tool = "atlas_layout";
+    Layout.ToolVersion = ATLAS_VERSION;
+    Layout.Output = LayoutPath;
+    Layout.Cook = AtlasCookLayout;
+
+    std::vector<atlas_source> Packed;
+    for (const atlas_source& Source : Sources) {
+        bool Duplicate = false;
+        for (const atlas_source& Other : Packed) {
+            Duplicate |= Other.Albedo == Source.Albedo && Other.Normal == Source.Normal && Other.PBR == Source.PBR;
+        }
+
+        i32 Width, Height;
+        if (Duplicate || !AtlasSourceSize(Source, &Width, &Height)) {
+            continue;
+        }
+
+        Packed.push_back(Source);
+        Layout.Settings += Source.Albedo + "\n" + Source.Normal + "\n" + Source.PBR + "\n";
+        for (const std::string* Path : { &Source.Albedo, &Source.Normal, &Source.PBR }) {
+            if (!Path->empty()) Layout.Inputs.push_back(*Path);
+        }
+    }
+
+    // NOTE(milo): A stale layout would keep materials pointing into pages that are no longer cooked.
+    if (Packed.empty()) {
+        remove(LayoutPath.c_str());
+        return;
+    }
+
+    asset_graph LayoutGraph;
+    AssetGraphAdd(&LayoutGraph, Layout);
+    if (AssetGraphBuild(&LayoutGraph).Failed > 0) {
+        return;
+    }
+
+    atlas_layout Atlas = {};
+    if (!AtlasLoadLayout(LayoutPath.c_str(), &Atlas)) {
+        return;
+    }
+
+    asset_graph PageGraph;
+    for (u32 Page = 0; Page < Atlas.PageCount; Page++) {
+        for (texture_role Role : { TextureRole_Albedo, TextureRole_Normal, TextureRole_PBR }) {
+            if (!AtlasPageHasRole(&Atlas, Page, Role)) {
+                continue;
+            }
+
+            asset_step Step;
+            Step.Tool = "atlas_page";
+            Step.ToolVersion = ATLAS_VERSION * 1000000 + TEXTURE_COOKER_VERSION * 1000 + COOKED_TEXTURE_VERSION;
+            Step.Settings = std::to_string(Page) + " " + std::to_string((u32)Role);
+            Step.Inputs.push_back(LayoutPath);
+            for (const atlas_entry& Entry : Atlas.Entries) {
+                const std::string& Path = AtlasSourcePath(Entry.Source, Role);
+                if (Entry.Page == Page && !Path.empty()) {
+                    Step.Inputs.push_back(Path);
+                }
+            }
+            Step.Output = AtlasPagePath(LayoutPath, Page, Role);
+            Step.Cook = AtlasCookPage;
+            AssetGraphAdd(&PageGraph, Step);
+        }
+    }
+    AssetGraphBuild(&PageGraph);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_texture.h"
+
+#include <string>
+#include <vector>
+
+#define ATLAS_VERSION 1
+#define ATLAS_EXTENSION ".atlas"
+#define ATLAS_SIZE 2048
+#define ATLAS_MAX_ENTRY_SIZE 256
+#define ATLAS_MIP_COUNT 3
+
+// NOTE(milo): Entries start on a block boundary of the last mip and are surrounded by a wrapped border of the same size, so every mip of
+// the atlas still has a 4 texel gutter and no compressed block spans two entries.
+#define ATLAS_ALIGNMENT (4 << (ATLAS_MIP_COUNT - 1))
+#define ATLAS_GUTTER ATLAS_ALIGNMENT
+
+// NOTE(milo): The textures of one material, all of the same size. Normal and PBR are empty when the material has none.
+struct atlas_source
+{
+    std::string Albedo;
+    std::string Normal;
+    std::string PBR;
+};
+
+// NOTE(milo): X, Y, Width and Height cover the entry's texels in its page, the gutter lies around them.
+struct atlas_entry
+{
+    atlas_source Source;
+    u32 Page;
+    u32 X;
+    u32 Y;
+    u32 Width;
+    u32 Height;
+};
+
+struct atlas_layout
+{
+    u32 PageCount;
+    std::vector<atlas_entry> Entries;
+};
+
+//~ NOTE(milo): Atlas cooking
+std::string AtlasLayoutPath(const std::string& MeshPath);
+std::string AtlasPagePath(const std::string& LayoutPath, u32 Page, texture_role Role);
+void AtlasCookMesh(const std::string& MeshPath, const std::vector<atlas_source>& Sources);
+
+//~ NOTE(milo): Atlas layouts
+bool AtlasLoadLayout(const char* Path, atlas_layout* Layout);
+const atlas_entry* AtlasFind(const atlas_layout* Layout, const atlas_source& Source);
+bool AtlasPageHasRole(const atlas_layout* Layout, u32 Page, texture_role Role);
+hmm_vec4 AtlasEntryRect(const atlas_entry* Entry);
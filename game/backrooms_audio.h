@@ -22,6 +22,7 @@ struct audio_source
     f32 Volume;
     f32 Pitch;
     i16* Samples;
+    void* FileData;
 
     audio_source_type Type;
     struct {
@@ -0,0 +1,543 @@
+#include "backrooms_bvh.h"
+#include "backrooms_job.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <utility>
+
+enum bvh_overlap
+{
+    BvhOverlap_Outside,
+    BvhOverlap_Partial,
+    BvhOverlap_Inside
+};
+
+typedef bvh_overlap (*PFN_BvhClassify)(const aabb* Box, const bvh_query* Query);
+
+//~ NOTE(milo): Bounds
+
+aabb AabbEmpty()
+{
+    aabb Box;
+    Box.Min = HMM_Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Box.Max = HMM_Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    return Box;
+}
+
+void AabbGrow(aabb* Box, const aabb* Other)
+{
+    Box->Min = HMM_Vec3(fminf(Box->Min.X, Other->Min.X), fminf(Box->Min.Y, Other->Min.Y), fminf(Box->Min.Z, Other->Min.Z));
+    Box->Max = HMM_Vec3(fmaxf(Box->Max.X, Other->Max.X), fmaxf(Box->Max.Y, Other->Max.Y), fmaxf(Box->Max.Z, Other->Max.Z));
+}
+
+void AabbGrowPoint(aabb* Box, hmm_vec3 Point)
+{
+    aabb Other = { Point, Point };
+    AabbGrow(Box, &Other);
+}
+
+aabb AabbFromSphere(hmm_vec4 Sphere)
+{
+    hmm_vec3 Extent = HMM_Vec3(Sphere.W, Sphere.W, Sphere.W);
+
+    aabb Box;
+    Box.Min = HMM_SubtractVec3(Sphere.XYZ, Extent);
+    Box.Max = HMM_AddVec3(Sphere.XYZ, Extent);
+    return Box;
+}
+
+aabb AabbTransform(const aabb* Box, hmm_mat4 Transform)
+{
+    aabb Result = AabbEmpty();
+    for (u32 Corner = 0; Corner < 8; Corner++) {
+        hmm_vec3 Point = HMM_Vec3((Corner & 1) ? Box->Max.X : Box->Min.X, (Corner & 2) ? Box->Max.Y : Box->Min.Y, (Corner & 4) ? Box->Max.Z : Box->Min.Z);
+        AabbGrowPoint(&Result, HMM_MultiplyMat4ByVec4(Transform, HMM_Vec4v(Point, 1.0f)).XYZ);
+    }
+    return Result;
+}
+
+bool AabbContains(const aabb* Box, hmm_vec3 Point, f32 Margin)
+{
+    for (i32 Axis = 0; Axis < 3; Axis++) {
+        if (Point.Elements[Axis] < Box->Min.Elements[Axis] - Margin || Point.Elements[Axis] > Box->Max.Elements[Axis] + Margin) {
+            return false;
+        }
+    }
+    return true;
+}
+
+f32 AabbSurfaceArea(const aabb* Box)
+{
+    hmm_vec3 Size = HMM_SubtractVec3(Box->Max, Box->Min);
+    return 2.0f * (Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X);
+}
+
+hmm_vec3 AabbCenter(const aabb* Box)
+{
+    return HMM_MultiplyVec3f(HMM_AddVec3(Box->Min, Box->Max), 0.5f);
+}
+
+//~ NOTE(milo): Tree
+
+void BvhResize(bvh* Tree, u32 Count)
+{
+    Tree->ItemBounds.resize(Count, AabbEmpty());
+    Tree->NeedsRebuild = true;
+}
+
+aabb BvhNodeBounds(const bvh* Tree, const bvh_node* Node)
+{
+    aabb Bounds = AabbEmpty();
+    if (Node->Left) {
+        AabbGrow(&Bounds, &Tree->Nodes[Node->Left].Bounds);
+        AabbGrow(&Bounds, &Tree->Nodes[Node->Left + 1].Bounds);
+    } else {
+        for (u32 Index = Node->First; Index < Node->First + Node->Count; Index++) {
+            AabbGrow(&Bounds, &Tree->ItemBounds[Tree->Items[Index]]);
+        }
+    }
+    return Bounds;
+}
+
+// NOTE(milo): Walks from the item's leaf to the root and stops at the first node whose bounds did not change.
+void BvhSetItem(bvh* Tree, u32 Item, aabb Bounds)
+{
+    assert(Item < Tree->ItemBounds.size());
+    Tree->ItemBounds[Item] = Bounds;
+    if (Tree->NeedsRebuild || Tree->Nodes.empty()) {
+        return;
+    }
+
+    u32 NodeIndex = Tree->ItemLeaf[Item];
+    for (;;) {
+        bvh_node* Node = &Tree->Nodes[NodeIndex];
+        aabb Refit = BvhNodeBounds(Tree, Node);
+        bool Changed = memcmp(&Refit, &Node->Bounds, sizeof(aabb)) != 0;
+        Node->Bounds = Refit;
+
+        if (!Changed || NodeIndex == 0) {
+            break;
+        }
+        NodeIndex = Node->Parent;
+    }
+    Tree->Refits++;
+}
+
+// NOTE(milo): Binned SAH over the centroids on every axis. Returns false when keeping the node as a leaf is cheaper.
+bool BvhFindSplit(const bvh* Tree, const bvh_node* Node, const std::vector<hmm_vec3>& Centroids, u32* SplitAxis, u32* SplitBin, aabb* CentroidBounds)
+{
+    *CentroidBounds = AabbEmpty();
+    for (u32 Index = Node->First; Index < Node->First + Node->Count; Index++) {
+        AabbGrowPoint(CentroidBounds, Centroids[Tree->Items[Index]]);
+    }
+
+    f32 NodeArea = AabbSurfaceArea(&Node->Bounds);
+    f32 BestCost = (f32)Node->Count;
+    bool Found = false;
+
+    for (u32 Axis = 0; Axis < 3; Axis++) {
+        f32 Min = CentroidBounds->Min.Elements[Axis];
+        f32 Extent = CentroidBounds->Max.Elements[Axis] - Min;
+        if (Extent <= 0.0f) {
+            continue;
+        }
+
+        aabb BinBounds[BVH_SAH_BINS];
+        u32 BinCounts[BVH_SAH_BINS] = {};
+        for (u32 Bin = 0; Bin < BVH_SAH_BINS; Bin++) {
+            BinBounds[Bin] = AabbEmpty();
+        }
+
+        f32 Scale = BVH_SAH_BINS / Extent;
+        for (u32 Index = Node->First; Index < Node->First + Node->Count; Index++) {
+            u32 Item = Tree->Items[Index];
+            u32 Bin = (u32)((Centroids[Item].Elements[Axis] - Min) * Scale);
+            Bin = Bin < BVH_SAH_BINS ? Bin : BVH_SAH_BINS - 1;
+            BinCounts[Bin]++;
+            AabbGrow(&BinBounds[Bin], &Tree->ItemBounds[Item]);
+        }
+
+        // NOTE(milo): Sweep from the right first so every split between bins has both sides' area and count.
+        f32 RightAreas[BVH_SAH_BINS];
+        u32 RightCounts[BVH_SAH_BINS];
+        aabb Right = AabbEmpty();
+        u32 RightCount = 0;
+        for (u32 Bin = BVH_SAH_BINS - 1; Bin > 0; Bin--) {
+            AabbGrow(&Right, &BinBounds[Bin]);
+            RightCount += BinCounts[Bin];
+            RightAreas[Bin] = RightCount ? AabbSurfaceArea(&Right) : 0.0f;
+            RightCounts[Bin] = RightCount;
+        }
+
+        aabb Left = AabbEmpty();
+        u32 LeftCount = 0;
+        for (u32 Bin = 0; Bin < BVH_SAH_BINS - 1; Bin++) {
+            AabbGrow(&Left, &BinBounds[Bin]);
+            LeftCount += BinCounts[Bin];
+            if (LeftCount == 0 || RightCounts[Bin + 1] == 0) {
+                continue;
+            }
+
+            f32 Cost = BVH_TRAVERSAL_COST + (LeftCount * AabbSurfaceArea(&Left) + RightCounts[Bin + 1] * RightAreas[Bin + 1]) / NodeArea;
+            if (Cost < BestCost) {
+                BestCost = Cost;
+                *SplitAxis = Axis;
+                *SplitBin = Bin;
+                Found = true;
+            }
+        }
+    }
+
+    // NOTE(milo): Big leaves are split in the middle of the widest centroid axis even when SAH disagrees.
+    if (!Found && Node->Count > BVH_MAX_LEAF_ITEMS) {
+        hmm_vec3 Extent = HMM_SubtractVec3(CentroidBounds->Max, CentroidBounds->Min);
+        u32 Widest = Extent.X >= Extent.Y && Extent.X >= Extent.Z ? 0 : (Extent.Y >= Extent.Z ? 1 : 2);
+        if (Extent.Elements[Widest] > 0.0f) {
+            *SplitAxis = Widest;
+            *SplitBin = BVH_SAH_BINS / 2 - 1;
+            Found = true;
+        }
+    }
+    return Found;
+}
+
+void BvhBuild(bvh* Tree)
+{
+    u32 Count = (u32)Tree->ItemBounds.size();
+    Tree->Items.resize(Count);
+    Tree->ItemLeaf.assign(Count, 0);
+    Tree->Nodes.clear();
+    Tree->NeedsRebuild = false;
+    Tree->Refits = 0;
+    Tree->BuiltCost = 0.0f;
+    if (Count == 0) {
+        return;
+    }
+
+    std::vector<hmm_vec3> Centroids(Count);
+    for (u32 Item = 0; Item < Count; Item++) {
+        Tree->Items[Item] = Item;
+        Centroids[Item] = AabbCenter(&Tree->ItemBounds[Item]);
+    }
+
+    Tree->Nodes.reserve(Count * 2);
+    Tree->Nodes.push_back({ AabbEmpty(), 0, Count, 0, 0 });
+
+    std::vector<u32> Stack = { 0 };
+    while (!Stack.empty()) {
+        u32 NodeIndex = Stack.back();
+        Stack.pop_back();
+
+        bvh_node Node = Tree->Nodes[NodeIndex];
+        Node.Bounds = BvhNodeBounds(Tree, &Node);
+        Tree->Nodes[NodeIndex].Bounds = Node.Bounds;
+
+        u32 Axis = 0, SplitBin = 0;
+        aabb CentroidBounds;
+        u32 Middle = Node.First;
+        if (Node.Count > 1 && BvhFindSplit(Tree, &Node, Centroids, &Axis, &SplitBin, &CentroidBounds)) {
+            f32 Min = CentroidBounds.Min.Elements[Axis];
+            f32 Scale = BVH_SAH_BINS / (CentroidBounds.Max.Elements[Axis] - Min);
+
+            u32 End = Node.First + Node.Count;
+            for (u32 Index = Node.First; Index < End; Index++) {
+                u32 Bin = (u32)((Centroids[Tree->Items[Index]].Elements[Axis] - Min) * Scale);
+                Bin = Bin < BVH_SAH_BINS ? Bin : BVH_SAH_BINS - 1;
+                if (Bin <= SplitBin) {
+                    std::swap(Tree->Items[Index], Tree->Items[Middle++]);
+                }
+            }
+        }
+
+        if (Middle == Node.First || Middle == Node.First + Node.Count) {
+            for (u32 Index = Node.First; Index < Node.First + Node.Count; Index++) {
+                Tree->ItemLeaf[Tree->Items[Index]] = NodeIndex;
+            }
+            continue;
+        }
+
+        u32 Left = (u32)Tree->Nodes.size();
+        Tree->Nodes.push_back({ AabbEmpty(), Node.First, Middle - Node.First, 0, NodeIndex });
+        Tree->Nodes.push_back({ AabbEmpty(), Middle, Node.First + Node.Count - Middle, 0, NodeIndex });
+        Tree->Nodes[NodeIndex].Left = Left;
+
+        Stack.push_back(Left);
+        Stack.push_back(Left + 1);
+    }
+
+    // NOTE(milo): Children are always created after their parent, walking backwards fixes every interior node's bounds.
+    for (u32 NodeIndex = (u32)Tree->Nodes.size(); NodeIndex-- > 0;) {
+        if (Tree->Nodes[NodeIndex].Left) {
+            Tree->Nodes[NodeIndex].Bounds = BvhNodeBounds(Tree, &Tree->Nodes[NodeIndex]);
+        }
+    }
+    Tree->BuiltCost = BvhCost(Tree);
+}
+
+// NOTE(milo): Rebuilds after items were added, or once enough refits happened and they made the tree noticeably worse.
+void BvhMaintain(bvh* Tree)
+{
+    if (Tree->NeedsRebuild) {
+        BvhBuild(Tree);
+        return;
+    }
+
+    u32 Threshold = (u32)Tree->ItemBounds.size() > BVH_MIN_REFITS ? (u32)Tree->ItemBounds.size() : BVH_MIN_REFITS;
+    if (Tree->Refits >= Threshold) {
+        Tree->Refits = 0;
+        if (BvhCost(Tree) > Tree->BuiltCost * BVH_REBUILD_RATIO) {
+            BvhBuild(Tree);
+        }
+    }
+}
+
+// NOTE(milo): Expected cost of a query reaching the root, relative to the root's area.
+f32 BvhCost(const bvh* Tree)
+{
+    if (Tree->Nodes.empty()) {
+        return 0.0f;
+    }
+
+    f32 RootArea = AabbSurfaceArea(&Tree->Nodes[0].Bounds);
+    if (RootArea <= 0.0f) {
+        return 0.0f;
+    }
+
+    f32 Cost = 0.0f;
+    for (const bvh_node& Node : Tree->Nodes) {
+        Cost += AabbSurfaceArea(&Node.Bounds) * (Node.Left ? BVH_TRAVERSAL_COST : (f32)Node.Count);
+    }
+    return Cost / RootArea;
+}
+
+void BvhFree(bvh* Tree)
+{
+    Tree->Nodes.clear();
+    Tree->Items.clear();
+    Tree->ItemBounds.clear();
+    Tree->ItemLeaf.clear();
+    Tree->NeedsRebuild = false;
+    Tree->Refits = 0;
+    Tree->BuiltCost = 0.0f;
+}
+
+//~ NOTE(milo): Queries
+
+bvh_overlap BvhClassifyFrustum(const aabb* Box, const bvh_query* Query)
+{
+    hmm_vec3 Center = AabbCenter(Box);
+    hmm_vec3 Extent = HMM_MultiplyVec3f(HMM_SubtractVec3(Box->Max, Box->Min), 0.5f);
+
+    bvh_overlap Overlap = BvhOverlap_Inside;
+    for (i32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+        hmm_vec4 Plane = Query->Planes[PlaneIndex];
+        f32 Distance = HMM_DotVec3(Plane.XYZ, Center) + Plane.W;
+        f32 Radius = fabsf(Plane.X) * Extent.X + fabsf(Plane.Y) * Extent.Y + fabsf(Plane.Z) * Extent.Z;
+        if (Distance + Radius < 0.0f) {
+            return BvhOverlap_Outside;
+        }
+        if (Distance - Radius < 0.0f) {
+            Overlap = BvhOverlap_Partial;
+        }
+    }
+    return Overlap;
+}
+
+bvh_overlap BvhClassifySphere(const aabb* Box, const bvh_query* Query)
+{
+    hmm_vec3 Center = Query->Sphere.XYZ;
+    f32 RadiusSquared = Query->Sphere.W * Query->Sphere.W;
+
+    f32 Nearest = 0.0f, Farthest = 0.0f;
+    for (i32 Axis = 0; Axis < 3; Axis++) {
+        f32 Below = Box->Min.Elements[Axis] - Center.Elements[Axis];
+        f32 Above = Center.Elements[Axis] - Box->Max.Elements[Axis];
+        f32 Gap = fmaxf(0.0f, fmaxf(Below, Above));
+        f32 Far = fmaxf(fabsf(Below), fabsf(Above));
+        Nearest += Gap * Gap;
+        Farthest += Far * Far;
+    }
+
+    if (Nearest > RadiusSquared) {
+        return BvhOverlap_Outside;
+    }
+    return Farthest <= RadiusSquared ? BvhOverlap_Inside : BvhOverlap_Partial;
+}
+
+bvh_overlap BvhClassifyAABB(const aabb* Box, const bvh_query* Query)
+{
+    const aabb* Other = &Query->Box;
+
+    bool Inside = true;
+    for (i32 Axis = 0; Axis < 3; Axis++) {
+        if (Box->Max.Elements[Axis] < Other->Min.Elements[Axis] || Box->Min.Elements[Axis] > Other->Max.Elements[Axis]) {
+            return BvhOverlap_Outside;
+        }
+        Inside = Inside && Box->Min.Elements[Axis] >= Other->Min.Elements[Axis] && Box->Max.Elements[Axis] <= Other->Max.Elements[Axis];
+    }
+    return Inside ? BvhOverlap_Inside : BvhOverlap_Partial;
+}
+
+// NOTE(milo): Nodes completely inside the query add their whole item range without testing the items again.
+void BvhCollect(const bvh* Tree, const bvh_query* Query, PFN_BvhClassify Classify, std::vector<u32>* Results)
+{
+    if (Tree->Nodes.empty()) {
+        return;
+    }
+
+    std::vector<u32> Stack = { 0 };
+    while (!Stack.empty()) {
+        const bvh_node* Node = &Tree->Nodes[Stack.back()];
+        Stack.pop_back();
+
+        bvh_overlap Overlap = Classify(&Node->Bounds, Query);
+        if (Overlap == BvhOverlap_Outside) {
+            continue;
+        }
+
+        if (Overlap == BvhOverlap_Inside) {
+            Results->insert(Results->end(), Tree->Items.begin() + Node->First, Tree->Items.begin() + Node->First + Node->Count);
+        } else if (Node->Left) {
+            Stack.push_back(Node->Left);
+            Stack.push_back(Node->Left + 1);
+        } else {
+            for (u32 Index = Node->First; Index < Node->First + Node->Count; Index++) {
+                u32 Item = Tree->Items[Index];
+                if (Classify(&Tree->ItemBounds[Item], Query) != BvhOverlap_Outside) {
+                    Results->push_back(Item);
+                }
+            }
+        }
+    }
+}
+
+void BvhQueryFrustum(const bvh* Tree, const hmm_vec4* Planes, std::vector<u32>* Results)
+{
+    bvh_query Query = {};
+    for (i32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+        Query.Planes[PlaneIndex] = Planes[PlaneIndex];
+    }
+    BvhCollect(Tree, &Query, BvhClassifyFrustum, Results);
+}
+
+void BvhQuerySphere(const bvh* Tree, hmm_vec4 Sphere, std::vector<u32>* Results)
+{
+    bvh_query Query = {};
+    Query.Sphere = Sphere;
+    BvhCollect(Tree, &Query, BvhClassifySphere, Results);
+}
+
+void BvhQueryAABB(const bvh* Tree, aabb Box, std::vector<u32>* Results)
+{
+    bvh_query Query = {};
+    Query.Box = Box;
+    BvhCollect(Tree, &Query, BvhClassifyAABB, Results);
+}
+
+// NOTE(milo): Slab test, Distance is where the ray enters the box or zero when it starts inside.
+bool BvhRayBox(const aabb* Box, hmm_vec3 Origin, hmm_vec3 InvDirection, f32 MaxDistance, f32* Distance)
+{
+    f32 Near = 0.0f, Far = MaxDistance;
+    for (i32 Axis = 0; Axis < 3; Axis++) {
+        f32 T0 = (Box->Min.Elements[Axis] - Origin.Elements[Axis]) * InvDirection.Elements[Axis];
+        f32 T1 = (Box->Max.Elements[Axis] - Origin.Elements[Axis]) * InvDirection.Elements[Axis];
+        Near = fmaxf(Near, fminf(T0, T1));
+        Far = fminf(Far, fmaxf(T0, T1));
+        if (Near > Far) {
+            return false;
+        }
+    }
+    *Distance = Near;
+    return true;
+}
+
+// NOTE(milo): Hits are against the item boxes, callers wanting the exact surface test the returned item themselves. The nearer child
+// is visited first so farther subtrees are usually skipped by the best distance so far.
+bool BvhRaycast(const bvh* Tree, hmm_vec3 Origin, hmm_vec3 Direction, f32 MaxDistance, bvh_hit* Hit)
+{
+    if (Tree->Nodes.empty()) {
+        return false;
+    }
+
+    hmm_vec3 InvDirection;
+    for (i32 Axis = 0; Axis < 3; Axis++) {
+        InvDirection.Elements[Axis] = Direction.Elements[Axis] != 0.0f ? 1.0f / Direction.Elements[Axis] : FLT_MAX;
+    }
+
+    bool Found = false;
+    f32 Best = MaxDistance;
+    f32 Distance;
+
+    std::vector<u32> Stack = { 0 };
+    while (!Stack.empty()) {
+        const bvh_node* Node = &Tree->Nodes[Stack.back()];
+        Stack.pop_back();
+
+        if (!BvhRayBox(&Node->Bounds, Origin, InvDirection, Best, &Distance)) {
+            continue;
+        }
+
+        if (Node->Left) {
+            f32 LeftDistance = FLT_MAX, RightDistance = FLT_MAX;
+            bool HitLeft = BvhRayBox(&Tree->Nodes[Node->Left].Bounds, Origin, InvDirection, Best, &LeftDistance);
+            bool HitRight = BvhRayBox(&Tree->Nodes[Node->Left + 1].Bounds, Origin, InvDirection, Best, &RightDistance);
+            u32 Near = LeftDistance <= RightDistance ? Node->Left : Node->Left + 1;
+            u32 Far = Near == Node->Left ? Node->Left + 1 : Node->Left;
+
+            if (HitLeft && HitRight) {
+                Stack.push_back(Far);
+                Stack.push_back(Near);
+            } else if (HitLeft || HitRight) {
+                Stack.push_back(HitLeft ? Node->Left : Node->Left + 1);
+            }
+            continue;
+        }
+
+        for (u32 Index = Node->First; Index < Node->First + Node->Count; Index++) {
+            u32 Item = Tree->Items[Index];
+            if (BvhRayBox(&Tree->ItemBounds[Item], Origin, InvDirection, Best, &Distance) && (!Found || Distance < Best)) {
+                Best = Distance;
+                Hit->Item = Item;
+                Hit->Distance = Distance;
+                Found = true;
+            }
+        }
+    }
+    return Found;
+}
+
+struct bvh_batch
+{
+    const bvh* Tree;
+    bvh_query* Queries;
+};
+
+void BvhRunQueries(void* Data, u32 Start, u32 End)
+{
+    bvh_batch* Batch = (bvh_batch*)Data;
+
+    for (u32 Index = Start; Index < End; Index++) {
+        bvh_query* Query = &Batch->Queries[Index];
+        Query->Results.clear();
+        Query->HasHit = false;
+
+        switch (Query->Type) {
+            case BvhQuery_Frustum: BvhCollect(Batch->Tree, Query, BvhClassifyFrustum, &Query->Results); break;
+            case BvhQuery_Sphere: BvhCollect(Batch->Tree, Query, BvhClassifySphere, &Query->Results); break;
+            case BvhQuery_AABB: BvhCollect(Batch->Tree, Query, BvhClassifyAABB, &Query->Results); break;
+            case BvhQuery_Ray: Query->HasHit = BvhRaycast(Batch->Tree, Query->Origin, Query->Direction, Query->MaxDistance, &Query->Hit); break;
+        }
+    }
+}
+
+// NOTE(milo): The tree is only read, so the queries run on the job system in BVH_QUERY_BATCH sized groups.
+void BvhQueryBatch(const bvh* Tree, bvh_query* Queries, u32 Count)
+{
+    bvh_batch Batch = { Tree, Queries };
+
+    job_counter Counter = {};
+    JobParallelFor(Count, BVH_QUERY_BATCH, BvhRunQueries, &Batch, &Counter);
+    JobWait(&Counter);
+}
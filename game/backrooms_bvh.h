@@ -0,0 +1,99 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_culling.h"
+
+#include <hmm/HandmadeMath.h>
+#include <vector>
+
+#define BVH_MAX_LEAF_ITEMS 4
+#define BVH_SAH_BINS 16
+#define BVH_TRAVERSAL_COST 1.0f // NOTE(milo): Relative to testing a single item.
+#define BVH_REBUILD_RATIO 1.3f // NOTE(milo): Refitted trees are rebuilt once their SAH cost grew past this factor of the built cost.
+#define BVH_MIN_REFITS 64
+#define BVH_QUERY_BATCH 4
+
+struct aabb
+{
+    hmm_vec3 Min;
+    hmm_vec3 Max;
+};
+
+// NOTE(milo): Every node covers Items[First, First + Count). Interior nodes have Left and Left + 1 as children, leaves have a Left of
+// zero since the root is never a child.
+struct bvh_node
+{
+    aabb Bounds;
+    u32 First;
+    u32 Count;
+    u32 Left;
+    u32 Parent;
+};
+
+// NOTE(milo): Items are identified by their index into ItemBounds, the scene uses its instance indices. Moving an item refits the
+// nodes above its leaf, adding items rebuilds the tree the next time it is maintained.
+struct bvh
+{
+    std::vector<bvh_node> Nodes;
+    std::vector<u32> Items;
+    std::vector<aabb> ItemBounds;
+    std::vector<u32> ItemLeaf;
+
+    bool NeedsRebuild;
+    u32 Refits;
+    f32 BuiltCost;
+};
+
+enum bvh_query_type
+{
+    BvhQuery_Frustum,
+    BvhQuery_Sphere,
+    BvhQuery_AABB,
+    BvhQuery_Ray
+};
+
+struct bvh_hit
+{
+    u32 Item;
+    f32 Distance;
+};
+
+// NOTE(milo): Only the inputs of the query's type are read. Overlap queries fill Results, rays fill Hit with the nearest item box.
+struct bvh_query
+{
+    bvh_query_type Type;
+    hmm_vec4 Planes[CULLING_PLANE_COUNT];
+    hmm_vec4 Sphere;
+    aabb Box;
+    hmm_vec3 Origin;
+    hmm_vec3 Direction;
+    f32 MaxDistance;
+
+    std::vector<u32> Results;
+    bool HasHit;
+    bvh_hit Hit;
+};
+
+//~ NOTE(milo): Bounds
+aabb AabbEmpty();
+void AabbGrow(aabb* Box, const aabb* Other);
+void AabbGrowPoint(aabb* Box, hmm_vec3 Point);
+aabb AabbFromSphere(hmm_vec4 Sphere);
+aabb AabbTransform(const aabb* Box, hmm_mat4 Transform);
+bool AabbContains(const aabb* Box, hmm_vec3 Point, f32 Margin = 0.0f);
+f32 AabbSurfaceArea(const aabb* Box);
+
+//~ NOTE(milo): Tree
+void BvhResize(bvh* Tree, u32 Count);
+void BvhSetItem(bvh* Tree, u32 Item, aabb Bounds);
+void BvhBuild(bvh* Tree);
+void BvhMaintain(bvh* Tree);
+f32 BvhCost(const bvh* Tree);
+void BvhFree(bvh* Tree);
+
+//~ NOTE(milo): Queries, Results are appended to
+void BvhQueryFrustum(const bvh* Tree, const hmm_vec4* Planes, std::vector<u32>* Results);
+void BvhQuerySphere(const bvh* Tree, hmm_vec4 Sphere, std::vector<u32>* Results);
+void BvhQueryAABB(const bvh* Tree, aabb Box, std::vector<u32>* Results);
+bool BvhRaycast(const bvh* Tree, hmm_vec3 Origin, hmm_vec3 Direction, f32 MaxDistance, bvh_hit* Hit);
+void BvhQueryBatch(const bvh* Tree, bvh_query* Queries, u32 Count);
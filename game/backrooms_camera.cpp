@@ -1,17 +1,10 @@
 #include "backrooms_camera.h"
 #include "backrooms_input.h"
+#include "backrooms_culling.h"
 
 #include <math.h>
 #include <string.h>
 
-hmm_vec4 PlaneToVec4(hmm_vec3 Norm, hmm_vec3 Point)
-{
-    hmm_vec4 Temp;
-    Temp.XYZ = Norm;
-    Temp.W = HMM_DotVec3(Norm, Point);
-    return Temp;
-}
-
 void NoClipCameraUpdateVectors(noclip_camera* Camera)
 {
     hmm_vec3 Front;
@@ -53,6 +46,7 @@ void NoClipCameraUpdate(noclip_camera* Camera, f32 Delta)
 
     Camera->View = HMM_LookAt(Camera->Position, HMM_AddVec3(Camera->Position, Camera->Front), Camera->WorldUp);
     Camera->Projection = HMM_Perspective(75.0f, Camera->Width / Camera->Height, 0.001f, 10000.0f);
+    NoClipCameraUpdateFrustum(Camera);
 }
 
 void NoClipCameraInput(noclip_camera* Camera, f32 Delta)
@@ -126,45 +120,5 @@ void NoClipCameraResize(noclip_camera* Camera, i32 Width, i32 Height)
 
 void NoClipCameraUpdateFrustum(noclip_camera* Camera)
 {
-    const f32 HalfVerticalSide = 10000.0f * tanf(HMM_ToRadians(75.0f) * 0.5f);
-    const f32 HalfHorizontalSide = HalfVerticalSide * (Camera->Width / Camera->Height);
-    const hmm_vec3 FrontMultFar = HMM_MultiplyVec3f(Camera->Front, 10000.0f);
-
-    Camera->ViewFrustum.Near.Point = HMM_AddVec3(Camera->Position, HMM_MultiplyVec3f(Camera->Front, 0.001f));
-    Camera->ViewFrustum.Near.Norm = Camera->Front;
-
-    Camera->ViewFrustum.Far.Point = HMM_AddVec3(Camera->Position, FrontMultFar);
-    Camera->ViewFrustum.Far.Norm = HMM_MultiplyVec3f(Camera->Front, -1.0f);
-
-    Camera->ViewFrustum.Right.Point = Camera->Position;
-    Camera->ViewFrustum.Right.Norm = HMM_Cross(Camera->Up, HMM_AddVec3(FrontMultFar, HMM_MultiplyVec3f(Camera->Right, HalfHorizontalSide)));
-
-    Camera->ViewFrustum.Left.Point = Camera->Position;
-    Camera->ViewFrustum.Left.Norm = HMM_Cross(HMM_SubtractVec3(FrontMultFar, HMM_MultiplyVec3f(Camera->Right, HalfHorizontalSide)), Camera->Up);
-
-    Camera->ViewFrustum.Top.Point = Camera->Position;
-    Camera->ViewFrustum.Top.Norm = HMM_Cross(Camera->Right, HMM_SubtractVec3(FrontMultFar, HMM_MultiplyVec3f(Camera->Up, HalfVerticalSide)));
-
-    Camera->ViewFrustum.Bottom.Point = Camera->Position;
-    Camera->ViewFrustum.Bottom.Norm = HMM_Cross(HMM_AddVec3(FrontMultFar, HMM_MultiplyVec3f(Camera->Up, HalfVerticalSide)), Camera->Right);
-
-    // //
-
-    Camera->Planes[0].XYZ = HMM_NormalizeVec3(Camera->ViewFrustum.Near.Norm);
-    Camera->Planes[0].W = HMM_DotVec3(Camera->Planes[0].XYZ, Camera->ViewFrustum.Near.Point);
-
-    Camera->Planes[1].XYZ = HMM_NormalizeVec3(Camera->ViewFrustum.Far.Norm);
-    Camera->Planes[1].W = HMM_DotVec3(Camera->Planes[1].XYZ, Camera->ViewFrustum.Far.Point);
-
-    Camera->Planes[2].XYZ = HMM_NormalizeVec3(Camera->ViewFrustum.Right.Norm);
-    Camera->Planes[2].W = HMM_DotVec3(Camera->Planes[2].XYZ, Camera->ViewFrustum.Right.Point);
-
-    Camera->Planes[3].XYZ = HMM_NormalizeVec3(Camera->ViewFrustum.Left.Norm);
-    Camera->Planes[3].W = HMM_DotVec3(Camera->Planes[3].XYZ, Camera->ViewFrustum.Left.Point);
-
-    Camera->Planes[4].XYZ = HMM_NormalizeVec3(Camera->ViewFrustum.Top.Norm);
-    Camera->Planes[4].W = HMM_DotVec3(Camera->Planes[4].XYZ, Camera->ViewFrustum.Top.Point);
-
-    Camera->Planes[5].XYZ = HMM_NormalizeVec3(Camera->ViewFrustum.Bottom.Norm);
-    Camera->Planes[5].W = HMM_DotVec3(Camera->Planes[5].XYZ, Camera->ViewFrustum.Bottom.Point);
+    CullingExtractPlanes(HMM_MultiplyMat4(Camera->Projection, Camera->View), Camera->Planes);
 }
\ No newline at end of file
@@ -11,22 +11,6 @@
 #define CAMERA_DEFAULT_GAMEPAD_SENSITIVITY 100.0f
 #define CAMERA_DEFAULT_ZOOM 90.0f
 
-struct frustum_plane
-{
-    hmm_vec3 Point;
-    hmm_vec3 Norm;
-};
-
-struct frustum_view
-{
-    frustum_plane Near;
-    frustum_plane Far;
-    frustum_plane Right;
-    frustum_plane Left;
-    frustum_plane Top;
-    frustum_plane Bottom;
-};
-
 // No, this is not related to how you noclip out of reality to get to Level 0. This is a noclip style camera.
 struct noclip_camera
 {
@@ -53,7 +37,7 @@ struct noclip_camera
     hmm_vec3 Velocity;
     f32 MaxVelocity;
 
-    frustum_view ViewFrustum;
+    // NOTE(milo): Extracted from Projection * View, see CullingExtractPlanes for the order.
     hmm_vec4 Planes[6];
 };
 
@@ -0,0 +1,176 @@
+#include "backrooms_culling.h"
+
+#include <assert.h>
+#include <float.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CULLING_TARGET_AVX
+#else
+#define CULLING_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+//~ NOTE(milo): Frustum
+
+// NOTE(milo): Gribb/Hartmann, every plane is a sum of rows of the matrix. The order is left, right, bottom, top, near, far and a point is
+// inside when dot(Plane.XYZ, Point) + Plane.W >= 0. HandmadeMath stores columns, so row R is Elements[0..3][R].
+void CullingExtractPlanes(hmm_mat4 ViewProjection, hmm_vec4* Planes)
+{
+    hmm_vec4 Rows[4];
+    for (i32 Row = 0; Row < 4; Row++) {
+        Rows[Row] = HMM_Vec4(ViewProjection.Elements[0][Row], ViewProjection.Elements[1][Row], ViewProjection.Elements[2][Row], ViewProjection.Elements[3][Row]);
+    }
+
+    Planes[0] = HMM_AddVec4(Rows[3], Rows[0]);
+    Planes[1] = HMM_SubtractVec4(Rows[3], Rows[0]);
+    Planes[2] = HMM_AddVec4(Rows[3], Rows[1]);
+    Planes[3] = HMM_SubtractVec4(Rows[3], Rows[1]);
+    Planes[4] = HMM_AddVec4(Rows[3], Rows[2]);
+    Planes[5] = HMM_SubtractVec4(Rows[3], Rows[2]);
+
+    // NOTE(milo): Normalized so the distance can be compared against a sphere radius.
+    for (i32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+        f32 Length = HMM_LengthVec3(Planes[PlaneIndex].XYZ);
+        if (Length > 0.0f) {
+            Planes[PlaneIndex] = HMM_MultiplyVec4f(Planes[PlaneIndex], 1.0f / Length);
+        }
+    }
+}
+
+//~ NOTE(milo): Bounds
+
+// NOTE(milo): The radius grows with the largest axis scale, so non uniformly scaled spheres stay conservative.
+hmm_vec4 CullingTransformSphere(hmm_mat4 Transform, hmm_vec4 Sphere)
+{
+    hmm_vec4 Center = HMM_MultiplyMat4ByVec4(Transform, HMM_Vec4v(Sphere.XYZ, 1.0f));
+
+    f32 Scale = 0.0f;
+    for (i32 Column = 0; Column < 3; Column++) {
+        f32 Length = HMM_LengthVec3(HMM_Vec3(Transform.Elements[Column][0], Transform.Elements[Column][1], Transform.Elements[Column][2]));
+        Scale = Length > Scale ? Length : Scale;
+    }
+    return HMM_Vec4v(Center.XYZ, Sphere.W * Scale);
+}
+
+void CullingBoundsResize(culling_bounds* Bounds, u32 Count)
+{
+    u32 Padded = (Count + CULLING_LANES - 1) / CULLING_LANES * CULLING_LANES;
+    Bounds->CenterX.resize(Padded, 0.0f);
+    Bounds->CenterY.resize(Padded, 0.0f);
+    Bounds->CenterZ.resize(Padded, 0.0f);
+    Bounds->Radius.resize(Padded, -FLT_MAX);
+
+    for (u32 Index = Count; Index < Padded; Index++) {
+        Bounds->Radius[Index] = -FLT_MAX;
+    }
+    Bounds->Count = Count;
+}
+
+void CullingBoundsSet(culling_bounds* Bounds, u32 Index, hmm_vec4 Sphere)
+{
+    assert(Index < Bounds->Count);
+    Bounds->CenterX[Index] = Sphere.X;
+    Bounds->CenterY[Index] = Sphere.Y;
+    Bounds->CenterZ[Index] = Sphere.Z;
+    Bounds->Radius[Index] = Sphere.W;
+}
+
+//~ NOTE(milo): Culling kernels
+
+// NOTE(milo): A sphere survives when its signed distance plus its radius is positive for all six planes.
+u32 CullingTestSpheresSSE(const culling_bounds* Bounds, const hmm_vec4* Planes, u32* Visible)
+{
+    __m128 PlaneX[CULLING_PLANE_COUNT], PlaneY[CULLING_PLANE_COUNT], PlaneZ[CULLING_PLANE_COUNT], PlaneW[CULLING_PLANE_COUNT];
+    for (i32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+        PlaneX[PlaneIndex] = _mm_set1_ps(Planes[PlaneIndex].X);
+        PlaneY[PlaneIndex] = _mm_set1_ps(Planes[PlaneIndex].Y);
+        PlaneZ[PlaneIndex] = _mm_set1_ps(Planes[PlaneIndex].Z);
+        PlaneW[PlaneIndex] = _mm_set1_ps(Planes[PlaneIndex].W);
+    }
+    __m128 Zero = _mm_setzero_ps();
+
+    u32 VisibleCount = 0;
+    for (u32 Index = 0; Index < Bounds->Count; Index += 4) {
+        __m128 X = _mm_loadu_ps(&Bounds->CenterX[Index]);
+        __m128 Y = _mm_loadu_ps(&Bounds->CenterY[Index]);
+        __m128 Z = _mm_loadu_ps(&Bounds->CenterZ[Index]);
+        __m128 R = _mm_loadu_ps(&Bounds->Radius[Index]);
+
+        __m128 Inside = _mm_cmpge_ps(R, Zero);
+        for (i32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+            __m128 Distance = _mm_add_ps(_mm_mul_ps(X, PlaneX[PlaneIndex]), _mm_mul_ps(Y, PlaneY[PlaneIndex]));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(Z, PlaneZ[PlaneIndex]));
+            Distance = _mm_add_ps(Distance, _mm_add_ps(PlaneW[PlaneIndex], R));
+            Inside = _mm_and_ps(Inside, _mm_cmpge_ps(Distance, Zero));
+        }
+
+        u32 Mask = (u32)_mm_movemask_ps(Inside);
+        for (u32 Lane = 0; Mask; Lane++, Mask >>= 1) {
+            if (Mask & 1) Visible[VisibleCount++] = Index + Lane;
+        }
+    }
+    return VisibleCount;
+}
+
+CULLING_TARGET_AVX u32 CullingTestSpheresAVX(const culling_bounds* Bounds, const hmm_vec4* Planes, u32* Visible)
+{
+    __m256 PlaneX[CULLING_PLANE_COUNT], PlaneY[CULLING_PLANE_COUNT], PlaneZ[CULLING_PLANE_COUNT], PlaneW[CULLING_PLANE_COUNT];
+    for (i32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+        PlaneX[PlaneIndex] = _mm256_set1_ps(Planes[PlaneIndex].X);
+        PlaneY[PlaneIndex] = _mm256_set1_ps(Planes[PlaneIndex].Y);
+        PlaneZ[PlaneIndex] = _mm256_set1_ps(Planes[PlaneIndex].Z);
+        PlaneW[PlaneIndex] = _mm256_set1_ps(Planes[PlaneIndex].W);
+    }
+    __m256 Zero = _mm256_setzero_ps();
+
+    u32 VisibleCount = 0;
+    for (u32 Index = 0; Index < Bounds->Count; Index += 8) {
+        __m256 X = _mm256_loadu_ps(&Bounds->CenterX[Index]);
+        __m256 Y = _mm256_loadu_ps(&Bounds->CenterY[Index]);
+        __m256 Z = _mm256_loadu_ps(&Bounds->CenterZ[Index]);
+        __m256 R = _mm256_loadu_ps(&Bounds->Radius[Index]);
+
+        __m256 Inside = _mm256_cmp_ps(R, Zero, _CMP_GE_OQ);
+        for (i32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+            __m256 Distance = _mm256_add_ps(_mm256_mul_ps(X, PlaneX[PlaneIndex]), _mm256_mul_ps(Y, PlaneY[PlaneIndex]));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Z, PlaneZ[PlaneIndex]));
+            Distance = _mm256_add_ps(Distance, _mm256_add_ps(PlaneW[PlaneIndex], R));
+            Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(Distance, Zero, _CMP_GE_OQ));
+        }
+
+        u32 Mask = (u32)_mm256_movemask_ps(Inside);
+        for (u32 Lane = 0; Mask; Lane++, Mask >>= 1) {
+            if (Mask & 1) Visible[VisibleCount++] = Index + Lane;
+        }
+    }
+    return VisibleCount;
+}
+
+// NOTE(milo): AVX needs both the CPU flag and the OS saving the YMM registers, the build does not assume either.
+bool CullingDetectAVX()
+{
+#if defined(_MSC_VER)
+    i32 Info[4];
+    __cpuid(Info, 1);
+    bool OSXSave = (Info[2] & (1 << 27)) != 0;
+    bool AVX = (Info[2] & (1 << 28)) != 0;
+    return OSXSave && AVX && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+u32 CullingTestSpheres(const culling_bounds* Bounds, const hmm_vec4* Planes, u32* Visible, culling_stats* Stats)
+{
+    static bool HasAVX = CullingDetectAVX();
+
+    u32 VisibleCount = HasAVX ? CullingTestSpheresAVX(Bounds, Planes, Visible) : CullingTestSpheresSSE(Bounds, Planes, Visible);
+    if (Stats) {
+        Stats->Tested = Bounds->Count;
+        Stats->Visible = VisibleCount;
+        Stats->Culled = Bounds->Count - VisibleCount;
+        Stats->Wide = HasAVX;
+    }
+    return VisibleCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "backrooms_common.h"
+
+#include <hmm/HandmadeMath.h>
+#include <vector>
+
+#define CULLING_PLANE_COUNT 6
+#define CULLING_LANES 8 // NOTE(milo): Bounds are padded to the width of the widest kernel.
+
+// NOTE(milo): World space bounding spheres, one array per component so the kernels load 4 or 8 objects at a time. Padding spheres have a
+// negative radius and never pass.
+struct culling_bounds
+{
+    std::vector<f32> CenterX;
+    std::vector<f32> CenterY;
+    std::vector<f32> CenterZ;
+    std::vector<f32> Radius;
+    u32 Count;
+};
+
+struct culling_stats
+{
+    u32 Tested;
+    u32 Visible;
+    u32 Culled;
+    bool Wide; // NOTE(milo): Whether the 8 wide AVX kernel ran.
+    bool Hierarchical; // NOTE(milo): Whether the scene BVH was walked instead of testing every sphere.
+};
+
+//~ NOTE(milo): Frustum
+void CullingExtractPlanes(hmm_mat4 ViewProjection, hmm_vec4* Planes);
+
+//~ NOTE(milo): Bounds
+hmm_vec4 CullingTransformSphere(hmm_mat4 Transform, hmm_vec4 Sphere);
+void CullingBoundsResize(culling_bounds* Bounds, u32 Count);
+void CullingBoundsSet(culling_bounds* Bounds, u32 Index, hmm_vec4 Sphere);
+
+//~ NOTE(milo): Culling, Visible needs room for Bounds->Count indices
+u32 CullingTestSpheres(const culling_bounds* Bounds, const hmm_vec4* Planes, u32* Visible, culling_stats* Stats = NULL);
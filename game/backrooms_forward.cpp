@@ -1,7 +1,33 @@
 #include "backrooms_forward.h"
 
+#include "backrooms_job.h"
+
+#include <algorithm>
 #include <imgui/imgui.h>
 
+void ForwardCreateBuffer(rhi_buffer* Buffer, u32 Count, u32 Stride, rhi_buffer_usage Usage, rhi_buffer_access Access = BufferAccess_Default)
+{
+    BufferInit(Buffer, Count * Stride, Stride, Usage, Access);
+    if (Usage == BufferUsage_Storage) {
+        BufferInitSRV(Buffer);
+    } else if (Usage == BufferUsage_VertexStorage || Usage == BufferUsage_Indirect) {
+        BufferInitUAV(Buffer);
+    }
+}
+
+void ForwardGrowBuffer(rhi_buffer* Buffer, u32* Capacity, u32 Count, u32 Stride, rhi_buffer_usage Usage, rhi_buffer_access Access = BufferAccess_Default)
+{
+    if (Count <= *Capacity) {
+        return;
+    }
+
+    while (*Capacity < Count) {
+        *Capacity *= 2;
+    }
+    BufferFree(Buffer);
+    ForwardCreateBuffer(Buffer, *Capacity, Stride, Usage, Access);
+}
+
 void ForwardPassInit(forward_pass* Pass)
 {
     TextureInit(&Pass->Output, 1280, 720, TextureFormat_R8G8B8A8_Unorm, TextureUsage_RTV);
@@ -9,17 +35,331 @@ void ForwardPassInit(forward_pass* Pass)
     TextureInitRTV(&Pass->Output);
     TextureInitDSV(&Pass->Depth);
 
-    ShaderInit(&Pass->ForwardShader, "data/shaders/forward/Vertex.hlsl", "data/shaders/forward/Fragment.hlsl");
     SamplerInit(&Pass->ForwardSampler, SamplerAddress_Wrap);
 
-    rhi_material_config MaterialConfig;
-    MaterialConfig.FrontFaceCCW = true;
-    MaterialConfig.CullMode = CullMode_Back;
-    MaterialConfig.FillMode = FillMode_Fill;
-    MaterialConfig.CompareOP = CompareOP_Less;
-    MaterialInit(&Pass->ForwardMaterial, MaterialConfig);
+    Pass->InstanceCapacity = FORWARD_DEFAULT_INSTANCES;
+    ForwardCreateBuffer(&Pass->InstanceStream, Pass->InstanceCapacity, sizeof(gpu_scene_draw), BufferUsage_Vertex, BufferAccess_Dynamic);
+
+    Pass->CullCapacity = FORWARD_DEFAULT_INSTANCES;
+    Pass->ArgsCapacity = FORWARD_DEFAULT_DRAWS;
+    ForwardCreateBuffer(&Pass->CandidateBuffer, Pass->CullCapacity, sizeof(forward_cull_candidate), BufferUsage_Storage);
+    ForwardCreateBuffer(&Pass->CulledStream, Pass->CullCapacity, sizeof(gpu_scene_draw), BufferUsage_VertexStorage);
+    ForwardCreateBuffer(&Pass->ArgsBuffer, Pass->ArgsCapacity, sizeof(rhi_draw_indexed_args), BufferUsage_Indirect);
+    Pass->CullShader.Internal = NULL;
+    Pass->GpuCullingEnabled = false;
+    Pass->GpuCulling = false;
+
+    Pass->HierarchicalCulling = true;
+    Pass->PortalCulling = true;
+    Pass->OcclusionCulling = true;
+    Pass->OcclusionTemporal = false;
+
+    rhi_pipeline_desc PipelineDesc = {};
+    PipelineDesc.Config.FrontFaceCCW = true;
+    PipelineDesc.Config.CullMode = CullMode_Back;
+    PipelineDesc.Config.FillMode = FillMode_Fill;
+    PipelineDesc.Config.CompareOP = CompareOP_Less;
+    PipelineDesc.Blend = BlendMode_Opaque;
+
+    std::vector<std::string> Features = { "HAS_NORMAL_MAP", "HAS_PBR_MAP", "USE_TEXTURE_ARRAYS", "USE_ATLAS" };
+    ShaderPermutationsInit(&Pass->ForwardPermutations, "data/shaders/forward/Vertex.hlsl", "data/shaders/forward/Fragment.hlsl", Features, PipelineDesc);
+}
+
+u32 ForwardMaterialFeatures(gltf_material* Material)
+{
+    u32 Features = 0;
+    if (Material->HasNormalMap) Features |= ForwardFeature_NormalMap;
+    if (Material->HasPBRMap) Features |= ForwardFeature_PBRMap;
+    if (Material->Packed) Features |= ForwardFeature_TextureArrays;
+    if (Material->Atlased) Features |= ForwardFeature_Atlas;
+    return Features;
+}
+
+forward_textures ForwardMaterialTextures(gltf_material* Material)
+{
+    forward_textures Textures = {};
+    if (Material->Packed) {
+        Textures.Albedo = TexturePoolGet(Material->AlbedoSlot.Array);
+        Textures.Normal = Material->HasNormalMap ? TexturePoolGet(Material->NormalSlot.Array) : NULL;
+        Textures.PBR = Material->HasPBRMap ? TexturePoolGet(Material->PBRSlot.Array) : NULL;
+    } else {
+        Textures.Albedo = &Material->Albedo;
+        Textures.Normal = Material->HasNormalMap ? &Material->Normal : NULL;
+        Textures.PBR = Material->HasPBRMap ? &Material->PBR : NULL;
+    }
+    return Textures;
+}
+
+// NOTE(milo): Pooled layers are uploaded through the queue like the geometry, a packed material waits for all of its layers.
+bool ForwardMaterialUploaded(gltf_material* Material)
+{
+    if (!Material->Packed) {
+        return true;
+    }
+    return UploadIsDone(Material->AlbedoSlot.UploadTicket) && (!Material->HasNormalMap || UploadIsDone(Material->NormalSlot.UploadTicket)) &&
+           (!Material->HasPBRMap || UploadIsDone(Material->PBRSlot.UploadTicket));
+}
+
+// NOTE(milo): Starts compiling the variants the mesh's materials need while the rest of the scene loads.
+void ForwardPassPrepare(forward_pass* Pass, gpu_mesh* Mesh)
+{
+    for (gltf_material& Material : Mesh->Materials) {
+        ShaderPermutationsPrepare(&Pass->ForwardPermutations, ForwardMaterialFeatures(&Material));
+    }
+}
+
+struct forward_record_context
+{
+    forward_pass* Pass;
+    frame_graph_scene* Scene;
+};
+
+void ForwardBindFrame(forward_pass* Pass, frame_graph_scene* Scene)
+{
+    BufferBindUniform(&Scene->CameraBuffer, 0, UniformBind_Vertex);
+    GpuSceneBind(&Scene->GpuScene);
+    SamplerBind(&Pass->ForwardSampler, 0, UniformBind_Pixel);
+    BufferBindVertex(Pass->GpuCulling ? &Pass->CulledStream : &Pass->InstanceStream, RHI_INSTANCE_SLOT);
+}
+
+void ForwardRecordDraws(forward_pass* Pass, u32 Start, u32 End)
+{
+    for (u32 DrawIndex = Start; DrawIndex < End; DrawIndex++) {
+        forward_draw& Draw = Pass->Draws[DrawIndex];
+        gltf_primitive& Primitive = Draw.Mesh->Primitives[Draw.PrimitiveIndex];
+        if (!PipelineBind(Draw.Pipeline)) {
+            continue;
+        }
+
+        TextureBindSRV(Draw.Textures.Albedo, 0, UniformBind_Pixel);
+        if (Draw.Textures.Normal) TextureBindSRV(Draw.Textures.Normal, 1, UniformBind_Pixel);
+        if (Draw.Textures.PBR) TextureBindSRV(Draw.Textures.PBR, 2, UniformBind_Pixel);
+
+        BufferBindVertex(&Primitive.VertexBuffer);
+        BufferBindIndex(&Primitive.IndexBuffer);
+        VideoDrawIndexedIndirect(&Pass->ArgsBuffer, DrawIndex * sizeof(rhi_draw_indexed_args));
+    }
+}
+
+void ForwardRecordLists(void* Data, u32 Start, u32 End)
+{
+    forward_record_context* Context = (forward_record_context*)Data;
+    forward_pass* Pass = Context->Pass;
+
+    for (u32 ListIndex = Start; ListIndex < End; ListIndex++) {
+        u32 First = ListIndex * FORWARD_DRAWS_PER_LIST;
+        u32 Last = First + FORWARD_DRAWS_PER_LIST < Pass->Draws.size() ? First + FORWARD_DRAWS_PER_LIST : (u32)Pass->Draws.size();
+
+        CommandListBegin(&Pass->CommandLists[ListIndex]);
+        ForwardBindFrame(Pass, Context->Scene);
+        ForwardRecordDraws(Pass, First, Last);
+        CommandListEnd(&Pass->CommandLists[ListIndex]);
+    }
+}
+
+// NOTE(milo): Large, simple primitives that passed the frustum test are rasterized into the occlusion buffer. In temporal mode only
+// the ones visible last frame are used, a primitive that just entered the frustum occludes from the next frame on.
+void ForwardRenderOccluders(forward_pass* Pass, frame_graph_scene* Scene, hmm_mat4 ViewProjection)
+{
+    OcclusionBegin(&Pass->Occlusion, ViewProjection);
+
+    for (gpu_mesh& Mesh : Scene->Meshes) {
+        for (u32 PrimitiveIndex = 0; PrimitiveIndex < Mesh.Primitives.size(); PrimitiveIndex++) {
+            gltf_primitive& Primitive = Mesh.Primitives[PrimitiveIndex];
+            u32 InstanceIndex = Mesh.SceneInstanceBase + PrimitiveIndex;
+            if (Primitive.Occluder.Indices.empty() || !Pass->InstanceVisible[InstanceIndex] || !UploadIsDone(Primitive.UploadTicket)) {
+                continue;
+            }
+            if (Pass->OcclusionTemporal && (InstanceIndex >= Pass->PreviousVisible.size() || !Pass->PreviousVisible[InstanceIndex])) {
+                continue;
+            }
+
+            OcclusionAddOccluder(&Pass->Occlusion, Scene->GpuScene.Instances[InstanceIndex].Transform, &Primitive.Occluder);
+        }
+    }
+
+    OcclusionRasterize(&Pass->Occlusion);
+}
+
+// NOTE(milo): Only frustum survivors overlapping a cell reached through the portals stay, the BVH finds each cell's instances.
+// InstanceVisible is scratch here, it is rebuilt from the final list.
+void ForwardCullCells(forward_pass* Pass, frame_graph_scene* Scene)
+{
+    portal_graph* Portals = &Scene->Portals;
+
+    Pass->CellInstances.clear();
+    for (u32 CellIndex : Portals->VisibleCells) {
+        BvhQueryAABB(&Scene->GpuScene.Tree, Portals->Cells[CellIndex].Bounds, &Pass->CellInstances);
+    }
+
+    Pass->InstanceVisible.assign(Scene->GpuScene.Bounds.Count, 0);
+    for (u32 InstanceIndex : Pass->CellInstances) {
+        Pass->InstanceVisible[InstanceIndex] = 1;
+    }
+
+    u32 Kept = 0;
+    for (u32 VisibleIndex = 0; VisibleIndex < Pass->VisibleInstances.size(); VisibleIndex++) {
+        u32 InstanceIndex = Pass->VisibleInstances[VisibleIndex];
+        if (Pass->InstanceVisible[InstanceIndex]) {
+            Pass->VisibleInstances[Kept++] = InstanceIndex;
+        }
+    }
+    Pass->VisibleInstances.resize(Kept);
+}
+
+// NOTE(milo): Tests the scene against the camera frustum, through the scene BVH or over every instance. When the camera is inside a
+// cell the survivors are limited to the cells seen through the portals, then tested against the occlusion buffer. Only what is
+// left is gathered and batched.
+void ForwardCullScene(forward_pass* Pass, frame_graph_scene* Scene)
+{
+    const culling_bounds* Bounds = &Scene->GpuScene.Bounds;
+
+    hmm_mat4 ViewProjection = HMM_MultiplyMat4(Scene->Camera.Projection, Scene->Camera.View);
+    hmm_vec4 Planes[CULLING_PLANE_COUNT];
+    CullingExtractPlanes(ViewProjection, Planes);
+
+    u32 VisibleCount = 0;
+    if (Pass->HierarchicalCulling) {
+        Pass->VisibleInstances.clear();
+        BvhQueryFrustum(&Scene->GpuScene.Tree, Planes, &Pass->VisibleInstances);
+        VisibleCount = (u32)Pass->VisibleInstances.size();
+
+        Pass->CullStats.Tested = Bounds->Count;
+        Pass->CullStats.Visible = VisibleCount;
+        Pass->CullStats.Culled = Bounds->Count - VisibleCount;
+        Pass->CullStats.Wide = false;
+        Pass->CullStats.Hierarchical = true;
+    } else {
+        Pass->VisibleInstances.resize(Bounds->Count);
+        VisibleCount = CullingTestSpheres(Bounds, Planes, Pass->VisibleInstances.data(), &Pass->CullStats);
+        Pass->VisibleInstances.resize(VisibleCount);
+        Pass->CullStats.Hierarchical = false;
+    }
+
+    Pass->PreviousVisible.swap(Pass->InstanceVisible);
+    if (Pass->PortalCulling && PortalFindVisibleCells(&Scene->Portals, PortalEyeFromView(Scene->Camera.View), Planes)) {
+        ForwardCullCells(Pass, Scene);
+        VisibleCount = (u32)Pass->VisibleInstances.size();
+    }
+
+    Pass->InstanceVisible.assign(Bounds->Count, 0);
+    for (u32 InstanceIndex : Pass->VisibleInstances) {
+        Pass->InstanceVisible[InstanceIndex] = 1;
+    }
+
+    if (Pass->OcclusionCulling) {
+        ForwardRenderOccluders(Pass, Scene, ViewProjection);
+        VisibleCount = OcclusionCullInstances(&Pass->Occlusion, Bounds, Pass->VisibleInstances.data(), VisibleCount);
+        Pass->VisibleInstances.resize(VisibleCount);
+
+        Pass->InstanceVisible.assign(Bounds->Count, 0);
+        for (u32 InstanceIndex : Pass->VisibleInstances) {
+            Pass->InstanceVisible[InstanceIndex] = 1;
+        }
+    }
+}
+
+// NOTE(milo): Sorting on the key puts every primitive sharing geometry, textures and pipeline next to each other, each run becomes
+// one instanced draw. The material factors differ per instance and come from the GPU scene.
+void ForwardBuildBatches(forward_pass* Pass)
+{
+    std::sort(Pass->Visible.begin(), Pass->Visible.end(), [](const forward_instance& A, const forward_instance& B) {
+        return memcmp(&A.Key, &B.Key, sizeof(forward_batch_key)) < 0;
+    });
+
+    Pass->Draws.clear();
+    Pass->Instances.clear();
+    for (u32 VisibleIndex = 0; VisibleIndex < Pass->Visible.size(); VisibleIndex++) {
+        forward_instance& Instance = Pass->Visible[VisibleIndex];
+        if (VisibleIndex == 0 || memcmp(&Instance.Key, &Pass->Visible[VisibleIndex - 1].Key, sizeof(forward_batch_key)) != 0) {
+            forward_draw Draw = {};
+            Draw.Mesh = Instance.Mesh;
+            Draw.PrimitiveIndex = Instance.PrimitiveIndex;
+            Draw.Pipeline = Instance.Key.Pipeline;
+            Draw.Textures = Instance.Textures;
+            Draw.FirstInstance = (u32)Pass->Instances.size();
+            Pass->Draws.push_back(Draw);
+        }
+
+        Pass->Instances.push_back(GpuSceneDraw(Instance.Mesh, Instance.PrimitiveIndex));
+        Pass->Draws.back().InstanceCount++;
+    }
+}
+
+void ForwardUploadInstances(forward_pass* Pass)
+{
+    if (Pass->Instances.empty()) {
+        return;
+    }
+
+    ForwardGrowBuffer(&Pass->InstanceStream, &Pass->InstanceCapacity, (u32)Pass->Instances.size(), sizeof(gpu_scene_draw), BufferUsage_Vertex, BufferAccess_Dynamic);
+    BufferWrite(&Pass->InstanceStream, Pass->Instances.data(), Pass->Instances.size() * sizeof(gpu_scene_draw));
 }
 
+// NOTE(milo): Every draw reads its arguments from ArgsBuffer. The CPU culled batches go up with their instance count, with GPU
+// culling they go up empty and the shader counts the survivors.
+void ForwardUploadArgs(forward_pass* Pass)
+{
+    if (Pass->Draws.empty()) {
+        return;
+    }
+
+    Pass->DrawArgs.clear();
+    for (forward_draw& Draw : Pass->Draws) {
+        rhi_draw_indexed_args Args = {};
+        Args.IndexCount = Draw.Mesh->Primitives[Draw.PrimitiveIndex].IndexCount;
+        Args.InstanceCount = Pass->GpuCulling ? 0 : Draw.InstanceCount;
+        Args.StartInstance = Draw.FirstInstance;
+        Pass->DrawArgs.push_back(Args);
+    }
+
+    ForwardGrowBuffer(&Pass->ArgsBuffer, &Pass->ArgsCapacity, (u32)Pass->DrawArgs.size(), sizeof(rhi_draw_indexed_args), BufferUsage_Indirect);
+    BufferUploadRange(&Pass->ArgsBuffer, Pass->DrawArgs.data(), 0, Pass->DrawArgs.size() * sizeof(rhi_draw_indexed_args));
+}
+
+// NOTE(milo): The shader tests the candidates against the camera frustum and bumps the count of the draw each survivor belongs to. The
+// CPU never learns what was culled.
+void ForwardCullInstances(forward_pass* Pass, frame_graph_scene* Scene)
+{
+    if (Pass->Instances.empty()) {
+        return;
+    }
+
+    Pass->Candidates.clear();
+    for (u32 DrawIndex = 0; DrawIndex < Pass->Draws.size(); DrawIndex++) {
+        forward_draw& Draw = Pass->Draws[DrawIndex];
+        for (u32 InstanceIndex = Draw.FirstInstance; InstanceIndex < Draw.FirstInstance + Draw.InstanceCount; InstanceIndex++) {
+            forward_cull_candidate Candidate = {};
+            Candidate.InstanceIndex = Pass->Instances[InstanceIndex].InstanceIndex;
+            Candidate.MaterialIndex = Pass->Instances[InstanceIndex].MaterialIndex;
+            Candidate.DrawIndex = DrawIndex;
+            Pass->Candidates.push_back(Candidate);
+        }
+    }
+
+    u32 CandidateCount = (u32)Pass->Candidates.size();
+    u32 CullCapacity = Pass->CullCapacity;
+    ForwardGrowBuffer(&Pass->CandidateBuffer, &Pass->CullCapacity, CandidateCount, sizeof(forward_cull_candidate), BufferUsage_Storage);
+    ForwardGrowBuffer(&Pass->CulledStream, &CullCapacity, CandidateCount, sizeof(gpu_scene_draw), BufferUsage_VertexStorage);
+    BufferUploadRange(&Pass->CandidateBuffer, Pass->Candidates.data(), 0, CandidateCount * sizeof(forward_cull_candidate));
+
+    forward_cull_constants Constants = {};
+    Constants.CandidateCount = CandidateCount;
+
+    ShaderBind(&Pass->CullShader);
+    BufferBindUniform(&Scene->CameraBuffer, 0, UniformBind_Compute);
+    UniformBindSlice(UniformPush(&Constants, sizeof(Constants)), 1, UniformBind_Compute);
+    BufferBindSRV(&Scene->GpuScene.InstanceBuffer, 0, UniformBind_Compute);
+    BufferBindSRV(&Pass->CandidateBuffer, 1, UniformBind_Compute);
+    BufferBindUAV(&Pass->ArgsBuffer, 0);
+    BufferBindUAV(&Pass->CulledStream, 1);
+    VideoDispatch((CandidateCount + FORWARD_CULL_GROUP_SIZE - 1) / FORWARD_CULL_GROUP_SIZE, 1, 1);
+    TextureResetUAV(0);
+    TextureResetUAV(1);
+}
+
+// NOTE(milo): Anything touching shared state, upload tickets and permutation lookups, is resolved while gathering so the recording
+// jobs only read. Lists are submitted in order, so the output matches recording everything on the main thread.
 void ForwardPassRender(forward_pass* Pass, frame_graph_scene* Scene)
 {
     TextureResetRTV();
@@ -28,25 +368,71 @@ void ForwardPassRender(forward_pass* Pass, frame_graph_scene* Scene)
     TextureResetSRV(2, UniformBind_Pixel);
 
     TextureBindRTV(&Pass->Output, &Pass->Depth, HMM_Vec4(0.1f, 0.2f, 0.3f, 1.0f));
-    ShaderBind(&Pass->ForwardShader);
-    MaterialBind(&Pass->ForwardMaterial);
-    BufferBindUniform(&Scene->CameraBuffer, 0, UniformBind_Vertex);
 
-    for (gpu_mesh Mesh : Scene->Meshes) {
-        for (gltf_primitive Primitive : Mesh.Primitives) {
-            gltf_material Material = Mesh.Materials[Primitive.MaterialIndex];
+    ForwardCullScene(Pass, Scene);
 
-            SamplerBind(&Pass->ForwardSampler, 0, UniformBind_Pixel);
-            TextureBindSRV(&Material.Albedo, 0, UniformBind_Pixel);
-            if (Material.HasNormalMap) TextureBindSRV(&Material.Normal, 1, UniformBind_Pixel);
-            if (Material.HasPBRMap) TextureBindSRV(&Material.PBR, 2, UniformBind_Pixel);
+    Pass->Visible.clear();
+    for (gpu_mesh& Mesh : Scene->Meshes) {
+        for (u32 PrimitiveIndex = 0; PrimitiveIndex < Mesh.Primitives.size(); PrimitiveIndex++) {
+            gltf_primitive& Primitive = Mesh.Primitives[PrimitiveIndex];
+            if (!Pass->InstanceVisible[Mesh.SceneInstanceBase + PrimitiveIndex] || !UploadIsDone(Primitive.UploadTicket)) {
+                continue;
+            }
+            gltf_material& Material = Mesh.Materials[Primitive.MaterialIndex];
+            if (!ForwardMaterialUploaded(&Material)) {
+                continue;
+            }
 
-            BufferBindVertex(&Primitive.VertexBuffer);
-            BufferBindIndex(&Primitive.IndexBuffer);
-            BufferBindUniform(&Primitive.InstanceBuffer, 1, UniformBind_Vertex);
-            VideoDrawIndexed(Primitive.IndexCount, 0);
+            forward_instance Instance = {};
+            Instance.Textures = ForwardMaterialTextures(&Material);
+            Instance.Key.Pipeline = ShaderPermutationsGet(&Pass->ForwardPermutations, ForwardMaterialFeatures(&Material));
+            Instance.Key.Albedo = Instance.Textures.Albedo->Internal;
+            Instance.Key.Normal = Instance.Textures.Normal ? Instance.Textures.Normal->Internal : NULL;
+            Instance.Key.PBR = Instance.Textures.PBR ? Instance.Textures.PBR->Internal : NULL;
+            Instance.Key.VertexBuffer = Primitive.VertexBuffer.Internal;
+            Instance.Key.IndexBuffer = Primitive.IndexBuffer.Internal;
+            Instance.Mesh = &Mesh;
+            Instance.PrimitiveIndex = PrimitiveIndex;
+            Pass->Visible.push_back(Instance);
         }
     }
+    ForwardBuildBatches(Pass);
+
+    if (Pass->GpuCullingEnabled && !Pass->CullShader.Internal) {
+        ShaderInitAsync(&Pass->CullShader, NULL, NULL, "data/shaders/cull/Compute.hlsl");
+    }
+    Pass->GpuCulling = Pass->GpuCullingEnabled && ShaderIsReady(&Pass->CullShader);
+    ForwardUploadArgs(Pass);
+    if (Pass->GpuCulling) {
+        ForwardCullInstances(Pass, Scene);
+    } else {
+        ForwardUploadInstances(Pass);
+    }
+
+    u32 ListCount = ((u32)Pass->Draws.size() + FORWARD_DRAWS_PER_LIST - 1) / FORWARD_DRAWS_PER_LIST;
+    if (ListCount <= 1) {
+        ForwardBindFrame(Pass, Scene);
+        ForwardRecordDraws(Pass, 0, (u32)Pass->Draws.size());
+        return;
+    }
+
+    while (Pass->CommandLists.size() < ListCount) {
+        rhi_command_list List = {};
+        CommandListInit(&List);
+        Pass->CommandLists.push_back(List);
+    }
+
+    forward_record_context Context = {};
+    Context.Pass = Pass;
+    Context.Scene = Scene;
+
+    job_counter Counter = {};
+    JobParallelFor(ListCount, 1, ForwardRecordLists, &Context, &Counter);
+    JobWait(&Counter);
+
+    for (u32 ListIndex = 0; ListIndex < ListCount; ListIndex++) {
+        CommandListSubmit(&Pass->CommandLists[ListIndex]);
+    }
 }
 
 void ForwardPassResize(forward_pass* Pass, u32 Width, u32 Height)
@@ -62,9 +448,20 @@ void ForwardPassResize(forward_pass* Pass, u32 Width, u32 Height)
 
 void ForwardPassFree(forward_pass* Pass)
 {
+    for (rhi_command_list& List : Pass->CommandLists) {
+        CommandListFree(&List);
+    }
+    Pass->CommandLists.clear();
+    BufferFree(&Pass->InstanceStream);
+    BufferFree(&Pass->CandidateBuffer);
+    BufferFree(&Pass->CulledStream);
+    BufferFree(&Pass->ArgsBuffer);
+    if (Pass->CullShader.Internal) {
+        ShaderFree(&Pass->CullShader);
+    }
+
     SamplerFree(&Pass->ForwardSampler);
-    MaterialFree(&Pass->ForwardMaterial);
-    ShaderFree(&Pass->ForwardShader);
+    ShaderPermutationsFree(&Pass->ForwardPermutations);
     TextureFree(&Pass->Depth);
     TextureFree(&Pass->Output);
 }
\ No newline at end of file
@@ -1,20 +1,133 @@
 #pragma once 
 
 #include "backrooms_rhi.h"
+#include "backrooms_permutation.h"
 
 #include "backrooms_graph_types.h"
 
+#include <vector>
+
+#define FORWARD_DRAWS_PER_LIST 2048
+#define FORWARD_DEFAULT_INSTANCES 4096
+#define FORWARD_DEFAULT_DRAWS 1024
+#define FORWARD_CULL_GROUP_SIZE 64
+
+// NOTE(milo): Bits of the forward shader permutations, each one compiles in the matching HAS_ or USE_ define.
+enum forward_feature
+{
+    ForwardFeature_NormalMap = 1 << 0,
+    ForwardFeature_PBRMap = 1 << 1,
+    ForwardFeature_TextureArrays = 1 << 2,
+    ForwardFeature_Atlas = 1 << 3
+};
+
+// NOTE(milo): Primitives that agree on all of these are drawn as instances of one draw. Sorted in field order, so draws sharing a pipeline
+// and texture arrays end up next to each other and the state cache skips their binds.
+struct forward_batch_key
+{
+    rhi_pipeline* Pipeline;
+    void* Albedo;
+    void* Normal;
+    void* PBR;
+    void* VertexBuffer;
+    void* IndexBuffer;
+};
+
+// NOTE(milo): The textures to bind, the pooled arrays for packed materials and the material's own textures otherwise.
+struct forward_textures
+{
+    rhi_texture* Albedo;
+    rhi_texture* Normal;
+    rhi_texture* PBR;
+};
+
+struct forward_instance
+{
+    forward_batch_key Key;
+    forward_textures Textures;
+    gpu_mesh* Mesh;
+    u32 PrimitiveIndex;
+};
+
+// NOTE(milo): Draws InstanceCount records of the instance stream from FirstInstance, Mesh and PrimitiveIndex are the first of them.
+struct forward_draw
+{
+    gpu_mesh* Mesh;
+    u32 PrimitiveIndex;
+    rhi_pipeline* Pipeline;
+    forward_textures Textures;
+    u32 FirstInstance;
+    u32 InstanceCount;
+};
+
+// NOTE(milo): One instance for the culling shader to test, survivors are appended to their draw's range of the culled stream.
+struct forward_cull_candidate
+{
+    u32 InstanceIndex;
+    u32 MaterialIndex;
+    u32 DrawIndex;
+    u32 Pad;
+};
+
+struct forward_cull_constants
+{
+    u32 CandidateCount;
+    u32 Pad[3];
+};
+
 struct forward_pass
 {
     rhi_texture Output;
     rhi_texture Depth;
 
-    rhi_shader ForwardShader;
-    rhi_material ForwardMaterial;
+    shader_permutation_set ForwardPermutations;
     rhi_sampler ForwardSampler;
+
+    // NOTE(milo): Scene instances whose bounding sphere passed the frustum test this frame, as a list and as a flag per instance.
+    // HierarchicalCulling walks the scene BVH instead of running the flat SIMD test over every instance.
+    std::vector<u32> VisibleInstances;
+    std::vector<u8> InstanceVisible;
+    culling_stats CullStats;
+    bool HierarchicalCulling;
+
+    // NOTE(milo): Instances overlapping the cells visible through the level's portals, only used while the camera is in a cell.
+    bool PortalCulling;
+    std::vector<u32> CellInstances;
+
+    // NOTE(milo): Frustum survivors are then tested against a small software depth buffer of the biggest occluders. PreviousVisible
+    // holds last frame's flags for the temporal occluder selection.
+    occlusion_buffer Occlusion;
+    bool OcclusionCulling;
+    bool OcclusionTemporal;
+    std::vector<u8> PreviousVisible;
+
+    // NOTE(milo): Gathered and batched on the main thread, then recorded in FORWARD_DRAWS_PER_LIST chunks on the job system.
+    std::vector<forward_instance> Visible;
+    std::vector<forward_draw> Draws;
+    std::vector<rhi_command_list> CommandLists;
+
+    // NOTE(milo): One gpu_scene_draw per instance, read through the shader's INSTANCE input.
+    std::vector<gpu_scene_draw> Instances;
+    rhi_buffer InstanceStream;
+    u32 InstanceCapacity;
+
+    // NOTE(milo): Every draw is indirect, its arguments come from ArgsBuffer and its instances from InstanceStream. GPU culling is opt
+    // in, the culling shader only starts building the first frame it is enabled. While the shader is available the arguments go up
+    // with no instances and it writes the counts and the surviving instances into CulledStream.
+    bool GpuCullingEnabled;
+    rhi_shader CullShader;
+    bool GpuCulling;
+    std::vector<forward_cull_candidate> Candidates;
+    std::vector<rhi_draw_indexed_args> DrawArgs;
+    rhi_buffer CandidateBuffer;
+    rhi_buffer CulledStream;
+    rhi_buffer ArgsBuffer;
+    u32 CullCapacity;
+    u32 ArgsCapacity;
 };
 
 void ForwardPassInit(forward_pass* Pass);
+void ForwardPassPrepare(forward_pass* Pass, gpu_mesh* Mesh);
 void ForwardPassRender(forward_pass* Pass, frame_graph_scene* Scene);
 void ForwardPassResize(forward_pass* Pass, u32 Width, u32 Height);
 void ForwardPassFree(forward_pass* Pass);
\ No newline at end of file
@@ -2,14 +2,16 @@
 
 void FrameGraphInit(frame_graph* Graph)
 {
-    BufferInit(&Graph->Scene.CameraBuffer, sizeof(frame_graph_camera_buffer), 0, BufferUsage_Uniform);
+    BufferInit(&Graph->Scene.CameraBuffer, sizeof(frame_graph_camera_buffer), 0, BufferUsage_Uniform, BufferAccess_Dynamic);
+    GpuSceneInit(&Graph->Scene.GpuScene);
 
     ForwardPassInit(&Graph->Forward);
 }
 
 void FrameGraphUpdate(frame_graph* Graph)
 {
-    BufferUpload(&Graph->Scene.CameraBuffer, &Graph->Scene.Camera);
+    BufferWrite(&Graph->Scene.CameraBuffer, &Graph->Scene.Camera, sizeof(frame_graph_camera_buffer));
+    GpuSceneUpdate(&Graph->Scene.GpuScene);
     ForwardPassRender(&Graph->Forward, &Graph->Scene);
 }
 
@@ -26,5 +28,49 @@ void FrameGraphResize(frame_graph* Graph, u32 Width, u32 Height)
 void FrameGraphFree(frame_graph* Graph)
 {
     ForwardPassFree(&Graph->Forward);
+    GpuSceneFree(&Graph->Scene.GpuScene);
+    PortalGraphFree(&Graph->Scene.Portals);
     BufferFree(&Graph->Scene.CameraBuffer);
+}
+
+// NOTE(milo): Adding the same mesh again places another copy that shares its buffers and textures, the forward pass instances them.
+void FrameGraphAddMesh(frame_graph* Graph, const gpu_mesh& Mesh, hmm_mat4 Transform)
+{
+    Graph->Scene.Meshes.push_back(Mesh);
+    GpuSceneAddMesh(&Graph->Scene.GpuScene, &Graph->Scene.Meshes.back());
+    GpuSceneSetMeshTransform(&Graph->Scene.GpuScene, &Graph->Scene.Meshes.back(), Transform);
+
+    for (const aabb& Cell : Mesh.Cells) {
+        PortalGraphAddCell(&Graph->Scene.Portals, AabbTransform(&Cell, Transform));
+    }
+    for (portal_polygon Polygon : Mesh.Portals) {
+        for (u32 Index = 0; Index < Polygon.VertexCount; Index++) {
+            Polygon.Vertices[Index] = HMM_MultiplyMat4ByVec4(Transform, HMM_Vec4v(Polygon.Vertices[Index], 1.0f)).XYZ;
+        }
+        PortalGraphAddPortal(&Graph->Scene.Portals, &Polygon);
+    }
+    ForwardPassPrepare(&Graph->Forward, &Graph->Scene.Meshes.back());
+}
+
+culling_stats FrameGraphGetCullingStats(frame_graph* Graph)
+{
+    return Graph->Forward.CullStats;
+}
+
+occlusion_stats FrameGraphGetOcclusionStats(frame_graph* Graph)
+{
+    return Graph->Forward.Occlusion.Stats;
+}
+
+portal_stats FrameGraphGetPortalStats(frame_graph* Graph)
+{
+    return Graph->Scene.Portals.Stats;
+}
+
+// NOTE(milo): Gameplay queries against the scene instances, results are instance indices. Meshes added since the last update are
+// picked up by maintaining the tree first.
+void FrameGraphQuery(frame_graph* Graph, bvh_query* Queries, u32 Count)
+{
+    BvhMaintain(&Graph->Scene.GpuScene.Tree);
+    BvhQueryBatch(&Graph->Scene.GpuScene.Tree, Queries, Count);
 }
\ No newline at end of file
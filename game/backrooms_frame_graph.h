@@ -16,4 +16,9 @@ void FrameGraphInit(frame_graph* Graph);
 void FrameGraphUpdate(frame_graph* Graph);
 void FrameGraphRender(frame_graph* Graph);
 void FrameGraphResize(frame_graph* Graph, u32 Width, u32 Height);
-void FrameGraphFree(frame_graph* Graph);
\ No newline at end of file
+void FrameGraphFree(frame_graph* Graph);
+void FrameGraphAddMesh(frame_graph* Graph, const gpu_mesh& Mesh, hmm_mat4 Transform = HMM_Mat4d(1.0f));
+culling_stats FrameGraphGetCullingStats(frame_graph* Graph);
+occlusion_stats FrameGraphGetOcclusionStats(frame_graph* Graph);
+portal_stats FrameGraphGetPortalStats(frame_graph* Graph);
+void FrameGraphQuery(frame_graph* Graph, bvh_query* Queries, u32 Count);
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "backrooms_gpu_scene.h"
+#include "backrooms_logger.h"
+
+void GpuSceneMarkDirty(gpu_scene_range* Range, u32 Start, u32 End)
+{
+    if (Range->Start >= Range->End) {
+        Range->Start = Start;
+        Range->End = End;
+        return;
+    }
+    Range->Start = Start < Range->Start ? Start : Range->Start;
+    Range->End = End > Range->End ? End : Range->End;
+}
+
+void GpuSceneCreateBuffer(rhi_buffer* Buffer, u32 Capacity, u32 Stride)
+{
+    BufferInit(Buffer, (i64)Capacity * Stride, Stride, BufferUsage_Storage);
+    BufferInitSRV(Buffer);
+}
+
+// NOTE(milo): Growing recreates the buffer, so everything up to Count goes up again on the next update.
+void GpuSceneGrow(rhi_buffer* Buffer, u32* Capacity, u32 Count, u32 Stride, gpu_scene_range* Dirty)
+{
+    if (Count <= *Capacity) {
+        return;
+    }
+
+    while (*Capacity < Count) {
+        *Capacity *= 2;
+    }
+    BufferFree(Buffer);
+    GpuSceneCreateBuffer(Buffer, *Capacity, Stride);
+    GpuSceneMarkDirty(Dirty, 0, Count);
+}
+
+void GpuSceneInit(gpu_scene* Scene, u32 InstanceCapacity, u32 MaterialCapacity)
+{
+    Scene->InstanceCapacity = InstanceCapacity;
+    Scene->MaterialCapacity = MaterialCapacity;
+    Scene->InstanceDirty = {};
+    Scene->MaterialDirty = {};
+    CullingBoundsResize(&Scene->Bounds, 0);
+    BvhResize(&Scene->Tree, 0);
+
+    GpuSceneCreateBuffer(&Scene->InstanceBuffer, InstanceCapacity, sizeof(gpu_scene_instance));
+    GpuSceneCreateBuffer(&Scene->MaterialBuffer, MaterialCapacity, sizeof(material_data));
+
+    // NOTE(milo): Material zero is what primitives without a material are drawn with.
+    material_data Default = {};
+    Default.AlbedoFactor = HMM_Vec3(1.0f, 1.0f, 1.0f);
+    Default.MetallicFactor = 0.0f;
+    Default.RoughnessFactor = 1.0f;
+    GpuSceneAddMaterial(Scene, Default);
+}
+
+void GpuSceneFree(gpu_scene* Scene)
+{
+    BufferFree(&Scene->InstanceBuffer);
+    BufferFree(&Scene->MaterialBuffer);
+    Scene->Instances.clear();
+    Scene->Materials.clear();
+    CullingBoundsResize(&Scene->Bounds, 0);
+    BvhFree(&Scene->Tree);
+}
+
+void GpuSceneUpdate(gpu_scene* Scene)
+{
+    BvhMaintain(&Scene->Tree);
+
+    if (Scene->InstanceDirty.Start < Scene->InstanceDirty.End) {
+        gpu_scene_range Range = Scene->InstanceDirty;
+        BufferUploadRange(&Scene->InstanceBuffer, &Scene->Instances[Range.Start], (u64)Range.Start * sizeof(gpu_scene_instance), (u64)(Range.End - Range.Start) * sizeof(gpu_scene_instance));
+        Scene->InstanceDirty = {};
+    }
+
+    if (Scene->MaterialDirty.Start < Scene->MaterialDirty.End) {
+        gpu_scene_range Range = Scene->MaterialDirty;
+        BufferUploadRange(&Scene->MaterialBuffer, &Scene->Materials[Range.Start], (u64)Range.Start * sizeof(material_data), (u64)(Range.End - Range.Start) * sizeof(material_data));
+        Scene->MaterialDirty = {};
+    }
+}
+
+void GpuSceneBind(gpu_scene* Scene)
+{
+    BufferBindSRV(&Scene->InstanceBuffer, GPU_SCENE_INSTANCE_BINDING, UniformBind_Vertex);
+    BufferBindSRV(&Scene->MaterialBuffer, GPU_SCENE_MATERIAL_BINDING, UniformBind_Pixel);
+}
+
+u32 GpuSceneAddInstance(gpu_scene* Scene, const gpu_scene_instance& Instance)
+{
+    u32 Index = (u32)Scene->Instances.size();
+    Scene->Instances.push_back(Instance);
+
+    hmm_vec4 Sphere = CullingTransformSphere(Instance.Transform, Instance.BoundingSphere);
+    CullingBoundsResize(&Scene->Bounds, Index + 1);
+    CullingBoundsSet(&Scene->Bounds, Index, Sphere);
+    BvhResize(&Scene->Tree, Index + 1);
+    BvhSetItem(&Scene->Tree, Index, AabbFromSphere(Sphere));
+
+    GpuSceneGrow(&Scene->InstanceBuffer, &Scene->InstanceCapacity, Index + 1, sizeof(gpu_scene_instance), &Scene->InstanceDirty);
+    GpuSceneMarkDirty(&Scene->InstanceDirty, Index, Index + 1);
+    return Index;
+}
+
+u32 GpuSceneAddMaterial(gpu_scene* Scene, const material_data& Material)
+{
+    u32 Index = (u32)Scene->Materials.size();
+    Scene->Materials.push_back(Material);
+
+    GpuSceneGrow(&Scene->MaterialBuffer, &Scene->MaterialCapacity, Index + 1, sizeof(material_data), &Scene->MaterialDirty);
+    GpuSceneMarkDirty(&Scene->MaterialDirty, Index, Index + 1);
+    return Index;
+}
+
+void GpuSceneSetTransform(gpu_scene* Scene, u32 InstanceIndex, hmm_mat4 Transform)
+{
+    if (InstanceIndex >= Scene->Instances.size()) {
+        LogWarn("Setting the transform of unknown scene instance %u", InstanceIndex);
+        return;
+    }
+
+    Scene->Instances[InstanceIndex].Transform = Transform;
+    hmm_vec4 Sphere = CullingTransformSphere(Transform, Scene->Instances[InstanceIndex].BoundingSphere);
+    CullingBoundsSet(&Scene->Bounds, InstanceIndex, Sphere);
+    BvhSetItem(&Scene->Tree, InstanceIndex, AabbFromSphere(Sphere));
+    GpuSceneMarkDirty(&Scene->InstanceDirty, InstanceIndex, InstanceIndex + 1);
+}
+
+void GpuSceneSetMaterial(gpu_scene* Scene, u32 MaterialIndex, const material_data& Material)
+{
+    if (MaterialIndex >= Scene->Materials.size()) {
+        LogWarn("Setting unknown scene material %u", MaterialIndex);
+        return;
+    }
+
+    Scene->Materials[MaterialIndex] = Material;
+    GpuSceneMarkDirty(&Scene->MaterialDirty, MaterialIndex, MaterialIndex + 1);
+}
+
+void GpuSceneAddMesh(gpu_scene* Scene, gpu_mesh* Mesh)
+{
+    Mesh->SceneMaterialBase = (u32)Scene->Materials.size();
+    for (gltf_material& Material : Mesh->Materials) {
+        GpuSceneAddMaterial(Scene, Material.MaterialData);
+    }
+
+    Mesh->SceneInstanceBase = (u32)Scene->Instances.size();
+    for (gltf_primitive& Primitive : Mesh->Primitives) {
+        gpu_scene_instance Instance = {};
+        Instance.Transform = Primitive.InstanceData.Transform;
+        Instance.BoundingSphere = Primitive.InstanceData.BoundingSphere;
+        Instance.MaterialIndex = Primitive.MaterialIndex < Mesh->Materials.size() ? Mesh->SceneMaterialBase + Primitive.MaterialIndex : 0;
+        GpuSceneAddInstance(Scene, Instance);
+    }
+}
+
+// NOTE(milo): Transform places the whole mesh, each primitive keeps the node transform it was loaded with underneath.
+void GpuSceneSetMeshTransform(gpu_scene* Scene, gpu_mesh* Mesh, hmm_mat4 Transform)
+{
+    for (u32 PrimitiveIndex = 0; PrimitiveIndex < Mesh->Primitives.size(); PrimitiveIndex++) {
+        hmm_mat4 World = HMM_MultiplyMat4(Transform, Mesh->Primitives[PrimitiveIndex].InstanceData.Transform);
+        GpuSceneSetTransform(Scene, Mesh->SceneInstanceBase + PrimitiveIndex, World);
+    }
+}
+
+gpu_scene_draw GpuSceneDraw(gpu_mesh* Mesh, u32 PrimitiveIndex)
+{
+    gltf_primitive* Primitive = &Mesh->Primitives[PrimitiveIndex];
+
+    gpu_scene_draw Draw = {};
+    Draw.InstanceIndex = Mesh->SceneInstanceBase + PrimitiveIndex;
+    Draw.MaterialIndex = Primitive->MaterialIndex < Mesh->Materials.size() ? Mesh->SceneMaterialBase + Primitive->MaterialIndex : 0;
+    return Draw;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_rhi.h"
+#include "backrooms_model.h"
+#include "backrooms_culling.h"
+#include "backrooms_bvh.h"
+
+#include <vector>
+
+#define GPU_SCENE_DEFAULT_INSTANCES 4096
+#define GPU_SCENE_DEFAULT_MATERIALS 256
+#define GPU_SCENE_INSTANCE_BINDING 0 // NOTE(milo): t0 in the vertex shader
+#define GPU_SCENE_MATERIAL_BINDING 3 // NOTE(milo): t3 in the pixel shader, after the material textures
+
+struct gpu_scene_instance
+{
+    hmm_mat4 Transform;
+    hmm_vec4 BoundingSphere;
+    u32 MaterialIndex;
+    u32 Pad[3];
+};
+
+// NOTE(milo): The only per draw data, the shaders fetch everything else from the scene buffers. Instanced draws stream one per instance.
+struct gpu_scene_draw
+{
+    u32 InstanceIndex;
+    u32 MaterialIndex;
+    u32 Pad[2];
+};
+
+// NOTE(milo): Dirty ranges are kept as [Start, End) in elements and are cleared once uploaded.
+struct gpu_scene_range
+{
+    u32 Start;
+    u32 End;
+};
+
+struct gpu_scene
+{
+    std::vector<gpu_scene_instance> Instances;
+    std::vector<material_data> Materials;
+
+    rhi_buffer InstanceBuffer;
+    rhi_buffer MaterialBuffer;
+    u32 InstanceCapacity;
+    u32 MaterialCapacity;
+
+    gpu_scene_range InstanceDirty;
+    gpu_scene_range MaterialDirty;
+
+    // NOTE(milo): World space bounding sphere of every instance, kept in step with the transforms for CPU culling.
+    culling_bounds Bounds;
+
+    // NOTE(milo): The same spheres as boxes in a BVH, refitted on every transform change and rebuilt in GpuSceneUpdate when needed.
+    bvh Tree;
+};
+
+//~ NOTE(milo): Scene database
+void GpuSceneInit(gpu_scene* Scene, u32 InstanceCapacity = GPU_SCENE_DEFAULT_INSTANCES, u32 MaterialCapacity = GPU_SCENE_DEFAULT_MATERIALS);
+void GpuSceneFree(gpu_scene* Scene);
+void GpuSceneUpdate(gpu_scene* Scene);
+void GpuSceneBind(gpu_scene* Scene);
+
+//~ NOTE(milo): Instances and materials
+u32 GpuSceneAddInstance(gpu_scene* Scene, const gpu_scene_instance& Instance);
+u32 GpuSceneAddMaterial(gpu_scene* Scene, const material_data& Material);
+void GpuSceneSetTransform(gpu_scene* Scene, u32 InstanceIndex, hmm_mat4 Transform);
+void GpuSceneSetMaterial(gpu_scene* Scene, u32 MaterialIndex, const material_data& Material);
+
+//~ NOTE(milo): Meshes
+void GpuSceneAddMesh(gpu_scene* Scene, gpu_mesh* Mesh);
+void GpuSceneSetMeshTransform(gpu_scene* Scene, gpu_mesh* Mesh, hmm_mat4 Transform);
+gpu_scene_draw GpuSceneDraw(gpu_mesh* Mesh, u32 PrimitiveIndex);
@@ -2,6 +2,7 @@
 
 #include "backrooms_common.h"
 #include "backrooms_model.h"
+#include "backrooms_gpu_scene.h"
 
 struct frame_graph_camera_buffer
 {
@@ -13,6 +14,8 @@ struct frame_graph_camera_buffer
 struct frame_graph_scene
 {
     std::vector<gpu_mesh> Meshes;
+    gpu_scene GpuScene;
+    portal_graph Portals;
 
     frame_graph_camera_buffer Camera;
     rhi_buffer CameraBuffer;
@@ -0,0 +1,141 @@
+#include "backrooms_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// NOTE(milo): XXH64, fast enough to hash whole source assets on every build and well distributed enough for hash tables.
+#define HASH_PRIME1 11400714785074694791ull
+#define HASH_PRIME2 14029467366897019727ull
+#define HASH_PRIME3 1609587929392839161ull
+#define HASH_PRIME4 9650029242287828579ull
+#define HASH_PRIME5 2870177450012600261ull
+
+u64 HashRotate(u64 Value, u32 Bits)
+{
+    return (Value << Bits) | (Value >> (64 - Bits));
+}
+
+u64 HashRead64(const u8* Data)
+{
+    u64 Value;
+    memcpy(&Value, Data, sizeof(u64));
+    return Value;
+}
+
+u32 HashRead32(const u8* Data)
+{
+    u32 Value;
+    memcpy(&Value, Data, sizeof(u32));
+    return Value;
+}
+
+u64 HashRound(u64 Accumulator, u64 Input)
+{
+    Accumulator += Input * HASH_PRIME2;
+    Accumulator = HashRotate(Accumulator, 31);
+    return Accumulator * HASH_PRIME1;
+}
+
+u64 HashMerge(u64 Accumulator, u64 Value)
+{
+    Accumulator ^= HashRound(0, Value);
+    return Accumulator * HASH_PRIME1 + HASH_PRIME4;
+}
+
+u64 HashBytes(const void* Data, u64 Size, u64 Seed)
+{
+    const u8* Cursor = (const u8*)Data;
+    const u8* End = Cursor + Size;
+    u64 Hash;
+
+    if (Size >= 32) {
+        u64 V1 = Seed + HASH_PRIME1 + HASH_PRIME2;
+        u64 V2 = Seed + HASH_PRIME2;
+        u64 V3 = Seed;
+        u64 V4 = Seed - HASH_PRIME1;
+
+        const u8* Limit = End - 32;
+        do {
+            V1 = HashRound(V1, HashRead64(Cursor));
+            V2 = HashRound(V2, HashRead64(Cursor + 8));
+            V3 = HashRound(V3, HashRead64(Cursor + 16));
+            V4 = HashRound(V4, HashRead64(Cursor + 24));
+            Cursor += 32;
+        } while (Cursor <= Limit);
+
+        Hash = HashRotate(V1, 1) + HashRotate(V2, 7) + HashRotate(V3, 12) + HashRotate(V4, 18);
+        Hash = HashMerge(Hash, V1);
+        Hash = HashMerge(Hash, V2);
+        Hash = HashMerge(Hash, V3);
+        Hash = HashMerge(Hash, V4);
+    } else {
+        Hash = Seed + HASH_PRIME5;
+    }
+
+    Hash += Size;
+
+    while (Cursor + 8 <= End) {
+        Hash ^= HashRound(0, HashRead64(Cursor));
+        Hash = HashRotate(Hash, 27) * HASH_PRIME1 + HASH_PRIME4;
+        Cursor += 8;
+    }
+
+    if (Cursor + 4 <= End) {
+        Hash ^= (u64)HashRead32(Cursor) * HASH_PRIME1;
+        Hash = HashRotate(Hash, 23) * HASH_PRIME2 + HASH_PRIME3;
+        Cursor += 4;
+    }
+
+    while (Cursor < End) {
+        Hash ^= (*Cursor) * HASH_PRIME5;
+        Hash = HashRotate(Hash, 11) * HASH_PRIME1;
+        Cursor++;
+    }
+
+    Hash ^= Hash >> 33;
+    Hash *= HASH_PRIME2;
+    Hash ^= Hash >> 29;
+    Hash *= HASH_PRIME3;
+    Hash ^= Hash >> 32;
+    return Hash;
+}
+
+u64 HashString(const std::string& String, u64 Seed)
+{
+    return HashBytes(String.data(), String.size(), Seed);
+}
+
+u64 HashCombine(u64 Hash, u64 Value)
+{
+    return HashBytes(&Value, sizeof(Value), Hash);
+}
+
+bool HashFile(const char* Path, u64* Hash)
+{
+    FILE* File = fopen(Path, "rb");
+    if (!File) {
+        return false;
+    }
+
+    fseek(File, 0, SEEK_END);
+    long Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    void* Data = malloc(Size > 0 ? Size : 1);
+    bool Read = fread(Data, 1, Size, File) == (size_t)Size;
+    fclose(File);
+
+    if (Read) {
+        *Hash = HashBytes(Data, (u64)Size);
+    }
+    free(Data);
+    return Read;
+}
+
+std::string HashToString(u64 Hash)
+{
+    char Buffer[17];
+    snprintf(Buffer, sizeof(Buffer), "%016llx", Hash);
+    return std::string(Buffer);
+}
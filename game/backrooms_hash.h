@@ -0,0 +1,14 @@
+#pragma once
+
+#include "backrooms_common.h"
+
+#include <string>
+
+#define HASH_DEFAULT_SEED 0
+
+//~ NOTE(milo): Hashing
+u64 HashBytes(const void* Data, u64 Size, u64 Seed = HASH_DEFAULT_SEED);
+u64 HashString(const std::string& String, u64 Seed = HASH_DEFAULT_SEED);
+u64 HashCombine(u64 Hash, u64 Value);
+bool HashFile(const char* Path, u64* Hash);
+std::string HashToString(u64 Hash);
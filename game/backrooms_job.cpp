@@ -0,0 +1,191 @@
+#include "backrooms_job.h"
+#include "backrooms_platform.h"
+#include "backrooms_logger.h"
+
+struct job
+{
+    PFN_JobFunction Function;
+    PFN_JobRangeFunction RangeFunction;
+    void* Data;
+    u32 Start;
+    u32 End;
+    job_counter* Counter;
+};
+
+struct job_system_state
+{
+    platform_thread Workers[JOB_MAX_WORKERS];
+    u32 WorkerCount;
+
+    platform_mutex QueueLock;
+    platform_semaphore Wakeup;
+    job Queue[JOB_QUEUE_SIZE];
+    u32 QueueHead;
+    u32 QueueCount;
+
+    std::atomic<bool> Running;
+};
+
+static job_system_state JobState;
+
+void JobExecute(job* Job)
+{
+    if (Job->RangeFunction) {
+        Job->RangeFunction(Job->Data, Job->Start, Job->End);
+    } else {
+        Job->Function(Job->Data);
+    }
+
+    if (Job->Counter) {
+        Job->Counter->Pending.fetch_sub(1);
+    }
+}
+
+bool JobPop(job* Job)
+{
+    bool Found = false;
+
+    PlatformMutexLock(&JobState.QueueLock);
+    if (JobState.QueueCount > 0) {
+        *Job = JobState.Queue[JobState.QueueHead];
+        JobState.QueueHead = (JobState.QueueHead + 1) % JOB_QUEUE_SIZE;
+        JobState.QueueCount--;
+        Found = true;
+    }
+    PlatformMutexUnlock(&JobState.QueueLock);
+
+    return Found;
+}
+
+void JobPush(job* Job)
+{
+    if (Job->Counter) {
+        Job->Counter->Pending.fetch_add(1);
+    }
+
+    if (JobState.WorkerCount == 0) {
+        JobExecute(Job);
+        return;
+    }
+
+    bool Queued = false;
+
+    PlatformMutexLock(&JobState.QueueLock);
+    if (JobState.QueueCount < JOB_QUEUE_SIZE) {
+        JobState.Queue[(JobState.QueueHead + JobState.QueueCount) % JOB_QUEUE_SIZE] = *Job;
+        JobState.QueueCount++;
+        Queued = true;
+    }
+    PlatformMutexUnlock(&JobState.QueueLock);
+
+    // NOTE(milo): A full queue runs the job on the submitting thread instead of blocking it.
+    if (Queued) {
+        PlatformSemaphoreSignal(&JobState.Wakeup, 1);
+    } else {
+        JobExecute(Job);
+    }
+}
+
+u32 JobWorkerMain(void* Parameter)
+{
+    while (true) {
+        PlatformSemaphoreWait(&JobState.Wakeup);
+        if (!JobState.Running.load()) {
+            break;
+        }
+
+        job Job;
+        while (JobPop(&Job)) {
+            JobExecute(&Job);
+        }
+    }
+
+    return 0;
+}
+
+void JobSystemInit()
+{
+    JobState.QueueHead = 0;
+    JobState.QueueCount = 0;
+    JobState.Running.store(true);
+
+    PlatformMutexCreate(&JobState.QueueLock);
+    PlatformSemaphoreCreate(&JobState.Wakeup, 0, JOB_QUEUE_SIZE + JOB_MAX_WORKERS);
+
+    // NOTE(milo): Leave the main thread its own core, it helps out in JobWait anyway.
+    i32 ProcessorCount = PlatformGetProcessorCount();
+    u32 WorkerCount = ProcessorCount > 1 ? (u32)(ProcessorCount - 1) : 1;
+    if (WorkerCount > JOB_MAX_WORKERS) {
+        WorkerCount = JOB_MAX_WORKERS;
+    }
+
+    for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++) {
+        PlatformThreadCreate(JobWorkerMain, NULL, false, &JobState.Workers[WorkerIndex]);
+    }
+    JobState.WorkerCount = WorkerCount;
+
+    LogInfo("Job system started with %u workers.", WorkerCount);
+}
+
+void JobSystemExit()
+{
+    JobState.Running.store(false);
+    PlatformSemaphoreSignal(&JobState.Wakeup, (i32)JobState.WorkerCount);
+
+    for (u32 WorkerIndex = 0; WorkerIndex < JobState.WorkerCount; WorkerIndex++) {
+        PlatformThreadWait(&JobState.Workers[WorkerIndex]);
+        PlatformThreadDestroy(&JobState.Workers[WorkerIndex]);
+    }
+    JobState.WorkerCount = 0;
+
+    PlatformSemaphoreDestroy(&JobState.Wakeup);
+    PlatformMutexDestroy(&JobState.QueueLock);
+}
+
+u32 JobWorkerCount()
+{
+    return JobState.WorkerCount;
+}
+
+void JobSubmit(PFN_JobFunction Function, void* Data, job_counter* Counter)
+{
+    job Job = {};
+    Job.Function = Function;
+    Job.Data = Data;
+    Job.Counter = Counter;
+    JobPush(&Job);
+}
+
+void JobParallelFor(u32 Count, u32 BatchSize, PFN_JobRangeFunction Function, void* Data, job_counter* Counter)
+{
+    if (BatchSize == 0) {
+        BatchSize = 1;
+    }
+
+    for (u32 Start = 0; Start < Count; Start += BatchSize) {
+        job Job = {};
+        Job.RangeFunction = Function;
+        Job.Data = Data;
+        Job.Start = Start;
+        Job.End = Count - Start < BatchSize ? Count : Start + BatchSize;
+        Job.Counter = Counter;
+        JobPush(&Job);
+    }
+}
+
+bool JobIsDone(job_counter* Counter)
+{
+    return Counter->Pending.load() == 0;
+}
+
+void JobWait(job_counter* Counter)
+{
+    while (!JobIsDone(Counter)) {
+        job Job;
+        if (JobPop(&Job)) {
+            JobExecute(&Job);
+        } else {
+            PlatformThreadSleep(NULL, 0);
+        }
+    }
+}
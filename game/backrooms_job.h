@@ -0,0 +1,27 @@
+#pragma once
+
+#include "backrooms_common.h"
+
+#include <atomic>
+
+#define JOB_MAX_WORKERS 32
+#define JOB_QUEUE_SIZE 4096
+
+typedef void (*PFN_JobFunction)(void* Data);
+typedef void (*PFN_JobRangeFunction)(void* Data, u32 Start, u32 End);
+
+struct job_counter
+{
+    std::atomic<i32> Pending;
+};
+
+//~ NOTE(milo): Job system
+void JobSystemInit();
+void JobSystemExit();
+u32 JobWorkerCount();
+
+//~ NOTE(milo): Jobs
+void JobSubmit(PFN_JobFunction Function, void* Data, job_counter* Counter);
+void JobParallelFor(u32 Count, u32 BatchSize, PFN_JobRangeFunction Function, void* Data, job_counter* Counter);
+bool JobIsDone(job_counter* Counter);
+void JobWait(job_counter* Counter);
@@ -1,89 +1,145 @@
 #include "backrooms_model.h"
+#include "backrooms_accessor.h"
+#include "backrooms_tangent.h"
+#include "backrooms_texture.h"
+#include "backrooms_streaming.h"
+#include "backrooms_asset_build.h"
+#include "backrooms_pack.h"
+#include "backrooms_bvh.h"
 #include "backrooms_platform.h"
+#include "backrooms_logger.h"
 
 #include <cgltf/cgltf.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <future>
+#include <unordered_map>
 
 #define CGLTFCall(Call) do { cgltf_result Result = (Call); assert(Result == cgltf_result_success); } while(0)
 
-struct aabb
+// NOTE(milo): Prefer the cooked texture next to the source image, fall back to decoding the PNG/JPEG.
+void MeshLoadImage(rhi_image* Image, const std::string& Path)
 {
-    hmm_vec3 Min;
-    hmm_vec3 Max;
-};
+    std::string CookedPath = TextureCookedPath(Path);
+    if (ImageLoadCooked(Image, CookedPath.c_str())) {
+        Image->Path = Path.c_str();
+        return;
+    }
+    ImageLoad(Image, Path.c_str());
+}
 
-u32 MeshLoadAlbedo(void* Parameter)
+// NOTE(milo): Cooked textures are streamed in starting from their low mips, anything else is loaded whole.
+void MeshLoadTexture(rhi_texture* Texture, rhi_image* Image, const std::string& Path, u32* Stream)
 {
-    gltf_material* Material = (gltf_material*)Parameter;
-    ImageLoad(&Material->AlbedoImage, Material->AlbedoPath.c_str());
-    return 1;
+    *Stream = StreamingTextureLoad(Texture, TextureCookedPath(Path));
+    if (*Stream != STREAMING_INVALID_HANDLE) {
+        return;
+    }
+
+    ImageLoad(Image, Path.c_str());
+    TextureInitFromImage(Texture, Image);
+    ImageFree(Image);
 }
 
-u32 MeshLoadNormal(void* Parameter)
+// NOTE(milo): Packs the material's textures into the texture pool, only when every one of them is cooked so a material never mixes
+// arrays and plain textures. Materials sharing an image share its layer.
+bool MeshPackMaterial(gltf_material* Material)
 {
-    gltf_material* Material = (gltf_material*)Parameter;
-    ImageLoad(&Material->NormalImage, Material->NormalPath.c_str());
-    return 1;
+    // NOTE(milo): A texture that can't be pooled gives back the ones already taken.
+    Material->Packed = TexturePoolAcquire(TextureCookedPath(Material->AlbedoPath), &Material->AlbedoSlot);
+    if (Material->Packed && Material->HasNormalMap && !TexturePoolAcquire(TextureCookedPath(Material->NormalPath), &Material->NormalSlot)) {
+        TexturePoolRelease(Material->AlbedoSlot);
+        Material->Packed = false;
+    }
+    if (Material->Packed && Material->HasPBRMap && !TexturePoolAcquire(TextureCookedPath(Material->PBRPath), &Material->PBRSlot)) {
+        TexturePoolRelease(Material->AlbedoSlot);
+        if (Material->HasNormalMap) TexturePoolRelease(Material->NormalSlot);
+        Material->Packed = false;
+    }
+
+    if (!Material->Packed) {
+        return false;
+    }
+
+    Material->MaterialData.AlbedoLayer = Material->AlbedoSlot.Layer;
+    Material->MaterialData.NormalLayer = Material->NormalSlot.Layer;
+    Material->MaterialData.PBRLayer = Material->PBRSlot.Layer;
+    return true;
 }
 
-u32 MeshLoadPBR(void* Parameter)
+// NOTE(milo): Atlas pages are small and shared by many materials, they are loaded whole instead of streamed.
+bool MeshLoadAtlasPage(rhi_texture* Texture, const std::string& Path)
 {
-    gltf_material* Material = (gltf_material*)Parameter;
-    ImageLoad(&Material->PBRImage, Material->PBRPath.c_str());
-    return 1;
+    rhi_image Image = {};
+    if (!ImageLoadCooked(&Image, Path.c_str())) {
+        LogError("Failed to load atlas page: %s", Path.c_str());
+        return false;
+    }
+    TextureInitFromImage(Texture, &Image);
+    ImageFree(&Image);
+    return true;
 }
 
-u32 CGLTFComponentSize(cgltf_component_type Type)
+void MeshFreeAtlas(gpu_mesh* Mesh)
 {
-    switch (Type)
-    {
-        case cgltf_component_type_r_8:
-        case cgltf_component_type_r_8u:
-            return 1;
-        case cgltf_component_type_r_16:
-        case cgltf_component_type_r_16u:
-            return 2;
-        case cgltf_component_type_r_32u:
-        case cgltf_component_type_r_32f:
-            return 4;
-    }
-
-    assert(0);
-    return 0;
+    for (mesh_atlas_page& Page : Mesh->AtlasPages) {
+        if (Page.Albedo.Internal) TextureFree(&Page.Albedo);
+        if (Page.Normal.Internal) TextureFree(&Page.Normal);
+        if (Page.PBR.Internal) TextureFree(&Page.PBR);
+    }
+    Mesh->AtlasPages.clear();
+    Mesh->Atlas.Entries.clear();
+    Mesh->Atlas.PageCount = 0;
 }
 
-u32 CGLTFComponentCount(cgltf_type Type)
+// NOTE(milo): Without every page the layout is dropped and all materials load their own textures.
+void MeshLoadAtlas(gpu_mesh* Mesh, const std::string& Path)
 {
-    switch (Type)
-    {
-        case cgltf_type_scalar:
-            return 1;
-        case cgltf_type_vec2:
-            return 2;
-        case cgltf_type_vec3:
-            return 3;
-        case cgltf_type_vec4:
-        case cgltf_type_mat2:
-            return 4;
-        case cgltf_type_mat3:
-            return 9;
-        case cgltf_type_mat4:
-            return 16;
-    }
-
-    assert(0);
-    return 0;
+    std::string LayoutPath = AtlasLayoutPath(Path);
+    if (!AtlasLoadLayout(LayoutPath.c_str(), &Mesh->Atlas)) {
+        return;
+    }
+
+    bool Loaded = true;
+    Mesh->AtlasPages.resize(Mesh->Atlas.PageCount);
+    for (u32 PageIndex = 0; PageIndex < Mesh->Atlas.PageCount && Loaded; PageIndex++) {
+        mesh_atlas_page* Page = &Mesh->AtlasPages[PageIndex];
+        *Page = {};
+
+        Loaded = MeshLoadAtlasPage(&Page->Albedo, AtlasPagePath(LayoutPath, PageIndex, TextureRole_Albedo));
+        if (Loaded && AtlasPageHasRole(&Mesh->Atlas, PageIndex, TextureRole_Normal)) {
+            Loaded = MeshLoadAtlasPage(&Page->Normal, AtlasPagePath(LayoutPath, PageIndex, TextureRole_Normal));
+        }
+        if (Loaded && AtlasPageHasRole(&Mesh->Atlas, PageIndex, TextureRole_PBR)) {
+            Loaded = MeshLoadAtlasPage(&Page->PBR, AtlasPagePath(LayoutPath, PageIndex, TextureRole_PBR));
+        }
+    }
+
+    if (!Loaded) {
+        MeshFreeAtlas(Mesh);
+    }
+}
+
+u32 MeshLoadAlbedo(void* Parameter)
+{
+    gltf_material* Material = (gltf_material*)Parameter;
+    MeshLoadImage(&Material->AlbedoImage, Material->AlbedoPath);
+    return 1;
 }
 
-void* GetAccessorData(cgltf_accessor* Accessor, u32* ComponentSize, u32* ComponentCount)
+u32 MeshLoadNormal(void* Parameter)
 {
-    *ComponentSize = CGLTFComponentSize(Accessor->component_type);
-    *ComponentCount = CGLTFComponentCount(Accessor->type);
+    gltf_material* Material = (gltf_material*)Parameter;
+    MeshLoadImage(&Material->NormalImage, Material->NormalPath);
+    return 1;
+}
 
-    cgltf_buffer_view* View = Accessor->buffer_view;
-    return OFFSET_PTR_BYTES(void, View->buffer->data, View->offset);
+u32 MeshLoadPBR(void* Parameter)
+{
+    gltf_material* Material = (gltf_material*)Parameter;
+    MeshLoadImage(&Material->PBRImage, Material->PBRPath);
+    return 1;
 }
 
 void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 Transform)
@@ -97,6 +153,7 @@ void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 T
     cgltf_attribute* PositionAttribute = NULL;
     cgltf_attribute* TexcoordAttribute = NULL;
     cgltf_attribute* NormalAttribute = NULL;
+    cgltf_attribute* TangentAttribute = NULL;
 
     for (i32 AttributeIndex = 0; AttributeIndex < GltfPrimitive->attributes_count; AttributeIndex++) {
         cgltf_attribute* Attribute = &GltfPrimitive->attributes[AttributeIndex];
@@ -104,57 +161,45 @@ void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 T
         if (strcmp(Attribute->name, "POSITION") == 0) PositionAttribute = Attribute;
         if (strcmp(Attribute->name, "TEXCOORD_0") == 0) TexcoordAttribute = Attribute;
         if (strcmp(Attribute->name, "NORMAL") == 0) NormalAttribute = Attribute;
+        if (strcmp(Attribute->name, "TANGENT") == 0) TangentAttribute = Attribute;
     }
 
     assert(PositionAttribute && TexcoordAttribute && NormalAttribute);
 
+    // NOTE(milo): Every attribute is decoded straight into Vertices, so they all need exactly one element per vertex.
     u32 VertexCount = (u32)PositionAttribute->data->count;
+    if (VertexCount == 0) {
+        return;
+    }
+    if (TexcoordAttribute->data->count != VertexCount || NormalAttribute->data->count != VertexCount ||
+        (TangentAttribute && TangentAttribute->data->count != VertexCount)) {
+        LogError("Primitive attributes disagree on the vertex count.");
+        return;
+    }
     u64 VertexBufferSize = VertexCount * sizeof(mesh_vertex);
     std::vector<mesh_vertex> Vertices(VertexCount);
 
     CODE_BLOCK("Position")
     {
-        u32 ComponentSize, ComponentCount;
-        f32* Source = (f32*)GetAccessorData(PositionAttribute->data, &ComponentSize, &ComponentCount);
-        assert(ComponentSize == 4);
-
-        if (Source)
-        {
-            for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
-                Vertices[VertexIndex].Position.X = Source[VertexIndex * ComponentCount + 0];
-                Vertices[VertexIndex].Position.Y = Source[VertexIndex * ComponentCount + 1];
-                Vertices[VertexIndex].Position.Z = Source[VertexIndex * ComponentCount + 2];
-            }
+        if (!AccessorDecodeFloats(PositionAttribute->data, &Vertices[0].Position, sizeof(mesh_vertex), 3)) {
+            LogError("Failed to decode primitive positions.");
+            return;
         }
     }
 
     CODE_BLOCK("Texcoords")
     {
-        u32 ComponentSize, ComponentCount;
-        f32* Source = (f32*)GetAccessorData(TexcoordAttribute->data, &ComponentSize, &ComponentCount);
-        assert(ComponentSize == 4);
-        if (Source)
-        {
-            for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
-                Vertices[VertexIndex].UV.X = Source[VertexIndex * ComponentCount + 0];
-                Vertices[VertexIndex].UV.Y = Source[VertexIndex * ComponentCount + 1];
-            }
+        if (!AccessorDecodeFloats(TexcoordAttribute->data, &Vertices[0].UV, sizeof(mesh_vertex), 2)) {
+            LogError("Failed to decode primitive texture coordinates.");
+            return;
         }
     }
 
     CODE_BLOCK("Normals")
     {
-        u32 ComponentSize, ComponentCount;
-        f32* Source = (f32*)GetAccessorData(NormalAttribute->data, &ComponentSize, &ComponentCount);
-        assert(ComponentSize == 4);
-
-        if (Source)
-        {
-            for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
-                Vertices[VertexIndex].Normals.X = Source[VertexIndex * ComponentCount + 0];
-                Vertices[VertexIndex].Normals.Y = Source[VertexIndex * ComponentCount + 1];
-                Vertices[VertexIndex].Normals.Z = Source[VertexIndex * ComponentCount + 2];
-            }
+        if (!AccessorDecodeFloats(NormalAttribute->data, &Vertices[0].Normals, sizeof(mesh_vertex), 3)) {
+            LogError("Failed to decode primitive normals.");
+            return;
         }
     }
 
@@ -164,56 +209,38 @@ void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 T
 
     CODE_BLOCK("Indices")
     {
-        if (GltfPrimitive->indices != NULL) {
-            for (u32 Index = 0; Index < (u32)GltfPrimitive->indices->count; Index++) {
-                Indices[Index] = (u32)(cgltf_accessor_read_index(GltfPrimitive->indices, Index));
-            }
+        if (GltfPrimitive->indices != NULL && !AccessorDecodeIndices(GltfPrimitive->indices, Indices.data())) {
+            LogError("Failed to decode primitive indices.");
+            return;
         }
     }
 
-    for (u32 TriangleIndex = 0; TriangleIndex < Primitive.IndexCount; TriangleIndex += 3) {
-        hmm_vec3 Pos1 = Vertices[Indices[TriangleIndex + 0]].Position;
-        hmm_vec3 Pos2 = Vertices[Indices[TriangleIndex + 1]].Position;
-        hmm_vec3 Pos3 = Vertices[Indices[TriangleIndex + 2]].Position;
-
-        hmm_vec2 UV1 = Vertices[Indices[TriangleIndex + 0]].UV;
-        hmm_vec2 UV2 = Vertices[Indices[TriangleIndex + 1]].UV;
-        hmm_vec2 UV3 = Vertices[Indices[TriangleIndex + 2]].UV;
-        
-        hmm_vec2 DeltaUV1 = HMM_SubtractVec2(UV2, UV1);
-		hmm_vec2 DeltaUV2 = HMM_SubtractVec2(UV3, UV1);
-
-		hmm_vec3 Edge1 = HMM_SubtractVec3(Pos2, Pos1);
-		hmm_vec3 Edge2 = HMM_SubtractVec3(Pos3, Pos1);
-
-        f32 F = 1.0f / (DeltaUV1.X * DeltaUV2.Y - DeltaUV2.X * DeltaUV1.Y);
-
-        hmm_vec3 Tangent = HMM_Vec3(
-            F * (DeltaUV2.Y * Edge1.X - DeltaUV1.Y * Edge2.X),
-			F * (DeltaUV2.Y * Edge1.Y - DeltaUV1.Y * Edge2.Y),
-			F * (DeltaUV2.Y * Edge1.Z - DeltaUV1.Y * Edge2.Z)
-        );
-
-        hmm_vec3 Bitangent = HMM_Vec3(
-            F * (-DeltaUV2.Y * Edge1.X + DeltaUV1.Y * Edge2.X),
-			F * (-DeltaUV2.Y * Edge1.Y + DeltaUV1.Y * Edge2.Y),
-			F * (-DeltaUV2.Y * Edge1.Z + DeltaUV1.Y * Edge2.Z)
-        );
-
-        Vertices[Indices[TriangleIndex + 0]].Tangent = Tangent;
-        Vertices[Indices[TriangleIndex + 1]].Tangent = Tangent;
-        Vertices[Indices[TriangleIndex + 2]].Tangent = Tangent;
+    CODE_BLOCK("Tangents")
+    {
+        std::vector<f32> SourceTangents;
+        if (TangentAttribute) {
+            SourceTangents.resize(VertexCount * 4);
+            if (!AccessorDecodeFloats(TangentAttribute->data, SourceTangents.data(), 4 * sizeof(f32), 4)) {
+                SourceTangents.clear();
+            }
+        }
 
-        Vertices[Indices[TriangleIndex + 0]].Bitangent = Bitangent;
-        Vertices[Indices[TriangleIndex + 1]].Bitangent = Bitangent;
-        Vertices[Indices[TriangleIndex + 2]].Bitangent = Bitangent;
+        if (!SourceTangents.empty()) {
+            for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
+                f32* Source = &SourceTangents[VertexIndex * 4];
+                Vertices[VertexIndex].Tangent = HMM_Vec3(Source[0], Source[1], Source[2]);
+                Vertices[VertexIndex].Bitangent = HMM_MultiplyVec3f(HMM_Cross(Vertices[VertexIndex].Normals, Vertices[VertexIndex].Tangent), Source[3]);
+            }
+        } else {
+            TangentGenerate(Vertices.data(), VertexCount, Indices.data(), Primitive.IndexCount);
+        }
     }
 
     CODE_BLOCK("AABB")
     {
         aabb BoundingBox;
         BoundingBox.Min = HMM_Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
-        BoundingBox.Max = HMM_Vec3(FLT_MIN, FLT_MIN, FLT_MIN);
+        BoundingBox.Max = HMM_Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
         for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
             const mesh_vertex* Vertex = &Vertices[VertexIndex];
@@ -228,8 +255,9 @@ void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 T
         }
 
         hmm_vec3 Extent = HMM_MultiplyVec3f(HMM_SubtractVec3(BoundingBox.Max, BoundingBox.Min), 0.5f);
-        hmm_vec3 Center = HMM_AddVec3(BoundingBox.Max, Extent);
+        hmm_vec3 Center = HMM_AddVec3(BoundingBox.Min, Extent);
         Primitive.InstanceData.BoundingSphere.XYZ = Center;
+        Primitive.InstanceData.BoundingSphere.W = 0.0f;
 
         for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
             const mesh_vertex* Vertex = &Vertices[VertexIndex];
@@ -238,14 +266,24 @@ void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 T
         }
     }
 
+    CODE_BLOCK("Occluder")
+    {
+        f32 Radius = CullingTransformSphere(Transform, Primitive.InstanceData.BoundingSphere).W;
+        if (Primitive.IndexCount / 3 <= OCCLUSION_MAX_OCCLUDER_TRIANGLES && Radius >= OCCLUSION_MIN_OCCLUDER_RADIUS) {
+            Primitive.Occluder.Vertices.resize(VertexCount);
+            for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
+                Primitive.Occluder.Vertices[VertexIndex] = Vertices[VertexIndex].Position;
+            }
+            Primitive.Occluder.Indices = Indices;
+        }
+    }
+
     BufferInit(&Primitive.VertexBuffer, VertexBufferSize, sizeof(mesh_vertex), BufferUsage_Vertex);
-    BufferUpload(&Primitive.VertexBuffer, Vertices.data());
+    UploadBuffer(&Primitive.VertexBuffer, Vertices.data(), 0, VertexBufferSize);
 
+    // NOTE(milo): Uploads complete in order, the index buffer's ticket covers the vertices too.
     BufferInit(&Primitive.IndexBuffer, IndexBufferSize, 0, BufferUsage_Index);
-    BufferUpload(&Primitive.IndexBuffer, Indices.data());
-
-    BufferInit(&Primitive.InstanceBuffer, sizeof(instance_data), 0, BufferUsage_Uniform);
-    BufferUpload(&Primitive.InstanceBuffer, &Primitive.InstanceData);
+    Primitive.UploadTicket = UploadBuffer(&Primitive.IndexBuffer, Indices.data(), 0, IndexBufferSize);
 
     CODE_BLOCK("Material loading")
     {
@@ -281,33 +319,39 @@ void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 T
                 }
             }
 
-            CODE_BLOCK("Texture loading")
+            CODE_BLOCK("Atlas")
             {
-                ImageLoad(&Material.AlbedoImage, Material.AlbedoPath.c_str());
-                if (Material.HasNormalMap) {
-                    ImageLoad(&Material.NormalImage, Material.NormalPath.c_str());
-                }
-                if (Material.HasPBRMap) {
-                    ImageLoad(&Material.PBRImage, Material.PBRPath.c_str());
+                atlas_source Source = { Material.AlbedoPath, Material.NormalPath, Material.PBRPath };
+                const atlas_entry* Entry = AtlasFind(&Mesh->Atlas, Source);
+                if (Entry) {
+                    mesh_atlas_page* Page = &Mesh->AtlasPages[Entry->Page];
+                    Material.Atlased = true;
+                    Material.AtlasPage = Entry->Page;
+                    Material.MaterialData.AtlasRect = AtlasEntryRect(Entry);
+                    Material.Albedo = Page->Albedo;
+                    if (Material.HasNormalMap) Material.Normal = Page->Normal;
+                    if (Material.HasPBRMap) Material.PBR = Page->PBR;
                 }
             }
 
-            CODE_BLOCK("Upload textures")
+            CODE_BLOCK("Texture loading")
             {
-                TextureInitFromImage(&Material.Albedo, &Material.AlbedoImage);
-                if (Material.HasNormalMap) 
-                    TextureInitFromImage(&Material.Normal, &Material.NormalImage);
-                if (Material.HasPBRMap)
-                    TextureInitFromImage(&Material.PBR, &Material.PBRImage);
-
-                ImageFree(&Material.AlbedoImage);
-                if (Material.HasNormalMap) ImageFree(&Material.NormalImage);
-                if (Material.HasPBRMap) ImageFree(&Material.PBRImage);
+                Material.AlbedoStream = STREAMING_INVALID_HANDLE;
+                Material.NormalStream = STREAMING_INVALID_HANDLE;
+                Material.PBRStream = STREAMING_INVALID_HANDLE;
+
+                // NOTE(milo): Packed materials stay fully resident, the rest are streamed or loaded one texture each.
+                if (!Material.Atlased && (!Mesh->PackTextures || !MeshPackMaterial(&Material))) {
+                    MeshLoadTexture(&Material.Albedo, &Material.AlbedoImage, Material.AlbedoPath, &Material.AlbedoStream);
+                    if (Material.HasNormalMap) {
+                        MeshLoadTexture(&Material.Normal, &Material.NormalImage, Material.NormalPath, &Material.NormalStream);
+                    }
+                    if (Material.HasPBRMap) {
+                        MeshLoadTexture(&Material.PBR, &Material.PBRImage, Material.PBRPath, &Material.PBRStream);
+                    }
+                }
             }
 
-            BufferInit(&Material.MaterialBuffer, sizeof(material_data), 0, BufferUsage_Uniform);
-            BufferUpload(&Material.MaterialBuffer, &Material.MaterialData);
-
             Mesh->Materials.push_back(Material);
         }
     }
@@ -325,26 +369,68 @@ void ProcessPrimitive(cgltf_primitive* GltfPrimitive, gpu_mesh* Mesh, hmm_mat4 T
     Mesh->Primitives.push_back(Primitive);
 }
 
-void ProcessNode(cgltf_node* Node, gpu_mesh* Mesh)
+// NOTE(milo): Cell and portal markers are never drawn, only the world space positions of their primitives are kept.
+bool ProcessMarker(cgltf_node* Node, gpu_mesh* Mesh, hmm_mat4 Transform)
 {
-    if (Node->mesh)
-    {
-        hmm_mat4 Transform = HMM_Mat4d(1.0f);
-        if (Node->has_translation) {
-            hmm_vec3 Translation = HMM_Vec3(Node->translation[0], Node->translation[1], Node->translation[2]);
-            Transform = HMM_MultiplyMat4(Transform, HMM_Translate(Translation));
+    bool IsCell = Node->name && strncmp(Node->name, PORTAL_CELL_PREFIX, strlen(PORTAL_CELL_PREFIX)) == 0;
+    bool IsPortal = Node->name && strncmp(Node->name, PORTAL_PREFIX, strlen(PORTAL_PREFIX)) == 0;
+    if (!IsCell && !IsPortal) {
+        return false;
+    }
+
+    std::vector<hmm_vec3> Points;
+    for (i32 GltfPrimitiveIndex = 0; GltfPrimitiveIndex < Node->mesh->primitives_count; GltfPrimitiveIndex++) {
+        cgltf_primitive* GltfPrimitive = &Node->mesh->primitives[GltfPrimitiveIndex];
+        for (i32 AttributeIndex = 0; AttributeIndex < GltfPrimitive->attributes_count; AttributeIndex++) {
+            cgltf_attribute* Attribute = &GltfPrimitive->attributes[AttributeIndex];
+            if (strcmp(Attribute->name, "POSITION") != 0) {
+                continue;
+            }
+
+            size_t First = Points.size();
+            Points.resize(First + Attribute->data->count);
+            if (!AccessorDecodeFloats(Attribute->data, &Points[First], sizeof(hmm_vec3), 3)) {
+                LogError("Failed to decode marker positions: %s", Node->name);
+                Points.resize(First);
+            }
         }
-        if (Node->has_rotation) {
-            hmm_quaternion Rotation = HMM_Quaternion(Node->rotation[0], Node->rotation[1], Node->rotation[2], Node->rotation[3]);
-            Transform = HMM_MultiplyMat4(Transform, HMM_QuaternionToMat4(Rotation));
+    }
+
+    for (hmm_vec3& Point : Points) {
+        Point = HMM_MultiplyMat4ByVec4(Transform, HMM_Vec4v(Point, 1.0f)).XYZ;
+    }
+
+    if (IsCell) {
+        aabb Bounds = AabbEmpty();
+        for (const hmm_vec3& Point : Points) {
+            AabbGrowPoint(&Bounds, Point);
+        }
+        if (!Points.empty()) {
+            Mesh->Cells.push_back(Bounds);
         }
-        if (Node->has_scale) {
-            hmm_vec3 Scale = HMM_Vec3(Node->scale[0], Node->scale[1], Node->scale[2]);
-            Transform = HMM_MultiplyMat4(Transform, HMM_Scale(Scale));
+    } else {
+        portal_polygon Polygon;
+        if (PortalPolygonFromPoints(Points.data(), (u32)Points.size(), &Polygon)) {
+            Mesh->Portals.push_back(Polygon);
+        } else {
+            LogWarn("Skipping portal %s", Node->name);
         }
+    }
+    return true;
+}
+
+void ProcessNode(cgltf_node* Node, gpu_mesh* Mesh)
+{
+    if (Node->mesh)
+    {
+        // NOTE(milo): KHR_mesh_quantization stores the dequantization scale and offset in the node hierarchy, so use the world transform.
+        hmm_mat4 Transform;
+        cgltf_node_transform_world(Node, &Transform.Elements[0][0]);
 
-        for (i32 GltfPrimitiveIndex = 0; GltfPrimitiveIndex < Node->mesh->primitives_count; GltfPrimitiveIndex++) {
-            ProcessPrimitive(&Node->mesh->primitives[GltfPrimitiveIndex], Mesh, Transform);
+        if (!ProcessMarker(Node, Mesh, Transform)) {
+            for (i32 GltfPrimitiveIndex = 0; GltfPrimitiveIndex < Node->mesh->primitives_count; GltfPrimitiveIndex++) {
+                ProcessPrimitive(&Node->mesh->primitives[GltfPrimitiveIndex], Mesh, Transform);
+            }
         }
     }
 
@@ -353,19 +439,48 @@ void ProcessNode(cgltf_node* Node, gpu_mesh* Mesh)
     }
 }
 
-void GpuMeshLoad(gpu_mesh* Mesh, const std::string& Path)
+cgltf_result MeshReadFile(const cgltf_memory_options* MemoryOptions, const cgltf_file_options* FileOptions, const char* Path, cgltf_size* Size, void** Data)
+{
+    u64 FileSize;
+    *Data = PackReadFile(Path, &FileSize);
+    if (!*Data) {
+        return cgltf_result_file_not_found;
+    }
+    if (Size) {
+        *Size = (cgltf_size)FileSize;
+    }
+    return cgltf_result_success;
+}
+
+void MeshReleaseFile(const cgltf_memory_options* MemoryOptions, const cgltf_file_options* FileOptions, void* Data)
+{
+    free(Data);
+}
+
+void GpuMeshLoad(gpu_mesh* Mesh, const std::string& Path, bool PackTextures)
 {
     cgltf_options Options;
     memset(&Options, 0, sizeof(Options));
+    Options.file.read = MeshReadFile;
+    Options.file.release = MeshReleaseFile;
     cgltf_data* Data = NULL;
     
     CGLTFCall(cgltf_parse_file(&Options, Path.c_str(), &Data));
     CGLTFCall(cgltf_load_buffers(&Options, Data, Path.c_str()));
+    if (!MeshoptDecompressBufferViews(Data)) {
+        LogError("Failed to decompress mesh: %s", Path.c_str());
+        cgltf_free(Data);
+        return;
+    }
     cgltf_scene* Scene = Data->scene;
 
     size_t Position = Path.find_last_of('/');
     std::string Directory = Path.substr(0, Position + 1);
     Mesh->Directory = Directory;
+    Mesh->SceneInstanceBase = 0;
+    Mesh->SceneMaterialBase = 0;
+    Mesh->PackTextures = PackTextures;
+    MeshLoadAtlas(Mesh, Path);
 
     for (i32 NodeIndex = 0; NodeIndex < Scene->nodes_count; NodeIndex++)
         ProcessNode(Scene->nodes[NodeIndex], Mesh);
@@ -373,21 +488,125 @@ void GpuMeshLoad(gpu_mesh* Mesh, const std::string& Path)
     cgltf_free(Data);
 }
 
+bool MeshCookTextureStep(const asset_step* Step)
+{
+    return TextureCook(Step->Inputs[0].c_str(), Step->Output.c_str(), (texture_role)atoi(Step->Settings.c_str()));
+}
+
+void GpuMeshCookTextures(const std::string& Path)
+{
+    cgltf_options Options;
+    memset(&Options, 0, sizeof(Options));
+    cgltf_data* Data = NULL;
+
+    if (cgltf_parse_file(&Options, Path.c_str(), &Data) != cgltf_result_success) {
+        LogError("Failed to parse mesh for cooking: %s", Path.c_str());
+        return;
+    }
+
+    size_t Position = Path.find_last_of('/');
+    std::string Directory = Path.substr(0, Position + 1);
+
+    // NOTE(milo): The same image can be referenced by several materials, cook each one once with the role of its first use.
+    std::unordered_map<std::string, texture_role> Textures;
+    std::vector<atlas_source> AtlasSources;
+    for (i32 MaterialIndex = 0; MaterialIndex < Data->materials_count; MaterialIndex++) {
+        cgltf_material* Material = &Data->materials[MaterialIndex];
+
+        cgltf_texture* Albedo = Material->pbr_metallic_roughness.base_color_texture.texture;
+        cgltf_texture* Normal = Material->normal_texture.texture;
+        cgltf_texture* PBR = Material->pbr_metallic_roughness.metallic_roughness_texture.texture;
+
+        if (Albedo && Albedo->image && Albedo->image->uri) Textures.emplace(Directory + Albedo->image->uri, TextureRole_Albedo);
+        if (Normal && Normal->image && Normal->image->uri) Textures.emplace(Directory + Normal->image->uri, TextureRole_Normal);
+        if (PBR && PBR->image && PBR->image->uri) Textures.emplace(Directory + PBR->image->uri, TextureRole_PBR);
+
+        // NOTE(milo): The loader matches atlas entries on the same paths it builds for the material.
+        if (Albedo && Albedo->image && Albedo->image->uri) {
+            atlas_source Source;
+            Source.Albedo = Directory + Albedo->image->uri;
+            if (Normal && Normal->image && Normal->image->uri) Source.Normal = Directory + Normal->image->uri;
+            if (PBR && PBR->image && PBR->image->uri) Source.PBR = Directory + PBR->image->uri;
+            AtlasSources.push_back(Source);
+        }
+    }
+
+    asset_graph Graph;
+    for (auto& Texture : Textures) {
+        asset_step Step;
+        Step.Tool = "texture";
+        Step.ToolVersion = TEXTURE_COOKER_VERSION * 1000 + COOKED_TEXTURE_VERSION;
+        Step.Settings = std::to_string((u32)Texture.second);
+        Step.Inputs.push_back(Texture.first);
+        Step.Output = TextureCookedPath(Texture.first);
+        Step.Cook = MeshCookTextureStep;
+        AssetGraphAdd(&Graph, Step);
+    }
+
+    AssetGraphBuild(&Graph);
+    AtlasCookMesh(Path, AtlasSources);
+    cgltf_free(Data);
+}
+
+void GpuMeshRequestMips(gpu_mesh* Mesh, hmm_vec3 CameraPosition, hmm_vec3 CameraFront, f32 ProjectionScale)
+{
+    for (gltf_primitive& Primitive : Mesh->Primitives) {
+        if (Primitive.MaterialIndex >= Mesh->Materials.size()) {
+            continue;
+        }
+
+        hmm_mat4 Transform = Primitive.InstanceData.Transform;
+        hmm_vec4 Center = HMM_MultiplyMat4ByVec4(Transform, HMM_Vec4v(Primitive.InstanceData.BoundingSphere.XYZ, 1.0f));
+
+        f32 Scale = 0.0f;
+        for (i32 Column = 0; Column < 3; Column++) {
+            Scale = std::max(Scale, HMM_LengthVec3(HMM_Vec3(Transform.Elements[Column][0], Transform.Elements[Column][1], Transform.Elements[Column][2])));
+        }
+        f32 Radius = Primitive.InstanceData.BoundingSphere.W * Scale;
+
+        hmm_vec3 ToCenter = HMM_SubtractVec3(Center.XYZ, CameraPosition);
+        if (HMM_DotVec3(ToCenter, CameraFront) < -Radius) {
+            continue;
+        }
+
+        f32 Distance = HMM_LengthVec3(ToCenter);
+        f32 ScreenSize = Distance > Radius ? 2.0f * Radius * ProjectionScale / Distance : FLT_MAX;
+
+        gltf_material* Material = &Mesh->Materials[Primitive.MaterialIndex];
+        StreamingTextureRequest(Material->AlbedoStream, ScreenSize);
+        StreamingTextureRequest(Material->NormalStream, ScreenSize);
+        StreamingTextureRequest(Material->PBRStream, ScreenSize);
+    }
+}
+
 void GpuMeshFree(gpu_mesh* Mesh)
 {
     for (gltf_material Material : Mesh->Materials) {
-        BufferFree(&Material.MaterialBuffer);
+        StreamingTextureRelease(Material.AlbedoStream);
+        StreamingTextureRelease(Material.NormalStream);
+        StreamingTextureRelease(Material.PBRStream);
+
+        if (Material.Packed) {
+            TexturePoolRelease(Material.AlbedoSlot);
+            if (Material.HasNormalMap) TexturePoolRelease(Material.NormalSlot);
+            if (Material.HasPBRMap) TexturePoolRelease(Material.PBRSlot);
+        }
+        if (Material.Atlased) {
+            continue;
+        }
         if (Material.Albedo.Internal) {
             TextureFree(&Material.Albedo);
         }
-        if (Material.HasNormalMap) {
+        if (Material.Normal.Internal) {
             TextureFree(&Material.Normal);
         }
-        if (Material.HasPBRMap) {
+        if (Material.PBR.Internal) {
             TextureFree(&Material.PBR);
         }
     }
 
+    MeshFreeAtlas(Mesh);
+
     for (gltf_primitive Primitive : Mesh->Primitives) {
         BufferFree(&Primitive.IndexBuffer);
         BufferFree(&Primitive.VertexBuffer);
@@ -2,6 +2,10 @@
 
 #include "backrooms_common.h"
 #include "backrooms_rhi.h"
+#include "backrooms_texture_pool.h"
+#include "backrooms_atlas.h"
+#include "backrooms_occlusion.h"
+#include "backrooms_portal.h"
 
 #include <string>
 #include <vector>
@@ -20,7 +24,14 @@ struct material_data
     hmm_vec3 AlbedoFactor;
     float MetallicFactor;
     float RoughnessFactor;
-    hmm_vec3 Pad;
+
+    // NOTE(milo): Layers of the pooled texture arrays, only read by the shaders compiled with USE_TEXTURE_ARRAYS.
+    u32 AlbedoLayer;
+    u32 NormalLayer;
+    u32 PBRLayer;
+
+    // NOTE(milo): Offset and scale of the material's entry in its atlas page, only read by the shaders compiled with USE_ATLAS.
+    hmm_vec4 AtlasRect;
 };
 
 struct gltf_material
@@ -41,7 +52,20 @@ struct gltf_material
     rhi_texture Albedo;
     rhi_texture Normal;
     rhi_texture PBR;
-    rhi_buffer MaterialBuffer;
+
+    u32 AlbedoStream;
+    u32 NormalStream;
+    u32 PBRStream;
+
+    // NOTE(milo): Packed materials sample the pooled arrays instead of Albedo, Normal and PBR, which are left empty.
+    bool Packed;
+    texture_pool_slot AlbedoSlot;
+    texture_pool_slot NormalSlot;
+    texture_pool_slot PBRSlot;
+
+    // NOTE(milo): Atlased materials share the textures of their mesh's atlas page, they neither own nor stream them.
+    bool Atlased;
+    u32 AtlasPage;
 };
 
 struct instance_data
@@ -56,7 +80,6 @@ struct gltf_primitive
 {
     rhi_buffer VertexBuffer;
     rhi_buffer IndexBuffer;
-    rhi_buffer InstanceBuffer;
 
     u32 VertexBufferSize;
     u32 IndexBufferSize;
@@ -65,8 +88,17 @@ struct gltf_primitive
     u32 IndexCount;
     u32 TriangleCount;
     u32 MaterialIndex;
+    u64 UploadTicket;
 
     instance_data InstanceData;
+    occluder_geometry Occluder; // NOTE(milo): Empty unless the primitive was picked as an occluder.
+};
+
+struct mesh_atlas_page
+{
+    rhi_texture Albedo;
+    rhi_texture Normal;
+    rhi_texture PBR;
 };
 
 struct gpu_mesh
@@ -78,7 +110,22 @@ struct gpu_mesh
     u32 TotalIndexCount;
     u32 TotalTriangleCount;
     std::string Directory;
+
+    // NOTE(milo): Where the mesh's primitives and materials start in the GPU scene, primitive N is instance SceneInstanceBase + N.
+    u32 SceneInstanceBase;
+    u32 SceneMaterialBase;
+
+    bool PackTextures;
+
+    atlas_layout Atlas;
+    std::vector<mesh_atlas_page> AtlasPages;
+
+    // NOTE(milo): Visibility markers found in the file, in the mesh's own space.
+    std::vector<aabb> Cells;
+    std::vector<portal_polygon> Portals;
 };
 
-void GpuMeshLoad(gpu_mesh* Mesh, const std::string& Path);
+void GpuMeshLoad(gpu_mesh* Mesh, const std::string& Path, bool PackTextures = false);
+void GpuMeshCookTextures(const std::string& Path);
+void GpuMeshRequestMips(gpu_mesh* Mesh, hmm_vec3 CameraPosition, hmm_vec3 CameraFront, f32 ProjectionScale);
 void GpuMeshFree(gpu_mesh* Mesh);
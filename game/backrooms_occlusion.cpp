@@ -0,0 +1,233 @@
+#include "backrooms_occlusion.h"
+#include "backrooms_platform.h"
+#include "backrooms_job.h"
+
+#include <emmintrin.h>
+#include <float.h>
+#include <math.h>
+
+//~ NOTE(milo): Occluders
+
+void OcclusionBegin(occlusion_buffer* Buffer, hmm_mat4 ViewProjection)
+{
+    Buffer->Depth.assign(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 0.0f);
+    Buffer->ViewProjection = ViewProjection;
+    Buffer->Triangles.clear();
+    Buffer->Stats = {};
+}
+
+// NOTE(milo): Triangles reaching behind the near plane are dropped rather than clipped, which only makes the buffer more conservative.
+void OcclusionAddOccluder(occlusion_buffer* Buffer, hmm_mat4 Transform, const occluder_geometry* Geometry)
+{
+    hmm_mat4 Matrix = HMM_MultiplyMat4(Buffer->ViewProjection, Transform);
+
+    u32 First = (u32)Buffer->Triangles.size();
+    for (u32 Index = 0; Index + 2 < Geometry->Indices.size(); Index += 3) {
+        occlusion_triangle Triangle;
+        bool Behind = false;
+
+        for (u32 Corner = 0; Corner < 3; Corner++) {
+            hmm_vec4 Clip = HMM_MultiplyMat4ByVec4(Matrix, HMM_Vec4v(Geometry->Vertices[Geometry->Indices[Index + Corner]], 1.0f));
+            if (Clip.W < OCCLUSION_NEAR) {
+                Behind = true;
+                break;
+            }
+
+            f32 InvW = 1.0f / Clip.W;
+            Triangle.X[Corner] = (Clip.X * InvW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+            Triangle.Y[Corner] = (0.5f - Clip.Y * InvW * 0.5f) * OCCLUSION_HEIGHT;
+            Triangle.InvW[Corner] = InvW;
+        }
+
+        if (!Behind) {
+            Buffer->Triangles.push_back(Triangle);
+        }
+    }
+
+    Buffer->Stats.Occluders++;
+    Buffer->Stats.OccluderTriangles += (u32)Buffer->Triangles.size() - First;
+}
+
+// NOTE(milo): Edge functions and 1 / W are evaluated 4 texels at a time at the texel centers, a texel is covered when all three edge
+// functions are positive. The triangle's winding does not matter, so both faces occlude.
+void OcclusionRasterizeTriangle(occlusion_buffer* Buffer, const occlusion_triangle* Triangle, i32 BandTop, i32 BandBottom)
+{
+    const f32* X = Triangle->X;
+    const f32* Y = Triangle->Y;
+    const f32* Z = Triangle->InvW;
+
+    f32 MinX = fminf(X[0], fminf(X[1], X[2])), MaxX = fmaxf(X[0], fmaxf(X[1], X[2]));
+    f32 MinY = fminf(Y[0], fminf(Y[1], Y[2])), MaxY = fmaxf(Y[0], fmaxf(Y[1], Y[2]));
+
+    i32 Top = (i32)floorf(MinY) > BandTop ? (i32)floorf(MinY) : BandTop;
+    i32 Bottom = (i32)ceilf(MaxY) < BandBottom ? (i32)ceilf(MaxY) : BandBottom;
+    i32 Left = ((i32)floorf(MinX) > 0 ? (i32)floorf(MinX) : 0) & ~3;
+    i32 Right = (i32)ceilf(MaxX) < OCCLUSION_WIDTH ? (i32)ceilf(MaxX) : OCCLUSION_WIDTH;
+    if (Top >= Bottom || Left >= Right) {
+        return;
+    }
+
+    f32 Area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+    if (fabsf(Area) < 1e-6f) {
+        return;
+    }
+    f32 Sign = Area > 0.0f ? 1.0f : -1.0f;
+
+    f32 A[3], B[3], C[3];
+    for (i32 Edge = 0; Edge < 3; Edge++) {
+        i32 Next = (Edge + 1) % 3;
+        A[Edge] = Sign * (Y[Edge] - Y[Next]);
+        B[Edge] = Sign * (X[Next] - X[Edge]);
+        C[Edge] = Sign * (X[Edge] * Y[Next] - X[Next] * Y[Edge]);
+    }
+
+    // NOTE(milo): The plane through the three corners in (X, Y, 1 / W), its normal's Z is the doubled area.
+    f32 NormalX = (Y[1] - Y[0]) * (Z[2] - Z[0]) - (Z[1] - Z[0]) * (Y[2] - Y[0]);
+    f32 NormalY = (Z[1] - Z[0]) * (X[2] - X[0]) - (X[1] - X[0]) * (Z[2] - Z[0]);
+    f32 GradientX = -NormalX / Area;
+    f32 GradientY = -NormalY / Area;
+    f32 Origin = Z[0] - GradientX * X[0] - GradientY * Y[0];
+
+    __m128 EdgeA[3];
+    for (i32 Edge = 0; Edge < 3; Edge++) {
+        EdgeA[Edge] = _mm_set1_ps(A[Edge]);
+    }
+    __m128 ZX = _mm_set1_ps(GradientX);
+    __m128 Zero = _mm_setzero_ps();
+    __m128 Lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+    for (i32 Row = Top; Row < Bottom; Row++) {
+        f32 CenterY = (f32)Row + 0.5f;
+        __m128 RowE0 = _mm_set1_ps(B[0] * CenterY + C[0]);
+        __m128 RowE1 = _mm_set1_ps(B[1] * CenterY + C[1]);
+        __m128 RowE2 = _mm_set1_ps(B[2] * CenterY + C[2]);
+        __m128 RowZ = _mm_set1_ps(GradientY * CenterY + Origin);
+        f32* Depth = &Buffer->Depth[(size_t)Row * OCCLUSION_WIDTH];
+
+        for (i32 Column = Left; Column < Right; Column += 4) {
+            __m128 CenterX = _mm_add_ps(_mm_set1_ps((f32)Column), Lanes);
+            __m128 E0 = _mm_add_ps(_mm_mul_ps(EdgeA[0], CenterX), RowE0);
+            __m128 E1 = _mm_add_ps(_mm_mul_ps(EdgeA[1], CenterX), RowE1);
+            __m128 E2 = _mm_add_ps(_mm_mul_ps(EdgeA[2], CenterX), RowE2);
+            __m128 Inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(E0, Zero), _mm_cmpge_ps(E1, Zero)), _mm_cmpge_ps(E2, Zero));
+            if (_mm_movemask_ps(Inside) == 0) {
+                continue;
+            }
+
+            __m128 Old = _mm_loadu_ps(Depth + Column);
+            __m128 New = _mm_max_ps(Old, _mm_add_ps(_mm_mul_ps(ZX, CenterX), RowZ));
+            _mm_storeu_ps(Depth + Column, _mm_or_ps(_mm_and_ps(Inside, New), _mm_andnot_ps(Inside, Old)));
+        }
+    }
+}
+
+void OcclusionRasterizeBands(void* Data, u32 Start, u32 End)
+{
+    occlusion_buffer* Buffer = (occlusion_buffer*)Data;
+
+    for (u32 Band = Start; Band < End; Band++) {
+        i32 BandTop = (i32)Band * OCCLUSION_BAND_ROWS;
+        i32 BandBottom = BandTop + OCCLUSION_BAND_ROWS < OCCLUSION_HEIGHT ? BandTop + OCCLUSION_BAND_ROWS : OCCLUSION_HEIGHT;
+
+        for (const occlusion_triangle& Triangle : Buffer->Triangles) {
+            OcclusionRasterizeTriangle(Buffer, &Triangle, BandTop, BandBottom);
+        }
+    }
+}
+
+void OcclusionRasterize(occlusion_buffer* Buffer)
+{
+    f32 Start = PlatformTimerGet();
+
+    if (!Buffer->Triangles.empty()) {
+        job_counter Counter = {};
+        JobParallelFor((OCCLUSION_HEIGHT + OCCLUSION_BAND_ROWS - 1) / OCCLUSION_BAND_ROWS, 1, OcclusionRasterizeBands, Buffer, &Counter);
+        JobWait(&Counter);
+    }
+
+    Buffer->Stats.RasterizeMilliseconds = (PlatformTimerGet() - Start) * 1000.0f;
+}
+
+//~ NOTE(milo): Occludees
+
+// NOTE(milo): The screen rectangle of the sphere's box is hidden when every texel under it holds an occluder closer than the box's
+// nearest corner. Anything reaching behind the near plane is kept.
+bool OcclusionTestSphere(const occlusion_buffer* Buffer, hmm_vec4 Sphere)
+{
+    f32 MinX = FLT_MAX, MinY = FLT_MAX, MaxX = -FLT_MAX, MaxY = -FLT_MAX;
+    f32 Nearest = 0.0f;
+
+    for (u32 Corner = 0; Corner < 8; Corner++) {
+        hmm_vec3 Offset = HMM_Vec3((Corner & 1) ? Sphere.W : -Sphere.W, (Corner & 2) ? Sphere.W : -Sphere.W, (Corner & 4) ? Sphere.W : -Sphere.W);
+        hmm_vec4 Clip = HMM_MultiplyMat4ByVec4(Buffer->ViewProjection, HMM_Vec4v(HMM_AddVec3(Sphere.XYZ, Offset), 1.0f));
+        if (Clip.W < OCCLUSION_NEAR) {
+            return true;
+        }
+
+        f32 InvW = 1.0f / Clip.W;
+        f32 X = (Clip.X * InvW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        f32 Y = (0.5f - Clip.Y * InvW * 0.5f) * OCCLUSION_HEIGHT;
+        MinX = fminf(MinX, X);
+        MaxX = fmaxf(MaxX, X);
+        MinY = fminf(MinY, Y);
+        MaxY = fmaxf(MaxY, Y);
+        Nearest = fmaxf(Nearest, InvW);
+    }
+
+    i32 Left = ((i32)floorf(MinX) > 0 ? (i32)floorf(MinX) : 0) & ~3;
+    i32 Right = (i32)ceilf(MaxX) < OCCLUSION_WIDTH ? (i32)ceilf(MaxX) : OCCLUSION_WIDTH;
+    i32 Top = (i32)floorf(MinY) > 0 ? (i32)floorf(MinY) : 0;
+    i32 Bottom = (i32)ceilf(MaxY) < OCCLUSION_HEIGHT ? (i32)ceilf(MaxY) : OCCLUSION_HEIGHT;
+    if (Left >= Right || Top >= Bottom) {
+        return true;
+    }
+
+    __m128 Closest = _mm_set1_ps(Nearest);
+    for (i32 Row = Top; Row < Bottom; Row++) {
+        const f32* Depth = &Buffer->Depth[(size_t)Row * OCCLUSION_WIDTH];
+        for (i32 Column = Left; Column < Right; Column += 4) {
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(Depth + Column), Closest)) != 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionTestRange(void* Data, u32 Start, u32 End)
+{
+    occlusion_buffer* Buffer = (occlusion_buffer*)Data;
+    const culling_bounds* Bounds = Buffer->Bounds;
+
+    for (u32 Index = Start; Index < End; Index++) {
+        u32 Instance = Buffer->Candidates[Index];
+        hmm_vec4 Sphere = HMM_Vec4(Bounds->CenterX[Instance], Bounds->CenterY[Instance], Bounds->CenterZ[Instance], Bounds->Radius[Instance]);
+        Buffer->Results[Index] = OcclusionTestSphere(Buffer, Sphere) ? 1 : 0;
+    }
+}
+
+// NOTE(milo): Removes the hidden instances from Visible in place, keeping the order, and returns how many are left.
+u32 OcclusionCullInstances(occlusion_buffer* Buffer, const culling_bounds* Bounds, u32* Visible, u32 Count)
+{
+    f32 Start = PlatformTimerGet();
+
+    Buffer->Bounds = Bounds;
+    Buffer->Candidates.assign(Visible, Visible + Count);
+    Buffer->Results.resize(Count);
+
+    job_counter Counter = {};
+    JobParallelFor(Count, OCCLUSION_TEST_BATCH, OcclusionTestRange, Buffer, &Counter);
+    JobWait(&Counter);
+
+    u32 Kept = 0;
+    for (u32 Index = 0; Index < Count; Index++) {
+        if (Buffer->Results[Index]) {
+            Visible[Kept++] = Buffer->Candidates[Index];
+        }
+    }
+
+    Buffer->Stats.Occludees = Count;
+    Buffer->Stats.Occluded = Count - Kept;
+    Buffer->Stats.TestMilliseconds = (PlatformTimerGet() - Start) * 1000.0f;
+    return Kept;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_culling.h"
+
+#include <hmm/HandmadeMath.h>
+#include <vector>
+
+#define OCCLUSION_WIDTH 320
+#define OCCLUSION_HEIGHT 192
+#define OCCLUSION_BAND_ROWS 16 // NOTE(milo): Each worker owns a band of rows of the buffer, so rasterizing needs no synchronisation.
+#define OCCLUSION_TEST_BATCH 64
+#define OCCLUSION_NEAR 0.01f
+
+// NOTE(milo): Primitives small enough to rasterize cheaply and large enough to hide something keep a copy of their triangles.
+#define OCCLUSION_MAX_OCCLUDER_TRIANGLES 1024
+#define OCCLUSION_MIN_OCCLUDER_RADIUS 1.0f
+
+struct occluder_geometry
+{
+    std::vector<hmm_vec3> Vertices;
+    std::vector<u32> Indices;
+};
+
+// NOTE(milo): Screen space position and 1 / W of each corner, 1 / W interpolates linearly across the screen unlike the depth itself.
+struct occlusion_triangle
+{
+    f32 X[3];
+    f32 Y[3];
+    f32 InvW[3];
+};
+
+struct occlusion_stats
+{
+    u32 Occluders;
+    u32 OccluderTriangles;
+    u32 Occludees;
+    u32 Occluded;
+    f32 RasterizeMilliseconds;
+    f32 TestMilliseconds;
+};
+
+// NOTE(milo): Every texel keeps the largest 1 / W of the occluders covering it, the closest surface. Zero is empty.
+struct occlusion_buffer
+{
+    std::vector<f32> Depth;
+    hmm_mat4 ViewProjection;
+    std::vector<occlusion_triangle> Triangles;
+
+    std::vector<u32> Candidates;
+    std::vector<u8> Results;
+    const culling_bounds* Bounds;
+
+    occlusion_stats Stats;
+};
+
+//~ NOTE(milo): Occluders
+void OcclusionBegin(occlusion_buffer* Buffer, hmm_mat4 ViewProjection);
+void OcclusionAddOccluder(occlusion_buffer* Buffer, hmm_mat4 Transform, const occluder_geometry* Geometry);
+void OcclusionRasterize(occlusion_buffer* Buffer);
+
+//~ NOTE(milo): Occludees
+bool OcclusionTestSphere(const occlusion_buffer* Buffer, hmm_vec4 Sphere);
+u32 OcclusionCullInstances(occlusion_buffer* Buffer, const culling_bounds* Bounds, u32* Visible, u32 Count);
@@ -0,0 +1,621 @@
+#include "backrooms_pack.h"
+#include "backrooms_hash.h"
+#include "backrooms_asset_build.h"
+#include "backrooms_platform.h"
+#include "backrooms_logger.h"
+#include "backrooms_job.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#define PACK_MIN_MATCH 4
+#define PACK_MAX_OFFSET 65535
+#define PACK_HASH_BITS 12
+#define PACK_BLOCK_BOUND(Size) ((Size) + (Size) / 255 + 16)
+
+struct pack_state
+{
+    platform_file_map Map;
+    const pack_header* Header;
+    const pack_entry* Table;
+    const pack_block* Blocks;
+    const u8* Data;
+    bool Mounted;
+
+    // NOTE(milo): Without an archive every loose read is logged, the next pack build lays files out in that order.
+    bool Recording;
+    platform_mutex LoadOrderLock;
+    std::vector<std::string> LoadOrder;
+    std::unordered_set<std::string> LoadOrderSeen;
+};
+
+struct pack_build_context
+{
+    const u8* Stream;
+    u64 StreamSize;
+    std::vector<std::vector<u8>>* Compressed;
+};
+
+static pack_state PackState;
+
+std::string PackNormalizePath(const char* Path)
+{
+    std::string Normalized = Path;
+    std::replace(Normalized.begin(), Normalized.end(), '\\', '/');
+    if (Normalized.compare(0, 2, "./") == 0) {
+        Normalized.erase(0, 2);
+    }
+    return Normalized;
+}
+
+//~ NOTE(milo): Block codec
+
+// NOTE(milo): LZ4 style sequences: a token with the literal count and match length nibbles, the literals, then a 16 bit offset.
+// The last sequence of a block only has literals.
+u8* PackWriteLength(u8* Output, u32 Length)
+{
+    while (Length >= 255) {
+        *Output++ = 255;
+        Length -= 255;
+    }
+    *Output++ = (u8)Length;
+    return Output;
+}
+
+u32 PackCompressBlock(const u8* Source, u32 Size, u8* Destination, u32 Capacity)
+{
+    if (Capacity < PACK_BLOCK_BOUND(Size)) {
+        return 0;
+    }
+
+    u32 Table[1 << PACK_HASH_BITS] = {};
+    u8* Output = Destination;
+    u32 Cursor = 0;
+    u32 Anchor = 0;
+
+    while (Size >= PACK_MIN_MATCH && Cursor <= Size - PACK_MIN_MATCH) {
+        u32 Sequence;
+        memcpy(&Sequence, Source + Cursor, sizeof(u32));
+        u32 Slot = (Sequence * 2654435761u) >> (32 - PACK_HASH_BITS);
+        u32 Candidate = Table[Slot];
+        Table[Slot] = Cursor + 1;
+
+        u32 Reference = Candidate - 1;
+        if (Candidate == 0 || Cursor - Reference > PACK_MAX_OFFSET || memcmp(Source + Reference, Source + Cursor, PACK_MIN_MATCH) != 0) {
+            // NOTE(milo): Skip faster through data that does not compress.
+            Cursor += 1 + ((Cursor - Anchor) >> 6);
+            continue;
+        }
+
+        u32 MatchLength = PACK_MIN_MATCH;
+        while (Cursor + MatchLength < Size && Source[Reference + MatchLength] == Source[Cursor + MatchLength]) {
+            MatchLength++;
+        }
+
+        u32 LiteralLength = Cursor - Anchor;
+        u8* Token = Output++;
+        *Token = (u8)(((LiteralLength < 15 ? LiteralLength : 15) << 4) | (MatchLength - PACK_MIN_MATCH < 15 ? MatchLength - PACK_MIN_MATCH : 15));
+
+        if (LiteralLength >= 15) {
+            Output = PackWriteLength(Output, LiteralLength - 15);
+        }
+        memcpy(Output, Source + Anchor, LiteralLength);
+        Output += LiteralLength;
+
+        u16 Offset = (u16)(Cursor - Reference);
+        memcpy(Output, &Offset, sizeof(u16));
+        Output += sizeof(u16);
+
+        if (MatchLength - PACK_MIN_MATCH >= 15) {
+            Output = PackWriteLength(Output, MatchLength - PACK_MIN_MATCH - 15);
+        }
+
+        Cursor += MatchLength;
+        Anchor = Cursor;
+    }
+
+    u32 LiteralLength = Size - Anchor;
+    *Output++ = (u8)((LiteralLength < 15 ? LiteralLength : 15) << 4);
+    if (LiteralLength >= 15) {
+        Output = PackWriteLength(Output, LiteralLength - 15);
+    }
+    memcpy(Output, Source + Anchor, LiteralLength);
+    Output += LiteralLength;
+
+    return (u32)(Output - Destination);
+}
+
+bool PackReadLength(const u8** Input, const u8* End, u32* Length)
+{
+    u8 Byte;
+    do {
+        if (*Input >= End) {
+            return false;
+        }
+        Byte = *(*Input)++;
+        *Length += Byte;
+    } while (Byte == 255);
+    return true;
+}
+
+bool PackDecompressBlock(const u8* Source, u32 Size, u8* Destination, u32 DestinationSize)
+{
+    const u8* Input = Source;
+    const u8* InputEnd = Source + Size;
+    u8* Output = Destination;
+    u8* OutputEnd = Destination + DestinationSize;
+
+    while (Input < InputEnd) {
+        u8 Token = *Input++;
+
+        u32 LiteralLength = Token >> 4;
+        if (LiteralLength == 15 && !PackReadLength(&Input, InputEnd, &LiteralLength)) {
+            return false;
+        }
+        if (LiteralLength > (u32)(InputEnd - Input) || LiteralLength > (u32)(OutputEnd - Output)) {
+            return false;
+        }
+        memcpy(Output, Input, LiteralLength);
+        Input += LiteralLength;
+        Output += LiteralLength;
+
+        if (Input == InputEnd) {
+            break;
+        }
+
+        if (InputEnd - Input < 2) {
+            return false;
+        }
+        u16 Offset;
+        memcpy(&Offset, Input, sizeof(u16));
+        Input += sizeof(u16);
+
+        u32 MatchLength = Token & 15;
+        if (MatchLength == 15 && !PackReadLength(&Input, InputEnd, &MatchLength)) {
+            return false;
+        }
+        MatchLength += PACK_MIN_MATCH;
+
+        if (Offset == 0 || Offset > (u32)(Output - Destination) || MatchLength > (u32)(OutputEnd - Output)) {
+            return false;
+        }
+
+        // NOTE(milo): Matches can overlap the bytes they produce, copy forward one byte at a time for short offsets.
+        const u8* Match = Output - Offset;
+        if (Offset >= 8) {
+            for (u32 Copied = 0; Copied < MatchLength; Copied += 8) {
+                u32 Chunk = MatchLength - Copied < 8 ? MatchLength - Copied : 8;
+                memcpy(Output + Copied, Match + Copied, Chunk);
+            }
+        } else {
+            for (u32 Copied = 0; Copied < MatchLength; Copied++) {
+                Output[Copied] = Match[Copied];
+            }
+        }
+        Output += MatchLength;
+    }
+
+    return Output == OutputEnd;
+}
+
+//~ NOTE(milo): Archive building
+
+void PackOrderFiles(std::vector<std::string>* Files, const char* LoadOrderPath)
+{
+    std::unordered_map<std::string, u32> Rank;
+
+    FILE* File = fopen(LoadOrderPath, "r");
+    if (File) {
+        char Line[1024];
+        while (fgets(Line, sizeof(Line), File)) {
+            Line[strcspn(Line, "\r\n")] = 0;
+            if (Line[0] && Rank.find(Line) == Rank.end()) {
+                u32 Index = (u32)Rank.size();
+                Rank[Line] = Index;
+            }
+        }
+        fclose(File);
+    }
+
+    // NOTE(milo): Files seen at load time come first in the order they were read, the rest follow by path.
+    std::sort(Files->begin(), Files->end(), [&Rank](const std::string& A, const std::string& B) {
+        auto RankA = Rank.find(A);
+        auto RankB = Rank.find(B);
+        if (RankA != Rank.end() && RankB != Rank.end()) {
+            return RankA->second < RankB->second;
+        }
+        if (RankA != Rank.end() || RankB != Rank.end()) {
+            return RankA != Rank.end();
+        }
+        return A < B;
+    });
+}
+
+void PackCompressBlocks(void* Data, u32 Start, u32 End)
+{
+    pack_build_context* Context = (pack_build_context*)Data;
+
+    for (u32 BlockIndex = Start; BlockIndex < End; BlockIndex++) {
+        u64 Offset = (u64)BlockIndex * PACK_BLOCK_SIZE;
+        u32 Size = (u32)(Context->StreamSize - Offset < PACK_BLOCK_SIZE ? Context->StreamSize - Offset : PACK_BLOCK_SIZE);
+
+        std::vector<u8>& Output = (*Context->Compressed)[BlockIndex];
+        Output.resize(PACK_BLOCK_BOUND(Size));
+        u32 CompressedSize = PackCompressBlock(Context->Stream + Offset, Size, Output.data(), (u32)Output.size());
+
+        if (CompressedSize == 0 || CompressedSize >= Size) {
+            Output.assign(Context->Stream + Offset, Context->Stream + Offset + Size);
+        } else {
+            Output.resize(CompressedSize);
+        }
+    }
+}
+
+bool PackBuild(const char* PackPath, const std::vector<std::string>& Files)
+{
+    u32 TableSize = 16;
+    while (TableSize < Files.size() * 2) {
+        TableSize *= 2;
+    }
+
+    std::vector<pack_entry> Table(TableSize);
+    std::vector<u8> Stream;
+
+    for (const std::string& Path : Files) {
+        std::string Normalized = PackNormalizePath(Path.c_str());
+        u64 Hash = HashString(Normalized);
+        Hash = Hash ? Hash : 1;
+
+        u32 Slot = (u32)(Hash & (TableSize - 1));
+        while (Table[Slot].PathHash != 0) {
+            if (Table[Slot].PathHash == Hash) {
+                LogError("Pack path hash collision on %s", Normalized.c_str());
+                return false;
+            }
+            Slot = (Slot + 1) & (TableSize - 1);
+        }
+
+        FILE* File = fopen(Path.c_str(), "rb");
+        if (!File) {
+            LogError("Failed to open file for packing: %s", Path.c_str());
+            return false;
+        }
+        fseek(File, 0, SEEK_END);
+        long Size = ftell(File);
+        fseek(File, 0, SEEK_SET);
+
+        u64 Offset = Stream.size();
+        Stream.resize(Offset + Size);
+        bool Read = fread(Stream.data() + Offset, 1, Size, File) == (size_t)Size;
+        fclose(File);
+
+        if (!Read) {
+            LogError("Failed to read file for packing: %s", Path.c_str());
+            return false;
+        }
+
+        Table[Slot].PathHash = Hash;
+        Table[Slot].Offset = Offset;
+        Table[Slot].Size = (u64)Size;
+    }
+
+    u32 BlockCount = (u32)((Stream.size() + PACK_BLOCK_SIZE - 1) / PACK_BLOCK_SIZE);
+    std::vector<std::vector<u8>> Compressed(BlockCount);
+
+    pack_build_context Context;
+    Context.Stream = Stream.data();
+    Context.StreamSize = Stream.size();
+    Context.Compressed = &Compressed;
+
+    job_counter Counter = {};
+    JobParallelFor(BlockCount, 4, PackCompressBlocks, &Context, &Counter);
+    JobWait(&Counter);
+
+    pack_header Header = {};
+    Header.Magic = PACK_MAGIC;
+    Header.Version = PACK_VERSION;
+    Header.FileCount = (u32)Files.size();
+    Header.TableSize = TableSize;
+    Header.BlockCount = BlockCount;
+    Header.TableOffset = sizeof(pack_header);
+    Header.BlockOffset = Header.TableOffset + TableSize * sizeof(pack_entry);
+    Header.DataOffset = Header.BlockOffset + BlockCount * sizeof(pack_block);
+
+    std::vector<pack_block> Blocks(BlockCount);
+    u64 CompressedTotal = 0;
+    for (u32 BlockIndex = 0; BlockIndex < BlockCount; BlockIndex++) {
+        u64 Offset = (u64)BlockIndex * PACK_BLOCK_SIZE;
+        Blocks[BlockIndex].Offset = CompressedTotal;
+        Blocks[BlockIndex].CompressedSize = (u32)Compressed[BlockIndex].size();
+        Blocks[BlockIndex].Size = (u32)(Stream.size() - Offset < PACK_BLOCK_SIZE ? Stream.size() - Offset : PACK_BLOCK_SIZE);
+        CompressedTotal += Compressed[BlockIndex].size();
+    }
+
+    FILE* File = fopen(PackPath, "wb");
+    if (!File) {
+        LogError("Failed to open pack for writing: %s", PackPath);
+        return false;
+    }
+
+    bool Written = fwrite(&Header, sizeof(Header), 1, File) == 1;
+    Written = Written && fwrite(Table.data(), sizeof(pack_entry), TableSize, File) == TableSize;
+    Written = Written && (BlockCount == 0 || fwrite(Blocks.data(), sizeof(pack_block), BlockCount, File) == BlockCount);
+    for (u32 BlockIndex = 0; Written && BlockIndex < BlockCount; BlockIndex++) {
+        Written = fwrite(Compressed[BlockIndex].data(), 1, Compressed[BlockIndex].size(), File) == Compressed[BlockIndex].size();
+    }
+    fclose(File);
+
+    if (!Written) {
+        LogError("Failed to write pack: %s", PackPath);
+        remove(PackPath);
+        return false;
+    }
+
+    LogInfo("Packed %u files into %s (%llu -> %llu bytes)", (u32)Files.size(), PackPath, (u64)Stream.size(), CompressedTotal);
+    return true;
+}
+
+bool PackBuildDirectory(const char* PackPath, const char* Directory)
+{
+    std::vector<std::string> Files;
+    PlatformListFiles(Directory, &Files);
+
+    // NOTE(milo): The asset cache is build output, not shipped data.
+    std::string Cache = std::string(Directory) + "/.cache/";
+    Files.erase(std::remove_if(Files.begin(), Files.end(), [&Cache](const std::string& Path) {
+        return PackNormalizePath(Path.c_str()).compare(0, Cache.size(), Cache) == 0;
+    }), Files.end());
+
+    PackOrderFiles(&Files, PACK_LOAD_ORDER_PATH);
+    return PackBuild(PackPath, Files);
+}
+
+//~ NOTE(milo): File access
+
+const pack_entry* PackFind(const char* Path)
+{
+    if (!PackState.Mounted) {
+        return NULL;
+    }
+
+    u64 Hash = HashString(PackNormalizePath(Path));
+    Hash = Hash ? Hash : 1;
+
+    u32 Mask = PackState.Header->TableSize - 1;
+    for (u32 Slot = (u32)(Hash & Mask); PackState.Table[Slot].PathHash != 0; Slot = (Slot + 1) & Mask) {
+        if (PackState.Table[Slot].PathHash == Hash) {
+            return &PackState.Table[Slot];
+        }
+    }
+    return NULL;
+}
+
+void PackRecordLoad(const char* Path)
+{
+    std::string Normalized = PackNormalizePath(Path);
+
+    PlatformMutexLock(&PackState.LoadOrderLock);
+    if (PackState.LoadOrderSeen.insert(Normalized).second) {
+        PackState.LoadOrder.push_back(Normalized);
+    }
+    PlatformMutexUnlock(&PackState.LoadOrderLock);
+}
+
+void PackReadBlocks(void* Data, u32 Start, u32 End)
+{
+    pack_read_context* Context = (pack_read_context*)Data;
+
+    u8 Scratch[PACK_BLOCK_SIZE];
+    for (u32 BlockIndex = Context->FirstBlock + Start; BlockIndex < Context->FirstBlock + End; BlockIndex++) {
+        const pack_block* Block = &PackState.Blocks[BlockIndex];
+        u64 BlockStart = (u64)BlockIndex * PACK_BLOCK_SIZE;
+        u64 CopyStart = Context->Offset > BlockStart ? Context->Offset : BlockStart;
+        u64 CopyEnd = Context->Offset + Context->Size < BlockStart + Block->Size ? Context->Offset + Context->Size : BlockStart + Block->Size;
+        u8* Output = Context->Destination + (CopyStart - Context->Offset);
+
+        const u8* Source = PackState.Data + Block->Offset;
+        if (Block->CompressedSize == Block->Size) {
+            memcpy(Output, Source + (CopyStart - BlockStart), CopyEnd - CopyStart);
+            continue;
+        }
+
+        // NOTE(milo): Whole blocks decompress straight into the destination, partial ones go through the scratch buffer.
+        bool Whole = CopyStart == BlockStart && CopyEnd == BlockStart + Block->Size;
+        u8* Target = Whole ? Output : Scratch;
+        if (!PackDecompressBlock(Source, Block->CompressedSize, Target, Block->Size)) {
+            Context->Failed.store(true);
+            continue;
+        }
+        if (!Whole) {
+            memcpy(Output, Scratch + (CopyStart - BlockStart), CopyEnd - CopyStart);
+        }
+    }
+}
+
+bool PackMount(const char* Path)
+{
+    PlatformMutexCreate(&PackState.LoadOrderLock);
+    PackState.Mounted = false;
+    PackState.Recording = true;
+
+    if (!PlatformFileMapOpen(&PackState.Map, Path)) {
+        LogInfo("No pack found at %s, reading loose files.", Path);
+        return false;
+    }
+
+    const pack_header* Header = (const pack_header*)PackState.Map.Data;
+    bool Valid = PackState.Map.Size >= sizeof(pack_header) && Header->Magic == PACK_MAGIC && Header->Version == PACK_VERSION &&
+                 Header->TableSize > 0 && (Header->TableSize & (Header->TableSize - 1)) == 0 && Header->DataOffset <= PackState.Map.Size &&
+                 Header->TableOffset <= Header->BlockOffset && (u64)Header->TableSize * sizeof(pack_entry) <= Header->BlockOffset - Header->TableOffset &&
+                 Header->BlockOffset <= Header->DataOffset && (u64)Header->BlockCount * sizeof(pack_block) <= Header->DataOffset - Header->BlockOffset;
+
+    // NOTE(milo): Sizes are compared against what is left so a corrupt offset can't wrap around. Readers find a block by dividing the
+    // stream offset by the block size, so every block but the last has to be full.
+    const pack_block* Blocks = (const pack_block*)((const u8*)PackState.Map.Data + Header->BlockOffset);
+    u64 DataSize = Valid ? PackState.Map.Size - Header->DataOffset : 0;
+    u64 StreamSize = 0;
+    for (u32 BlockIndex = 0; Valid && BlockIndex < Header->BlockCount; BlockIndex++) {
+        const pack_block* Block = &Blocks[BlockIndex];
+        Valid = (Block->Size == PACK_BLOCK_SIZE || BlockIndex == Header->BlockCount - 1) && Block->Size <= PACK_BLOCK_SIZE &&
+                Block->CompressedSize <= Block->Size && Block->Offset <= DataSize && Block->CompressedSize <= DataSize - Block->Offset;
+        StreamSize += Block->Size;
+    }
+
+    const pack_entry* Table = (const pack_entry*)((const u8*)PackState.Map.Data + Header->TableOffset);
+    for (u32 Slot = 0; Valid && Slot < Header->TableSize; Slot++) {
+        const pack_entry* Entry = &Table[Slot];
+        Valid = Entry->PathHash == 0 || (Entry->Offset <= StreamSize && Entry->Size <= StreamSize - Entry->Offset);
+    }
+
+    if (!Valid) {
+        LogError("Invalid pack: %s", Path);
+        PlatformFileMapClose(&PackState.Map);
+        return false;
+    }
+
+    PackState.Header = Header;
+    PackState.Table = Table;
+    PackState.Blocks = Blocks;
+    PackState.Data = (const u8*)PackState.Map.Data + Header->DataOffset;
+    PackState.Mounted = true;
+    PackState.Recording = false;
+
+    LogInfo("Mounted %s with %u files.", Path, Header->FileCount);
+    return true;
+}
+
+void PackUnmount()
+{
+    if (PackState.Mounted) {
+        PlatformFileMapClose(&PackState.Map);
+        PackState.Mounted = false;
+    } else if (PackState.Recording && !PackState.LoadOrder.empty()) {
+        PlatformCreateDirectory(ASSET_CACHE_DIRECTORY);
+        FILE* File = fopen(PACK_LOAD_ORDER_PATH, "w");
+        if (File) {
+            for (const std::string& Path : PackState.LoadOrder) {
+                fprintf(File, "%s\n", Path.c_str());
+            }
+            fclose(File);
+        }
+    }
+
+    PackState.Recording = false;
+    PackState.LoadOrder.clear();
+    PackState.LoadOrderSeen.clear();
+    PlatformMutexDestroy(&PackState.LoadOrderLock);
+}
+
+bool PackFileSize(const char* Path, u64* Size)
+{
+    const pack_entry* Entry = PackFind(Path);
+    if (Entry) {
+        *Size = Entry->Size;
+        return true;
+    }
+
+    FILE* File = fopen(Path, "rb");
+    if (!File) {
+        return false;
+    }
+    fseek(File, 0, SEEK_END);
+    *Size = (u64)ftell(File);
+    fclose(File);
+    return true;
+}
+
+bool PackReadRangeAsync(const char* Path, u64 Offset, u64 Size, void* Destination, pack_request* Request)
+{
+    Request->Loose = false;
+    Request->File.Handle = NULL;
+    Request->Read.Internal = NULL;
+    Request->Counter.Pending.store(0);
+    Request->Context.Failed.store(false);
+
+    const pack_entry* Entry = PackFind(Path);
+    if (!Entry) {
+        if (!PlatformAsyncFileOpen(&Request->File, Path)) {
+            return false;
+        }
+
+        if (PackState.Recording) {
+            PackRecordLoad(Path);
+        }
+
+        Request->Loose = true;
+        if (!PlatformAsyncRead(&Request->File, Offset, Size, Destination, &Request->Read)) {
+            PlatformAsyncFileClose(&Request->File);
+            return false;
+        }
+        return true;
+    }
+
+    if (Offset + Size > Entry->Size) {
+        return false;
+    }
+    if (Size == 0) {
+        return true;
+    }
+
+    pack_read_context* Context = &Request->Context;
+    Context->Offset = Entry->Offset + Offset;
+    Context->Size = Size;
+    Context->Destination = (u8*)Destination;
+
+    // NOTE(milo): Block indices passed to the range function are relative to the first block touched by the read.
+    Context->FirstBlock = (u32)(Context->Offset / PACK_BLOCK_SIZE);
+    u32 BlockCount = (u32)((Context->Offset + Size + PACK_BLOCK_SIZE - 1) / PACK_BLOCK_SIZE) - Context->FirstBlock;
+    JobParallelFor(BlockCount, 1, PackReadBlocks, Context, &Request->Counter);
+    return true;
+}
+
+bool PackRequestIsDone(pack_request* Request)
+{
+    if (Request->Loose) {
+        return PlatformAsyncReadPoll(&Request->File, &Request->Read);
+    }
+    return JobIsDone(&Request->Counter);
+}
+
+bool PackRequestWait(pack_request* Request)
+{
+    if (Request->Loose) {
+        bool Succeeded = PlatformAsyncReadWait(&Request->File, &Request->Read);
+        PlatformAsyncFileClose(&Request->File);
+        Request->Loose = false;
+        return Succeeded;
+    }
+
+    JobWait(&Request->Counter);
+    return !Request->Context.Failed.load();
+}
+
+bool PackReadRange(const char* Path, u64 Offset, u64 Size, void* Destination)
+{
+    pack_request Request;
+    if (!PackReadRangeAsync(Path, Offset, Size, Destination, &Request)) {
+        return false;
+    }
+    return PackRequestWait(&Request);
+}
+
+void* PackReadFile(const char* Path, u64* Size)
+{
+    u64 FileSize;
+    if (!PackFileSize(Path, &FileSize)) {
+        return NULL;
+    }
+
+    void* Data = malloc(FileSize > 0 ? FileSize : 1);
+    if (!PackReadRange(Path, 0, FileSize, Data)) {
+        free(Data);
+        return NULL;
+    }
+
+    *Size = FileSize;
+    return Data;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_platform.h"
+#include "backrooms_job.h"
+
+#include <string>
+#include <vector>
+
+#define PACK_MAGIC 0x4B415042 // NOTE(milo): "BPAK"
+#define PACK_VERSION 1
+#define PACK_BLOCK_SIZE (64 * 1024)
+#define PACK_DEFAULT_PATH "data.pack"
+#define PACK_SOURCE_DIRECTORY "data"
+#define PACK_LOAD_ORDER_PATH "data/.cache/load_order.txt"
+
+struct pack_header
+{
+    u32 Magic;
+    u32 Version;
+    u32 FileCount;
+    u32 TableSize;
+    u32 BlockCount;
+    u32 Pad;
+    u64 TableOffset;
+    u64 BlockOffset;
+    u64 DataOffset;
+};
+
+// NOTE(milo): Open addressed on the path hash, a zero hash marks an empty slot.
+struct pack_entry
+{
+    u64 PathHash;
+    u64 Offset;
+    u64 Size;
+};
+
+// NOTE(milo): Files are laid out back to back in one stream cut into blocks, a block with CompressedSize == Size is stored raw.
+struct pack_block
+{
+    u64 Offset;
+    u32 CompressedSize;
+    u32 Size;
+};
+
+struct pack_read_context
+{
+    u32 FirstBlock;
+    u64 Offset;
+    u64 Size;
+    u8* Destination;
+    std::atomic<bool> Failed;
+};
+
+// NOTE(milo): Loose files are read with the platform's async IO, packed ones are decompressed on the job system.
+struct pack_request
+{
+    bool Loose;
+    platform_async_file File;
+    platform_async_read Read;
+
+    pack_read_context Context;
+    job_counter Counter;
+};
+
+//~ NOTE(milo): Block codec
+u32 PackCompressBlock(const u8* Source, u32 Size, u8* Destination, u32 Capacity);
+bool PackDecompressBlock(const u8* Source, u32 Size, u8* Destination, u32 DestinationSize);
+
+//~ NOTE(milo): Archive building
+void PackOrderFiles(std::vector<std::string>* Files, const char* LoadOrderPath);
+bool PackBuild(const char* PackPath, const std::vector<std::string>& Files);
+bool PackBuildDirectory(const char* PackPath, const char* Directory);
+
+//~ NOTE(milo): File access, served from the mounted archive or the loose file
+bool PackMount(const char* Path);
+void PackUnmount();
+bool PackFileSize(const char* Path, u64* Size);
+bool PackReadRange(const char* Path, u64 Offset, u64 Size, void* Destination);
+void* PackReadFile(const char* Path, u64* Size);
+
+//~ NOTE(milo): Async reads, the destination has to outlive the request and every request must be waited on once
+bool PackReadRangeAsync(const char* Path, u64 Offset, u64 Size, void* Destination, pack_request* Request);
+bool PackRequestIsDone(pack_request* Request);
+bool PackRequestWait(pack_request* Request);
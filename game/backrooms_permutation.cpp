@@ -0,0 +1,66 @@
+#include "backrooms_permutation.h"
+#include "backrooms_logger.h"
+
+shader_permutation* ShaderPermutationsBuild(shader_permutation_set* Set, u32 Mask)
+{
+    std::vector<rhi_shader_define> Defines;
+    for (u32 Feature = 0; Feature < Set->Features.size(); Feature++) {
+        if (Mask & (1u << Feature)) {
+            Defines.push_back({ Set->Features[Feature].c_str(), "1" });
+        }
+    }
+
+    shader_permutation* Variant = new shader_permutation;
+    ShaderInitAsync(&Variant->Shader, Set->V.empty() ? NULL : Set->V.c_str(), Set->P.empty() ? NULL : Set->P.c_str(), NULL, Defines.data(), (u32)Defines.size());
+
+    rhi_pipeline_desc Desc = Set->Desc;
+    Desc.Shader = &Variant->Shader;
+    PipelineInit(&Variant->Pipeline, Desc);
+
+    if (Mask != 0) {
+        PipelineSetFallback(&Variant->Pipeline, &Set->Variants[0]->Pipeline);
+    }
+
+    Set->Variants[Mask] = Variant;
+    return Variant;
+}
+
+void ShaderPermutationsInit(shader_permutation_set* Set, const char* V, const char* P, const std::vector<std::string>& Features, const rhi_pipeline_desc& Desc)
+{
+    if (Features.size() > SHADER_PERMUTATION_MAX_FEATURES) {
+        LogError("Too many shader features for %s, only the first %d are used.", P ? P : V, SHADER_PERMUTATION_MAX_FEATURES);
+    }
+
+    Set->V = V ? V : "";
+    Set->P = P ? P : "";
+    Set->Features.assign(Features.begin(), Features.begin() + (Features.size() > SHADER_PERMUTATION_MAX_FEATURES ? SHADER_PERMUTATION_MAX_FEATURES : Features.size()));
+    Set->Desc = Desc;
+
+    ShaderPermutationsBuild(Set, 0);
+}
+
+void ShaderPermutationsFree(shader_permutation_set* Set)
+{
+    for (auto& Entry : Set->Variants) {
+        PipelineFree(&Entry.second->Pipeline);
+        ShaderFree(&Entry.second->Shader);
+        delete Entry.second;
+    }
+    Set->Variants.clear();
+}
+
+void ShaderPermutationsPrepare(shader_permutation_set* Set, u32 Mask)
+{
+    ShaderPermutationsGet(Set, Mask);
+}
+
+rhi_pipeline* ShaderPermutationsGet(shader_permutation_set* Set, u32 Mask)
+{
+    Mask &= (1u << Set->Features.size()) - 1;
+
+    auto Found = Set->Variants.find(Mask);
+    if (Found != Set->Variants.end()) {
+        return &Found->second->Pipeline;
+    }
+    return &ShaderPermutationsBuild(Set, Mask)->Pipeline;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_rhi.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#define SHADER_PERMUTATION_MAX_FEATURES 8
+
+struct shader_permutation
+{
+    rhi_shader Shader;
+    rhi_pipeline Pipeline;
+};
+
+// NOTE(milo): Feature bit N compiles with Features[N] defined. Variants are built on first use, the base variant without any feature
+// is built up front and stands in for the others while they compile.
+struct shader_permutation_set
+{
+    std::string V;
+    std::string P;
+    std::vector<std::string> Features;
+    rhi_pipeline_desc Desc;
+
+    std::unordered_map<u32, shader_permutation*> Variants;
+};
+
+//~ NOTE(milo): Shader permutations
+void ShaderPermutationsInit(shader_permutation_set* Set, const char* V, const char* P, const std::vector<std::string>& Features, const rhi_pipeline_desc& Desc);
+void ShaderPermutationsFree(shader_permutation_set* Set);
+void ShaderPermutationsPrepare(shader_permutation_set* Set, u32 Mask);
+rhi_pipeline* ShaderPermutationsGet(shader_permutation_set* Set, u32 Mask);
@@ -3,6 +3,7 @@
 #include "backrooms_common.h"
 
 #include <string>
+#include <vector>
 
 typedef u32 (*PFN_ThreadStart)(void*);
 
@@ -31,6 +32,32 @@ struct platform_mutex
     void* Internal;
 };
 
+struct platform_semaphore
+{
+    void* Internal;
+};
+
+struct platform_file_map
+{
+    void* File;
+    void* Mapping;
+    const void* Data;
+    u64 Size;
+};
+
+struct platform_async_file
+{
+    void* Handle;
+};
+
+// NOTE(milo): One read in flight, the destination buffer has to stay alive until the read completes.
+struct platform_async_read
+{
+    void* Internal;
+    u64 Size;
+    bool Succeeded;
+};
+
 enum log_color
 {
     LogColor_CyanInfo,
@@ -46,6 +73,17 @@ void PlatformSetLogColor(log_color Color);
 
 //~ NOTE(milo): File IO
 std::string PlatformReadFile(const char* Path);
+bool PlatformCreateDirectory(const char* Path);
+void PlatformListFiles(const char* Directory, std::vector<std::string>* Files);
+bool PlatformFileMapOpen(platform_file_map* Map, const char* Path);
+void PlatformFileMapClose(platform_file_map* Map);
+
+//~ NOTE(milo): Async file IO
+bool PlatformAsyncFileOpen(platform_async_file* File, const char* Path);
+void PlatformAsyncFileClose(platform_async_file* File);
+bool PlatformAsyncRead(platform_async_file* File, u64 Offset, u64 Size, void* Destination, platform_async_read* Read);
+bool PlatformAsyncReadPoll(platform_async_file* File, platform_async_read* Read);
+bool PlatformAsyncReadWait(platform_async_file* File, platform_async_read* Read);
 
 //~ NOTE(milo): DLL
 void PlatformDLLInit(platform_dynamic_lib* Library, const char* Path);
@@ -71,4 +109,10 @@ void PlatformThreadSleep(platform_thread* Thread, u64 Miliseconds);
 void PlatformMutexCreate(platform_mutex* Mutex);
 void PlatformMutexDestroy(platform_mutex* Mutex);
 bool PlatformMutexLock(platform_mutex* Mutex);
-bool PlatformMutexUnlock(platform_mutex* Mutex);
\ No newline at end of file
+bool PlatformMutexUnlock(platform_mutex* Mutex);
+
+//~ NOTE(milo): Semaphore
+void PlatformSemaphoreCreate(platform_semaphore* Semaphore, i32 InitialCount, i32 MaxCount);
+void PlatformSemaphoreDestroy(platform_semaphore* Semaphore);
+void PlatformSemaphoreSignal(platform_semaphore* Semaphore, i32 Count);
+void PlatformSemaphoreWait(platform_semaphore* Semaphore);
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "backrooms_portal.h"
+#include "backrooms_logger.h"
+
+#include <math.h>
+#include <algorithm>
+
+//~ NOTE(milo): Authoring
+
+// NOTE(milo): The marker mesh is a triangle soup, its unique corners are sorted by angle around their centroid in the polygon's plane.
+bool PortalPolygonFromPoints(const hmm_vec3* Points, u32 Count, portal_polygon* Polygon)
+{
+    std::vector<hmm_vec3> Unique;
+    for (u32 Index = 0; Index < Count; Index++) {
+        bool Seen = false;
+        for (const hmm_vec3& Other : Unique) {
+            Seen = Seen || HMM_DistanceVec3(Other, Points[Index]) < 1e-4f;
+        }
+        if (!Seen) {
+            Unique.push_back(Points[Index]);
+        }
+    }
+
+    if (Unique.size() < 3 || Unique.size() > PORTAL_MAX_VERTICES) {
+        LogWarn("Portal has %u corners, expected between 3 and %u", (u32)Unique.size(), PORTAL_MAX_VERTICES);
+        return false;
+    }
+
+    // NOTE(milo): The widest pair of corners and the corner farthest from their line give a stable normal for any convex shape.
+    hmm_vec3 Origin = Unique[0];
+    hmm_vec3 Far = Unique[1];
+    for (const hmm_vec3& Point : Unique) {
+        Far = HMM_DistanceVec3(Point, Origin) > HMM_DistanceVec3(Far, Origin) ? Point : Far;
+    }
+    hmm_vec3 Normal = HMM_Vec3(0.0f, 0.0f, 0.0f);
+    for (const hmm_vec3& Point : Unique) {
+        hmm_vec3 Cross = HMM_Cross(HMM_SubtractVec3(Far, Origin), HMM_SubtractVec3(Point, Origin));
+        Normal = HMM_LengthVec3(Cross) > HMM_LengthVec3(Normal) ? Cross : Normal;
+    }
+    if (HMM_LengthVec3(Normal) < 1e-8f) {
+        LogWarn("Portal corners are collinear");
+        return false;
+    }
+
+    hmm_vec3 Center = HMM_Vec3(0.0f, 0.0f, 0.0f);
+    for (const hmm_vec3& Point : Unique) {
+        Center = HMM_AddVec3(Center, Point);
+    }
+    Center = HMM_MultiplyVec3f(Center, 1.0f / (f32)Unique.size());
+
+    hmm_vec3 AxisU = HMM_NormalizeVec3(HMM_SubtractVec3(Far, Origin));
+    hmm_vec3 AxisV = HMM_Cross(HMM_NormalizeVec3(Normal), AxisU);
+    std::sort(Unique.begin(), Unique.end(), [&](const hmm_vec3& A, const hmm_vec3& B) {
+        hmm_vec3 OffsetA = HMM_SubtractVec3(A, Center);
+        hmm_vec3 OffsetB = HMM_SubtractVec3(B, Center);
+        return atan2f(HMM_DotVec3(OffsetA, AxisV), HMM_DotVec3(OffsetA, AxisU)) < atan2f(HMM_DotVec3(OffsetB, AxisV), HMM_DotVec3(OffsetB, AxisU));
+    });
+
+    Polygon->VertexCount = (u32)Unique.size();
+    for (u32 Index = 0; Index < Polygon->VertexCount; Index++) {
+        Polygon->Vertices[Index] = Unique[Index];
+    }
+    return true;
+}
+
+void PortalGraphAddCell(portal_graph* Graph, aabb Bounds)
+{
+    portal_cell Cell;
+    Cell.Bounds = Bounds;
+    Graph->Cells.push_back(Cell);
+    Graph->Dirty = true;
+}
+
+void PortalGraphAddPortal(portal_graph* Graph, const portal_polygon* Polygon)
+{
+    Graph->Polygons.push_back(*Polygon);
+    Graph->Dirty = true;
+}
+
+void PortalGraphFree(portal_graph* Graph)
+{
+    Graph->Cells.clear();
+    Graph->Polygons.clear();
+    Graph->Portals.clear();
+    Graph->VisibleCells.clear();
+    Graph->CellVisible.clear();
+    Graph->OnPath.clear();
+    Graph->Dirty = false;
+}
+
+hmm_vec3 PortalPolygonCenter(const portal_polygon* Polygon)
+{
+    hmm_vec3 Center = HMM_Vec3(0.0f, 0.0f, 0.0f);
+    for (u32 Index = 0; Index < Polygon->VertexCount; Index++) {
+        Center = HMM_AddVec3(Center, Polygon->Vertices[Index]);
+    }
+    return HMM_MultiplyVec3f(Center, 1.0f / (f32)Polygon->VertexCount);
+}
+
+// NOTE(milo): Newell's method, every edge contributes so collinear corners do not matter.
+hmm_vec4 PortalPolygonPlane(const portal_polygon* Polygon)
+{
+    hmm_vec3 Normal = HMM_Vec3(0.0f, 0.0f, 0.0f);
+    for (u32 Index = 0; Index < Polygon->VertexCount; Index++) {
+        hmm_vec3 A = Polygon->Vertices[Index];
+        hmm_vec3 B = Polygon->Vertices[(Index + 1) % Polygon->VertexCount];
+        Normal.X += (A.Y - B.Y) * (A.Z + B.Z);
+        Normal.Y += (A.Z - B.Z) * (A.X + B.X);
+        Normal.Z += (A.X - B.X) * (A.Y + B.Y);
+    }
+    Normal = HMM_NormalizeVec3(Normal);
+    return HMM_Vec4v(Normal, -HMM_DotVec3(Normal, PortalPolygonCenter(Polygon)));
+}
+
+// NOTE(milo): A portal connects the first two cells its center touches, portals touching fewer are reported and ignored.
+void PortalGraphLink(portal_graph* Graph)
+{
+    Graph->Portals.clear();
+    for (portal_cell& Cell : Graph->Cells) {
+        Cell.Portals.clear();
+    }
+
+    for (const portal_polygon& Polygon : Graph->Polygons) {
+        hmm_vec3 Center = PortalPolygonCenter(&Polygon);
+
+        portal Portal;
+        Portal.Polygon = Polygon;
+        u32 Found = 0;
+        for (u32 CellIndex = 0; CellIndex < Graph->Cells.size() && Found < 2; CellIndex++) {
+            if (AabbContains(&Graph->Cells[CellIndex].Bounds, Center, PORTAL_LINK_MARGIN)) {
+                Portal.Cells[Found++] = CellIndex;
+            }
+        }
+
+        if (Found < 2) {
+            LogWarn("Portal at (%.2f, %.2f, %.2f) does not connect two cells", Center.X, Center.Y, Center.Z);
+            continue;
+        }
+
+        u32 PortalIndex = (u32)Graph->Portals.size();
+        Graph->Portals.push_back(Portal);
+        Graph->Cells[Portal.Cells[0]].Portals.push_back(PortalIndex);
+        Graph->Cells[Portal.Cells[1]].Portals.push_back(PortalIndex);
+    }
+
+    Graph->Dirty = false;
+}
+
+//~ NOTE(milo): Visibility
+
+// NOTE(milo): The view matrix is a rigid transform, the eye is its translation rotated back by the transposed rotation.
+hmm_vec3 PortalEyeFromView(hmm_mat4 View)
+{
+    hmm_vec3 Translation = HMM_Vec3(View.Elements[3][0], View.Elements[3][1], View.Elements[3][2]);
+    hmm_vec3 Eye;
+    for (i32 Axis = 0; Axis < 3; Axis++) {
+        hmm_vec3 Row = HMM_Vec3(View.Elements[Axis][0], View.Elements[Axis][1], View.Elements[Axis][2]);
+        Eye.Elements[Axis] = -HMM_DotVec3(Row, Translation);
+    }
+    return Eye;
+}
+
+f32 PortalPlaneDistance(hmm_vec4 Plane, hmm_vec3 Point)
+{
+    return HMM_DotVec3(Plane.XYZ, Point) + Plane.W;
+}
+
+// NOTE(milo): Sutherland-Hodgman against every plane of the frustum. Each plane adds at most one corner to a convex polygon.
+u32 PortalClipPolygon(const portal_polygon* Polygon, const portal_frustum* Frustum, hmm_vec3* Output)
+{
+    hmm_vec3 Buffers[2][PORTAL_MAX_CLIP_VERTICES];
+    u32 Count = Polygon->VertexCount;
+    for (u32 Index = 0; Index < Count; Index++) {
+        Buffers[0][Index] = Polygon->Vertices[Index];
+    }
+
+    u32 Source = 0;
+    for (u32 PlaneIndex = 0; PlaneIndex < Frustum->Count && Count >= 3; PlaneIndex++) {
+        hmm_vec4 Plane = Frustum->Planes[PlaneIndex];
+        hmm_vec3* Input = Buffers[Source];
+        hmm_vec3* Clipped = Buffers[Source ^ 1];
+
+        u32 ClippedCount = 0;
+        for (u32 Index = 0; Index < Count; Index++) {
+            hmm_vec3 A = Input[Index];
+            hmm_vec3 B = Input[(Index + 1) % Count];
+            f32 DistanceA = PortalPlaneDistance(Plane, A);
+            f32 DistanceB = PortalPlaneDistance(Plane, B);
+
+            if (DistanceA >= 0.0f && ClippedCount < PORTAL_MAX_CLIP_VERTICES) {
+                Clipped[ClippedCount++] = A;
+            }
+            if ((DistanceA >= 0.0f) != (DistanceB >= 0.0f) && ClippedCount < PORTAL_MAX_CLIP_VERTICES) {
+                f32 T = DistanceA / (DistanceA - DistanceB);
+                Clipped[ClippedCount++] = HMM_AddVec3(A, HMM_MultiplyVec3f(HMM_SubtractVec3(B, A), T));
+            }
+        }
+
+        Count = ClippedCount;
+        Source ^= 1;
+    }
+
+    if (Count < 3) {
+        return 0;
+    }
+    for (u32 Index = 0; Index < Count; Index++) {
+        Output[Index] = Buffers[Source][Index];
+    }
+    return Count;
+}
+
+// NOTE(milo): One plane through the eye and every edge of the opening, plus the portal's own plane so nothing between the eye and the
+// portal passes.
+void PortalBuildFrustum(hmm_vec3 Eye, const hmm_vec3* Corners, u32 Count, hmm_vec4 PortalPlane, portal_frustum* Frustum)
+{
+    hmm_vec3 Center = HMM_Vec3(0.0f, 0.0f, 0.0f);
+    for (u32 Index = 0; Index < Count; Index++) {
+        Center = HMM_AddVec3(Center, Corners[Index]);
+    }
+    Center = HMM_MultiplyVec3f(Center, 1.0f / (f32)Count);
+
+    Frustum->Count = 0;
+    for (u32 Index = 0; Index < Count && Frustum->Count < PORTAL_MAX_PLANES - 1; Index++) {
+        hmm_vec3 Normal = HMM_Cross(HMM_SubtractVec3(Corners[Index], Eye), HMM_SubtractVec3(Corners[(Index + 1) % Count], Eye));
+        f32 Length = HMM_LengthVec3(Normal);
+        if (Length < 1e-8f) {
+            continue;
+        }
+
+        hmm_vec4 Plane = HMM_Vec4v(HMM_MultiplyVec3f(Normal, 1.0f / Length), 0.0f);
+        Plane.W = -HMM_DotVec3(Plane.XYZ, Eye);
+        if (PortalPlaneDistance(Plane, Center) < 0.0f) {
+            Plane = HMM_MultiplyVec4f(Plane, -1.0f);
+        }
+        Frustum->Planes[Frustum->Count++] = Plane;
+    }
+    Frustum->Planes[Frustum->Count++] = PortalPlane;
+}
+
+void PortalVisit(portal_graph* Graph, u32 CellIndex, hmm_vec3 Eye, const portal_frustum* Frustum, u32 Depth)
+{
+    if (!Graph->CellVisible[CellIndex]) {
+        Graph->CellVisible[CellIndex] = 1;
+        Graph->VisibleCells.push_back(CellIndex);
+    }
+    if (Depth >= PORTAL_MAX_DEPTH) {
+        return;
+    }
+
+    Graph->OnPath[CellIndex] = 1;
+    for (u32 PortalIndex : Graph->Cells[CellIndex].Portals) {
+        const portal* Portal = &Graph->Portals[PortalIndex];
+        u32 Next = Portal->Cells[0] == CellIndex ? Portal->Cells[1] : Portal->Cells[0];
+        if (Graph->OnPath[Next]) {
+            continue;
+        }
+        Graph->Stats.PortalsTested++;
+
+        const portal_polygon* Polygon = &Portal->Polygon;
+        hmm_vec4 PortalPlane = PortalPolygonPlane(Polygon);
+        f32 EyeDistance = PortalPlaneDistance(PortalPlane, Eye);
+
+        // NOTE(milo): Standing in the doorway the opening is behind the near plane but covers the whole view, the current frustum
+        // carries over unchanged.
+        if (fabsf(EyeDistance) < PORTAL_DOORWAY_DISTANCE && AabbContains(&Graph->Cells[Next].Bounds, Eye, PORTAL_LINK_MARGIN)) {
+            Graph->Stats.PortalsPassed++;
+            PortalVisit(Graph, Next, Eye, Frustum, Depth + 1);
+            continue;
+        }
+
+        hmm_vec3 Corners[PORTAL_MAX_CLIP_VERTICES];
+        u32 CornerCount = PortalClipPolygon(Polygon, Frustum, Corners);
+        if (CornerCount == 0) {
+            continue;
+        }
+        Graph->Stats.PortalsPassed++;
+
+        if (EyeDistance > 0.0f) {
+            PortalPlane = HMM_MultiplyVec4f(PortalPlane, -1.0f);
+        }
+
+        // NOTE(milo): Clipping adds corners, past the plane budget the whole portal is used which only lets more through.
+        portal_frustum Narrowed;
+        if (CornerCount < PORTAL_MAX_PLANES) {
+            PortalBuildFrustum(Eye, Corners, CornerCount, PortalPlane, &Narrowed);
+        } else {
+            PortalBuildFrustum(Eye, Polygon->Vertices, Polygon->VertexCount, PortalPlane, &Narrowed);
+        }
+        PortalVisit(Graph, Next, Eye, &Narrowed, Depth + 1);
+    }
+    Graph->OnPath[CellIndex] = 0;
+}
+
+// NOTE(milo): Starts in the cell holding the eye and walks through every portal still inside the narrowed frustum. Returns false when
+// the eye is outside every cell, the caller should not cull anything then.
+bool PortalFindVisibleCells(portal_graph* Graph, hmm_vec3 Eye, const hmm_vec4* Planes)
+{
+    if (Graph->Dirty) {
+        PortalGraphLink(Graph);
+    }
+
+    u32 CellCount = (u32)Graph->Cells.size();
+    Graph->Stats = {};
+    Graph->Stats.Cells = CellCount;
+    Graph->VisibleCells.clear();
+    Graph->CellVisible.assign(CellCount, 0);
+    Graph->OnPath.assign(CellCount, 0);
+
+    u32 Start = CellCount;
+    for (u32 CellIndex = 0; CellIndex < CellCount && Start == CellCount; CellIndex++) {
+        if (AabbContains(&Graph->Cells[CellIndex].Bounds, Eye)) {
+            Start = CellIndex;
+        }
+    }
+    if (Start == CellCount) {
+        return false;
+    }
+
+    portal_frustum Frustum;
+    Frustum.Count = CULLING_PLANE_COUNT;
+    for (u32 PlaneIndex = 0; PlaneIndex < CULLING_PLANE_COUNT; PlaneIndex++) {
+        Frustum.Planes[PlaneIndex] = Planes[PlaneIndex];
+    }
+
+    PortalVisit(Graph, Start, Eye, &Frustum, 0);
+
+    Graph->Stats.VisibleCells = (u32)Graph->VisibleCells.size();
+    Graph->Stats.InsideCell = true;
+    return true;
+}
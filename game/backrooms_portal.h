@@ -0,0 +1,79 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_culling.h"
+#include "backrooms_bvh.h"
+
+#include <hmm/HandmadeMath.h>
+#include <vector>
+
+// NOTE(milo): Level nodes named with these prefixes are visibility markers instead of render geometry. A cell's mesh only gives its
+// bounds, a portal's mesh is a flat convex polygon, usually a quad covering a doorway.
+#define PORTAL_CELL_PREFIX "Cell_"
+#define PORTAL_PREFIX "Portal_"
+
+#define PORTAL_MAX_VERTICES 8
+#define PORTAL_MAX_CLIP_VERTICES 32
+#define PORTAL_MAX_PLANES 32
+#define PORTAL_MAX_DEPTH 16
+#define PORTAL_LINK_MARGIN 0.1f // NOTE(milo): Portals sit on the shared face of two cells, the cells are grown this much to find both.
+#define PORTAL_DOORWAY_DISTANCE 0.05f // NOTE(milo): Closer to a portal than this and its opening no longer narrows the frustum.
+
+struct portal_polygon
+{
+    hmm_vec3 Vertices[PORTAL_MAX_VERTICES];
+    u32 VertexCount;
+};
+
+struct portal
+{
+    portal_polygon Polygon;
+    u32 Cells[2];
+};
+
+struct portal_cell
+{
+    aabb Bounds;
+    std::vector<u32> Portals;
+};
+
+// NOTE(milo): Inside is dot(Plane.XYZ, Point) + Plane.W >= 0, like the camera frustum planes.
+struct portal_frustum
+{
+    hmm_vec4 Planes[PORTAL_MAX_PLANES];
+    u32 Count;
+};
+
+struct portal_stats
+{
+    u32 Cells;
+    u32 VisibleCells;
+    u32 PortalsTested;
+    u32 PortalsPassed;
+    bool InsideCell; // NOTE(milo): False when the camera is outside every cell and nothing was culled.
+};
+
+// NOTE(milo): Cells and portal polygons are added in world space, the portals are linked to the cells they touch the next time the
+// visible cells are searched.
+struct portal_graph
+{
+    std::vector<portal_cell> Cells;
+    std::vector<portal_polygon> Polygons;
+    std::vector<portal> Portals;
+    bool Dirty;
+
+    std::vector<u32> VisibleCells;
+    std::vector<u8> CellVisible;
+    std::vector<u8> OnPath;
+    portal_stats Stats;
+};
+
+//~ NOTE(milo): Authoring
+bool PortalPolygonFromPoints(const hmm_vec3* Points, u32 Count, portal_polygon* Polygon);
+void PortalGraphAddCell(portal_graph* Graph, aabb Bounds);
+void PortalGraphAddPortal(portal_graph* Graph, const portal_polygon* Polygon);
+void PortalGraphFree(portal_graph* Graph);
+
+//~ NOTE(milo): Visibility
+hmm_vec3 PortalEyeFromView(hmm_mat4 View);
+bool PortalFindVisibleCells(portal_graph* Graph, hmm_vec3 Eye, const hmm_vec4* Planes);
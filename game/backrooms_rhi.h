@@ -5,6 +5,15 @@
 #include <stdlib.h>
 #include <hmm/HandmadeMath.h>
 
+#define RHI_MAX_MIPS 16
+#define RHI_UPLOAD_DEFAULT_BUDGET (8 * 1024 * 1024)
+#define RHI_UPLOAD_DEFAULT_MILLISECONDS 2.0f
+#define RHI_UNIFORM_RING_SIZE (4 * 1024 * 1024)
+#define RHI_COMMAND_LIST_UNIFORM_SIZE (1 * 1024 * 1024)
+#define RHI_MAX_VERTEX_STREAMS 2
+#define RHI_INSTANCE_SLOT 1
+#define RHI_INSTANCE_SEMANTIC "INSTANCE" // NOTE(milo): Vertex inputs whose semantic starts with this are read per instance from RHI_INSTANCE_SLOT
+
 enum rhi_texture_format
 {
     TextureFormat_Unknown = 0,
@@ -133,7 +142,22 @@ enum rhi_buffer_usage
     BufferUsage_Vertex,
     BufferUsage_Index,
     BufferUsage_Uniform,
-    BufferUsage_Storage
+    BufferUsage_Storage,
+    BufferUsage_VertexStorage, // NOTE(milo): A vertex stream compute writes through a raw UAV
+    BufferUsage_Indirect // NOTE(milo): rhi_draw_indexed_args records, written through a raw UAV
+};
+
+// NOTE(milo): Dynamic buffers live in CPU writable memory and are rewritten through BufferMap instead of the upload queue.
+enum rhi_buffer_access
+{
+    BufferAccess_Default,
+    BufferAccess_Dynamic
+};
+
+enum rhi_buffer_map
+{
+    BufferMap_Discard,
+    BufferMap_NoOverwrite
 };
 
 enum rhi_uniform_bind
@@ -168,6 +192,13 @@ enum rhi_comp_op
     CompareOP_Always
 };
 
+enum rhi_blend_mode
+{
+    BlendMode_Opaque,
+    BlendMode_Alpha,
+    BlendMode_Additive
+};
+
 enum rhi_texture_usage
 {
     TextureUsage_RTV,
@@ -190,6 +221,15 @@ struct rhi_sampler
     void* Internal;
 };
 
+struct rhi_image_mip
+{
+    void* Data;
+    u32 Pitch;
+    u32 Size;
+    i32 Width;
+    i32 Height;
+};
+
 struct rhi_image
 {
     void* Data;
@@ -197,6 +237,12 @@ struct rhi_image
     i32 Height;
     bool Float;
     const char* Path;
+
+    // NOTE(milo): Cooked images carry their whole mip chain in a block compressed format.
+    bool Cooked;
+    rhi_texture_format Format;
+    u32 MipCount;
+    rhi_image_mip Mips[RHI_MAX_MIPS];
 };
 
 struct rhi_texture
@@ -205,6 +251,9 @@ struct rhi_texture
 
     rhi_texture_format Format;
     i32 Width, Height;
+    u32 MipCount;
+    u32 FirstMip; // NOTE(milo): Streamed textures only hold the levels from FirstMip of their image down.
+    u32 Layers; // NOTE(milo): Texture arrays are sampled as Texture2DArray, every layer shares the size, format and mip count.
     bool Cube;
 };
 
@@ -233,6 +282,67 @@ struct rhi_shader
     void* Internal;
 };
 
+struct rhi_shader_define
+{
+    const char* Name;
+    const char* Value;
+};
+
+// NOTE(milo): The pipeline keeps a pointer to the shader, which has to outlive it.
+struct rhi_pipeline_desc
+{
+    rhi_shader* Shader;
+    rhi_material_config Config;
+    rhi_blend_mode Blend;
+    bool DepthReadOnly;
+};
+
+struct rhi_pipeline
+{
+    void* Internal;
+};
+
+// NOTE(milo): Recorded on any thread and submitted on the main one. Between Begin and End every bind, draw, upload and uniform push
+// made on the recording thread goes to the list instead of the device, starting from the render target and viewport bound at Begin.
+struct rhi_command_list
+{
+    void* Internal;
+};
+
+// NOTE(milo): Laid out the way the API reads indirect draws, BaseVertex is added to every index.
+struct rhi_draw_indexed_args
+{
+    u32 IndexCount;
+    u32 InstanceCount;
+    u32 StartIndex;
+    i32 BaseVertex;
+    u32 StartInstance;
+};
+
+// NOTE(milo): A range of the frame's uniform ring, only valid until the next VideoPresent.
+struct rhi_uniform_slice
+{
+    u32 Offset;
+    u32 Size;
+};
+
+// NOTE(milo): Binds that reached the driver versus binds dropped because the state was already set, over the last frame.
+struct rhi_bind_stats
+{
+    u32 Issued;
+    u32 Filtered;
+};
+
+struct rhi_upload_stats
+{
+    u64 BudgetBytes;
+    u64 BytesThisFrame;
+    u64 PendingBytes;
+    u32 PendingUploads;
+    u32 StagingTextures;
+    u32 RingStalls;
+};
+
 //~ NOTE(milo): Video
 void VideoInit(void* WindowHandle);
 void VideoExit();
@@ -242,26 +352,59 @@ bool VideoReady();
 void VideoBegin();
 void VideoDraw(u32 Count, u32 Start);
 void VideoDrawIndexed(u32 Count, u32 Start);
+void VideoDrawIndexedInstanced(u32 Count, u32 InstanceCount, u32 Start, u32 StartInstance);
+void VideoDrawIndexedIndirect(rhi_buffer* Args, u32 Offset);
+void VideoMultiDrawIndexedIndirect(rhi_buffer* Args, u32 DrawCount, u32 Offset = 0);
 void VideoDispatch(u32 X, u32 Y, u32 Z);
 void VideoBlitToSwapchain(rhi_texture* Texture);
 void VideoImGuiBegin();
 void VideoImGuiEnd();
+rhi_bind_stats VideoGetBindStats();
+
+//~ NOTE(milo): Command list
+// NOTE(milo): A list's uniforms grow in pages of RHI_COMMAND_LIST_UNIFORM_SIZE bytes, it is submitted once per recording and has to be
+// submitted before VideoPresent. The main thread must not bind targets or present while lists are being recorded.
+void CommandListInit(rhi_command_list* List);
+void CommandListFree(rhi_command_list* List);
+void CommandListBegin(rhi_command_list* List);
+void CommandListEnd(rhi_command_list* List);
+void CommandListSubmit(rhi_command_list* List);
 
 //~ NOTE(milo): Buffer
-void BufferInit(rhi_buffer* Buffer, i64 Size, i64 Stride, rhi_buffer_usage Usage);
+void BufferInit(rhi_buffer* Buffer, i64 Size, i64 Stride, rhi_buffer_usage Usage, rhi_buffer_access Access = BufferAccess_Default);
 void BufferFree(rhi_buffer* Buffer);
 void BufferInitSRV(rhi_buffer* Buffer);
 void BufferInitUAV(rhi_buffer* Buffer);
 void BufferUpload(rhi_buffer* Buffer, void* Data);
-void BufferBindVertex(rhi_buffer* Buffer);
+void BufferUploadRange(rhi_buffer* Buffer, const void* Data, u64 Offset, u64 Size);
+void* BufferMap(rhi_buffer* Buffer, rhi_buffer_map Map);
+void BufferUnmap(rhi_buffer* Buffer);
+void BufferWrite(rhi_buffer* Buffer, const void* Data, u64 Size);
+void BufferBindVertex(rhi_buffer* Buffer, u32 Slot = 0);
 void BufferBindIndex(rhi_buffer* Buffer);
 void BufferBindUniform(rhi_buffer* Buffer, i32 Binding, rhi_uniform_bind Bind);
-void BufferBindSRV(rhi_buffer* Buffer, i32 Binding);
+void BufferBindSRV(rhi_buffer* Buffer, i32 Binding, rhi_uniform_bind Bind = UniformBind_Compute);
 void BufferBindUAV(rhi_buffer* Buffer, i32 Binding);
 void* BufferGetData(rhi_buffer* Buffer);
 
+//~ NOTE(milo): Upload
+// NOTE(milo): Uploads are copied into the staging ring at the end of the frame, within the budget. A ticket is done once its copies are
+// recorded, anything drawn after that sees the data.
+u64 UploadBuffer(rhi_buffer* Buffer, const void* Data, u64 Offset, u64 Size);
+bool UploadIsDone(u64 Ticket);
+void UploadFlush();
+void UploadSetBudget(u64 Bytes, f32 Milliseconds);
+rhi_upload_stats UploadGetStats();
+
+//~ NOTE(milo): Uniform ring
+rhi_uniform_slice UniformPush(const void* Data, u32 Size);
+void UniformBindSlice(rhi_uniform_slice Slice, i32 Binding, rhi_uniform_bind Bind);
+
 //~ NOTE(milo): Shader
-void ShaderInit(rhi_shader* Shader, const char* V = NULL, const char* P = NULL, const char* C = NULL);
+void ShaderInit(rhi_shader* Shader, const char* V = NULL, const char* P = NULL, const char* C = NULL, const rhi_shader_define* Defines = NULL, u32 DefineCount = 0);
+void ShaderInitAsync(rhi_shader* Shader, const char* V = NULL, const char* P = NULL, const char* C = NULL, const rhi_shader_define* Defines = NULL, u32 DefineCount = 0);
+bool ShaderIsReady(rhi_shader* Shader);
+bool ShaderWait(rhi_shader* Shader);
 void ShaderFree(rhi_shader* Shader);
 void ShaderBind(rhi_shader* Shader);
 
@@ -276,11 +419,14 @@ void ImageLoadFloat(rhi_image* Image, const char* Path);
 void ImageFree(rhi_image* Image);
 
 //~ NOTE(milo): Texture
-void TextureInit(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format Format, rhi_texture_usage Usage);
+void TextureInit(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format Format, rhi_texture_usage Usage, u32 Layers = 1, u32 MipCount = 1);
 void TextureInitCube(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format Format, rhi_texture_usage Usage);
 void TextureLoad(rhi_texture* Texture, const char* Path); // NOTE(milo): Deprecated
 void TextureLoadFloat(rhi_texture* Texture, const char* Path); // NOTE(milo): Deprecated
 void TextureInitFromImage(rhi_texture* Texture, rhi_image* Image);
+void TextureUpdateMips(rhi_texture* Texture, rhi_image* Image, u32 FirstMip);
+u64 TextureUploadLayer(rhi_texture* Texture, u32 Layer, rhi_image* Image);
+void TextureResizeLayers(rhi_texture* Texture, u32 Layers);
 void TextureFree(rhi_texture* Texture);
 void TextureInitRTV(rhi_texture* Texture);
 void TextureInitDSV(rhi_texture* Texture);
@@ -296,4 +442,13 @@ void TextureResetUAV(i32 Binding);
 //~ NOTE(milo): Material
 void MaterialInit(rhi_material* Material, rhi_material_config Config);
 void MaterialFree(rhi_material* Material);
-void MaterialBind(rhi_material* Material);
\ No newline at end of file
+void MaterialBind(rhi_material* Material);
+
+//~ NOTE(milo): Pipeline
+// NOTE(milo): Pipelines with the same shader and states share one internal object, and the state objects are shared across all of them.
+// A fallback is set on that shared object and referenced by it, the fallback's shader still has to outlive the pipeline.
+void PipelineInit(rhi_pipeline* Pipeline, const rhi_pipeline_desc& Desc);
+void PipelineFree(rhi_pipeline* Pipeline);
+bool PipelineBind(rhi_pipeline* Pipeline);
+bool PipelineIsReady(rhi_pipeline* Pipeline);
+void PipelineSetFallback(rhi_pipeline* Pipeline, rhi_pipeline* Fallback);
\ No newline at end of file
@@ -1,14 +1,21 @@
 #include "backrooms_rhi.h"
 #include "backrooms_logger.h"
 #include "backrooms_platform.h"
+#include "backrooms_pack.h"
+#include "backrooms_hash.h"
+#include "backrooms_shader_cache.h"
+#include "backrooms_job.h"
 
 #if defined(BACKROOMS_WINDOWS)
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <dxgi.h>
 #include <d3dcompiler.h>
 #include <string>
 #include <vector>
+#include <deque>
+#include <unordered_map>
 #include <stb/stb_image.h>
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_dx11.h>
@@ -16,6 +23,172 @@
 
 #define SafeRelease(ptr) if (ptr) ptr->Release()
 
+#define D3D11_UPLOAD_CHUNK_SIZE (4 * 1024 * 1024)
+#define D3D11_UPLOAD_CHUNK_COUNT 4
+#define D3D11_UPLOAD_MAX_STAGING_TEXTURES 32
+#define D3D11_UNIFORM_ALIGNMENT 256
+#define D3D11_UNIFORM_MAX_SLICE (D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16)
+#define D3D11_STAGE_COUNT 3
+#define D3D11_CACHED_SRV_SLOTS 16
+
+// NOTE(milo): One slice of the staging ring. It is only mapped again once the fence issued after its copies has passed.
+struct d3d11_upload_chunk
+{
+    ID3D11Buffer* Staging;
+    ID3D11Query* Fence;
+    u8* Mapped;
+    u64 Used;
+    bool InFlight;
+};
+
+struct d3d11_chunk_copy
+{
+    ID3D11Buffer* Destination;
+    u64 DestinationOffset;
+    u64 SourceOffset;
+    u64 Size;
+};
+
+// NOTE(milo): D3D11 cannot copy from a buffer into a texture, texture levels go through pooled staging textures instead.
+struct d3d11_staging_texture
+{
+    ID3D11Texture2D* Texture;
+    ID3D11Query* Fence;
+    DXGI_FORMAT Format;
+    u32 Width;
+    u32 Height;
+    bool InFlight;
+};
+
+struct d3d11_upload
+{
+    u64 Ticket;
+    std::vector<u8> Data;
+    u64 Done;
+
+    ID3D11Buffer* Buffer;
+    u64 Offset;
+
+    ID3D11Texture2D* Texture;
+    u32 Subresource;
+    DXGI_FORMAT Format;
+    u32 Width;
+    u32 Height;
+    u32 Pitch;
+};
+
+struct d3d11_texture;
+
+// NOTE(milo): A texture whose levels are still queued, its resource and view replace the live ones once the ticket is done.
+struct d3d11_pending_texture
+{
+    d3d11_texture* Internal;
+    ID3D11Texture2D* Texture;
+    ID3D11ShaderResourceView* SRV;
+    u64 Ticket;
+    bool GenerateMips;
+};
+
+struct d3d11_uploader
+{
+    d3d11_upload_chunk Chunks[D3D11_UPLOAD_CHUNK_COUNT];
+    u32 CurrentChunk;
+    std::vector<d3d11_chunk_copy> ChunkCopies;
+    std::vector<d3d11_staging_texture> StagingTextures;
+
+    std::deque<d3d11_upload> Queue;
+    std::vector<d3d11_pending_texture> PendingTextures;
+    u64 NextTicket;
+    u64 CompletedTicket;
+
+    u64 BudgetBytes;
+    f32 BudgetMilliseconds;
+    u64 BytesThisFrame;
+    u32 RingStalls;
+};
+
+// NOTE(milo): Draws suballocate their constants from one dynamic buffer and bind it by offset. Without D3D11.1 offsetting the ring
+// lives on the CPU and each bind copies its slice into a per slot buffer. A command list's ring is Deferred, pushes only land in the
+// shadow and the buffers are filled from it when the list is submitted. Binds already recorded point into the full buffer, so instead of
+// wrapping it moves on to another page of Size bytes, with its own buffer and its own part of the shadow.
+struct d3d11_uniform_ring
+{
+    ID3D11DeviceContext1* Context1;
+    bool Offsetting;
+    bool Deferred;
+
+    ID3D11Buffer* Buffer;
+    u8* Shadow;
+    u32 Size;
+    u32 Head;
+    bool Discard;
+
+    std::vector<ID3D11Buffer*> Pages;
+    u32 Page;
+    u32 PageCount;
+
+    ID3D11Buffer* Fallback[3][D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+};
+
+struct d3d11_cached_constants
+{
+    ID3D11Buffer* Buffer;
+    u32 FirstConstant;
+    u32 ConstantCount;
+};
+
+// NOTE(milo): Mirrors what is bound on the context so binds of state that is already set never reach the driver. Stages are indexed
+// by rhi_uniform_bind. Output binds forget the SRVs and input buffers because the runtime unbinds resources that become outputs.
+struct d3d11_state_cache
+{
+    ID3D11VertexShader* VS;
+    ID3D11PixelShader* PS;
+    ID3D11ComputeShader* CS;
+    ID3D11InputLayout* InputLayout;
+    ID3D11RasterizerState* Rasterizer;
+    ID3D11DepthStencilState* DepthStencil;
+    ID3D11BlendState* Blend;
+    D3D11_PRIMITIVE_TOPOLOGY Topology;
+
+    ID3D11Buffer* VertexBuffers[RHI_MAX_VERTEX_STREAMS];
+    u32 VertexStrides[RHI_MAX_VERTEX_STREAMS];
+    ID3D11Buffer* IndexBuffer;
+
+    ID3D11SamplerState* Samplers[D3D11_STAGE_COUNT][D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+    ID3D11ShaderResourceView* SRVs[D3D11_STAGE_COUNT][D3D11_CACHED_SRV_SLOTS];
+    d3d11_cached_constants Constants[D3D11_STAGE_COUNT][D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+
+    rhi_bind_stats Frame;
+    rhi_bind_stats LastFrame;
+};
+
+struct d3d11_command_list
+{
+    ID3D11DeviceContext* Context;
+    ID3D11CommandList* Commands;
+    d3d11_uniform_ring Uniforms;
+    d3d11_state_cache Cache;
+};
+
+// NOTE(milo): What the immediate context renders into, command lists start from it and submits put it back.
+struct d3d11_targets
+{
+    ID3D11RenderTargetView* RTV;
+    ID3D11DepthStencilView* DSV;
+    D3D11_VIEWPORT Viewport;
+};
+
+struct d3d11_pipeline;
+
+// NOTE(milo): State objects are keyed by the hash of their D3D11 description and live until VideoExit.
+struct d3d11_state_objects
+{
+    std::unordered_map<u64, ID3D11RasterizerState*> Rasterizers;
+    std::unordered_map<u64, ID3D11DepthStencilState*> DepthStencils;
+    std::unordered_map<u64, ID3D11BlendState*> Blends;
+    std::unordered_map<u64, d3d11_pipeline*> Pipelines;
+};
+
 struct d3d11_state
 {
     HWND Window;
@@ -28,10 +201,17 @@ struct d3d11_state
     ID3D11Device* Device;
     ID3D11DeviceContext* DeviceContext;
     D3D_FEATURE_LEVEL FeatureLevel;
+    bool DriverCommandLists;
 
     IDXGISwapChain* SwapChain;
     ID3D11Texture2D* SwapchainBuffer;
     ID3D11RenderTargetView* SwapchainRenderTarget;
+
+    d3d11_uploader Upload;
+    d3d11_uniform_ring Uniforms;
+    d3d11_state_cache Cache;
+    d3d11_state_objects Objects;
+    d3d11_targets Targets;
 };
 
 struct d3d11_shader
@@ -40,6 +220,20 @@ struct d3d11_shader
     ID3D11PixelShader* PS;
     ID3D11ComputeShader* CS;
     ID3D11InputLayout* InputLayout;  
+
+    // NOTE(milo): Async shaders are built by a job, nothing above is touched until the counter is done.
+    job_counter Counter;
+    bool Failed;
+};
+
+// NOTE(milo): Owns copies of the paths, the caller's strings may be gone by the time the job runs.
+struct d3d11_shader_job
+{
+    d3d11_shader* Internal;
+    std::string V;
+    std::string P;
+    std::string C;
+    std::vector<shader_define> Defines;
 };
 
 struct d3d11_material
@@ -48,6 +242,18 @@ struct d3d11_material
     ID3D11DepthStencilState* DState;
 };
 
+struct d3d11_pipeline
+{
+    u64 Hash;
+    u32 References;
+    d3d11_pipeline* Fallback;
+
+    d3d11_shader* Shader;
+    ID3D11RasterizerState* RState;
+    ID3D11DepthStencilState* DState;
+    ID3D11BlendState* BState;
+};
+
 struct d3d11_texture
 {
     ID3D11Texture2D* ColorTexture;
@@ -61,12 +267,15 @@ struct d3d11_texture
 struct d3d11_buffer
 {
     ID3D11Buffer* Buffer;
+    u64 Size;
+    bool Dynamic;
     ID3D11ShaderResourceView* SRV;
     ID3D11UnorderedAccessView* UAV;
     D3D11_MAPPED_SUBRESOURCE MappedSubresource;
 };
 
 static d3d11_state State;
+static thread_local d3d11_command_list* Recording;
 
 const D3D_DRIVER_TYPE DriverTypes[] =
 {
@@ -81,6 +290,91 @@ D3D11_FILL_MODE FillModeToD3D11(rhi_fill_mode Fill);
 D3D11_COMPARISON_FUNC CompareToD3D11(rhi_comp_op Compare);
 D3D11_TEXTURE_ADDRESS_MODE SamplerAddressToD3D11(rhi_sampler_address Address);
 D3D11_BIND_FLAG TextureUsageToD3D11(rhi_texture_usage Usage);
+void UploadInit();
+void UploadExit();
+void UploadProcess(bool Flush);
+void UniformInit();
+void UniformExit();
+void StateCacheInvalidate();
+void StateObjectsExit();
+void StateCacheInvalidateInputs();
+ID3D11ShaderResourceView* TextureCreateSRV(ID3D11Texture2D* Texture, rhi_texture_format Format, bool Cube, bool Mips, u32 Layers = 1);
+void TextureQueueSwap(struct d3d11_texture* Internal, ID3D11Texture2D* Texture, ID3D11ShaderResourceView* SRV, u64 Ticket, bool GenerateMips);
+void TextureDropPending(struct d3d11_texture* Internal);
+
+// NOTE(milo): Binds and draws go to the command list the calling thread is recording, or to the immediate context.
+ID3D11DeviceContext* ContextCurrent()
+{
+    return Recording ? Recording->Context : State.DeviceContext;
+}
+
+d3d11_state_cache* CacheCurrent()
+{
+    return Recording ? &Recording->Cache : &State.Cache;
+}
+
+d3d11_uniform_ring* UniformsCurrent()
+{
+    return Recording ? &Recording->Uniforms : &State.Uniforms;
+}
+
+// NOTE(milo): Returns whether the bind has to be issued, and counts it either way.
+template<typename T>
+bool StateCacheSet(T* Cached, T Value)
+{
+    d3d11_state_cache* Cache = CacheCurrent();
+    if (*Cached == Value) {
+        Cache->Frame.Filtered++;
+        return false;
+    }
+
+    *Cached = Value;
+    Cache->Frame.Issued++;
+    return true;
+}
+
+// NOTE(milo): Slots past what the cache mirrors are always issued.
+bool StateCacheSetSRV(rhi_uniform_bind Bind, i32 Binding, ID3D11ShaderResourceView* SRV)
+{
+    d3d11_state_cache* Cache = CacheCurrent();
+    if (Binding >= D3D11_CACHED_SRV_SLOTS) {
+        Cache->Frame.Issued++;
+        return true;
+    }
+    return StateCacheSet(&Cache->SRVs[Bind][Binding], SRV);
+}
+
+bool StateCacheSetConstants(rhi_uniform_bind Bind, i32 Binding, ID3D11Buffer* Buffer, u32 FirstConstant, u32 ConstantCount)
+{
+    d3d11_state_cache* Cache = CacheCurrent();
+    d3d11_cached_constants* Cached = &Cache->Constants[Bind][Binding];
+    if (Cached->Buffer == Buffer && Cached->FirstConstant == FirstConstant && Cached->ConstantCount == ConstantCount) {
+        Cache->Frame.Filtered++;
+        return false;
+    }
+
+    Cached->Buffer = Buffer;
+    Cached->FirstConstant = FirstConstant;
+    Cached->ConstantCount = ConstantCount;
+    Cache->Frame.Issued++;
+    return true;
+}
+
+// NOTE(milo): Only binds made on the immediate context are remembered, a list's targets end with the list.
+void ContextBindTargets(ID3D11RenderTargetView* RTV, ID3D11DepthStencilView* DSV, const D3D11_VIEWPORT* Viewport)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
+    if (Viewport) {
+        Context->RSSetViewports(1, Viewport);
+    }
+    Context->OMSetRenderTargets(1, &RTV, DSV);
+
+    if (!Recording) {
+        State.Targets.RTV = RTV;
+        State.Targets.DSV = DSV;
+        if (Viewport) State.Targets.Viewport = *Viewport;
+    }
+}
 
 void VideoInit(void* WindowHandle)
 {
@@ -106,6 +400,14 @@ void VideoInit(void* WindowHandle)
         return;
     }
 
+    D3D11_FEATURE_DATA_THREADING Threading = {};
+    if (SUCCEEDED(State.Device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &Threading, sizeof(Threading)))) {
+        State.DriverCommandLists = Threading.DriverCommandLists;
+    }
+    if (!State.DriverCommandLists) {
+        LogWarn("The driver has no native command lists, the runtime emulates them.");
+    }
+
     State.Device->QueryInterface(IID_PPV_ARGS(&State.DXGI));
     State.DXGI->GetParent(IID_PPV_ARGS(&State.Adapter));
     State.Adapter->GetParent(IID_PPV_ARGS(&State.Factory));
@@ -136,10 +438,18 @@ void VideoInit(void* WindowHandle)
     ImGui_ImplWin32_EnableDpiAwareness();
 	ImGui_ImplWin32_Init(State.Window);
 	ImGui_ImplDX11_Init(State.Device, State.DeviceContext);
+
+    UploadInit();
+    UniformInit();
+    StateCacheInvalidate();
 }
 
 void VideoExit()
 {
+    UniformExit();
+    UploadExit();
+    StateObjectsExit();
+
     ImGui_ImplDX11_Shutdown();
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
@@ -201,6 +511,15 @@ void VideoPresent()
     if (FAILED(Result)) {
         LogCritical("Failed to present D3D11 swapchain.");
     }
+
+    // NOTE(milo): Uploads requested during this frame are recorded here, ahead of the next frame's draws.
+    UploadProcess(false);
+
+    State.Uniforms.Head = 0;
+    State.Uniforms.Discard = true;
+
+    State.Cache.LastFrame = State.Cache.Frame;
+    State.Cache.Frame = {};
 }
 
 bool VideoReady()
@@ -219,24 +538,66 @@ void VideoBegin()
     Viewport.MinDepth = 0.0f;
     Viewport.MaxDepth = 1.0f;
 
-    State.DeviceContext->RSSetViewports(1, &Viewport);
-    State.DeviceContext->OMSetRenderTargets(1, &State.SwapchainRenderTarget, NULL);
+    ContextBindTargets(State.SwapchainRenderTarget, NULL, &Viewport);
+    StateCacheInvalidateInputs();
 }
 
 void VideoDraw(u32 Count, u32 Start)
 {
-    State.DeviceContext->Draw(Count, Start);
+    ID3D11DeviceContext* Context = ContextCurrent();
+
+    Context->Draw(Count, Start);
 }
 
 void VideoDrawIndexed(u32 Count, u32 Start)
 {
-    State.DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    State.DeviceContext->DrawIndexed(Count, Start, 0);
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
+
+    if (StateCacheSet(&Cache->Topology, D3D11_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)) {
+        Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    }
+    Context->DrawIndexed(Count, Start, 0);
+}
+
+void VideoDrawIndexedIndirect(rhi_buffer* Args, u32 Offset)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
+    d3d11_buffer* Internal = (d3d11_buffer*)Args->Internal;
+
+    if (StateCacheSet(&Cache->Topology, D3D11_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)) {
+        Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    }
+    Context->DrawIndexedInstancedIndirect(Internal->Buffer, Offset);
+}
+
+// NOTE(milo): D3D11 has no multi draw, so this issues one indirect draw per record. The driver still skips records with no instances
+// without the CPU ever reading them.
+void VideoMultiDrawIndexedIndirect(rhi_buffer* Args, u32 DrawCount, u32 Offset)
+{
+    for (u32 DrawIndex = 0; DrawIndex < DrawCount; DrawIndex++) {
+        VideoDrawIndexedIndirect(Args, Offset + DrawIndex * sizeof(rhi_draw_indexed_args));
+    }
+}
+
+// NOTE(milo): StartInstance offsets the per instance streams, so batches can share one instance buffer.
+void VideoDrawIndexedInstanced(u32 Count, u32 InstanceCount, u32 Start, u32 StartInstance)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
+
+    if (StateCacheSet(&Cache->Topology, D3D11_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)) {
+        Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    }
+    Context->DrawIndexedInstanced(Count, InstanceCount, Start, 0, StartInstance);
 }
 
 void VideoDispatch(u32 X, u32 Y, u32 Z)
 {
-    State.DeviceContext->Dispatch(X, Y, Z);
+    ID3D11DeviceContext* Context = ContextCurrent();
+
+    Context->Dispatch(X, Y, Z);
 }
 
 void VideoBlitToSwapchain(rhi_texture* Texture)
@@ -265,23 +626,57 @@ void VideoImGuiEnd()
 		ImGui::UpdatePlatformWindows();
 		ImGui::RenderPlatformWindowsDefault();
 	}
+
+    // NOTE(milo): The ImGui backend binds behind the cache's back.
+    StateCacheInvalidate();
+}
+
+rhi_bind_stats VideoGetBindStats()
+{
+    return State.Cache.LastFrame;
+}
+
+// NOTE(milo): Forgotten entries hold a pointer nothing can match, so even binding NULL goes through.
+void StateCacheInvalidate()
+{
+    rhi_bind_stats Frame = State.Cache.Frame;
+    rhi_bind_stats LastFrame = State.Cache.LastFrame;
+    memset(&State.Cache, 0xFF, sizeof(State.Cache));
+    State.Cache.Frame = Frame;
+    State.Cache.LastFrame = LastFrame;
+}
+
+void StateCacheInvalidateInputs()
+{
+    d3d11_state_cache* Cache = CacheCurrent();
+    memset(Cache->SRVs, 0xFF, sizeof(Cache->SRVs));
+    memset(Cache->VertexBuffers, 0xFF, sizeof(Cache->VertexBuffers));
+    memset(&Cache->IndexBuffer, 0xFF, sizeof(Cache->IndexBuffer));
 }
 
-void BufferInit(rhi_buffer* Buffer, i64 Size, i64 Stride, rhi_buffer_usage Usage)
+void BufferInit(rhi_buffer* Buffer, i64 Size, i64 Stride, rhi_buffer_usage Usage, rhi_buffer_access Access)
 {
     Buffer->Stride = Stride;
     Buffer->Internal = new d3d11_buffer();
+    ((d3d11_buffer*)Buffer->Internal)->Size = (u64)Size;
+    ((d3d11_buffer*)Buffer->Internal)->Dynamic = Access == BufferAccess_Dynamic;
 
     D3D11_BUFFER_DESC BufferCreateInfo = {};
-    BufferCreateInfo.Usage = D3D11_USAGE_DEFAULT;
+    BufferCreateInfo.Usage = Access == BufferAccess_Dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
     BufferCreateInfo.ByteWidth = Size;
     BufferCreateInfo.BindFlags = BufferUsageToD3D11(Usage);
-    BufferCreateInfo.CPUAccessFlags = 0;
+    BufferCreateInfo.CPUAccessFlags = Access == BufferAccess_Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
     BufferCreateInfo.StructureByteStride = Stride;
     BufferCreateInfo.MiscFlags = 0;
     if (Usage == BufferUsage_Storage) {
         BufferCreateInfo.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
     }
+    if (Usage == BufferUsage_VertexStorage) {
+        BufferCreateInfo.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+    }
+    if (Usage == BufferUsage_Indirect) {
+        BufferCreateInfo.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+    }
 
     HRESULT Result = State.Device->CreateBuffer(&BufferCreateInfo, NULL, (ID3D11Buffer**)&((d3d11_buffer*)Buffer->Internal)->Buffer);
     if (FAILED(Result)) {
@@ -365,57 +760,156 @@ void BufferInitUAV(rhi_buffer* Buffer)
 
 void BufferUpload(rhi_buffer* Buffer, void* Data)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
+
+    if (Internal->Dynamic) {
+        BufferWrite(Buffer, Data, Internal->Size);
+        return;
+    }
+    Context->UpdateSubresource(Internal->Buffer, NULL, NULL, Data, NULL, NULL);
+}
+
+// NOTE(milo): Updates [Offset, Offset + Size) right away, for small dirty ranges that have to be visible to this frame's draws.
+void BufferUploadRange(rhi_buffer* Buffer, const void* Data, u64 Offset, u64 Size)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
+    assert(!Internal->Dynamic);
+    assert(Offset + Size <= Internal->Size);
+
+    D3D11_BOX Box = {};
+    Box.left = (u32)Offset;
+    Box.right = (u32)(Offset + Size);
+    Box.bottom = 1;
+    Box.back = 1;
+
+    // NOTE(milo): When the runtime emulates command lists it offsets the source by the box a second time, so undo it up front.
+    if (Recording && !State.DriverCommandLists) {
+        Data = (const u8*)Data - Box.left;
+    }
+    Context->UpdateSubresource(Internal->Buffer, 0, &Box, Data, 0, 0);
+}
+
+// NOTE(milo): Discard hands back fresh memory while the GPU keeps reading the old contents. No-overwrite keeps the contents, the caller
+// promises to only write ranges no draw in flight uses.
+void* BufferMap(rhi_buffer* Buffer, rhi_buffer_map Map)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
+    assert(Internal->Dynamic);
+
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    D3D11_MAP Type = Map == BufferMap_Discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    if (FAILED(Context->Map(Internal->Buffer, 0, Type, 0, &Mapped))) {
+        LogError("Failed to map dynamic buffer!");
+        return NULL;
+    }
+    return Mapped.pData;
+}
+
+void BufferUnmap(rhi_buffer* Buffer)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
     d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
+    Context->Unmap(Internal->Buffer, 0);
+}
 
-    State.DeviceContext->UpdateSubresource(Internal->Buffer, NULL, NULL, Data, NULL, NULL);
+void BufferWrite(rhi_buffer* Buffer, const void* Data, u64 Size)
+{
+    void* Mapped = BufferMap(Buffer, BufferMap_Discard);
+    if (Mapped) {
+        memcpy(Mapped, Data, Size);
+        BufferUnmap(Buffer);
+    }
 }
 
-void BufferBindVertex(rhi_buffer* Buffer)
+void BufferBindVertex(rhi_buffer* Buffer, u32 Slot)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
     d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
+    assert(Slot < RHI_MAX_VERTEX_STREAMS);
 
     u32 Stride = Buffer->Stride;
     u32 Offset = 0;
-    State.DeviceContext->IASetVertexBuffers(0, 1, &Internal->Buffer, &Stride, &Offset);
+    if (Cache->VertexBuffers[Slot] == Internal->Buffer && Cache->VertexStrides[Slot] == Stride) {
+        Cache->Frame.Filtered++;
+        return;
+    }
+    Cache->VertexBuffers[Slot] = Internal->Buffer;
+    Cache->VertexStrides[Slot] = Stride;
+    Cache->Frame.Issued++;
+    Context->IASetVertexBuffers(Slot, 1, &Internal->Buffer, &Stride, &Offset);
 }
 
 void BufferBindIndex(rhi_buffer* Buffer)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
     d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
-    State.DeviceContext->IASetIndexBuffer(Internal->Buffer, DXGI_FORMAT_R32_UINT, 0);
+    if (!StateCacheSet(&Cache->IndexBuffer, Internal->Buffer)) {
+        return;
+    }
+    Context->IASetIndexBuffer(Internal->Buffer, DXGI_FORMAT_R32_UINT, 0);
 }
 
 void BufferBindUniform(rhi_buffer* Buffer, i32 Binding, rhi_uniform_bind Bind)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
     d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
+    if (!StateCacheSetConstants(Bind, Binding, Internal->Buffer, 0, 0)) {
+        return;
+    }
 
     switch (Bind)
     {
         case UniformBind_Vertex: {
-            State.DeviceContext->VSSetConstantBuffers(Binding, 1, &Internal->Buffer);
+            Context->VSSetConstantBuffers(Binding, 1, &Internal->Buffer);
             break;
         }
         case UniformBind_Pixel: {
-            State.DeviceContext->PSSetConstantBuffers(Binding, 1, &Internal->Buffer);
+            Context->PSSetConstantBuffers(Binding, 1, &Internal->Buffer);
             break;
         }
         case UniformBind_Compute: {
-            State.DeviceContext->CSSetConstantBuffers(Binding, 1, &Internal->Buffer);
+            Context->CSSetConstantBuffers(Binding, 1, &Internal->Buffer);
             break;
         }
     }
 }
 
-void BufferBindSRV(rhi_buffer* Buffer, i32 Binding)
+void BufferBindSRV(rhi_buffer* Buffer, i32 Binding, rhi_uniform_bind Bind)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
     d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
-    State.DeviceContext->CSSetShaderResources(Binding, 1, &Internal->SRV);
+    if (!StateCacheSetSRV(Bind, Binding, Internal->SRV)) {
+        return;
+    }
+
+    switch (Bind)
+    {
+        case UniformBind_Vertex: {
+            Context->VSSetShaderResources(Binding, 1, &Internal->SRV);
+            break;
+        }
+        case UniformBind_Pixel: {
+            Context->PSSetShaderResources(Binding, 1, &Internal->SRV);
+            break;
+        }
+        case UniformBind_Compute: {
+            Context->CSSetShaderResources(Binding, 1, &Internal->SRV);
+            break;
+        }
+    }
 }
 
 void BufferBindUAV(rhi_buffer* Buffer, i32 Binding)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
     d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
-    State.DeviceContext->CSSetUnorderedAccessViews(Binding, 1, &Internal->UAV, NULL);
+    Context->CSSetUnorderedAccessViews(Binding, 1, &Internal->UAV, NULL);
+    StateCacheInvalidateInputs();
 }
 
 void* BufferGetData(rhi_buffer* Buffer)
@@ -446,201 +940,1054 @@ void* BufferGetData(rhi_buffer* Buffer)
     return NULL;
 }
 
-ID3DBlob* CompileBlob(std::string Source, const char* Profile)
-{
-    ID3DBlob* ShaderBlob;
-    ID3DBlob* ErrorBlob;
-    HRESULT Status = D3DCompile(Source.c_str(), Source.size(), NULL, NULL, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", Profile, 0, 0, &ShaderBlob, &ErrorBlob);
-    if (ErrorBlob)
-        LogCritical("Shader Error (profile: %s) : %s", Profile, (char*)ErrorBlob->GetBufferPointer());
-    return ShaderBlob;
-}
-
-void ShaderInit(rhi_shader* Shader, const char* V, const char* P, const char* C)
+void UniformInit()
 {
-    Shader->Internal = new d3d11_shader;
-    d3d11_shader* Internal = (d3d11_shader*)Shader->Internal;
-    ZeroMemory(Internal, sizeof(d3d11_shader));
+    d3d11_uniform_ring* Ring = &State.Uniforms;
+    Ring->Size = RHI_UNIFORM_RING_SIZE;
+    Ring->Head = 0;
+    Ring->Discard = true;
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS Options = {};
+    if (SUCCEEDED(State.DeviceContext->QueryInterface(IID_PPV_ARGS(&Ring->Context1))) &&
+        SUCCEEDED(State.Device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &Options, sizeof(Options)))) {
+        Ring->Offsetting = Options.ConstantBufferOffsetting && Options.MapNoOverwriteOnDynamicConstantBuffer;
+    }
 
-    ID3DBlob* VS = nullptr;
-    ID3DBlob* PS = nullptr;
-    ID3DBlob* CS = nullptr;
+    if (!Ring->Offsetting) {
+        LogWarn("Constant buffer offsetting is not supported, emulating the uniform ring.");
+        Ring->Shadow = (u8*)malloc(RHI_UNIFORM_RING_SIZE);
+        return;
+    }
 
-    if (V) {
-        VS = CompileBlob(PlatformReadFile(V), "vs_5_0");
-        if (FAILED(State.Device->CreateVertexShader(VS->GetBufferPointer(), VS->GetBufferSize(), NULL, &Internal->VS))) {
-            LogCritical("Failed to create vertex shader!");
-        }
+    D3D11_BUFFER_DESC Desc = {};
+    Desc.Usage = D3D11_USAGE_DYNAMIC;
+    Desc.ByteWidth = RHI_UNIFORM_RING_SIZE;
+    Desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    if (FAILED(State.Device->CreateBuffer(&Desc, NULL, &Ring->Buffer))) {
+        LogCritical("Failed to create uniform ring!");
     }
-    if (P) {
-        PS = CompileBlob(PlatformReadFile(P), "ps_5_0");
-        if (FAILED(State.Device->CreatePixelShader(PS->GetBufferPointer(), PS->GetBufferSize(), NULL, &Internal->PS))) {
-            LogCritical("Failed to create pixel shader!");
+}
+
+void UniformRingFree(d3d11_uniform_ring* Ring)
+{
+    for (u32 Stage = 0; Stage < 3; Stage++) {
+        for (u32 Slot = 0; Slot < D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT; Slot++) {
+            SafeRelease(Ring->Fallback[Stage][Slot]);
         }
     }
-    if (C) {
-        CS = CompileBlob(PlatformReadFile(C), "cs_5_0");
-        if (FAILED(State.Device->CreateComputeShader(CS->GetBufferPointer(), CS->GetBufferSize(), NULL, &Internal->CS))) {
-            LogCritical("Failed to create compute shader!");
+    if (Ring->Deferred) {
+        for (ID3D11Buffer* Page : Ring->Pages) {
+            SafeRelease(Page);
         }
+    } else {
+        SafeRelease(Ring->Buffer);
     }
+    SafeRelease(Ring->Context1);
+    free(Ring->Shadow);
+}
 
-    if (VS) {
-        ID3D11ShaderReflection* Reflect = NULL;
-        if (FAILED(D3DReflect(VS->GetBufferPointer(), VS->GetBufferSize(), IID_PPV_ARGS(&Reflect)))) {
-            LogCritical("Failed to reflect vertex shader!");
-        }
-
-        D3D11_SHADER_DESC ShaderDesc;
-        Reflect->GetDesc(&ShaderDesc);
+void UniformExit()
+{
+    UniformRingFree(&State.Uniforms);
+}
 
-        std::vector<D3D11_INPUT_ELEMENT_DESC> InputLayoutDesc;
-        for (u32 ParameterIndex = 0; ParameterIndex < ShaderDesc.InputParameters; ParameterIndex++)
-        {
-            D3D11_SIGNATURE_PARAMETER_DESC ParamDesc;
-            Reflect->GetInputParameterDesc(ParameterIndex, &ParamDesc);
+ID3D11Buffer* UniformCreateBuffer(u32 Size)
+{
+    D3D11_BUFFER_DESC Desc = {};
+    Desc.Usage = D3D11_USAGE_DYNAMIC;
+    Desc.ByteWidth = Size;
+    Desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    ID3D11Buffer* Buffer = NULL;
+    if (FAILED(State.Device->CreateBuffer(&Desc, NULL, &Buffer))) {
+        return NULL;
+    }
+    return Buffer;
+}
 
-            D3D11_INPUT_ELEMENT_DESC ElementDesc;
-            ElementDesc.SemanticName = ParamDesc.SemanticName;
-            ElementDesc.SemanticIndex = ParamDesc.SemanticIndex;
-            ElementDesc.InputSlot = 0;
-            ElementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-            ElementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-            ElementDesc.InstanceDataStepRate = 0;   
-
-            if (ParamDesc.Mask == 1)
-            {
-                if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) ElementDesc.Format = DXGI_FORMAT_R32_UINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) ElementDesc.Format = DXGI_FORMAT_R32_SINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) ElementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-            }
-            else if (ParamDesc.Mask <= 3)
-            {
-                if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) ElementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) ElementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) ElementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-            }
-            else if ( ParamDesc.Mask <= 7 )
-            {
-                if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) ElementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) ElementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) ElementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-            }
-            else if (ParamDesc.Mask <= 15)
-            {
-                if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) ElementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) ElementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-                else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) ElementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-            }
+u8* UniformShadow(d3d11_uniform_ring* Ring)
+{
+    return Ring->Shadow + (u64)Ring->Page * Ring->Size;
+}
 
-            InputLayoutDesc.push_back(ElementDesc);
+// NOTE(milo): Pages are kept across recordings, a list that needed more once will have them ready the next time.
+bool UniformNextPage(d3d11_uniform_ring* Ring)
+{
+    if (Ring->Page + 1 == Ring->PageCount) {
+        ID3D11Buffer* Buffer = NULL;
+        if (Ring->Offsetting && !(Buffer = UniformCreateBuffer(Ring->Size))) {
+            return false;
         }
 
-        if (FAILED(State.Device->CreateInputLayout(&InputLayoutDesc[0], (UINT)InputLayoutDesc.size(), VS->GetBufferPointer(), VS->GetBufferSize(), &Internal->InputLayout))) {
-            LogCritical("Failed to create input layout!");
+        u8* Shadow = (u8*)realloc(Ring->Shadow, (u64)(Ring->PageCount + 1) * Ring->Size);
+        if (!Shadow) {
+            SafeRelease(Buffer);
+            return false;
+        }
+        Ring->Shadow = Shadow;
+        Ring->PageCount++;
+        if (Buffer) {
+            Ring->Pages.push_back(Buffer);
         }
-
-        SafeRelease(Reflect);
     }
 
-    SafeRelease(CS);
-    SafeRelease(PS);
-    SafeRelease(VS);
+    Ring->Page++;
+    Ring->Head = 0;
+    if (Ring->Offsetting) {
+        Ring->Buffer = Ring->Pages[Ring->Page];
+    }
+    return true;
 }
 
-void ShaderFree(rhi_shader* Shader)
+// NOTE(milo): The ring is discarded on the first push of a frame and whenever it wraps, every other push appends with no-overwrite.
+rhi_uniform_slice UniformPush(const void* Data, u32 Size)
 {
-    d3d11_shader* Internal = (d3d11_shader*)Shader->Internal;
-    SafeRelease(Internal->InputLayout);
-    SafeRelease(Internal->CS);
-    SafeRelease(Internal->PS);
-    SafeRelease(Internal->VS);
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_uniform_ring* Ring = UniformsCurrent();
+    assert(Size <= D3D11_UNIFORM_MAX_SLICE);
+
+    u32 AlignedSize = (Size + D3D11_UNIFORM_ALIGNMENT - 1) & ~(D3D11_UNIFORM_ALIGNMENT - 1);
+    if (Ring->Head + AlignedSize > Ring->Size) {
+        if (!Ring->Deferred) {
+            Ring->Head = 0;
+            Ring->Discard = true;
+        } else if (!UniformNextPage(Ring)) {
+            LogError("Failed to grow command list uniforms, earlier draws in the list will read the wrong constants.");
+            Ring->Head = 0;
+        }
+    }
 
-    delete Shader->Internal;
-}
+    rhi_uniform_slice Slice;
+    Slice.Offset = Ring->Head;
+    Slice.Size = AlignedSize;
+    Ring->Head += AlignedSize;
 
-void ShaderBind(rhi_shader* Shader)
-{
-    d3d11_shader* Internal = (d3d11_shader*)Shader->Internal;
-    if (Internal->VS) State.DeviceContext->VSSetShader(Internal->VS, NULL, 0);
-    if (Internal->PS) State.DeviceContext->PSSetShader(Internal->PS, NULL, 0);
-    if (Internal->CS) State.DeviceContext->CSSetShader(Internal->CS, NULL, 0);
-    if (Internal->InputLayout) State.DeviceContext->IASetInputLayout(Internal->InputLayout);
+    if (!Ring->Offsetting || Ring->Deferred) {
+        memcpy(UniformShadow(Ring) + Slice.Offset, Data, Size);
+        return Slice;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    D3D11_MAP Type = Ring->Discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    if (FAILED(Context->Map(Ring->Buffer, 0, Type, 0, &Mapped))) {
+        LogError("Failed to map uniform ring!");
+        return Slice;
+    }
+    memcpy((u8*)Mapped.pData + Slice.Offset, Data, Size);
+    Context->Unmap(Ring->Buffer, 0);
+    Ring->Discard = false;
+
+    return Slice;
 }
 
-void SamplerInit(rhi_sampler* Sampler, rhi_sampler_address Address)
+ID3D11Buffer* UniformFallbackBuffer(rhi_uniform_slice Slice, i32 Binding, rhi_uniform_bind Bind)
 {
-    Sampler->Address = Address;
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_uniform_ring* Ring = UniformsCurrent();
+    ID3D11Buffer** Buffer = &Ring->Fallback[Bind][Binding];
+
+    if (!*Buffer) {
+        D3D11_BUFFER_DESC Desc = {};
+        Desc.Usage = D3D11_USAGE_DYNAMIC;
+        Desc.ByteWidth = D3D11_UNIFORM_MAX_SLICE;
+        Desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (FAILED(State.Device->CreateBuffer(&Desc, NULL, Buffer))) {
+            LogError("Failed to create uniform fallback buffer!");
+            return NULL;
+        }
+    }
 
-    D3D11_SAMPLER_DESC Desc = {};
-    Desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-    Desc.AddressU = SamplerAddressToD3D11(Address);
-    Desc.AddressV = Desc.AddressU;
-    Desc.AddressW = Desc.AddressU;
-    Desc.MipLODBias = 0.0f;
-    Desc.MaxAnisotropy = 1;
-    Desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-    Desc.MinLOD = 0.0f;
-    Desc.MaxLOD = D3D11_FLOAT32_MAX;
-    
-    if (FAILED(State.Device->CreateSamplerState(&Desc, (ID3D11SamplerState**)&Sampler->Internal))) {
-        LogCritical("Failed to create sampler state!");
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    if (SUCCEEDED(Context->Map(*Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped))) {
+        memcpy(Mapped.pData, UniformShadow(Ring) + Slice.Offset, Slice.Size);
+        Context->Unmap(*Buffer, 0);
     }
+    return *Buffer;
 }
 
-void SamplerFree(rhi_sampler* Sampler)
+void UniformBindSlice(rhi_uniform_slice Slice, i32 Binding, rhi_uniform_bind Bind)
 {
-    ((ID3D11SamplerState*)Sampler->Internal)->Release();
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_uniform_ring* Ring = UniformsCurrent();
+
+    if (!Ring->Offsetting) {
+        ID3D11Buffer* Buffer = UniformFallbackBuffer(Slice, Binding, Bind);
+        if (!StateCacheSetConstants(Bind, Binding, Buffer, 0, 0)) {
+            return;
+        }
+        switch (Bind)
+        {
+            case UniformBind_Vertex: Context->VSSetConstantBuffers(Binding, 1, &Buffer); break;
+            case UniformBind_Pixel: Context->PSSetConstantBuffers(Binding, 1, &Buffer); break;
+            case UniformBind_Compute: Context->CSSetConstantBuffers(Binding, 1, &Buffer); break;
+        }
+        return;
+    }
+
+    // NOTE(milo): Offsets and counts are in 16 byte constants, slices are already aligned to the 256 bytes the API asks for.
+    u32 FirstConstant = Slice.Offset / 16;
+    u32 ConstantCount = Slice.Size / 16;
+    if (!StateCacheSetConstants(Bind, Binding, Ring->Buffer, FirstConstant, ConstantCount)) {
+        return;
+    }
+    switch (Bind)
+    {
+        case UniformBind_Vertex: Ring->Context1->VSSetConstantBuffers1(Binding, 1, &Ring->Buffer, &FirstConstant, &ConstantCount); break;
+        case UniformBind_Pixel: Ring->Context1->PSSetConstantBuffers1(Binding, 1, &Ring->Buffer, &FirstConstant, &ConstantCount); break;
+        case UniformBind_Compute: Ring->Context1->CSSetConstantBuffers1(Binding, 1, &Ring->Buffer, &FirstConstant, &ConstantCount); break;
+    }
+}
+
+void CommandListInit(rhi_command_list* List)
+{
+    d3d11_command_list* Internal = new d3d11_command_list();
+    List->Internal = Internal;
+
+    if (FAILED(State.Device->CreateDeferredContext(0, &Internal->Context))) {
+        LogCritical("Failed to create D3D11 deferred context!");
+        return;
+    }
+
+    d3d11_uniform_ring* Ring = &Internal->Uniforms;
+    Ring->Offsetting = State.Uniforms.Offsetting;
+    Ring->Deferred = true;
+    Ring->Size = RHI_COMMAND_LIST_UNIFORM_SIZE;
+    Ring->Shadow = (u8*)malloc(Ring->Size);
+    Ring->Page = 0;
+    Ring->PageCount = 1;
+    if (!Ring->Offsetting) {
+        return;
+    }
+
+    Internal->Context->QueryInterface(IID_PPV_ARGS(&Ring->Context1));
+
+    Ring->Buffer = UniformCreateBuffer(Ring->Size);
+    if (!Ring->Buffer) {
+        LogCritical("Failed to create command list uniform buffer!");
+        return;
+    }
+    Ring->Pages.push_back(Ring->Buffer);
+}
+
+void CommandListFree(rhi_command_list* List)
+{
+    d3d11_command_list* Internal = (d3d11_command_list*)List->Internal;
+    if (!Internal) {
+        return;
+    }
+
+    SafeRelease(Internal->Commands);
+    UniformRingFree(&Internal->Uniforms);
+    SafeRelease(Internal->Context);
+    delete Internal;
+    List->Internal = NULL;
+}
+
+// NOTE(milo): A deferred context starts every recording from the default state, so the list's cache starts out knowing nothing.
+void CommandListBegin(rhi_command_list* List)
+{
+    d3d11_command_list* Internal = (d3d11_command_list*)List->Internal;
+    assert(!Recording);
+
+    memset(&Internal->Cache, 0xFF, sizeof(Internal->Cache));
+    Internal->Cache.Frame = {};
+    Internal->Uniforms.Head = 0;
+    Internal->Uniforms.Page = 0;
+    if (!Internal->Uniforms.Pages.empty()) {
+        Internal->Uniforms.Buffer = Internal->Uniforms.Pages[0];
+    }
+    Recording = Internal;
+
+    ContextBindTargets(State.Targets.RTV, State.Targets.DSV, &State.Targets.Viewport);
+}
+
+void CommandListEnd(rhi_command_list* List)
+{
+    d3d11_command_list* Internal = (d3d11_command_list*)List->Internal;
+    assert(Recording == Internal);
+
+    SafeRelease(Internal->Commands);
+    Internal->Commands = NULL;
+    if (FAILED(Internal->Context->FinishCommandList(FALSE, &Internal->Commands))) {
+        LogError("Failed to finish command list!");
+        Internal->Commands = NULL;
+    }
+    Recording = NULL;
+}
+
+// NOTE(milo): The list's uniforms are written right before it runs. Executing without restoring state leaves the immediate context
+// cleared, so the cache is forgotten and the targets are bound again.
+void CommandListSubmit(rhi_command_list* List)
+{
+    d3d11_command_list* Internal = (d3d11_command_list*)List->Internal;
+    assert(!Recording);
+    if (!Internal->Commands) {
+        return;
+    }
+
+    // NOTE(milo): Every page before the current one was filled up to where the next push no longer fit.
+    d3d11_uniform_ring* Ring = &Internal->Uniforms;
+    for (u32 Page = 0; Ring->Offsetting && Page <= Ring->Page; Page++) {
+        u32 Used = Page < Ring->Page ? Ring->Size : Ring->Head;
+        if (Used == 0) {
+            continue;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE Mapped;
+        if (SUCCEEDED(State.DeviceContext->Map(Ring->Pages[Page], 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped))) {
+            memcpy(Mapped.pData, Ring->Shadow + (u64)Page * Ring->Size, Used);
+            State.DeviceContext->Unmap(Ring->Pages[Page], 0);
+        } else {
+            LogError("Failed to map command list uniform buffer!");
+        }
+    }
+
+    State.DeviceContext->ExecuteCommandList(Internal->Commands, FALSE);
+    Internal->Commands->Release();
+    Internal->Commands = NULL;
+
+    State.Cache.Frame.Issued += Internal->Cache.Frame.Issued;
+    State.Cache.Frame.Filtered += Internal->Cache.Frame.Filtered;
+    StateCacheInvalidate();
+    ContextBindTargets(State.Targets.RTV, State.Targets.DSV, &State.Targets.Viewport);
+}
+
+bool UploadFenceDone(ID3D11Query* Fence, bool Wait)
+{
+    HRESULT Result;
+    while ((Result = State.DeviceContext->GetData(Fence, NULL, 0, Wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH)) == S_FALSE && Wait) {
+        YieldProcessor();
+    }
+    return Result == S_OK;
+}
+
+void UploadInit()
+{
+    d3d11_uploader* Upload = &State.Upload;
+    Upload->CurrentChunk = 0;
+    Upload->NextTicket = 1;
+    Upload->CompletedTicket = 0;
+    Upload->BudgetBytes = RHI_UPLOAD_DEFAULT_BUDGET;
+    Upload->BudgetMilliseconds = RHI_UPLOAD_DEFAULT_MILLISECONDS;
+    Upload->BytesThisFrame = 0;
+    Upload->RingStalls = 0;
+
+    D3D11_BUFFER_DESC Desc = {};
+    Desc.Usage = D3D11_USAGE_STAGING;
+    Desc.ByteWidth = D3D11_UPLOAD_CHUNK_SIZE;
+    Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    D3D11_QUERY_DESC QueryDesc = {};
+    QueryDesc.Query = D3D11_QUERY_EVENT;
+
+    for (u32 ChunkIndex = 0; ChunkIndex < D3D11_UPLOAD_CHUNK_COUNT; ChunkIndex++) {
+        d3d11_upload_chunk* Chunk = &Upload->Chunks[ChunkIndex];
+        Chunk->Mapped = NULL;
+        Chunk->Used = 0;
+        Chunk->InFlight = false;
+
+        if (FAILED(State.Device->CreateBuffer(&Desc, NULL, &Chunk->Staging)) || FAILED(State.Device->CreateQuery(&QueryDesc, &Chunk->Fence))) {
+            LogCritical("Failed to create upload staging ring!");
+        }
+    }
+}
+
+void UploadExit()
+{
+    UploadFlush();
+
+    d3d11_uploader* Upload = &State.Upload;
+    for (u32 ChunkIndex = 0; ChunkIndex < D3D11_UPLOAD_CHUNK_COUNT; ChunkIndex++) {
+        SafeRelease(Upload->Chunks[ChunkIndex].Fence);
+        SafeRelease(Upload->Chunks[ChunkIndex].Staging);
+    }
+    for (d3d11_staging_texture& Staging : Upload->StagingTextures) {
+        SafeRelease(Staging.Fence);
+        SafeRelease(Staging.Texture);
+    }
+    Upload->StagingTextures.clear();
+}
+
+bool UploadChunkReady(d3d11_upload_chunk* Chunk, bool Wait)
+{
+    if (Chunk->InFlight) {
+        if (!UploadFenceDone(Chunk->Fence, Wait)) {
+            return false;
+        }
+        Chunk->InFlight = false;
+        Chunk->Used = 0;
+    }
+
+    if (!Chunk->Mapped) {
+        D3D11_MAPPED_SUBRESOURCE Mapped;
+        if (FAILED(State.DeviceContext->Map(Chunk->Staging, 0, D3D11_MAP_WRITE, 0, &Mapped))) {
+            LogError("Failed to map upload staging chunk!");
+            return false;
+        }
+        Chunk->Mapped = (u8*)Mapped.pData;
+    }
+    return true;
+}
+
+// NOTE(milo): Copies can only be recorded once the chunk is unmapped, so they are batched per chunk and issued together.
+void UploadChunkSubmit()
+{
+    d3d11_uploader* Upload = &State.Upload;
+    d3d11_upload_chunk* Chunk = &Upload->Chunks[Upload->CurrentChunk];
+    if (!Chunk->Mapped) {
+        return;
+    }
+
+    State.DeviceContext->Unmap(Chunk->Staging, 0);
+    Chunk->Mapped = NULL;
+
+    if (Upload->ChunkCopies.empty()) {
+        return;
+    }
+
+    for (d3d11_chunk_copy& Copy : Upload->ChunkCopies) {
+        D3D11_BOX Box = { (UINT)Copy.SourceOffset, 0, 0, (UINT)(Copy.SourceOffset + Copy.Size), 1, 1 };
+        State.DeviceContext->CopySubresourceRegion(Copy.Destination, 0, (UINT)Copy.DestinationOffset, 0, 0, Chunk->Staging, 0, &Box);
+        Copy.Destination->Release();
+    }
+    Upload->ChunkCopies.clear();
+
+    State.DeviceContext->End(Chunk->Fence);
+    Chunk->InFlight = true;
+    Upload->CurrentChunk = (Upload->CurrentChunk + 1) % D3D11_UPLOAD_CHUNK_COUNT;
+}
+
+bool UploadProcessBuffer(d3d11_upload* Item, u64 Budget, bool Flush)
+{
+    d3d11_uploader* Upload = &State.Upload;
+
+    // NOTE(milo): Large buffers are split over as many chunks and frames as they need.
+    while (Item->Done < Item->Data.size()) {
+        d3d11_upload_chunk* Chunk = &Upload->Chunks[Upload->CurrentChunk];
+        if (!UploadChunkReady(Chunk, Flush)) {
+            Upload->RingStalls++;
+            return false;
+        }
+
+        u64 Space = D3D11_UPLOAD_CHUNK_SIZE - Chunk->Used;
+        if (Space == 0) {
+            UploadChunkSubmit();
+            continue;
+        }
+
+        u64 Count = Item->Data.size() - Item->Done;
+        Count = Count < Space ? Count : Space;
+        Count = Count < Budget ? Count : Budget;
+        if (Count == 0) {
+            return false;
+        }
+
+        memcpy(Chunk->Mapped + Chunk->Used, Item->Data.data() + Item->Done, Count);
+
+        d3d11_chunk_copy Copy;
+        Copy.Destination = Item->Buffer;
+        Copy.Destination->AddRef();
+        Copy.DestinationOffset = Item->Offset + Item->Done;
+        Copy.SourceOffset = Chunk->Used;
+        Copy.Size = Count;
+        Upload->ChunkCopies.push_back(Copy);
+
+        Chunk->Used += Count;
+        Item->Done += Count;
+        Upload->BytesThisFrame += Count;
+        Budget -= Count;
+    }
+
+    return true;
+}
+
+d3d11_staging_texture* UploadAcquireStagingTexture(DXGI_FORMAT Format, u32 Width, u32 Height, bool Flush)
+{
+    d3d11_uploader* Upload = &State.Upload;
+
+    d3d11_staging_texture* Idle = NULL;
+    for (d3d11_staging_texture& Staging : Upload->StagingTextures) {
+        if (Staging.InFlight && UploadFenceDone(Staging.Fence, false)) {
+            Staging.InFlight = false;
+        }
+        if (!Staging.InFlight) {
+            if (Staging.Format == Format && Staging.Width == Width && Staging.Height == Height) {
+                return &Staging;
+            }
+            Idle = Idle ? Idle : &Staging;
+        }
+    }
+
+    if (Upload->StagingTextures.size() >= D3D11_UPLOAD_MAX_STAGING_TEXTURES) {
+        if (!Idle && Flush) {
+            Idle = &Upload->StagingTextures[0];
+            UploadFenceDone(Idle->Fence, true);
+            Idle->InFlight = false;
+        }
+        if (!Idle) {
+            return NULL;
+        }
+
+        // NOTE(milo): The pool is full, recycle an idle texture of another size.
+        SafeRelease(Idle->Texture);
+        SafeRelease(Idle->Fence);
+        *Idle = Upload->StagingTextures.back();
+        Upload->StagingTextures.pop_back();
+    }
+
+    d3d11_staging_texture Staging = {};
+    Staging.Format = Format;
+    Staging.Width = Width;
+    Staging.Height = Height;
+
+    D3D11_TEXTURE2D_DESC Desc = {};
+    Desc.Width = Width;
+    Desc.Height = Height;
+    Desc.MipLevels = 1;
+    Desc.ArraySize = 1;
+    Desc.Format = Format;
+    Desc.SampleDesc.Count = 1;
+    Desc.Usage = D3D11_USAGE_STAGING;
+    Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    D3D11_QUERY_DESC QueryDesc = {};
+    QueryDesc.Query = D3D11_QUERY_EVENT;
+
+    if (FAILED(State.Device->CreateTexture2D(&Desc, NULL, &Staging.Texture)) || FAILED(State.Device->CreateQuery(&QueryDesc, &Staging.Fence))) {
+        LogError("Failed to create staging texture!");
+        SafeRelease(Staging.Texture);
+        return NULL;
+    }
+
+    Upload->StagingTextures.push_back(Staging);
+    return &Upload->StagingTextures.back();
+}
+
+bool UploadProcessTexture(d3d11_upload* Item, bool Flush)
+{
+    d3d11_uploader* Upload = &State.Upload;
+    u32 Rows = (u32)(Item->Data.size() / Item->Pitch);
+
+    // NOTE(milo): Block compressed levels smaller than a block cannot live in a staging texture of their own, they are tiny anyway.
+    bool Compressed = (Item->Format >= DXGI_FORMAT_BC1_TYPELESS && Item->Format <= DXGI_FORMAT_BC5_SNORM) || (Item->Format >= DXGI_FORMAT_BC6H_TYPELESS && Item->Format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+    if (Compressed && ((Item->Width % 4) != 0 || (Item->Height % 4) != 0)) {
+        State.DeviceContext->UpdateSubresource(Item->Texture, Item->Subresource, NULL, Item->Data.data(), Item->Pitch, (UINT)Item->Data.size());
+        Upload->BytesThisFrame += Item->Data.size();
+        return true;
+    }
+
+    d3d11_staging_texture* Staging = UploadAcquireStagingTexture(Item->Format, Item->Width, Item->Height, Flush);
+    if (!Staging) {
+        Upload->RingStalls++;
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE Mapped;
+    if (FAILED(State.DeviceContext->Map(Staging->Texture, 0, D3D11_MAP_WRITE, 0, &Mapped))) {
+        LogError("Failed to map staging texture!");
+        return false;
+    }
+
+    for (u32 Row = 0; Row < Rows; Row++) {
+        memcpy((u8*)Mapped.pData + Row * Mapped.RowPitch, Item->Data.data() + Row * Item->Pitch, Item->Pitch);
+    }
+    State.DeviceContext->Unmap(Staging->Texture, 0);
+
+    State.DeviceContext->CopySubresourceRegion(Item->Texture, Item->Subresource, 0, 0, 0, Staging->Texture, 0, NULL);
+    State.DeviceContext->End(Staging->Fence);
+    Staging->InFlight = true;
+
+    Upload->BytesThisFrame += Item->Data.size();
+    return true;
+}
+
+u64 UploadTexture(ID3D11Texture2D* Texture, u32 Subresource, DXGI_FORMAT Format, u32 Width, u32 Height, const void* Data, u32 Pitch, u32 Size)
+{
+    d3d11_uploader* Upload = &State.Upload;
+
+    d3d11_upload Item = {};
+    Item.Ticket = Upload->NextTicket++;
+    Item.Data.assign((const u8*)Data, (const u8*)Data + Size);
+    Item.Texture = Texture;
+    Item.Texture->AddRef();
+    Item.Subresource = Subresource;
+    Item.Format = Format;
+    Item.Width = Width;
+    Item.Height = Height;
+    Item.Pitch = Pitch;
+    Upload->Queue.push_back(std::move(Item));
+    return Upload->Queue.back().Ticket;
+}
+
+void UploadSwapTexture(d3d11_texture* Internal, ID3D11Texture2D* Texture, ID3D11ShaderResourceView* SRV, bool GenerateMips);
+
+void UploadProcess(bool Flush)
+{
+    d3d11_uploader* Upload = &State.Upload;
+    f32 Start = PlatformTimerGet();
+    Upload->BytesThisFrame = 0;
+
+    while (!Upload->Queue.empty()) {
+        if (!Flush && Upload->BytesThisFrame > 0) {
+            f32 Milliseconds = (PlatformTimerGet() - Start) * 1000.0f;
+            if (Upload->BytesThisFrame >= Upload->BudgetBytes || Milliseconds >= Upload->BudgetMilliseconds) {
+                break;
+            }
+        }
+
+        d3d11_upload* Item = &Upload->Queue.front();
+        u64 Budget = Flush ? ~0ull : Upload->BudgetBytes - Upload->BytesThisFrame;
+        bool Done = Item->Buffer ? UploadProcessBuffer(Item, Budget, Flush) : UploadProcessTexture(Item, Flush);
+        if (!Done) {
+            break;
+        }
+
+        SafeRelease(Item->Buffer);
+        SafeRelease(Item->Texture);
+        Upload->CompletedTicket = Item->Ticket;
+        Upload->Queue.pop_front();
+    }
+
+    UploadChunkSubmit();
+
+    for (u32 PendingIndex = 0; PendingIndex < Upload->PendingTextures.size();) {
+        d3d11_pending_texture* Pending = &Upload->PendingTextures[PendingIndex];
+        if (Pending->Ticket > Upload->CompletedTicket) {
+            PendingIndex++;
+            continue;
+        }
+
+        UploadSwapTexture(Pending->Internal, Pending->Texture, Pending->SRV, Pending->GenerateMips);
+        Upload->PendingTextures[PendingIndex] = Upload->PendingTextures.back();
+        Upload->PendingTextures.pop_back();
+    }
+}
+
+u64 UploadBuffer(rhi_buffer* Buffer, const void* Data, u64 Offset, u64 Size)
+{
+    d3d11_uploader* Upload = &State.Upload;
+    d3d11_buffer* Internal = (d3d11_buffer*)Buffer->Internal;
+    assert(!Internal->Dynamic);
+
+    d3d11_upload Item = {};
+    Item.Ticket = Upload->NextTicket++;
+    Item.Data.assign((const u8*)Data, (const u8*)Data + Size);
+    Item.Buffer = Internal->Buffer;
+    Item.Buffer->AddRef();
+    Item.Offset = Offset;
+    Upload->Queue.push_back(std::move(Item));
+    return Upload->Queue.back().Ticket;
+}
+
+bool UploadIsDone(u64 Ticket)
+{
+    return Ticket <= State.Upload.CompletedTicket;
+}
+
+void UploadFlush()
+{
+    UploadProcess(true);
+}
+
+void UploadSetBudget(u64 Bytes, f32 Milliseconds)
+{
+    State.Upload.BudgetBytes = Bytes > 0 ? Bytes : 1;
+    State.Upload.BudgetMilliseconds = Milliseconds;
+}
+
+rhi_upload_stats UploadGetStats()
+{
+    d3d11_uploader* Upload = &State.Upload;
+
+    rhi_upload_stats Stats = {};
+    Stats.BudgetBytes = Upload->BudgetBytes;
+    Stats.BytesThisFrame = Upload->BytesThisFrame;
+    Stats.PendingUploads = (u32)Upload->Queue.size();
+    Stats.StagingTextures = (u32)Upload->StagingTextures.size();
+    Stats.RingStalls = Upload->RingStalls;
+    for (d3d11_upload& Item : Upload->Queue) {
+        Stats.PendingBytes += Item.Data.size() - Item.Done;
+    }
+    return Stats;
+}
+
+std::string ShaderReadSource(const char* Path)
+{
+    u64 Size;
+    char* Data = (char*)PackReadFile(Path, &Size);
+    if (!Data) {
+        LogError("Failed to open file: %s", Path);
+        return "";
+    }
+    std::string Source(Data, Size);
+    free(Data);
+    return Source;
+}
+
+// NOTE(milo): Errors from async builds are only logged, a broken shader mid game leaves its pipelines on their fallback.
+ID3DBlob* CompileBlob(std::string Source, const char* Profile, const std::vector<shader_define>& Defines, bool Async)
+{
+    std::vector<D3D_SHADER_MACRO> Macros;
+    for (const shader_define& Define : Defines) {
+        Macros.push_back({ Define.Name.c_str(), Define.Value.c_str() });
+    }
+    Macros.push_back({ NULL, NULL });
+
+    ID3DBlob* ShaderBlob = NULL;
+    ID3DBlob* ErrorBlob = NULL;
+    HRESULT Status = D3DCompile(Source.c_str(), Source.size(), NULL, Macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", Profile, 0, 0, &ShaderBlob, &ErrorBlob);
+    if (ErrorBlob && Async)
+        LogError("Shader Error (profile: %s) : %s", Profile, (char*)ErrorBlob->GetBufferPointer());
+    else if (ErrorBlob)
+        LogCritical("Shader Error (profile: %s) : %s", Profile, (char*)ErrorBlob->GetBufferPointer());
+    SafeRelease(ErrorBlob);
+    return ShaderBlob;
+}
+
+void ShaderReflectInputs(ID3DBlob* Blob, std::vector<shader_input_element>* Elements)
+{
+    ID3D11ShaderReflection* Reflect = NULL;
+    if (FAILED(D3DReflect(Blob->GetBufferPointer(), Blob->GetBufferSize(), IID_PPV_ARGS(&Reflect)))) {
+        LogCritical("Failed to reflect vertex shader!");
+        return;
+    }
+
+    D3D11_SHADER_DESC ShaderDesc;
+    Reflect->GetDesc(&ShaderDesc);
+
+    for (u32 ParameterIndex = 0; ParameterIndex < ShaderDesc.InputParameters; ParameterIndex++)
+    {
+        D3D11_SIGNATURE_PARAMETER_DESC ParamDesc;
+        Reflect->GetInputParameterDesc(ParameterIndex, &ParamDesc);
+
+        shader_input_element Element = {};
+        strncpy(Element.SemanticName, ParamDesc.SemanticName, SHADER_CACHE_MAX_SEMANTIC - 1);
+        Element.SemanticIndex = ParamDesc.SemanticIndex;
+        Element.Format = TextureFormat_Unknown;
+
+        if (ParamDesc.Mask == 1)
+        {
+            if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) Element.Format = TextureFormat_R32_Uint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) Element.Format = TextureFormat_R32_Sint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) Element.Format = TextureFormat_R32_Float;
+        }
+        else if (ParamDesc.Mask <= 3)
+        {
+            if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) Element.Format = TextureFormat_R32G32_Uint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) Element.Format = TextureFormat_R32G32_Sint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) Element.Format = TextureFormat_R32G32_Float;
+        }
+        else if ( ParamDesc.Mask <= 7 )
+        {
+            if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) Element.Format = TextureFormat_R32G32B32_Uint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) Element.Format = TextureFormat_R32G32B32_Sint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) Element.Format = TextureFormat_R32G32B32_Float;
+        }
+        else if (ParamDesc.Mask <= 15)
+        {
+            if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) Element.Format = TextureFormat_R32G32B32A32_Uint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) Element.Format = TextureFormat_R32G32B32A32_Sint;
+            else if (ParamDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) Element.Format = TextureFormat_R32G32B32A32_Float;
+        }
+
+        Elements->push_back(Element);
+    }
+
+    SafeRelease(Reflect);
+}
+
+// NOTE(milo): Takes the stage from the shader cache when its key matches, otherwise compiles and reflects it and stores the result.
+bool ShaderLoadStage(const char* Path, const char* Profile, const std::vector<shader_define>& Defines, shader_cache_entry* Entry, bool Async)
+{
+    u64 Key;
+    bool Keyed = ShaderCacheKey(Path, Profile, "main", Defines, &Key);
+    if (Keyed && ShaderCacheLoad(Key, Entry)) {
+        return true;
+    }
+
+    ID3DBlob* Blob = CompileBlob(ShaderReadSource(Path), Profile, Defines, Async);
+    if (!Blob) {
+        return false;
+    }
+
+    u8* Bytecode = (u8*)Blob->GetBufferPointer();
+    Entry->Bytecode.assign(Bytecode, Bytecode + Blob->GetBufferSize());
+    if (Profile[0] == 'v') {
+        ShaderReflectInputs(Blob, &Entry->InputElements);
+    }
+    SafeRelease(Blob);
+
+    if (Keyed) {
+        ShaderCacheStore(Key, *Entry);
+    }
+    return true;
+}
+
+// NOTE(milo): Device object creation is free threaded, so this runs the same on the calling thread and on a worker.
+bool ShaderBuild(d3d11_shader* Internal, const char* V, const char* P, const char* C, const std::vector<shader_define>& Defines, bool Async)
+{
+    shader_cache_entry VS;
+    shader_cache_entry PS;
+    shader_cache_entry CS;
+
+    bool Success = true;
+    if (V && !ShaderLoadStage(V, "vs_5_0", Defines, &VS, Async)) Success = false;
+    if (P && !ShaderLoadStage(P, "ps_5_0", Defines, &PS, Async)) Success = false;
+    if (C && !ShaderLoadStage(C, "cs_5_0", Defines, &CS, Async)) Success = false;
+    if (!Success) {
+        return false;
+    }
+
+    if (V) {
+        if (FAILED(State.Device->CreateVertexShader(VS.Bytecode.data(), VS.Bytecode.size(), NULL, &Internal->VS))) {
+            LogCritical("Failed to create vertex shader!");
+        }
+    }
+    if (P) {
+        if (FAILED(State.Device->CreatePixelShader(PS.Bytecode.data(), PS.Bytecode.size(), NULL, &Internal->PS))) {
+            LogCritical("Failed to create pixel shader!");
+        }
+    }
+    if (C) {
+        if (FAILED(State.Device->CreateComputeShader(CS.Bytecode.data(), CS.Bytecode.size(), NULL, &Internal->CS))) {
+            LogCritical("Failed to create compute shader!");
+        }
+    }
+
+    // NOTE(milo): System values are generated by the input assembler and have no place in the layout.
+    if (Internal->VS && !VS.InputElements.empty()) {
+        std::vector<D3D11_INPUT_ELEMENT_DESC> InputLayoutDesc;
+        for (shader_input_element& Element : VS.InputElements) {
+            if (strncmp(Element.SemanticName, "SV_", 3) == 0) {
+                continue;
+            }
+            bool Instance = strncmp(Element.SemanticName, RHI_INSTANCE_SEMANTIC, strlen(RHI_INSTANCE_SEMANTIC)) == 0;
+
+            D3D11_INPUT_ELEMENT_DESC ElementDesc;
+            ElementDesc.SemanticName = Element.SemanticName;
+            ElementDesc.SemanticIndex = Element.SemanticIndex;
+            ElementDesc.Format = (DXGI_FORMAT)Element.Format;
+            ElementDesc.InputSlot = Instance ? RHI_INSTANCE_SLOT : 0;
+            ElementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+            ElementDesc.InputSlotClass = Instance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+            ElementDesc.InstanceDataStepRate = Instance ? 1 : 0;
+            InputLayoutDesc.push_back(ElementDesc);
+        }
+
+        if (!InputLayoutDesc.empty() && FAILED(State.Device->CreateInputLayout(&InputLayoutDesc[0], (UINT)InputLayoutDesc.size(), VS.Bytecode.data(), VS.Bytecode.size(), &Internal->InputLayout))) {
+            LogCritical("Failed to create input layout!");
+        }
+    }
+
+    return (!V || Internal->VS) && (!P || Internal->PS) && (!C || Internal->CS);
+}
+
+void ShaderBuildJob(void* Data)
+{
+    d3d11_shader_job* Job = (d3d11_shader_job*)Data;
+
+    const char* V = Job->V.empty() ? NULL : Job->V.c_str();
+    const char* P = Job->P.empty() ? NULL : Job->P.c_str();
+    const char* C = Job->C.empty() ? NULL : Job->C.c_str();
+    Job->Internal->Failed = !ShaderBuild(Job->Internal, V, P, C, Job->Defines, true);
+
+    delete Job;
+}
+
+std::vector<shader_define> ShaderDefines(const rhi_shader_define* Defines, u32 DefineCount)
+{
+    std::vector<shader_define> Result;
+    for (u32 DefineIndex = 0; DefineIndex < DefineCount; DefineIndex++) {
+        Result.push_back({ Defines[DefineIndex].Name, Defines[DefineIndex].Value ? Defines[DefineIndex].Value : "1" });
+    }
+    return Result;
+}
+
+void ShaderInit(rhi_shader* Shader, const char* V, const char* P, const char* C, const rhi_shader_define* Defines, u32 DefineCount)
+{
+    d3d11_shader* Internal = new d3d11_shader();
+    Shader->Internal = Internal;
+    Internal->Failed = !ShaderBuild(Internal, V, P, C, ShaderDefines(Defines, DefineCount), false);
+}
+
+void ShaderInitAsync(rhi_shader* Shader, const char* V, const char* P, const char* C, const rhi_shader_define* Defines, u32 DefineCount)
+{
+    d3d11_shader* Internal = new d3d11_shader();
+    Shader->Internal = Internal;
+
+    d3d11_shader_job* Job = new d3d11_shader_job;
+    Job->Internal = Internal;
+    Job->V = V ? V : "";
+    Job->P = P ? P : "";
+    Job->C = C ? C : "";
+    Job->Defines = ShaderDefines(Defines, DefineCount);
+    JobSubmit(ShaderBuildJob, Job, &Internal->Counter);
+}
+
+bool ShaderIsReady(rhi_shader* Shader)
+{
+    d3d11_shader* Internal = (d3d11_shader*)Shader->Internal;
+    return JobIsDone(&Internal->Counter) && !Internal->Failed;
+}
+
+bool ShaderWait(rhi_shader* Shader)
+{
+    d3d11_shader* Internal = (d3d11_shader*)Shader->Internal;
+    JobWait(&Internal->Counter);
+    return !Internal->Failed;
+}
+
+void ShaderFree(rhi_shader* Shader)
+{
+    d3d11_shader* Internal = (d3d11_shader*)Shader->Internal;
+    JobWait(&Internal->Counter);
+    SafeRelease(Internal->InputLayout);
+    SafeRelease(Internal->CS);
+    SafeRelease(Internal->PS);
+    SafeRelease(Internal->VS);
+
+    delete Shader->Internal;
+}
+
+void ShaderBind(rhi_shader* Shader)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
+    d3d11_shader* Internal = (d3d11_shader*)Shader->Internal;
+    if (!ShaderIsReady(Shader)) {
+        return;
+    }
+
+    if (Internal->VS && StateCacheSet(&Cache->VS, Internal->VS)) Context->VSSetShader(Internal->VS, NULL, 0);
+    if (Internal->PS && StateCacheSet(&Cache->PS, Internal->PS)) Context->PSSetShader(Internal->PS, NULL, 0);
+    if (Internal->CS && StateCacheSet(&Cache->CS, Internal->CS)) Context->CSSetShader(Internal->CS, NULL, 0);
+    if (Internal->InputLayout && StateCacheSet(&Cache->InputLayout, Internal->InputLayout)) Context->IASetInputLayout(Internal->InputLayout);
+}
+
+void SamplerInit(rhi_sampler* Sampler, rhi_sampler_address Address)
+{
+    Sampler->Address = Address;
+
+    D3D11_SAMPLER_DESC Desc = {};
+    Desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    Desc.AddressU = SamplerAddressToD3D11(Address);
+    Desc.AddressV = Desc.AddressU;
+    Desc.AddressW = Desc.AddressU;
+    Desc.MipLODBias = 0.0f;
+    Desc.MaxAnisotropy = 1;
+    Desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+    Desc.MinLOD = 0.0f;
+    Desc.MaxLOD = D3D11_FLOAT32_MAX;
+    
+    if (FAILED(State.Device->CreateSamplerState(&Desc, (ID3D11SamplerState**)&Sampler->Internal))) {
+        LogCritical("Failed to create sampler state!");
+    }
+}
+
+void SamplerFree(rhi_sampler* Sampler)
+{
+    ((ID3D11SamplerState*)Sampler->Internal)->Release();
 }
 
 void SamplerBind(rhi_sampler* Sampler, i32 Binding, rhi_uniform_bind Bind)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
+
+    if (!StateCacheSet(&Cache->Samplers[Bind][Binding], (ID3D11SamplerState*)Sampler->Internal)) {
+        return;
+    }
+
     switch (Bind) {
         case UniformBind_Vertex: {
-            State.DeviceContext->VSSetSamplers(Binding, 1, (ID3D11SamplerState**)&Sampler->Internal);
+            Context->VSSetSamplers(Binding, 1, (ID3D11SamplerState**)&Sampler->Internal);
             break;
         }
         case UniformBind_Pixel: {
-            State.DeviceContext->PSSetSamplers(Binding, 1, (ID3D11SamplerState**)&Sampler->Internal);
+            Context->PSSetSamplers(Binding, 1, (ID3D11SamplerState**)&Sampler->Internal);
             break;
         }
         case UniformBind_Compute: {
-            State.DeviceContext->CSSetSamplers(Binding, 1, (ID3D11SamplerState**)&Sampler->Internal);
+            Context->CSSetSamplers(Binding, 1, (ID3D11SamplerState**)&Sampler->Internal);
             break;
         }
     }
 }
 
+// NOTE(milo): Reads through the pack so images decode from the archive when one is mounted.
+void* ImageDecode(const char* Path, i32* Width, i32* Height, bool Float)
+{
+    u64 Size;
+    u8* File = (u8*)PackReadFile(Path, &Size);
+    if (!File) {
+        return NULL;
+    }
+
+    i32 Channels = 0;
+    void* Data;
+    if (Float) {
+        Data = (void*)stbi_loadf_from_memory(File, (i32)Size, Width, Height, &Channels, STBI_rgb_alpha);
+    } else {
+        Data = (void*)stbi_load_from_memory(File, (i32)Size, Width, Height, &Channels, STBI_rgb_alpha);
+    }
+    free(File);
+    return Data;
+}
+
 void ImageLoad(rhi_image* Image, const char* Path)
 {   
-    i32 Channels = 0;
-    Image->Data = (void*)stbi_load(Path, &Image->Width, &Image->Height, &Channels, STBI_rgb_alpha);
+    Image->Data = ImageDecode(Path, &Image->Width, &Image->Height, false);
     Image->Float = false;
     Image->Path = Path;
+    Image->Cooked = false;
+    Image->MipCount = 0;
     if (!Image->Data)
         LogError("Failed to load image data: %s", Path);
 }
 
 void ImageLoadFloat(rhi_image* Image, const char* Path)
 {
-    i32 Channels = 0;
-    Image->Data = (void*)stbi_loadf(Path, &Image->Width, &Image->Height, &Channels, STBI_rgb_alpha);
+    Image->Data = ImageDecode(Path, &Image->Width, &Image->Height, true);
     Image->Float = true;
     Image->Path = Path;
+    Image->Cooked = false;
+    Image->MipCount = 0;
     if (!Image->Data)
         LogError("Failed to load image data: %s", Path);
 }
 
 void ImageFree(rhi_image* Image)
 {
-    stbi_image_free(Image->Data);
+    if (Image->Cooked) {
+        free(Image->Data);
+    } else {
+        stbi_image_free(Image->Data);
+    }
+    Image->Data = NULL;
+}
+
+u32 TextureFullMipCount(i32 Width, i32 Height)
+{
+    u32 Count = 1;
+    while (Width > 1 || Height > 1) {
+        Width = Width > 1 ? Width / 2 : 1;
+        Height = Height > 1 ? Height / 2 : 1;
+        Count++;
+    }
+    return Count;
 }
 
-void TextureInit(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format Format, rhi_texture_usage Usage)
+void TextureInit(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format Format, rhi_texture_usage Usage, u32 Layers, u32 MipCount)
 {
     Texture->Cube = false;
+    Texture->Layers = Layers;
     Texture->Width = Width;
     Texture->Height = Height;
+    Texture->MipCount = MipCount;
+    Texture->FirstMip = 0;
     Texture->Format = Format;
     Texture->Internal = new d3d11_texture();
 
@@ -648,10 +1995,10 @@ void TextureInit(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format
     Desc.Width = Width;
     Desc.Height = Height;
     Desc.Format = (DXGI_FORMAT)Format;
-    Desc.ArraySize = 1;
+    Desc.ArraySize = Layers;
     Desc.BindFlags = TextureUsageToD3D11(Usage);
     Desc.SampleDesc.Count = 1;
-    Desc.MipLevels = 1;
+    Desc.MipLevels = MipCount;
 
     if (FAILED(State.Device->CreateTexture2D(&Desc, NULL, (ID3D11Texture2D**)&((d3d11_texture*)Texture->Internal)->ColorTexture))) {
         LogCritical("Failed to create texture!");
@@ -661,8 +2008,11 @@ void TextureInit(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format
 void TextureInitCube(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_format Format, rhi_texture_usage Usage)
 {
     Texture->Cube = true;
+    Texture->Layers = 1;
     Texture->Width = Width;
     Texture->Height = Height;
+    Texture->MipCount = 1;
+    Texture->FirstMip = 0;
     Texture->Format = Format;
     Texture->Internal = new d3d11_texture();
 
@@ -684,13 +2034,15 @@ void TextureInitCube(rhi_texture* Texture, i32 Width, i32 Height, rhi_texture_fo
 void TextureLoad(rhi_texture* Texture, const char* Path)
 {
     Texture->Cube = false;
+    Texture->Layers = 1;
     Texture->Format = TextureFormat_R8G8B8A8_Unorm;
     Texture->Internal = new d3d11_texture();
 
-    i32 Channels = 0;
-    u8* Buffer = stbi_load(Path, &Texture->Width, &Texture->Height, &Channels, STBI_rgb_alpha);
+    u8* Buffer = (u8*)ImageDecode(Path, &Texture->Width, &Texture->Height, false);
     if (!Buffer)
         LogCritical("Failed to load texture file: %s", Path);
+    Texture->MipCount = TextureFullMipCount(Texture->Width, Texture->Height);
+    Texture->FirstMip = 0;
 
     D3D11_TEXTURE2D_DESC Desc = {};
     Desc.Width = Texture->Width;
@@ -718,13 +2070,15 @@ void TextureLoadFloat(rhi_texture* Texture, const char* Path)
     u32 ChannelSize = 4 * sizeof(f32);
 
     Texture->Cube = false;
+    Texture->Layers = 1;
     Texture->Format = TextureFormat_R32G32B32A32_Float;
     Texture->Internal = new d3d11_texture();
 
-    i32 Channels = 0;
-    f32* Buffer = stbi_loadf(Path, &Texture->Width, &Texture->Height, &Channels, STBI_rgb_alpha);
+    f32* Buffer = (f32*)ImageDecode(Path, &Texture->Width, &Texture->Height, true);
     if (!Buffer)
         LogCritical("Failed to load texture file: %s", Path);
+    Texture->MipCount = 1;
+    Texture->FirstMip = 0;
 
     D3D11_TEXTURE2D_DESC Desc = {};
     Desc.Width = Texture->Width;
@@ -749,16 +2103,59 @@ void TextureLoadFloat(rhi_texture* Texture, const char* Path)
     stbi_image_free(Buffer);
 }
 
+void TextureInitFromImageCooked(rhi_texture* Texture, rhi_image* Image)
+{
+    Texture->Cube = false;
+    Texture->Layers = 1;
+    Texture->Format = Image->Format;
+    Texture->Internal = new d3d11_texture();
+    Texture->Width = Image->Width;
+    Texture->Height = Image->Height;
+    Texture->MipCount = Image->MipCount;
+    Texture->FirstMip = 0;
+
+    D3D11_TEXTURE2D_DESC Desc = {};
+    Desc.Width = Image->Width;
+    Desc.Height = Image->Height;
+    Desc.Format = (DXGI_FORMAT)Texture->Format;
+    Desc.ArraySize = 1;
+    Desc.BindFlags = D3D11_BIND_FLAG::D3D11_BIND_SHADER_RESOURCE;
+    Desc.SampleDesc.Count = 1;
+    Desc.MipLevels = Image->MipCount;
+    Desc.Usage = D3D11_USAGE_IMMUTABLE;
+
+    D3D11_SUBRESOURCE_DATA Subresources[RHI_MAX_MIPS] = {};
+    for (u32 MipIndex = 0; MipIndex < Image->MipCount; MipIndex++) {
+        Subresources[MipIndex].pSysMem = Image->Mips[MipIndex].Data;
+        Subresources[MipIndex].SysMemPitch = Image->Mips[MipIndex].Pitch;
+        Subresources[MipIndex].SysMemSlicePitch = Image->Mips[MipIndex].Size;
+    }
+
+    if (FAILED(State.Device->CreateTexture2D(&Desc, Subresources, (ID3D11Texture2D**)&((d3d11_texture*)Texture->Internal)->ColorTexture))) {
+        LogCritical("Failed to create texture!");
+    }
+
+    TextureInitSRV(Texture, true);
+}
+
 void TextureInitFromImage(rhi_texture* Texture, rhi_image* Image)
 {
     assert(Image->Data);
+    if (Image->Cooked) {
+        TextureInitFromImageCooked(Texture, Image);
+        return;
+    }
+
     u32 ChannelSize = Image->Float ? 4 * sizeof(f32) : 4 * sizeof(u8);
 
     Texture->Cube = false;
+    Texture->Layers = 1;
     Texture->Format = Image->Float ? TextureFormat_R32G32B32A32_Float : TextureFormat_R8G8B8A8_Unorm;
     Texture->Internal = new d3d11_texture();
     Texture->Width = Image->Width;
     Texture->Height = Image->Height;
+    Texture->MipCount = TextureFullMipCount(Image->Width, Image->Height);
+    Texture->FirstMip = 0;
 
     D3D11_TEXTURE2D_DESC Desc = {};
     Desc.Width = Image->Width;
@@ -770,22 +2167,133 @@ void TextureInitFromImage(rhi_texture* Texture, rhi_image* Image)
     Desc.MipLevels = 0;
     Desc.MiscFlags = Image->Float ? 0 : D3D11_RESOURCE_MISC_GENERATE_MIPS;
 
-    D3D11_SUBRESOURCE_DATA Subresource;
-    Subresource.pSysMem = Image->Data;
-    Subresource.SysMemPitch = ChannelSize * Image->Width;
-    Subresource.SysMemSlicePitch = ChannelSize * Image->Width * Image->Height;
-
-    if (FAILED(State.Device->CreateTexture2D(&Desc, NULL, (ID3D11Texture2D**)&((d3d11_texture*)Texture->Internal)->ColorTexture))) {
+    ID3D11Texture2D* NewTexture = NULL;
+    if (FAILED(State.Device->CreateTexture2D(&Desc, NULL, &NewTexture))) {
         LogCritical("Failed to create texture!");
     }
 
-    State.DeviceContext->UpdateSubresource(((d3d11_texture*)Texture->Internal)->ColorTexture, 0u, nullptr, Image->Data, ChannelSize * Texture->Width, 0u);
+    // NOTE(milo): The texture stays unbound until the top level is uploaded, the rest of the chain is generated from it afterwards.
+    u32 Pitch = ChannelSize * Image->Width;
+    u64 Ticket = UploadTexture(NewTexture, 0, Desc.Format, Image->Width, Image->Height, Image->Data, Pitch, Pitch * Image->Height);
+    ID3D11ShaderResourceView* SRV = TextureCreateSRV(NewTexture, Texture->Format, false, !Image->Float);
+    TextureQueueSwap((d3d11_texture*)Texture->Internal, NewTexture, SRV, Ticket, !Image->Float);
+}
+
+// NOTE(milo): Recreates the texture with the levels FirstMip.. of the image. Levels the old texture already holds are copied on the GPU,
+// the others are queued for upload. The d3d11_texture is updated in place once they land, so every copy of the rhi_texture sees them.
+void TextureUpdateMips(rhi_texture* Texture, rhi_image* Image, u32 FirstMip)
+{
+    assert(Image->Cooked && FirstMip < Image->MipCount);
+
+    if (!Texture->Internal) {
+        Texture->Internal = new d3d11_texture();
+        Texture->Cube = false;
+        Texture->Layers = 1;
+    }
+    d3d11_texture* Internal = (d3d11_texture*)Texture->Internal;
+
+    D3D11_TEXTURE2D_DESC Desc = {};
+    Desc.Width = Image->Mips[FirstMip].Width;
+    Desc.Height = Image->Mips[FirstMip].Height;
+    Desc.Format = (DXGI_FORMAT)Image->Format;
+    Desc.ArraySize = 1;
+    Desc.BindFlags = D3D11_BIND_FLAG::D3D11_BIND_SHADER_RESOURCE;
+    Desc.SampleDesc.Count = 1;
+    Desc.MipLevels = Image->MipCount - FirstMip;
+    Desc.Usage = D3D11_USAGE_DEFAULT;
+
+    ID3D11Texture2D* NewTexture = NULL;
+    if (FAILED(State.Device->CreateTexture2D(&Desc, NULL, &NewTexture))) {
+        LogError("Failed to create streamed texture!");
+        return;
+    }
+
+    // NOTE(milo): Resident levels are copied from the live texture, so an earlier update still in the queue has to land first.
+    for (d3d11_pending_texture& Pending : State.Upload.PendingTextures) {
+        if (Pending.Internal == Internal) {
+            UploadFlush();
+            break;
+        }
+    }
+
+    u64 Ticket = 0;
+    for (u32 MipIndex = FirstMip; MipIndex < Image->MipCount; MipIndex++) {
+        u32 Destination = MipIndex - FirstMip;
+        if (Internal->ColorTexture && MipIndex >= Texture->FirstMip) {
+            State.DeviceContext->CopySubresourceRegion(NewTexture, Destination, 0, 0, 0, Internal->ColorTexture, MipIndex - Texture->FirstMip, NULL);
+        } else if (Image->Mips[MipIndex].Data) {
+            rhi_image_mip* Mip = &Image->Mips[MipIndex];
+            Ticket = UploadTexture(NewTexture, Destination, Desc.Format, (u32)Mip->Width, (u32)Mip->Height, Mip->Data, Mip->Pitch, Mip->Size);
+        } else {
+            LogError("Streamed texture is missing mip %u.", MipIndex);
+        }
+    }
+
+    Texture->Format = Image->Format;
+    Texture->Width = Image->Mips[FirstMip].Width;
+    Texture->Height = Image->Mips[FirstMip].Height;
+    Texture->MipCount = Image->MipCount - FirstMip;
+    Texture->FirstMip = FirstMip;
+
+    ID3D11ShaderResourceView* SRV = TextureCreateSRV(NewTexture, Texture->Format, false, true);
+    TextureQueueSwap(Internal, NewTexture, SRV, Ticket, false);
+}
+
+// NOTE(milo): Queues every level of a cooked image into one layer of a texture array created with the same size, format and mip count.
+u64 TextureUploadLayer(rhi_texture* Texture, u32 Layer, rhi_image* Image)
+{
+    assert(Image->Cooked && Layer < Texture->Layers);
+    assert(Image->Format == Texture->Format && Image->MipCount == Texture->MipCount);
+    assert(Image->Width == Texture->Width && Image->Height == Texture->Height);
+
+    d3d11_texture* Internal = (d3d11_texture*)Texture->Internal;
+
+    u64 Ticket = 0;
+    for (u32 MipIndex = 0; MipIndex < Image->MipCount; MipIndex++) {
+        rhi_image_mip* Mip = &Image->Mips[MipIndex];
+        u32 Subresource = D3D11CalcSubresource(MipIndex, Layer, Texture->MipCount);
+        Ticket = UploadTexture(Internal->ColorTexture, Subresource, (DXGI_FORMAT)Texture->Format, (u32)Mip->Width, (u32)Mip->Height, Mip->Data, Mip->Pitch, Mip->Size);
+    }
+    return Ticket;
+}
+
+// NOTE(milo): Grows a texture array, the existing layers are copied on the GPU. The d3d11_texture is updated in place so every copy of the
+// rhi_texture sees the new array.
+void TextureResizeLayers(rhi_texture* Texture, u32 Layers)
+{
+    d3d11_texture* Internal = (d3d11_texture*)Texture->Internal;
+    assert(Layers > Texture->Layers);
+
+    D3D11_TEXTURE2D_DESC Desc;
+    Internal->ColorTexture->GetDesc(&Desc);
+    Desc.ArraySize = Layers;
+
+    ID3D11Texture2D* NewTexture = NULL;
+    if (FAILED(State.Device->CreateTexture2D(&Desc, NULL, &NewTexture))) {
+        LogError("Failed to grow texture array to %u layers!", Layers);
+        return;
+    }
+
+    // NOTE(milo): Layers still in the upload queue target the old array, they have to land before it is copied.
+    UploadFlush();
 
-    TextureInitSRV(Texture, Image->Float ? false : true);
+    for (u32 Layer = 0; Layer < Texture->Layers; Layer++) {
+        for (u32 MipIndex = 0; MipIndex < Texture->MipCount; MipIndex++) {
+            u32 Subresource = D3D11CalcSubresource(MipIndex, Layer, Texture->MipCount);
+            State.DeviceContext->CopySubresourceRegion(NewTexture, Subresource, 0, 0, 0, Internal->ColorTexture, Subresource, NULL);
+        }
+    }
+
+    SafeRelease(Internal->SRV);
+    SafeRelease(Internal->ColorTexture);
+    Internal->ColorTexture = NewTexture;
+    Texture->Layers = Layers;
+    Internal->SRV = TextureCreateSRV(NewTexture, Texture->Format, false, Texture->MipCount > 1, Layers);
 }
 
 void TextureFree(rhi_texture* Texture)
 {
+    TextureDropPending((d3d11_texture*)Texture->Internal);
     SafeRelease(((d3d11_texture*)Texture->Internal)->UAV);
     SafeRelease(((d3d11_texture*)Texture->Internal)->DSV);
     SafeRelease(((d3d11_texture*)Texture->Internal)->SRV);
@@ -808,20 +2316,84 @@ void TextureInitDSV(rhi_texture* Texture)
     }
 }
 
-void TextureInitSRV(rhi_texture* Texture, bool Mips)
+ID3D11ShaderResourceView* TextureCreateSRV(ID3D11Texture2D* Texture, rhi_texture_format Format, bool Cube, bool Mips, u32 Layers)
 {
     D3D11_SHADER_RESOURCE_VIEW_DESC Desc = {};
-    Desc.Format = (DXGI_FORMAT)Texture->Format;
-    Desc.ViewDimension = Texture->Cube ? D3D11_SRV_DIMENSION_TEXTURECUBE : D3D11_SRV_DIMENSION_TEXTURE2D;
-    Desc.Texture2D.MipLevels = Mips ? -1 : 1;
-    Desc.Texture2D.MostDetailedMip = 0;
+    Desc.Format = (DXGI_FORMAT)Format;
+    if (Layers > 1) {
+        Desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        Desc.Texture2DArray.MipLevels = Mips ? -1 : 1;
+        Desc.Texture2DArray.MostDetailedMip = 0;
+        Desc.Texture2DArray.FirstArraySlice = 0;
+        Desc.Texture2DArray.ArraySize = Layers;
+    } else {
+        Desc.ViewDimension = Cube ? D3D11_SRV_DIMENSION_TEXTURECUBE : D3D11_SRV_DIMENSION_TEXTURE2D;
+        Desc.Texture2D.MipLevels = Mips ? -1 : 1;
+        Desc.Texture2D.MostDetailedMip = 0;
+    }
 
-    if (FAILED(State.Device->CreateShaderResourceView(((d3d11_texture*)Texture->Internal)->ColorTexture, &Desc, &((d3d11_texture*)Texture->Internal)->SRV))) {
+    ID3D11ShaderResourceView* SRV = NULL;
+    if (FAILED(State.Device->CreateShaderResourceView(Texture, &Desc, &SRV))) {
         LogCritical("Failed to create shader resource view!");
     }
+    return SRV;
+}
+
+void TextureInitSRV(rhi_texture* Texture, bool Mips)
+{
+    d3d11_texture* Internal = (d3d11_texture*)Texture->Internal;
+    Internal->SRV = TextureCreateSRV(Internal->ColorTexture, Texture->Format, Texture->Cube, Mips, Texture->Layers);
+
+    // NOTE(milo): Cooked textures come with their mip chain, only generate it for textures created to be filled on the GPU.
+    D3D11_TEXTURE2D_DESC TextureDesc;
+    Internal->ColorTexture->GetDesc(&TextureDesc);
+    if (Mips && (TextureDesc.MiscFlags & D3D11_RESOURCE_MISC_GENERATE_MIPS)) {
+        State.DeviceContext->GenerateMips(Internal->SRV);
+    }
+}
+
+void UploadSwapTexture(d3d11_texture* Internal, ID3D11Texture2D* Texture, ID3D11ShaderResourceView* SRV, bool GenerateMips)
+{
+    SafeRelease(Internal->SRV);
+    SafeRelease(Internal->ColorTexture);
+    Internal->ColorTexture = Texture;
+    Internal->SRV = SRV;
+
+    if (GenerateMips) {
+        State.DeviceContext->GenerateMips(SRV);
+    }
+}
+
+// NOTE(milo): Swaps right away when the levels are already recorded, otherwise once the upload queue gets past Ticket.
+void TextureQueueSwap(d3d11_texture* Internal, ID3D11Texture2D* Texture, ID3D11ShaderResourceView* SRV, u64 Ticket, bool GenerateMips)
+{
+    if (UploadIsDone(Ticket)) {
+        UploadSwapTexture(Internal, Texture, SRV, GenerateMips);
+        return;
+    }
+
+    d3d11_pending_texture Pending;
+    Pending.Internal = Internal;
+    Pending.Texture = Texture;
+    Pending.SRV = SRV;
+    Pending.Ticket = Ticket;
+    Pending.GenerateMips = GenerateMips;
+    State.Upload.PendingTextures.push_back(Pending);
+}
 
-    if (Mips) {
-        State.DeviceContext->GenerateMips(((d3d11_texture*)Texture->Internal)->SRV);
+void TextureDropPending(d3d11_texture* Internal)
+{
+    std::vector<d3d11_pending_texture>& PendingTextures = State.Upload.PendingTextures;
+    for (u32 PendingIndex = 0; PendingIndex < PendingTextures.size();) {
+        if (PendingTextures[PendingIndex].Internal != Internal) {
+            PendingIndex++;
+            continue;
+        }
+
+        SafeRelease(PendingTextures[PendingIndex].SRV);
+        SafeRelease(PendingTextures[PendingIndex].Texture);
+        PendingTextures[PendingIndex] = PendingTextures.back();
+        PendingTextures.pop_back();
     }
 }
 
@@ -839,44 +2411,50 @@ void TextureInitUAV(rhi_texture* Texture)
 
 void TextureBindRTV(rhi_texture* Texture, rhi_texture* Depth, hmm_vec4 ClearColor)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
+
     D3D11_VIEWPORT Viewport = {};
     Viewport.Width = (FLOAT)State.Width;
     Viewport.Height = (FLOAT)State.Height;
     Viewport.MinDepth = 0.0f;
     Viewport.MaxDepth = 1.0f;
-    State.DeviceContext->RSSetViewports(1, &Viewport);
 
     d3d11_texture* Internal = (d3d11_texture*)Texture->Internal;
 
     ID3D11RenderTargetView* BindRTV = Internal->RTV;
     ID3D11DepthStencilView* BindDSV = nullptr;
-    State.DeviceContext->ClearRenderTargetView(BindRTV, ClearColor.Elements);
+    Context->ClearRenderTargetView(BindRTV, ClearColor.Elements);
     if (Depth) {
         BindDSV = ((d3d11_texture*)Depth->Internal)->DSV;
-        State.DeviceContext->ClearDepthStencilView(BindDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+        Context->ClearDepthStencilView(BindDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
     }
 
-    State.DeviceContext->OMSetRenderTargets(1, &BindRTV, BindDSV);
+    ContextBindTargets(BindRTV, BindDSV, &Viewport);
+    StateCacheInvalidateInputs();
 }
 
 void TextureBindSRV(rhi_texture* Texture, i32 Binding, rhi_uniform_bind Bind)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
     d3d11_texture* Internal = (d3d11_texture*)Texture->Internal;
 
     ID3D11ShaderResourceView* SRV[1] = { nullptr };
     SRV[0] = Internal->SRV;
+    if (!StateCacheSetSRV(Bind, Binding, SRV[0])) {
+        return;
+    }
 
     switch (Bind) {
         case UniformBind_Vertex: {
-            State.DeviceContext->VSSetShaderResources(Binding, 1, SRV);
+            Context->VSSetShaderResources(Binding, 1, SRV);
             return; 
         }
         case UniformBind_Pixel: {
-            State.DeviceContext->PSSetShaderResources(Binding, 1, SRV);
+            Context->PSSetShaderResources(Binding, 1, SRV);
             return; 
         }
         case UniformBind_Compute: {
-            State.DeviceContext->CSSetShaderResources(Binding, 1, SRV);
+            Context->CSSetShaderResources(Binding, 1, SRV);
             return;
         }
     }
@@ -884,34 +2462,37 @@ void TextureBindSRV(rhi_texture* Texture, i32 Binding, rhi_uniform_bind Bind)
 
 void TextureBindUAV(rhi_texture* Texture, i32 Binding)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
     d3d11_texture* Internal = (d3d11_texture*)Texture->Internal;
 
-    State.DeviceContext->CSSetUnorderedAccessViews(Binding, 1, &Internal->UAV, NULL);
+    Context->CSSetUnorderedAccessViews(Binding, 1, &Internal->UAV, NULL);
+    StateCacheInvalidateInputs();
 }
 
 void TextureResetRTV()
 {
-    ID3D11RenderTargetView* const RTV[1] = { NULL };
-	ID3D11DepthStencilView* DSV = NULL;
-
-    State.DeviceContext->OMSetRenderTargets(1, RTV, DSV);
+    ContextBindTargets(NULL, NULL, NULL);
 }
 
 void TextureResetSRV(i32 Binding, rhi_uniform_bind Bind)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
     ID3D11ShaderResourceView* const SRV[1] = { NULL };
+    if (!StateCacheSetSRV(Bind, Binding, NULL)) {
+        return;
+    }
 
     switch (Bind) {
         case UniformBind_Vertex: {
-            State.DeviceContext->VSSetShaderResources(Binding, 1, SRV);
+            Context->VSSetShaderResources(Binding, 1, SRV);
             return; 
         }
         case UniformBind_Pixel: {
-            State.DeviceContext->PSSetShaderResources(Binding, 1, SRV);
+            Context->PSSetShaderResources(Binding, 1, SRV);
             return; 
         }
         case UniformBind_Compute: {
-            State.DeviceContext->CSSetShaderResources(Binding, 1, SRV);
+            Context->CSSetShaderResources(Binding, 1, SRV);
             return;
         }
     }
@@ -919,50 +2500,252 @@ void TextureResetSRV(i32 Binding, rhi_uniform_bind Bind)
 
 void TextureResetUAV(i32 Binding)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
     ID3D11UnorderedAccessView* const UAV[1] = { NULL };
-    State.DeviceContext->CSSetUnorderedAccessViews(Binding, 1, UAV, NULL);
+    Context->CSSetUnorderedAccessViews(Binding, 1, UAV, NULL);
 }
 
-void MaterialInit(rhi_material* Material, rhi_material_config Config)
+ID3D11RasterizerState* StateObjectRasterizer(rhi_material_config Config, u64* Hash = NULL)
 {
-    Material->Config = Config;
-    Material->Internal = new d3d11_material;
-    d3d11_material* Internal = (d3d11_material*)Material->Internal;
-    ZeroMemory(Internal, sizeof(d3d11_material));
-
-    D3D11_RASTERIZER_DESC Desc = {};
+    D3D11_RASTERIZER_DESC Desc;
+    ZeroMemory(&Desc, sizeof(Desc));
     Desc.CullMode = CullModeToD3D11(Config.CullMode);
     Desc.FillMode = FillModeToD3D11(Config.FillMode);
     Desc.FrontCounterClockwise = (BOOL)Config.FrontFaceCCW;
 
-    if (FAILED(State.Device->CreateRasterizerState(&Desc, &Internal->RState))) {
-        LogCritical("Failed to create material rasterizer state!");
+    u64 Key = HashBytes(&Desc, sizeof(Desc));
+    if (Hash) *Hash = Key;
+
+    auto Found = State.Objects.Rasterizers.find(Key);
+    if (Found != State.Objects.Rasterizers.end()) {
+        return Found->second;
+    }
+
+    ID3D11RasterizerState* RState = NULL;
+    if (FAILED(State.Device->CreateRasterizerState(&Desc, &RState))) {
+        LogCritical("Failed to create rasterizer state!");
+        return NULL;
+    }
+    State.Objects.Rasterizers[Key] = RState;
+    return RState;
+}
+
+ID3D11DepthStencilState* StateObjectDepthStencil(rhi_material_config Config, bool ReadOnly, u64* Hash = NULL)
+{
+    D3D11_DEPTH_STENCIL_DESC Desc;
+    ZeroMemory(&Desc, sizeof(Desc));
+    Desc.DepthEnable = true;
+    Desc.DepthFunc = CompareToD3D11(Config.CompareOP);
+    Desc.DepthWriteMask = ReadOnly ? D3D11_DEPTH_WRITE_MASK_ZERO : D3D11_DEPTH_WRITE_MASK_ALL;
+
+    u64 Key = HashBytes(&Desc, sizeof(Desc));
+    if (Hash) *Hash = Key;
+
+    auto Found = State.Objects.DepthStencils.find(Key);
+    if (Found != State.Objects.DepthStencils.end()) {
+        return Found->second;
+    }
+
+    ID3D11DepthStencilState* DState = NULL;
+    if (FAILED(State.Device->CreateDepthStencilState(&Desc, &DState))) {
+        LogCritical("Failed to create depth stencil state!");
+        return NULL;
+    }
+    State.Objects.DepthStencils[Key] = DState;
+    return DState;
+}
+
+ID3D11BlendState* StateObjectBlend(rhi_blend_mode Mode, u64* Hash = NULL)
+{
+    D3D11_BLEND_DESC Desc;
+    ZeroMemory(&Desc, sizeof(Desc));
+
+    D3D11_RENDER_TARGET_BLEND_DESC* Target = &Desc.RenderTarget[0];
+    Target->BlendEnable = Mode != BlendMode_Opaque;
+    Target->SrcBlend = Mode == BlendMode_Alpha ? D3D11_BLEND_SRC_ALPHA : D3D11_BLEND_ONE;
+    Target->DestBlend = Mode == BlendMode_Alpha ? D3D11_BLEND_INV_SRC_ALPHA : (Mode == BlendMode_Additive ? D3D11_BLEND_ONE : D3D11_BLEND_ZERO);
+    Target->BlendOp = D3D11_BLEND_OP_ADD;
+    Target->SrcBlendAlpha = D3D11_BLEND_ONE;
+    Target->DestBlendAlpha = Mode == BlendMode_Opaque ? D3D11_BLEND_ZERO : D3D11_BLEND_INV_SRC_ALPHA;
+    Target->BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    Target->RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+    u64 Key = HashBytes(&Desc, sizeof(Desc));
+    if (Hash) *Hash = Key;
+
+    auto Found = State.Objects.Blends.find(Key);
+    if (Found != State.Objects.Blends.end()) {
+        return Found->second;
     }
 
-    D3D11_DEPTH_STENCIL_DESC DDesc = {};
-    DDesc.DepthEnable = true;
-    DDesc.DepthFunc = CompareToD3D11(Config.CompareOP);
-    DDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    ID3D11BlendState* BState = NULL;
+    if (FAILED(State.Device->CreateBlendState(&Desc, &BState))) {
+        LogCritical("Failed to create blend state!");
+        return NULL;
+    }
+    State.Objects.Blends[Key] = BState;
+    return BState;
+}
 
-    if (FAILED(State.Device->CreateDepthStencilState(&DDesc, &Internal->DState))) {
-        LogCritical("Failed to create material depth stencil state!");
+void StateObjectsExit()
+{
+    for (auto& Entry : State.Objects.Pipelines) {
+        LogWarn("Pipeline %s was never freed.", HashToString(Entry.first).c_str());
+        delete Entry.second;
+    }
+    for (auto& Entry : State.Objects.Rasterizers) {
+        SafeRelease(Entry.second);
     }
+    for (auto& Entry : State.Objects.DepthStencils) {
+        SafeRelease(Entry.second);
+    }
+    for (auto& Entry : State.Objects.Blends) {
+        SafeRelease(Entry.second);
+    }
+    State.Objects.Pipelines.clear();
+    State.Objects.Rasterizers.clear();
+    State.Objects.DepthStencils.clear();
+    State.Objects.Blends.clear();
+}
+
+void MaterialInit(rhi_material* Material, rhi_material_config Config)
+{
+    Material->Config = Config;
+    Material->Internal = new d3d11_material;
+    d3d11_material* Internal = (d3d11_material*)Material->Internal;
+    ZeroMemory(Internal, sizeof(d3d11_material));
+
+    Internal->RState = StateObjectRasterizer(Config);
+    Internal->DState = StateObjectDepthStencil(Config, false);
 }
 
+// NOTE(milo): The state objects belong to the cache.
 void MaterialFree(rhi_material* Material)
 {
     d3d11_material* Internal = (d3d11_material*)Material->Internal;
-    SafeRelease(Internal->DState);
-    SafeRelease(Internal->RState);
     delete Internal;
 }
 
 void MaterialBind(rhi_material* Material)
 {
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
     d3d11_material* Internal = (d3d11_material*)Material->Internal;
 
-    State.DeviceContext->RSSetState(Internal->RState);
-    State.DeviceContext->OMSetDepthStencilState(Internal->DState, 0);
+    if (StateCacheSet(&Cache->Rasterizer, Internal->RState)) {
+        Context->RSSetState(Internal->RState);
+    }
+    if (StateCacheSet(&Cache->DepthStencil, Internal->DState)) {
+        Context->OMSetDepthStencilState(Internal->DState, 0);
+    }
+}
+
+void PipelineInit(rhi_pipeline* Pipeline, const rhi_pipeline_desc& Desc)
+{
+    u64 RHash, DHash, BHash;
+    ID3D11RasterizerState* RState = StateObjectRasterizer(Desc.Config, &RHash);
+    ID3D11DepthStencilState* DState = StateObjectDepthStencil(Desc.Config, Desc.DepthReadOnly, &DHash);
+    ID3D11BlendState* BState = StateObjectBlend(Desc.Blend, &BHash);
+
+    u64 Hash = HashBytes(&Desc.Shader->Internal, sizeof(void*));
+    Hash = HashCombine(Hash, RHash);
+    Hash = HashCombine(Hash, DHash);
+    Hash = HashCombine(Hash, BHash);
+
+    auto Found = State.Objects.Pipelines.find(Hash);
+    if (Found != State.Objects.Pipelines.end()) {
+        Found->second->References++;
+        Pipeline->Internal = Found->second;
+        return;
+    }
+
+    d3d11_pipeline* Internal = new d3d11_pipeline;
+    Internal->Hash = Hash;
+    Internal->References = 1;
+    Internal->Fallback = NULL;
+    Internal->Shader = (d3d11_shader*)Desc.Shader->Internal;
+    Internal->RState = RState;
+    Internal->DState = DState;
+    Internal->BState = BState;
+
+    State.Objects.Pipelines[Hash] = Internal;
+    Pipeline->Internal = Internal;
+}
+
+void PipelineRelease(d3d11_pipeline* Internal)
+{
+    if (--Internal->References == 0) {
+        if (Internal->Fallback) {
+            PipelineRelease(Internal->Fallback);
+        }
+        State.Objects.Pipelines.erase(Internal->Hash);
+        delete Internal;
+    }
+}
+
+void PipelineFree(rhi_pipeline* Pipeline)
+{
+    d3d11_pipeline* Internal = (d3d11_pipeline*)Pipeline->Internal;
+    Pipeline->Internal = NULL;
+    PipelineRelease(Internal);
+}
+
+bool PipelineInternalReady(d3d11_pipeline* Internal)
+{
+    return JobIsDone(&Internal->Shader->Counter) && !Internal->Shader->Failed;
+}
+
+bool PipelineIsReady(rhi_pipeline* Pipeline)
+{
+    return PipelineInternalReady((d3d11_pipeline*)Pipeline->Internal);
+}
+
+// NOTE(milo): The internal holds a reference on its fallback, so freeing the fallback's handle first leaves it alive until every
+// pipeline falling back to it is gone.
+void PipelineSetFallback(rhi_pipeline* Pipeline, rhi_pipeline* Fallback)
+{
+    d3d11_pipeline* Internal = (d3d11_pipeline*)Pipeline->Internal;
+    d3d11_pipeline* Previous = Internal->Fallback;
+
+    Internal->Fallback = Fallback ? (d3d11_pipeline*)Fallback->Internal : NULL;
+    if (Internal->Fallback) {
+        Internal->Fallback->References++;
+    }
+    if (Previous) {
+        PipelineRelease(Previous);
+    }
+}
+
+// NOTE(milo): Binds the fallback while the shader is still building, and returns false when neither is ready so the caller can skip
+// its draws.
+bool PipelineBind(rhi_pipeline* Pipeline)
+{
+    ID3D11DeviceContext* Context = ContextCurrent();
+    d3d11_state_cache* Cache = CacheCurrent();
+    d3d11_pipeline* Internal = (d3d11_pipeline*)Pipeline->Internal;
+    if (!PipelineInternalReady(Internal)) {
+        Internal = Internal->Fallback;
+        if (!Internal || !PipelineInternalReady(Internal)) {
+            return false;
+        }
+    }
+    d3d11_shader* Shader = Internal->Shader;
+
+    if (Shader->VS && StateCacheSet(&Cache->VS, Shader->VS)) Context->VSSetShader(Shader->VS, NULL, 0);
+    if (Shader->PS && StateCacheSet(&Cache->PS, Shader->PS)) Context->PSSetShader(Shader->PS, NULL, 0);
+    if (Shader->CS && StateCacheSet(&Cache->CS, Shader->CS)) Context->CSSetShader(Shader->CS, NULL, 0);
+    if (Shader->InputLayout && StateCacheSet(&Cache->InputLayout, Shader->InputLayout)) Context->IASetInputLayout(Shader->InputLayout);
+
+    if (StateCacheSet(&Cache->Rasterizer, Internal->RState)) {
+        Context->RSSetState(Internal->RState);
+    }
+    if (StateCacheSet(&Cache->DepthStencil, Internal->DState)) {
+        Context->OMSetDepthStencilState(Internal->DState, 0);
+    }
+    if (StateCacheSet(&Cache->Blend, Internal->BState)) {
+        Context->OMSetBlendState(Internal->BState, NULL, 0xFFFFFFFF);
+    }
+    return true;
 }
 
 
@@ -982,6 +2765,12 @@ D3D11_BIND_FLAG BufferUsageToD3D11(rhi_buffer_usage Usage)
         case BufferUsage_Storage: {
             return (D3D11_BIND_FLAG)(D3D11_BIND_FLAG::D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_FLAG::D3D11_BIND_SHADER_RESOURCE);
         }
+        case BufferUsage_VertexStorage: {
+            return (D3D11_BIND_FLAG)(D3D11_BIND_FLAG::D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_FLAG::D3D11_BIND_UNORDERED_ACCESS);
+        }
+        case BufferUsage_Indirect: {
+            return (D3D11_BIND_FLAG)(D3D11_BIND_FLAG::D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_FLAG::D3D11_BIND_SHADER_RESOURCE);
+        }
     }
 
     return D3D11_BIND_FLAG::D3D11_BIND_VERTEX_BUFFER;
@@ -0,0 +1,225 @@
+#include "backrooms_shader_cache.h"
+#include "backrooms_hash.h"
+#include "backrooms_pack.h"
+#include "backrooms_platform.h"
+#include "backrooms_logger.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHADER_CACHE_CHECK_DIRECTORY "data/.cache/shader_check"
+
+static std::atomic<u32> ShaderCacheWrites;
+
+std::string ShaderCachePath(u64 Key)
+{
+    return std::string(SHADER_CACHE_DIRECTORY) + "/" + HashToString(Key) + ".bin";
+}
+
+std::string ShaderCacheDirectory(const std::string& Path)
+{
+    size_t Slash = Path.find_last_of("/\\");
+    return Slash == std::string::npos ? "" : Path.substr(0, Slash + 1);
+}
+
+// NOTE(milo): Hashes the file and, depth first, every quoted include in it. Includes are looked up next to the including file first
+// and then from the working directory, the order the standard include handler uses.
+bool ShaderCacheHashSource(const std::string& Path, u32 Depth, u64* Hash)
+{
+    if (Depth > SHADER_CACHE_MAX_INCLUDE_DEPTH) {
+        LogError("Shader includes nest too deep at %s", Path.c_str());
+        return false;
+    }
+
+    u64 Size;
+    char* Data = (char*)PackReadFile(Path.c_str(), &Size);
+    if (!Data) {
+        return false;
+    }
+
+    *Hash = HashCombine(*Hash, HashBytes(Data, Size));
+
+    bool Success = true;
+    std::string Source(Data, Size);
+    free(Data);
+
+    size_t Position = 0;
+    while ((Position = Source.find("#include", Position)) != std::string::npos) {
+        size_t Open = Source.find('"', Position);
+        size_t LineEnd = Source.find('\n', Position);
+        Position += 8;
+        if (Open == std::string::npos || (LineEnd != std::string::npos && Open > LineEnd)) {
+            continue;
+        }
+        size_t Close = Source.find('"', Open + 1);
+        if (Close == std::string::npos) {
+            continue;
+        }
+
+        std::string Include = Source.substr(Open + 1, Close - Open - 1);
+        std::string Relative = ShaderCacheDirectory(Path) + Include;
+
+        u64 Unused;
+        std::string Resolved = PackFileSize(Relative.c_str(), &Unused) ? Relative : Include;
+        if (!ShaderCacheHashSource(Resolved, Depth + 1, Hash)) {
+            LogError("Missing include %s in shader %s", Include.c_str(), Path.c_str());
+            Success = false;
+            break;
+        }
+    }
+
+    return Success;
+}
+
+bool ShaderCacheKey(const char* Path, const char* Profile, const char* Entry, const std::vector<shader_define>& Defines, u64* Key)
+{
+    u64 Hash = HashCombine(SHADER_CACHE_VERSION, HashString(Profile));
+    Hash = HashCombine(Hash, HashString(Entry));
+    for (const shader_define& Define : Defines) {
+        Hash = HashCombine(Hash, HashString(Define.Name));
+        Hash = HashCombine(Hash, HashString(Define.Value));
+    }
+
+    if (!ShaderCacheHashSource(Path, 0, &Hash)) {
+        return false;
+    }
+
+    *Key = Hash;
+    return true;
+}
+
+bool ShaderCacheLoad(u64 Key, shader_cache_entry* Entry)
+{
+    FILE* File = fopen(ShaderCachePath(Key).c_str(), "rb");
+    if (!File) {
+        return false;
+    }
+
+    shader_cache_header Header;
+    bool Valid = fread(&Header, sizeof(Header), 1, File) == 1 && Header.Magic == SHADER_CACHE_MAGIC &&
+                 Header.Version == SHADER_CACHE_VERSION && Header.Key == Key;
+    if (Valid) {
+        Entry->Bytecode.resize(Header.BytecodeSize);
+        Entry->InputElements.resize(Header.InputElementCount);
+        Valid = fread(Entry->Bytecode.data(), 1, Header.BytecodeSize, File) == Header.BytecodeSize &&
+                fread(Entry->InputElements.data(), sizeof(shader_input_element), Header.InputElementCount, File) == Header.InputElementCount;
+    }
+
+    fclose(File);
+    if (!Valid) {
+        LogWarn("Ignoring corrupt shader cache entry %s", HashToString(Key).c_str());
+        Entry->Bytecode.clear();
+        Entry->InputElements.clear();
+    }
+    return Valid;
+}
+
+bool ShaderCacheStore(u64 Key, const shader_cache_entry& Entry)
+{
+    PlatformCreateDirectory("data/.cache");
+    PlatformCreateDirectory(SHADER_CACHE_DIRECTORY);
+
+    // NOTE(milo): Written under a temporary name and renamed, so a crash mid write never leaves a truncated entry behind. Permutations
+    // build on the job system and may store the same key at once, so every write gets its own temporary file.
+    std::string Path = ShaderCachePath(Key);
+    std::string Temporary = Path + "." + std::to_string(PlatformGetThreadID()) + "." + std::to_string(ShaderCacheWrites.fetch_add(1)) + ".tmp";
+    FILE* File = fopen(Temporary.c_str(), "wb");
+    if (!File) {
+        LogWarn("Failed to write shader cache entry %s", Path.c_str());
+        return false;
+    }
+
+    shader_cache_header Header;
+    Header.Magic = SHADER_CACHE_MAGIC;
+    Header.Version = SHADER_CACHE_VERSION;
+    Header.Key = Key;
+    Header.BytecodeSize = (u32)Entry.Bytecode.size();
+    Header.InputElementCount = (u32)Entry.InputElements.size();
+
+    bool Success = fwrite(&Header, sizeof(Header), 1, File) == 1 &&
+                   fwrite(Entry.Bytecode.data(), 1, Entry.Bytecode.size(), File) == Entry.Bytecode.size() &&
+                   fwrite(Entry.InputElements.data(), sizeof(shader_input_element), Entry.InputElements.size(), File) == Entry.InputElements.size();
+    fclose(File);
+
+    remove(Path.c_str());
+    if (!Success || rename(Temporary.c_str(), Path.c_str()) != 0) {
+        LogWarn("Failed to write shader cache entry %s", Path.c_str());
+        remove(Temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ShaderCacheWriteFile(const std::string& Path, const char* Text)
+{
+    FILE* File = fopen(Path.c_str(), "wb");
+    if (!File) {
+        LogError("Failed to write %s", Path.c_str());
+        return false;
+    }
+    bool Written = fwrite(Text, 1, strlen(Text), File) == strlen(Text);
+    fclose(File);
+    return Written;
+}
+
+// NOTE(milo): Runs without a device. Writes a small shader with one include into the cache directory and checks that its key is
+// stable, that defines and edits to the include change it, and that an entry stored under it loads back unchanged.
+bool ShaderCacheCheck()
+{
+    PlatformCreateDirectory("data/.cache");
+    PlatformCreateDirectory(SHADER_CACHE_CHECK_DIRECTORY);
+    std::string Source = std::string(SHADER_CACHE_CHECK_DIRECTORY) + "/Check.hlsl";
+    std::string Include = std::string(SHADER_CACHE_CHECK_DIRECTORY) + "/Common.hlsl";
+
+    bool Passed = ShaderCacheWriteFile(Include, "float4 Tint() { return 1.0f; }\n") &&
+                  ShaderCacheWriteFile(Source, "#include \"Common.hlsl\"\nfloat4 Main() : SV_Target { return Tint(); }\n");
+
+    std::vector<shader_define> Defines;
+    std::vector<shader_define> OtherDefines = { { "HAS_NORMAL_MAP", "1" } };
+    u64 Key = 0, Again = 0, Defined = 0, Edited = 0;
+
+    CODE_BLOCK("Key")
+    {
+        if (Passed && (!ShaderCacheKey(Source.c_str(), "ps_5_0", "Main", Defines, &Key) ||
+                       !ShaderCacheKey(Source.c_str(), "ps_5_0", "Main", Defines, &Again) || Key != Again)) {
+            LogError("Shader cache check: the key of an unchanged shader is not stable.");
+            Passed = false;
+        }
+        if (Passed && (!ShaderCacheKey(Source.c_str(), "ps_5_0", "Main", OtherDefines, &Defined) || Defined == Key)) {
+            LogError("Shader cache check: defines do not change the key.");
+            Passed = false;
+        }
+        if (Passed && (!ShaderCacheWriteFile(Include, "float4 Tint() { return 0.5f; }\n") ||
+                       !ShaderCacheKey(Source.c_str(), "ps_5_0", "Main", Defines, &Edited) || Edited == Key)) {
+            LogError("Shader cache check: editing an include does not change the key.");
+            Passed = false;
+        }
+    }
+
+    CODE_BLOCK("Round trip")
+    {
+        shader_cache_entry Stored;
+        Stored.Bytecode = { 0x44, 0x58, 0x42, 0x43, 0x01, 0x02, 0x03 };
+        shader_input_element Element = {};
+        strcpy(Element.SemanticName, "POSITION");
+        Element.Format = TextureFormat_R32G32B32_Float;
+        Stored.InputElements.push_back(Element);
+
+        shader_cache_entry Loaded;
+        if (Passed && (!ShaderCacheStore(Edited, Stored) || !ShaderCacheLoad(Edited, &Loaded) || Loaded.Bytecode != Stored.Bytecode ||
+                       Loaded.InputElements.size() != 1 || memcmp(&Loaded.InputElements[0], &Element, sizeof(Element)) != 0)) {
+            LogError("Shader cache check: a stored entry does not load back unchanged.");
+            Passed = false;
+        }
+        remove(ShaderCachePath(Edited).c_str());
+    }
+
+    remove(Source.c_str());
+    remove(Include.c_str());
+    if (Passed) {
+        LogInfo("Shader cache check passed.");
+    }
+    return Passed;
+}
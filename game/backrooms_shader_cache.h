@@ -0,0 +1,50 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_rhi.h"
+
+#include <string>
+#include <vector>
+
+#define SHADER_CACHE_DIRECTORY "data/.cache/shaders"
+#define SHADER_CACHE_MAGIC 0x48534842 // NOTE(milo): "BSHH"
+#define SHADER_CACHE_VERSION 1
+#define SHADER_CACHE_MAX_SEMANTIC 32
+#define SHADER_CACHE_MAX_INCLUDE_DEPTH 16
+
+struct shader_define
+{
+    std::string Name;
+    std::string Value;
+};
+
+// NOTE(milo): Format uses the rhi_texture_format values, which match the backend's vertex formats.
+struct shader_input_element
+{
+    char SemanticName[SHADER_CACHE_MAX_SEMANTIC];
+    u32 SemanticIndex;
+    rhi_texture_format Format;
+};
+
+struct shader_cache_header
+{
+    u32 Magic;
+    u32 Version;
+    u64 Key;
+    u32 BytecodeSize;
+    u32 InputElementCount;
+};
+
+struct shader_cache_entry
+{
+    std::vector<u8> Bytecode;
+    std::vector<shader_input_element> InputElements;
+};
+
+//~ NOTE(milo): Shader cache
+// NOTE(milo): The key covers the source and every file it includes, the profile, the entry point and the defines. Editing any of them
+// gives a new key, so stale entries are never read and simply stop being used.
+bool ShaderCacheKey(const char* Path, const char* Profile, const char* Entry, const std::vector<shader_define>& Defines, u64* Key);
+bool ShaderCacheLoad(u64 Key, shader_cache_entry* Entry);
+bool ShaderCacheStore(u64 Key, const shader_cache_entry& Entry);
+bool ShaderCacheCheck();
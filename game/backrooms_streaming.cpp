@@ -0,0 +1,320 @@
+#include "backrooms_streaming.h"
+#include "backrooms_texture.h"
+#include "backrooms_logger.h"
+#include "backrooms_pack.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+struct streaming_texture
+{
+    bool Active;
+
+    // NOTE(milo): Shares its Internal with the material's copy, TextureUpdateMips swaps the resource underneath both.
+    rhi_texture Texture;
+    std::string Path;
+    cooked_texture_header Header;
+
+    u32 ResidentMip;
+    u32 CoarsestMip;
+    u32 WantedMip;
+    u64 LastUsedFrame;
+
+    // NOTE(milo): Loads read straight into LoadData with an async request, nothing blocks on the read.
+    bool Loading;
+    u32 LoadingMip;
+    u8* LoadData;
+    pack_request Request;
+};
+
+struct streaming_state
+{
+    std::vector<streaming_texture*> Textures;
+
+    u64 Budget;
+    u64 ResidentBytes;
+    u64 LoadingBytes;
+    u64 Frame;
+
+    u32 PendingLoads;
+    u32 LoadsCompleted;
+    u32 Evictions;
+};
+
+static streaming_state StreamingState;
+
+u64 StreamingMipBytes(streaming_texture* Stream, u32 FirstMip)
+{
+    u64 Bytes = 0;
+    for (u32 MipIndex = FirstMip; MipIndex < Stream->Header.MipCount; MipIndex++) {
+        Bytes += Stream->Header.Mips[MipIndex].Size;
+    }
+    return Bytes;
+}
+
+bool StreamingStartLoad(streaming_texture* Stream)
+{
+    u64 Offset = TextureCookedRangeOffset(&Stream->Header, Stream->LoadingMip);
+    u64 Size = TextureCookedRangeSize(&Stream->Header, Stream->LoadingMip, Stream->ResidentMip);
+
+    Stream->LoadData = (u8*)malloc(Size);
+    if (!PackReadRangeAsync(Stream->Path.c_str(), Offset, Size, Stream->LoadData, &Stream->Request)) {
+        LogError("Failed to start streaming read: %s", Stream->Path.c_str());
+        free(Stream->LoadData);
+        Stream->LoadData = NULL;
+        return false;
+    }
+    return true;
+}
+
+void StreamingSetResidentMip(streaming_texture* Stream, rhi_image* Image, u32 Mip)
+{
+    StreamingState.ResidentBytes -= StreamingMipBytes(Stream, Stream->ResidentMip);
+    TextureUpdateMips(&Stream->Texture, Image, Mip);
+    Stream->ResidentMip = Mip;
+    StreamingState.ResidentBytes += StreamingMipBytes(Stream, Stream->ResidentMip);
+}
+
+void StreamingCompleteLoad(streaming_texture* Stream)
+{
+    StreamingState.LoadingBytes -= StreamingMipBytes(Stream, Stream->LoadingMip) - StreamingMipBytes(Stream, Stream->ResidentMip);
+    StreamingState.PendingLoads--;
+    Stream->Loading = false;
+
+    if (!PackRequestWait(&Stream->Request)) {
+        LogError("Failed to stream cooked texture: %s", Stream->Path.c_str());
+        free(Stream->LoadData);
+        Stream->LoadData = NULL;
+        return;
+    }
+
+    rhi_image Image;
+    ImageFromCookedMips(&Image, &Stream->Header, Stream->LoadData, Stream->LoadingMip, Stream->ResidentMip);
+    Stream->LoadData = NULL;
+
+    StreamingSetResidentMip(Stream, &Image, Stream->LoadingMip);
+    ImageFree(&Image);
+    StreamingState.LoadsCompleted++;
+}
+
+// NOTE(milo): Drops the finer levels of the least recently used textures that are sharper than they were asked to be this frame.
+void StreamingEvict(u64 Needed)
+{
+    std::vector<streaming_texture*> Candidates;
+    for (streaming_texture* Stream : StreamingState.Textures) {
+        if (Stream->Active && !Stream->Loading && Stream->ResidentMip < Stream->WantedMip) {
+            Candidates.push_back(Stream);
+        }
+    }
+
+    std::sort(Candidates.begin(), Candidates.end(), [](streaming_texture* A, streaming_texture* B) {
+        return A->LastUsedFrame < B->LastUsedFrame;
+    });
+
+    for (streaming_texture* Stream : Candidates) {
+        if (StreamingState.ResidentBytes + StreamingState.LoadingBytes + Needed <= StreamingState.Budget) {
+            break;
+        }
+
+        rhi_image Image;
+        ImageFromCookedHeader(&Image, &Stream->Header);
+        StreamingSetResidentMip(Stream, &Image, Stream->WantedMip);
+        StreamingState.Evictions++;
+    }
+}
+
+void StreamingInit(u64 Budget)
+{
+    StreamingState.Budget = Budget;
+    StreamingState.ResidentBytes = 0;
+    StreamingState.LoadingBytes = 0;
+    StreamingState.Frame = 0;
+    StreamingState.PendingLoads = 0;
+    StreamingState.LoadsCompleted = 0;
+    StreamingState.Evictions = 0;
+}
+
+void StreamingExit()
+{
+    for (u32 Handle = 0; Handle < StreamingState.Textures.size(); Handle++) {
+        StreamingTextureRelease(Handle);
+        delete StreamingState.Textures[Handle];
+    }
+    StreamingState.Textures.clear();
+}
+
+void StreamingSetBudget(u64 Budget)
+{
+    StreamingState.Budget = Budget;
+}
+
+void StreamingUpdate()
+{
+    CODE_BLOCK("Finished loads")
+    {
+        for (streaming_texture* Stream : StreamingState.Textures) {
+            if (Stream->Active && Stream->Loading && PackRequestIsDone(&Stream->Request)) {
+                StreamingCompleteLoad(Stream);
+            }
+        }
+    }
+
+    CODE_BLOCK("Budget")
+    {
+        if (StreamingState.ResidentBytes + StreamingState.LoadingBytes > StreamingState.Budget) {
+            StreamingEvict(0);
+        }
+    }
+
+    CODE_BLOCK("New loads")
+    {
+        std::vector<streaming_texture*> Candidates;
+        for (streaming_texture* Stream : StreamingState.Textures) {
+            if (Stream->Active && !Stream->Loading && Stream->WantedMip < Stream->ResidentMip) {
+                Candidates.push_back(Stream);
+            }
+        }
+
+        // NOTE(milo): Textures used this frame that are the furthest from their wanted level go first.
+        std::sort(Candidates.begin(), Candidates.end(), [](streaming_texture* A, streaming_texture* B) {
+            if (A->LastUsedFrame != B->LastUsedFrame) {
+                return A->LastUsedFrame > B->LastUsedFrame;
+            }
+            return A->ResidentMip - A->WantedMip > B->ResidentMip - B->WantedMip;
+        });
+
+        for (streaming_texture* Stream : Candidates) {
+            if (StreamingState.PendingLoads >= STREAMING_MAX_LOADS) {
+                break;
+            }
+
+            u64 Needed = StreamingMipBytes(Stream, Stream->WantedMip) - StreamingMipBytes(Stream, Stream->ResidentMip);
+            if (StreamingState.ResidentBytes + StreamingState.LoadingBytes + Needed > StreamingState.Budget) {
+                StreamingEvict(Needed);
+                if (StreamingState.ResidentBytes + StreamingState.LoadingBytes + Needed > StreamingState.Budget) {
+                    continue;
+                }
+            }
+
+            Stream->LoadingMip = Stream->WantedMip;
+            if (!StreamingStartLoad(Stream)) {
+                continue;
+            }
+
+            Stream->Loading = true;
+            StreamingState.LoadingBytes += Needed;
+            StreamingState.PendingLoads++;
+        }
+    }
+
+    for (streaming_texture* Stream : StreamingState.Textures) {
+        Stream->WantedMip = Stream->CoarsestMip;
+    }
+    StreamingState.Frame++;
+}
+
+streaming_stats StreamingGetStats()
+{
+    streaming_stats Stats = {};
+    Stats.Budget = StreamingState.Budget;
+    Stats.ResidentBytes = StreamingState.ResidentBytes;
+    Stats.PendingLoads = StreamingState.PendingLoads;
+    Stats.LoadsCompleted = StreamingState.LoadsCompleted;
+    Stats.Evictions = StreamingState.Evictions;
+    for (streaming_texture* Stream : StreamingState.Textures) {
+        Stats.TextureCount += Stream->Active ? 1 : 0;
+    }
+    return Stats;
+}
+
+u32 StreamingTextureLoad(rhi_texture* Texture, const std::string& CookedPath)
+{
+    cooked_texture_header Header;
+    if (!TextureReadCookedHeader(CookedPath.c_str(), &Header)) {
+        return STREAMING_INVALID_HANDLE;
+    }
+
+    // NOTE(milo): The top level of a block compressed texture must be a whole number of blocks, which bounds how coarse we can go.
+    u32 CoarsestMip = 0;
+    for (u32 MipIndex = 1; MipIndex < Header.MipCount; MipIndex++) {
+        if ((Header.Mips[MipIndex].Width % 4) != 0 || (Header.Mips[MipIndex].Height % 4) != 0) {
+            break;
+        }
+        CoarsestMip = MipIndex;
+    }
+
+    u32 InitialMip = CoarsestMip;
+    for (u32 MipIndex = 0; MipIndex < CoarsestMip; MipIndex++) {
+        if (Header.Mips[MipIndex].Width <= STREAMING_INITIAL_SIZE && Header.Mips[MipIndex].Height <= STREAMING_INITIAL_SIZE) {
+            InitialMip = MipIndex;
+            break;
+        }
+    }
+
+    rhi_image Image;
+    if (!ImageLoadCookedMips(&Image, CookedPath.c_str(), InitialMip, Header.MipCount)) {
+        return STREAMING_INVALID_HANDLE;
+    }
+
+    Texture->Internal = NULL;
+    TextureUpdateMips(Texture, &Image, InitialMip);
+    ImageFree(&Image);
+
+    streaming_texture* Stream = new streaming_texture();
+    Stream->Active = true;
+    Stream->Texture = *Texture;
+    Stream->Path = CookedPath;
+    Stream->Header = Header;
+    Stream->ResidentMip = InitialMip;
+    Stream->CoarsestMip = CoarsestMip;
+    Stream->WantedMip = CoarsestMip;
+    Stream->LastUsedFrame = StreamingState.Frame;
+    Stream->Loading = false;
+    Stream->LoadData = NULL;
+
+    StreamingState.ResidentBytes += StreamingMipBytes(Stream, InitialMip);
+    StreamingState.Textures.push_back(Stream);
+    return (u32)(StreamingState.Textures.size() - 1);
+}
+
+void StreamingTextureRelease(u32 Handle)
+{
+    if (Handle >= StreamingState.Textures.size() || !StreamingState.Textures[Handle]->Active) {
+        return;
+    }
+
+    streaming_texture* Stream = StreamingState.Textures[Handle];
+    if (Stream->Loading) {
+        PackRequestWait(&Stream->Request);
+        StreamingState.LoadingBytes -= StreamingMipBytes(Stream, Stream->LoadingMip) - StreamingMipBytes(Stream, Stream->ResidentMip);
+        StreamingState.PendingLoads--;
+        Stream->Loading = false;
+        free(Stream->LoadData);
+        Stream->LoadData = NULL;
+    }
+
+    StreamingState.ResidentBytes -= StreamingMipBytes(Stream, Stream->ResidentMip);
+    Stream->Active = false;
+}
+
+void StreamingTextureRequest(u32 Handle, f32 ScreenSize)
+{
+    if (Handle >= StreamingState.Textures.size() || !StreamingState.Textures[Handle]->Active) {
+        return;
+    }
+
+    streaming_texture* Stream = StreamingState.Textures[Handle];
+    Stream->LastUsedFrame = StreamingState.Frame;
+
+    // NOTE(milo): One texel per pixel across the object's screen footprint, assuming its UVs span the texture about once.
+    f32 Size = (f32)std::max(Stream->Header.Width, Stream->Header.Height);
+    u32 Mip = 0;
+    if (ScreenSize < Size) {
+        Mip = (u32)floorf(log2f(Size / std::max(ScreenSize, 1.0f)));
+    }
+
+    Mip = std::min(Mip, Stream->CoarsestMip);
+    Stream->WantedMip = std::min(Stream->WantedMip, Mip);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_rhi.h"
+
+#include <string>
+
+#define STREAMING_INVALID_HANDLE 0xFFFFFFFF
+#define STREAMING_DEFAULT_BUDGET (256ull * 1024ull * 1024ull)
+#define STREAMING_INITIAL_SIZE 64
+#define STREAMING_MAX_LOADS 16
+
+struct streaming_stats
+{
+    u64 Budget;
+    u64 ResidentBytes;
+    u32 TextureCount;
+    u32 PendingLoads;
+    u32 LoadsCompleted;
+    u32 Evictions;
+};
+
+//~ NOTE(milo): Streaming system
+void StreamingInit(u64 Budget);
+void StreamingExit();
+void StreamingSetBudget(u64 Budget);
+void StreamingUpdate();
+streaming_stats StreamingGetStats();
+
+//~ NOTE(milo): Streamed textures
+u32 StreamingTextureLoad(rhi_texture* Texture, const std::string& CookedPath);
+void StreamingTextureRelease(u32 Handle);
+void StreamingTextureRequest(u32 Handle, f32 ScreenSize);
@@ -0,0 +1,224 @@
+#include "backrooms_tangent.h"
+#include "backrooms_logger.h"
+#include "backrooms_job.h"
+
+#include <xmmintrin.h>
+#include <math.h>
+#include <vector>
+
+#define TANGENT_EPSILON 1e-20f
+
+struct tangent_triangle
+{
+    hmm_vec3 Os;
+    hmm_vec3 Ot;
+};
+
+struct tangent_context
+{
+    mesh_vertex* Vertices;
+    u32 VertexCount;
+    const u32* Indices;
+    u32 TriangleCount;
+
+    tangent_triangle* Triangles;
+    const u32* CornerOffsets;
+    const u32* Corners;
+};
+
+hmm_vec3 TangentProject(hmm_vec3 Vector, hmm_vec3 Normal)
+{
+    return HMM_SubtractVec3(Vector, HMM_MultiplyVec3f(Normal, HMM_DotVec3(Normal, Vector)));
+}
+
+hmm_vec3 TangentNormalizeSafe(hmm_vec3 Vector)
+{
+    f32 Length = HMM_LengthVec3(Vector);
+    return Length > TANGENT_EPSILON ? HMM_DivideVec3f(Vector, Length) : HMM_Vec3(0.0f, 0.0f, 0.0f);
+}
+
+// NOTE(milo): Same per-face quantities as MikkTSpace: the unit directions of dP/du and dP/dv, flipped on mirrored UVs.
+void TangentTriangleRange(void* Data, u32 Start, u32 End)
+{
+    tangent_context* Context = (tangent_context*)Data;
+
+    const __m128 Zero = _mm_setzero_ps();
+    const __m128 One = _mm_set1_ps(1.0f);
+    const __m128 MinusOne = _mm_set1_ps(-1.0f);
+    const __m128 Epsilon = _mm_set1_ps(TANGENT_EPSILON);
+    const __m128 AbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    for (u32 Triangle = Start; Triangle < End; Triangle += 4) {
+        alignas(16) f32 P[3][3][4];
+        alignas(16) f32 T[3][2][4];
+
+        // NOTE(milo): Lanes past the end of the range repeat the last triangle and are never stored.
+        for (u32 Lane = 0; Lane < 4; Lane++) {
+            u32 Source = Triangle + Lane < End ? Triangle + Lane : End - 1;
+            for (u32 Corner = 0; Corner < 3; Corner++) {
+                const mesh_vertex* Vertex = &Context->Vertices[Context->Indices[Source * 3 + Corner]];
+                P[Corner][0][Lane] = Vertex->Position.X;
+                P[Corner][1][Lane] = Vertex->Position.Y;
+                P[Corner][2][Lane] = Vertex->Position.Z;
+                T[Corner][0][Lane] = Vertex->UV.X;
+                T[Corner][1][Lane] = Vertex->UV.Y;
+            }
+        }
+
+        __m128 D1[3], D2[3];
+        for (u32 Axis = 0; Axis < 3; Axis++) {
+            __m128 P0 = _mm_load_ps(P[0][Axis]);
+            D1[Axis] = _mm_sub_ps(_mm_load_ps(P[1][Axis]), P0);
+            D2[Axis] = _mm_sub_ps(_mm_load_ps(P[2][Axis]), P0);
+        }
+
+        __m128 T21X = _mm_sub_ps(_mm_load_ps(T[1][0]), _mm_load_ps(T[0][0]));
+        __m128 T21Y = _mm_sub_ps(_mm_load_ps(T[1][1]), _mm_load_ps(T[0][1]));
+        __m128 T31X = _mm_sub_ps(_mm_load_ps(T[2][0]), _mm_load_ps(T[0][0]));
+        __m128 T31Y = _mm_sub_ps(_mm_load_ps(T[2][1]), _mm_load_ps(T[0][1]));
+
+        __m128 Area = _mm_sub_ps(_mm_mul_ps(T21X, T31Y), _mm_mul_ps(T21Y, T31X));
+        __m128 Positive = _mm_cmpgt_ps(Area, Zero);
+        __m128 Sign = _mm_or_ps(_mm_and_ps(Positive, One), _mm_andnot_ps(Positive, MinusOne));
+        __m128 ValidArea = _mm_cmpgt_ps(_mm_and_ps(Area, AbsMask), Epsilon);
+
+        __m128 Os[3], Ot[3];
+        for (u32 Axis = 0; Axis < 3; Axis++) {
+            Os[Axis] = _mm_sub_ps(_mm_mul_ps(T31Y, D1[Axis]), _mm_mul_ps(T21Y, D2[Axis]));
+            Ot[Axis] = _mm_sub_ps(_mm_mul_ps(T21X, D2[Axis]), _mm_mul_ps(T31X, D1[Axis]));
+        }
+
+        __m128 LengthOs = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Os[0], Os[0]), _mm_mul_ps(Os[1], Os[1])), _mm_mul_ps(Os[2], Os[2])));
+        __m128 LengthOt = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Ot[0], Ot[0]), _mm_mul_ps(Ot[1], Ot[1])), _mm_mul_ps(Ot[2], Ot[2])));
+
+        __m128 ValidOs = _mm_and_ps(ValidArea, _mm_cmpgt_ps(LengthOs, Epsilon));
+        __m128 ValidOt = _mm_and_ps(ValidArea, _mm_cmpgt_ps(LengthOt, Epsilon));
+        __m128 ScaleOs = _mm_and_ps(ValidOs, _mm_div_ps(Sign, _mm_max_ps(LengthOs, Epsilon)));
+        __m128 ScaleOt = _mm_and_ps(ValidOt, _mm_div_ps(Sign, _mm_max_ps(LengthOt, Epsilon)));
+
+        alignas(16) f32 OutOs[3][4];
+        alignas(16) f32 OutOt[3][4];
+        for (u32 Axis = 0; Axis < 3; Axis++) {
+            _mm_store_ps(OutOs[Axis], _mm_mul_ps(Os[Axis], ScaleOs));
+            _mm_store_ps(OutOt[Axis], _mm_mul_ps(Ot[Axis], ScaleOt));
+        }
+
+        for (u32 Lane = 0; Lane < 4 && Triangle + Lane < End; Lane++) {
+            tangent_triangle* Output = &Context->Triangles[Triangle + Lane];
+            Output->Os = HMM_Vec3(OutOs[0][Lane], OutOs[1][Lane], OutOs[2][Lane]);
+            Output->Ot = HMM_Vec3(OutOt[0][Lane], OutOt[1][Lane], OutOt[2][Lane]);
+        }
+    }
+}
+
+void TangentVertexRange(void* Data, u32 Start, u32 End)
+{
+    tangent_context* Context = (tangent_context*)Data;
+
+    for (u32 VertexIndex = Start; VertexIndex < End; VertexIndex++) {
+        mesh_vertex* Vertex = &Context->Vertices[VertexIndex];
+
+        hmm_vec3 Normal = TangentNormalizeSafe(Vertex->Normals);
+        if (HMM_LengthSquaredVec3(Normal) == 0.0f) {
+            Normal = HMM_Vec3(0.0f, 1.0f, 0.0f);
+        }
+
+        hmm_vec3 SumTangent = HMM_Vec3(0.0f, 0.0f, 0.0f);
+        hmm_vec3 SumBitangent = HMM_Vec3(0.0f, 0.0f, 0.0f);
+
+        for (u32 CornerIndex = Context->CornerOffsets[VertexIndex]; CornerIndex < Context->CornerOffsets[VertexIndex + 1]; CornerIndex++) {
+            u32 Corner = Context->Corners[CornerIndex];
+            u32 Triangle = Corner / 3;
+            u32 Local = Corner % 3;
+
+            const tangent_triangle* Face = &Context->Triangles[Triangle];
+            hmm_vec3 Os = TangentNormalizeSafe(TangentProject(Face->Os, Normal));
+            hmm_vec3 Ot = TangentNormalizeSafe(TangentProject(Face->Ot, Normal));
+
+            // NOTE(milo): Weight each face by the angle it spans at this vertex, measured in the tangent plane.
+            hmm_vec3 Origin = Context->Vertices[Context->Indices[Triangle * 3 + Local]].Position;
+            hmm_vec3 Next = Context->Vertices[Context->Indices[Triangle * 3 + (Local + 1) % 3]].Position;
+            hmm_vec3 Previous = Context->Vertices[Context->Indices[Triangle * 3 + (Local + 2) % 3]].Position;
+
+            hmm_vec3 Edge1 = TangentNormalizeSafe(TangentProject(HMM_SubtractVec3(Next, Origin), Normal));
+            hmm_vec3 Edge2 = TangentNormalizeSafe(TangentProject(HMM_SubtractVec3(Previous, Origin), Normal));
+
+            f32 Cosine = HMM_DotVec3(Edge1, Edge2);
+            Cosine = Cosine > 1.0f ? 1.0f : (Cosine < -1.0f ? -1.0f : Cosine);
+            f32 Angle = acosf(Cosine);
+
+            SumTangent = HMM_AddVec3(SumTangent, HMM_MultiplyVec3f(Os, Angle));
+            SumBitangent = HMM_AddVec3(SumBitangent, HMM_MultiplyVec3f(Ot, Angle));
+        }
+
+        hmm_vec3 Tangent = TangentNormalizeSafe(TangentProject(SumTangent, Normal));
+        if (HMM_LengthSquaredVec3(Tangent) == 0.0f) {
+            hmm_vec3 Axis = fabsf(Normal.X) < 0.9f ? HMM_Vec3(1.0f, 0.0f, 0.0f) : HMM_Vec3(0.0f, 1.0f, 0.0f);
+            Tangent = HMM_NormalizeVec3(TangentProject(Axis, Normal));
+        }
+
+        hmm_vec3 Bitangent = HMM_Cross(Normal, Tangent);
+        if (HMM_DotVec3(Bitangent, SumBitangent) < 0.0f) {
+            Bitangent = HMM_MultiplyVec3f(Bitangent, -1.0f);
+        }
+
+        Vertex->Tangent = Tangent;
+        Vertex->Bitangent = Bitangent;
+    }
+}
+
+void TangentGenerate(mesh_vertex* Vertices, u32 VertexCount, const u32* Indices, u32 IndexCount)
+{
+    u32 TriangleCount = IndexCount / 3;
+    if (TriangleCount == 0 || VertexCount == 0) {
+        return;
+    }
+
+    std::vector<u32> CornerOffsets(VertexCount + 1, 0);
+    std::vector<u32> Corners(TriangleCount * 3);
+    std::vector<tangent_triangle> Triangles(TriangleCount);
+
+    CODE_BLOCK("Vertex to corner adjacency")
+    {
+        for (u32 Index = 0; Index < TriangleCount * 3; Index++) {
+            if (Indices[Index] >= VertexCount) {
+                LogError("Tangent generation found an out of range index (%u >= %u).", Indices[Index], VertexCount);
+                return;
+            }
+            CornerOffsets[Indices[Index] + 1]++;
+        }
+
+        for (u32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++) {
+            CornerOffsets[VertexIndex + 1] += CornerOffsets[VertexIndex];
+        }
+
+        std::vector<u32> Cursor(CornerOffsets.begin(), CornerOffsets.end() - 1);
+        for (u32 Index = 0; Index < TriangleCount * 3; Index++) {
+            Corners[Cursor[Indices[Index]]++] = Index;
+        }
+    }
+
+    tangent_context Context;
+    Context.Vertices = Vertices;
+    Context.VertexCount = VertexCount;
+    Context.Indices = Indices;
+    Context.TriangleCount = TriangleCount;
+    Context.Triangles = Triangles.data();
+    Context.CornerOffsets = CornerOffsets.data();
+    Context.Corners = Corners.data();
+
+    if (IndexCount < TANGENT_PARALLEL_THRESHOLD || JobWorkerCount() == 0) {
+        TangentTriangleRange(&Context, 0, TriangleCount);
+        TangentVertexRange(&Context, 0, VertexCount);
+        return;
+    }
+
+    // NOTE(milo): Batches are multiples of four so every SIMD group except the last one is full.
+    job_counter TriangleCounter = {};
+    JobParallelFor(TriangleCount, TANGENT_BATCH_SIZE, TangentTriangleRange, &Context, &TriangleCounter);
+    JobWait(&TriangleCounter);
+
+    job_counter VertexCounter = {};
+    JobParallelFor(VertexCount, TANGENT_BATCH_SIZE, TangentVertexRange, &Context, &VertexCounter);
+    JobWait(&VertexCounter);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_model.h"
+
+#define TANGENT_PARALLEL_THRESHOLD 16384
+#define TANGENT_BATCH_SIZE 8192
+
+//~ NOTE(milo): Tangent space
+void TangentGenerate(mesh_vertex* Vertices, u32 VertexCount, const u32* Indices, u32 IndexCount);
@@ -0,0 +1,777 @@
+#include "backrooms_texture.h"
+#include "backrooms_logger.h"
+#include "backrooms_job.h"
+#include "backrooms_pack.h"
+
+#include <stb/stb_image.h>
+#include <emmintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define TEXTURE_ROW_BATCH 64
+#define TEXTURE_EPSILON 1e-8f
+
+struct texture_srgb_tables
+{
+    f32 ToLinear[256];
+    u8 FromLinear[4096];
+};
+
+struct texture_level
+{
+    i32 Width;
+    i32 Height;
+    std::vector<f32> Texels;
+};
+
+struct texture_cook_context
+{
+    texture_role Role;
+    rhi_texture_format Format;
+    const texture_srgb_tables* Tables;
+
+    const texture_level* Source;
+    texture_level* Destination;
+
+    const u8* Pixels;
+    u8* Output;
+    i32 Width;
+    i32 Height;
+    u32 Pitch;
+    u32 BlockSize;
+};
+
+struct texture_bit_writer
+{
+    u8* Data;
+    u32 Position;
+};
+
+texture_srgb_tables TextureBuildSRGBTables()
+{
+    texture_srgb_tables Tables;
+    for (u32 Value = 0; Value < 256; Value++) {
+        f32 Encoded = Value / 255.0f;
+        Tables.ToLinear[Value] = Encoded <= 0.04045f ? Encoded / 12.92f : powf((Encoded + 0.055f) / 1.055f, 2.4f);
+    }
+    for (u32 Value = 0; Value < 4096; Value++) {
+        f32 Linear = Value / 4095.0f;
+        f32 Encoded = Linear <= 0.0031308f ? Linear * 12.92f : 1.055f * powf(Linear, 1.0f / 2.4f) - 0.055f;
+        Tables.FromLinear[Value] = (u8)(Encoded * 255.0f + 0.5f);
+    }
+    return Tables;
+}
+
+const texture_srgb_tables* TextureSRGBTables()
+{
+    static texture_srgb_tables Tables = TextureBuildSRGBTables();
+    return &Tables;
+}
+
+//~ NOTE(milo): Block helpers
+
+void TextureBlockToChannels(const u8* Pixels, f32 Channels[4][16])
+{
+    for (u32 Pixel = 0; Pixel < 16; Pixel++) {
+        for (u32 Channel = 0; Channel < 4; Channel++) {
+            Channels[Channel][Pixel] = (f32)Pixels[Pixel * 4 + Channel];
+        }
+    }
+}
+
+f32 TextureHorizontalSum(__m128 Value)
+{
+    __m128 Shuffled = _mm_shuffle_ps(Value, Value, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 Sum = _mm_add_ps(Value, Shuffled);
+    Shuffled = _mm_movehl_ps(Shuffled, Sum);
+    return _mm_cvtss_f32(_mm_add_ss(Sum, Shuffled));
+}
+
+// NOTE(milo): Endpoints are the extremes of the block projected on its principal axis, found with a few power iterations on the covariance.
+void TextureBlockEndpoints(const f32 Channels[4][16], u32 ChannelCount, f32* Low, f32* High)
+{
+    f32 Mean[4] = {};
+    __m128 Centered[4][4];
+    for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+        __m128 Sum = _mm_setzero_ps();
+        for (u32 Group = 0; Group < 4; Group++) {
+            Sum = _mm_add_ps(Sum, _mm_load_ps(&Channels[Channel][Group * 4]));
+        }
+        Mean[Channel] = TextureHorizontalSum(Sum) / 16.0f;
+
+        __m128 MeanWide = _mm_set1_ps(Mean[Channel]);
+        for (u32 Group = 0; Group < 4; Group++) {
+            Centered[Channel][Group] = _mm_sub_ps(_mm_load_ps(&Channels[Channel][Group * 4]), MeanWide);
+        }
+    }
+
+    f32 Covariance[4][4] = {};
+    for (u32 A = 0; A < ChannelCount; A++) {
+        for (u32 B = A; B < ChannelCount; B++) {
+            __m128 Sum = _mm_setzero_ps();
+            for (u32 Group = 0; Group < 4; Group++) {
+                Sum = _mm_add_ps(Sum, _mm_mul_ps(Centered[A][Group], Centered[B][Group]));
+            }
+            Covariance[A][B] = Covariance[B][A] = TextureHorizontalSum(Sum);
+        }
+    }
+
+    u32 Largest = 0;
+    for (u32 Channel = 1; Channel < ChannelCount; Channel++) {
+        if (Covariance[Channel][Channel] > Covariance[Largest][Largest]) {
+            Largest = Channel;
+        }
+    }
+
+    f32 Axis[4] = {};
+    for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+        Axis[Channel] = Covariance[Largest][Channel];
+    }
+
+    for (u32 Iteration = 0; Iteration < 8; Iteration++) {
+        f32 Next[4] = {};
+        f32 Norm = 0.0f;
+        for (u32 Row = 0; Row < ChannelCount; Row++) {
+            for (u32 Column = 0; Column < ChannelCount; Column++) {
+                Next[Row] += Covariance[Row][Column] * Axis[Column];
+            }
+            Norm = fmaxf(Norm, fabsf(Next[Row]));
+        }
+        if (Norm < TEXTURE_EPSILON) {
+            break;
+        }
+        for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+            Axis[Channel] = Next[Channel] / Norm;
+        }
+    }
+
+    f32 Length = 0.0f;
+    for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+        Length += Axis[Channel] * Axis[Channel];
+    }
+    Length = sqrtf(Length);
+
+    if (Length < TEXTURE_EPSILON) {
+        for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+            Low[Channel] = High[Channel] = Mean[Channel];
+        }
+        return;
+    }
+
+    __m128 Minimum = _mm_set1_ps(FLT_MAX);
+    __m128 Maximum = _mm_set1_ps(-FLT_MAX);
+    for (u32 Group = 0; Group < 4; Group++) {
+        __m128 Projection = _mm_setzero_ps();
+        for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+            Projection = _mm_add_ps(Projection, _mm_mul_ps(Centered[Channel][Group], _mm_set1_ps(Axis[Channel] / Length)));
+        }
+        Minimum = _mm_min_ps(Minimum, Projection);
+        Maximum = _mm_max_ps(Maximum, Projection);
+    }
+
+    alignas(16) f32 MinimumLanes[4];
+    alignas(16) f32 MaximumLanes[4];
+    _mm_store_ps(MinimumLanes, Minimum);
+    _mm_store_ps(MaximumLanes, Maximum);
+    f32 TMin = fminf(fminf(MinimumLanes[0], MinimumLanes[1]), fminf(MinimumLanes[2], MinimumLanes[3]));
+    f32 TMax = fmaxf(fmaxf(MaximumLanes[0], MaximumLanes[1]), fmaxf(MaximumLanes[2], MaximumLanes[3]));
+
+    for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+        f32 Direction = Axis[Channel] / Length;
+        Low[Channel] = fminf(fmaxf(Mean[Channel] + Direction * TMin, 0.0f), 255.0f);
+        High[Channel] = fminf(fmaxf(Mean[Channel] + Direction * TMax, 0.0f), 255.0f);
+    }
+}
+
+// NOTE(milo): Indices are the position of each texel along Low -> High, rounded to one of the palette steps.
+void TextureBlockIndices(const f32 Channels[4][16], u32 ChannelCount, const f32* Low, const f32* High, u32 Steps, u32* Indices)
+{
+    f32 Direction[4] = {};
+    f32 LengthSquared = 0.0f;
+    for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+        Direction[Channel] = High[Channel] - Low[Channel];
+        LengthSquared += Direction[Channel] * Direction[Channel];
+    }
+
+    if (LengthSquared < TEXTURE_EPSILON) {
+        memset(Indices, 0, 16 * sizeof(u32));
+        return;
+    }
+
+    __m128 Scale = _mm_set1_ps((f32)(Steps - 1) / LengthSquared);
+    __m128 Zero = _mm_setzero_ps();
+    __m128 Last = _mm_set1_ps((f32)(Steps - 1));
+
+    for (u32 Group = 0; Group < 4; Group++) {
+        __m128 Projection = _mm_setzero_ps();
+        for (u32 Channel = 0; Channel < ChannelCount; Channel++) {
+            __m128 Offset = _mm_sub_ps(_mm_load_ps(&Channels[Channel][Group * 4]), _mm_set1_ps(Low[Channel]));
+            Projection = _mm_add_ps(Projection, _mm_mul_ps(Offset, _mm_set1_ps(Direction[Channel])));
+        }
+        Projection = _mm_min_ps(_mm_max_ps(_mm_mul_ps(Projection, Scale), Zero), Last);
+        _mm_storeu_si128((__m128i*)&Indices[Group * 4], _mm_cvtps_epi32(Projection));
+    }
+}
+
+u16 TexturePackRGB565(const f32* Color)
+{
+    u32 R = (u32)(Color[0] * 31.0f / 255.0f + 0.5f);
+    u32 G = (u32)(Color[1] * 63.0f / 255.0f + 0.5f);
+    u32 B = (u32)(Color[2] * 31.0f / 255.0f + 0.5f);
+    return (u16)((R << 11) | (G << 5) | B);
+}
+
+void TextureUnpackRGB565(u16 Packed, f32* Color)
+{
+    u32 R = (Packed >> 11) & 31;
+    u32 G = (Packed >> 5) & 63;
+    u32 B = Packed & 31;
+    Color[0] = (f32)((R << 3) | (R >> 2));
+    Color[1] = (f32)((G << 2) | (G >> 4));
+    Color[2] = (f32)((B << 3) | (B >> 2));
+}
+
+void TextureBitWrite(texture_bit_writer* Writer, u32 Value, u32 Bits)
+{
+    for (u32 Bit = 0; Bit < Bits; Bit++) {
+        if ((Value >> Bit) & 1) {
+            Writer->Data[Writer->Position >> 3] |= (u8)(1 << (Writer->Position & 7));
+        }
+        Writer->Position++;
+    }
+}
+
+//~ NOTE(milo): Block compression
+
+void TextureEncodeBC1Channels(const f32 Channels[4][16], u8* Block)
+{
+    f32 Low[4], High[4];
+    TextureBlockEndpoints(Channels, 3, Low, High);
+
+    u16 Color0 = TexturePackRGB565(High);
+    u16 Color1 = TexturePackRGB565(Low);
+    if (Color0 < Color1) {
+        u16 Swap = Color0;
+        Color0 = Color1;
+        Color1 = Swap;
+    }
+
+    u32 Packed = 0;
+    if (Color0 != Color1) {
+        f32 Endpoint0[4], Endpoint1[4];
+        TextureUnpackRGB565(Color0, Endpoint0);
+        TextureUnpackRGB565(Color1, Endpoint1);
+
+        // NOTE(milo): Color0 > Color1 selects the four color palette: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1.
+        static const u32 StepToIndex[4] = { 0, 2, 3, 1 };
+        u32 Steps[16];
+        TextureBlockIndices(Channels, 3, Endpoint0, Endpoint1, 4, Steps);
+        for (u32 Pixel = 0; Pixel < 16; Pixel++) {
+            Packed |= StepToIndex[Steps[Pixel]] << (Pixel * 2);
+        }
+    }
+
+    Block[0] = (u8)(Color0 & 0xFF);
+    Block[1] = (u8)(Color0 >> 8);
+    Block[2] = (u8)(Color1 & 0xFF);
+    Block[3] = (u8)(Color1 >> 8);
+    memcpy(Block + 4, &Packed, sizeof(u32));
+}
+
+void TextureEncodeBC1(const u8* Pixels, u8* Block)
+{
+    alignas(16) f32 Channels[4][16];
+    TextureBlockToChannels(Pixels, Channels);
+    TextureEncodeBC1Channels(Channels, Block);
+}
+
+void TextureEncodeBC4(const u8* Values, u8* Block)
+{
+    u8 Minimum = 255;
+    u8 Maximum = 0;
+    for (u32 Pixel = 0; Pixel < 16; Pixel++) {
+        Minimum = Values[Pixel] < Minimum ? Values[Pixel] : Minimum;
+        Maximum = Values[Pixel] > Maximum ? Values[Pixel] : Maximum;
+    }
+
+    Block[0] = Maximum;
+    Block[1] = Minimum;
+
+    u64 Packed = 0;
+    if (Maximum != Minimum) {
+        // NOTE(milo): Alpha0 > Alpha1 selects the eight value palette, index 0 and 1 are the endpoints and 2..7 step from Alpha0 to Alpha1.
+        f32 Scale = 7.0f / (f32)(Maximum - Minimum);
+        for (u32 Pixel = 0; Pixel < 16; Pixel++) {
+            u32 Step = (u32)((f32)(Maximum - Values[Pixel]) * Scale + 0.5f);
+            u64 Index = Step == 0 ? 0 : (Step == 7 ? 1 : Step + 1);
+            Packed |= Index << (Pixel * 3);
+        }
+    }
+
+    for (u32 Byte = 0; Byte < 6; Byte++) {
+        Block[2 + Byte] = (u8)(Packed >> (Byte * 8));
+    }
+}
+
+void TextureEncodeBC3(const u8* Pixels, u8* Block)
+{
+    u8 Alpha[16];
+    for (u32 Pixel = 0; Pixel < 16; Pixel++) {
+        Alpha[Pixel] = Pixels[Pixel * 4 + 3];
+    }
+
+    TextureEncodeBC4(Alpha, Block);
+    TextureEncodeBC1(Pixels, Block + 8);
+}
+
+// NOTE(milo): Picks the shared P-bit that reconstructs the endpoint with the least error, mode 6 endpoints are 7 bits plus one P-bit.
+void TextureQuantizeBC7Endpoint(const f32* Endpoint, u32* Quantized, u32* PBit, f32* Reconstructed)
+{
+    f32 BestError = FLT_MAX;
+    for (u32 Candidate = 0; Candidate < 2; Candidate++) {
+        u32 Values[4];
+        f32 Error = 0.0f;
+        for (u32 Channel = 0; Channel < 4; Channel++) {
+            i32 Value = (i32)((Endpoint[Channel] - (f32)Candidate) * 0.5f + 0.5f);
+            Value = Value < 0 ? 0 : (Value > 127 ? 127 : Value);
+            Values[Channel] = (u32)Value;
+
+            f32 Difference = (f32)((Value << 1) | Candidate) - Endpoint[Channel];
+            Error += Difference * Difference;
+        }
+
+        if (Error < BestError) {
+            BestError = Error;
+            *PBit = Candidate;
+            for (u32 Channel = 0; Channel < 4; Channel++) {
+                Quantized[Channel] = Values[Channel];
+                Reconstructed[Channel] = (f32)((Values[Channel] << 1) | Candidate);
+            }
+        }
+    }
+}
+
+void TextureEncodeBC7(const u8* Pixels, u8* Block)
+{
+    alignas(16) f32 Channels[4][16];
+    TextureBlockToChannels(Pixels, Channels);
+
+    f32 Low[4], High[4];
+    TextureBlockEndpoints(Channels, 4, Low, High);
+
+    u32 Quantized[2][4];
+    u32 PBits[2];
+    f32 Reconstructed[2][4];
+    TextureQuantizeBC7Endpoint(Low, Quantized[0], &PBits[0], Reconstructed[0]);
+    TextureQuantizeBC7Endpoint(High, Quantized[1], &PBits[1], Reconstructed[1]);
+
+    u32 Indices[16];
+    TextureBlockIndices(Channels, 4, Reconstructed[0], Reconstructed[1], 16, Indices);
+
+    // NOTE(milo): The anchor index is stored without its top bit, flip the endpoints so it is always below 8.
+    u32 First = 0;
+    if (Indices[0] & 8) {
+        First = 1;
+        for (u32 Pixel = 0; Pixel < 16; Pixel++) {
+            Indices[Pixel] = 15 - Indices[Pixel];
+        }
+    }
+    u32 Second = 1 - First;
+
+    memset(Block, 0, 16);
+    texture_bit_writer Writer = { Block, 0 };
+
+    TextureBitWrite(&Writer, 1 << 6, 7);
+    for (u32 Channel = 0; Channel < 4; Channel++) {
+        TextureBitWrite(&Writer, Quantized[First][Channel], 7);
+        TextureBitWrite(&Writer, Quantized[Second][Channel], 7);
+    }
+    TextureBitWrite(&Writer, PBits[First], 1);
+    TextureBitWrite(&Writer, PBits[Second], 1);
+
+    TextureBitWrite(&Writer, Indices[0], 3);
+    for (u32 Pixel = 1; Pixel < 16; Pixel++) {
+        TextureBitWrite(&Writer, Indices[Pixel], 4);
+    }
+}
+
+//~ NOTE(milo): Mip chain
+
+void TextureDownsampleRows(void* Data, u32 Start, u32 End)
+{
+    texture_cook_context* Context = (texture_cook_context*)Data;
+    const texture_level* Source = Context->Source;
+    texture_level* Destination = Context->Destination;
+
+    const __m128 Quarter = _mm_set1_ps(0.25f);
+
+    for (u32 Y = Start; Y < End; Y++) {
+        i32 Y0 = (i32)Y * 2;
+        i32 Y1 = Y0 + 1 < Source->Height ? Y0 + 1 : Source->Height - 1;
+        const f32* Row0 = &Source->Texels[(size_t)Y0 * Source->Width * 4];
+        const f32* Row1 = &Source->Texels[(size_t)Y1 * Source->Width * 4];
+        f32* Output = &Destination->Texels[(size_t)Y * Destination->Width * 4];
+
+        for (i32 X = 0; X < Destination->Width; X++) {
+            i32 X0 = X * 2;
+            i32 X1 = X0 + 1 < Source->Width ? X0 + 1 : Source->Width - 1;
+
+            __m128 Sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(Row0 + X0 * 4), _mm_loadu_ps(Row0 + X1 * 4)),
+                                    _mm_add_ps(_mm_loadu_ps(Row1 + X0 * 4), _mm_loadu_ps(Row1 + X1 * 4)));
+            __m128 Average = _mm_mul_ps(Sum, Quarter);
+
+            if (Context->Role == TextureRole_Normal) {
+                __m128 Squared = _mm_mul_ps(Average, Average);
+                alignas(16) f32 Lanes[4];
+                _mm_store_ps(Lanes, Squared);
+                f32 Length = sqrtf(Lanes[0] + Lanes[1] + Lanes[2]);
+                if (Length > TEXTURE_EPSILON) {
+                    __m128 Scale = _mm_setr_ps(1.0f / Length, 1.0f / Length, 1.0f / Length, 1.0f);
+                    Average = _mm_mul_ps(Average, Scale);
+                }
+            }
+
+            _mm_storeu_ps(Output + X * 4, Average);
+        }
+    }
+}
+
+void TextureQuantizeRows(void* Data, u32 Start, u32 End)
+{
+    texture_cook_context* Context = (texture_cook_context*)Data;
+    const texture_level* Source = Context->Source;
+    u8* Output = (u8*)Context->Pixels;
+
+    // NOTE(milo): Normals are stored biased to [0, 1], albedo goes through the 12 bit linear to sRGB table.
+    __m128 Scale = _mm_set1_ps(255.0f);
+    __m128 Bias = _mm_setzero_ps();
+    if (Context->Role == TextureRole_Normal) {
+        Scale = _mm_set1_ps(127.5f);
+        Bias = _mm_set1_ps(127.5f);
+    } else if (Context->Role == TextureRole_Albedo) {
+        Scale = _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f);
+    }
+    __m128 Maximum = _mm_add_ps(Scale, Bias);
+    __m128 Zero = _mm_setzero_ps();
+    __m128 Half = _mm_set1_ps(0.5f);
+
+    for (u32 Y = Start; Y < End; Y++) {
+        const f32* Row = &Source->Texels[(size_t)Y * Source->Width * 4];
+        u8* OutputRow = Output + (size_t)Y * Source->Width * 4;
+
+        for (i32 X = 0; X < Source->Width; X++) {
+            __m128 Value = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(Row + X * 4), Scale), Bias);
+            Value = _mm_min_ps(_mm_max_ps(_mm_add_ps(Value, Half), Zero), Maximum);
+
+            alignas(16) i32 Lanes[4];
+            _mm_store_si128((__m128i*)Lanes, _mm_cvttps_epi32(Value));
+
+            if (Context->Role == TextureRole_Albedo) {
+                OutputRow[X * 4 + 0] = Context->Tables->FromLinear[Lanes[0]];
+                OutputRow[X * 4 + 1] = Context->Tables->FromLinear[Lanes[1]];
+                OutputRow[X * 4 + 2] = Context->Tables->FromLinear[Lanes[2]];
+            } else {
+                OutputRow[X * 4 + 0] = (u8)Lanes[0];
+                OutputRow[X * 4 + 1] = (u8)Lanes[1];
+                OutputRow[X * 4 + 2] = (u8)Lanes[2];
+            }
+            OutputRow[X * 4 + 3] = (u8)Lanes[3];
+        }
+    }
+}
+
+void TextureEncodeRows(void* Data, u32 Start, u32 End)
+{
+    texture_cook_context* Context = (texture_cook_context*)Data;
+    i32 BlocksX = (Context->Width + 3) / 4;
+
+    for (u32 BlockY = Start; BlockY < End; BlockY++) {
+        for (i32 BlockX = 0; BlockX < BlocksX; BlockX++) {
+            // NOTE(milo): Edge blocks of levels that are not a multiple of four repeat their last row and column.
+            u8 Pixels[64];
+            for (i32 Y = 0; Y < 4; Y++) {
+                i32 SourceY = (i32)BlockY * 4 + Y < Context->Height ? (i32)BlockY * 4 + Y : Context->Height - 1;
+                for (i32 X = 0; X < 4; X++) {
+                    i32 SourceX = BlockX * 4 + X < Context->Width ? BlockX * 4 + X : Context->Width - 1;
+                    memcpy(&Pixels[(Y * 4 + X) * 4], &Context->Pixels[((size_t)SourceY * Context->Width + SourceX) * 4], 4);
+                }
+            }
+
+            u8* Block = Context->Output + (size_t)BlockY * Context->Pitch + (size_t)BlockX * Context->BlockSize;
+            switch (Context->Format) {
+                case TextureFormat_BC1_Unorm: TextureEncodeBC1(Pixels, Block); break;
+                case TextureFormat_BC3_Unorm: TextureEncodeBC3(Pixels, Block); break;
+                case TextureFormat_BC7_Unorm: TextureEncodeBC7(Pixels, Block); break;
+                default: break;
+            }
+        }
+    }
+}
+
+void TextureRunRows(texture_cook_context* Context, u32 Rows, u32 Batch, PFN_JobRangeFunction Function)
+{
+    job_counter Counter = {};
+    JobParallelFor(Rows, Batch, Function, Context, &Counter);
+    JobWait(&Counter);
+}
+
+//~ NOTE(milo): Cooker
+
+std::string TextureCookedPath(const std::string& SourcePath)
+{
+    return SourcePath + COOKED_TEXTURE_EXTENSION;
+}
+
+bool TextureCook(const char* SourcePath, const char* CookedPath, texture_role Role)
+{
+    i32 Width = 0, Height = 0, Channels = 0;
+    u8* Source = stbi_load(SourcePath, &Width, &Height, &Channels, STBI_rgb_alpha);
+    if (!Source) {
+        LogError("Failed to load texture for cooking: %s", SourcePath);
+        return false;
+    }
+
+    // NOTE(milo): D3D11 wants the top level of a block compressed texture to be a whole number of blocks, smaller levels can be anything.
+    if ((Width % 4) != 0 || (Height % 4) != 0) {
+        LogError("Texture %s is %dx%d, block compression needs a multiple of 4.", SourcePath, Width, Height);
+        stbi_image_free(Source);
+        return false;
+    }
+
+    bool Cooked = TextureCookPixels(Source, Width, Height, CookedPath, Role, RHI_MAX_MIPS);
+    stbi_image_free(Source);
+    return Cooked;
+}
+
+// NOTE(milo): Source is RGBA8 with a size that is a multiple of 4. The chain stops after MaxMips levels or at 1x1.
+bool TextureCookPixels(const u8* Source, i32 Width, i32 Height, const char* CookedPath, texture_role Role, u32 MaxMips)
+{
+    texture_cook_context Context = {};
+    Context.Role = Role;
+    Context.Tables = TextureSRGBTables();
+
+    // NOTE(milo): Albedo stays sRGB encoded in a UNORM format like the uncompressed path, only the filtering happens in linear space.
+    switch (Role) {
+        case TextureRole_Albedo: {
+            Context.Format = TextureFormat_BC1_Unorm;
+            for (i32 Pixel = 0; Pixel < Width * Height; Pixel++) {
+                if (Source[Pixel * 4 + 3] != 255) {
+                    Context.Format = TextureFormat_BC3_Unorm;
+                    break;
+                }
+            }
+            break;
+        }
+        // NOTE(milo): The forward shaders read X, Y and Z from the map, so normals need all three channels.
+        case TextureRole_Normal: {
+            Context.Format = TextureFormat_BC7_Unorm;
+            break;
+        }
+        case TextureRole_PBR: {
+            Context.Format = TextureFormat_BC7_Unorm;
+            break;
+        }
+    }
+    Context.BlockSize = (Context.Format == TextureFormat_BC1_Unorm) ? 8 : 16;
+
+    texture_level Level;
+    Level.Width = Width;
+    Level.Height = Height;
+    Level.Texels.resize((size_t)Width * Height * 4);
+
+    for (i32 Pixel = 0; Pixel < Width * Height; Pixel++) {
+        for (i32 Channel = 0; Channel < 4; Channel++) {
+            u8 Value = Source[Pixel * 4 + Channel];
+            f32* Texel = &Level.Texels[(size_t)Pixel * 4 + Channel];
+            if (Role == TextureRole_Albedo && Channel < 3) {
+                *Texel = Context.Tables->ToLinear[Value];
+            } else if (Role == TextureRole_Normal && Channel < 3) {
+                *Texel = Value / 127.5f - 1.0f;
+            } else {
+                *Texel = Value / 255.0f;
+            }
+        }
+    }
+
+    cooked_texture_header Header = {};
+    Header.Magic = COOKED_TEXTURE_MAGIC;
+    Header.Version = COOKED_TEXTURE_VERSION;
+    Header.Format = (u32)Context.Format;
+    Header.Role = (u32)Role;
+    Header.Width = (u32)Width;
+    Header.Height = (u32)Height;
+
+    std::vector<u8> Pixels;
+    std::vector<u8> Payload;
+    u64 Offset = sizeof(cooked_texture_header);
+
+    MaxMips = MaxMips < RHI_MAX_MIPS ? MaxMips : RHI_MAX_MIPS;
+    while (Header.MipCount < MaxMips) {
+        cooked_texture_mip* Mip = &Header.Mips[Header.MipCount++];
+        Mip->Width = (u32)Level.Width;
+        Mip->Height = (u32)Level.Height;
+        Mip->Pitch = ((Level.Width + 3) / 4) * Context.BlockSize;
+        Mip->Size = Mip->Pitch * ((Level.Height + 3) / 4);
+        Mip->Offset = Offset;
+
+        CODE_BLOCK("Quantize")
+        {
+            Pixels.resize((size_t)Level.Width * Level.Height * 4);
+            Context.Source = &Level;
+            Context.Pixels = Pixels.data();
+            TextureRunRows(&Context, (u32)Level.Height, TEXTURE_ROW_BATCH, TextureQuantizeRows);
+        }
+
+        CODE_BLOCK("Encode")
+        {
+            Payload.resize((size_t)(Offset - sizeof(cooked_texture_header)) + Mip->Size);
+            Context.Output = Payload.data() + (Offset - sizeof(cooked_texture_header));
+            Context.Width = Level.Width;
+            Context.Height = Level.Height;
+            Context.Pitch = Mip->Pitch;
+            TextureRunRows(&Context, (u32)(Level.Height + 3) / 4, COOKED_TEXTURE_BLOCK_ROWS, TextureEncodeRows);
+        }
+        Offset += Mip->Size;
+
+        if ((Level.Width == 1 && Level.Height == 1) || Header.MipCount == MaxMips) {
+            break;
+        }
+
+        CODE_BLOCK("Downsample")
+        {
+            texture_level Next;
+            Next.Width = Level.Width > 1 ? Level.Width / 2 : 1;
+            Next.Height = Level.Height > 1 ? Level.Height / 2 : 1;
+            Next.Texels.resize((size_t)Next.Width * Next.Height * 4);
+
+            Context.Source = &Level;
+            Context.Destination = &Next;
+            TextureRunRows(&Context, (u32)Next.Height, TEXTURE_ROW_BATCH, TextureDownsampleRows);
+
+            Level = std::move(Next);
+        }
+    }
+
+    FILE* File = fopen(CookedPath, "wb");
+    if (!File) {
+        LogError("Failed to open cooked texture for writing: %s", CookedPath);
+        return false;
+    }
+
+    bool Written = fwrite(&Header, sizeof(Header), 1, File) == 1 && fwrite(Payload.data(), 1, Payload.size(), File) == Payload.size();
+    fclose(File);
+
+    if (!Written) {
+        LogError("Failed to write cooked texture: %s", CookedPath);
+        remove(CookedPath);
+        return false;
+    }
+
+    LogInfo("Cooked %s (%dx%d, %u mips, %zu bytes)", CookedPath, Width, Height, Header.MipCount, Payload.size());
+    return true;
+}
+
+//~ NOTE(milo): Cooked images
+
+bool TextureReadCookedHeader(const char* Path, cooked_texture_header* Header)
+{
+    u64 Size;
+    if (!PackFileSize(Path, &Size)) {
+        return false;
+    }
+
+    if (Size < sizeof(cooked_texture_header) || !PackReadRange(Path, 0, sizeof(cooked_texture_header), Header)) {
+        LogError("Cooked texture is truncated: %s", Path);
+        return false;
+    }
+
+    bool Valid = Header->Magic == COOKED_TEXTURE_MAGIC && Header->Version == COOKED_TEXTURE_VERSION && Header->MipCount > 0 && Header->MipCount <= RHI_MAX_MIPS;
+    for (u32 MipIndex = 0; Valid && MipIndex < Header->MipCount; MipIndex++) {
+        Valid = Header->Mips[MipIndex].Offset + Header->Mips[MipIndex].Size <= Size;
+        if (MipIndex > 0) {
+            Valid = Valid && Header->Mips[MipIndex].Offset >= Header->Mips[MipIndex - 1].Offset + Header->Mips[MipIndex - 1].Size;
+        }
+    }
+
+    if (!Valid) {
+        LogError("Invalid cooked texture: %s", Path);
+    }
+    return Valid;
+}
+
+void ImageFromCookedHeader(rhi_image* Image, const cooked_texture_header* Header)
+{
+    Image->Data = NULL;
+    Image->Width = (i32)Header->Width;
+    Image->Height = (i32)Header->Height;
+    Image->Float = false;
+    Image->Path = NULL;
+    Image->Cooked = true;
+    Image->Format = (rhi_texture_format)Header->Format;
+    Image->MipCount = Header->MipCount;
+
+    for (u32 MipIndex = 0; MipIndex < Header->MipCount; MipIndex++) {
+        const cooked_texture_mip* Mip = &Header->Mips[MipIndex];
+        Image->Mips[MipIndex].Data = NULL;
+        Image->Mips[MipIndex].Pitch = Mip->Pitch;
+        Image->Mips[MipIndex].Size = Mip->Size;
+        Image->Mips[MipIndex].Width = (i32)Mip->Width;
+        Image->Mips[MipIndex].Height = (i32)Mip->Height;
+    }
+}
+
+u64 TextureCookedRangeOffset(const cooked_texture_header* Header, u32 FirstMip)
+{
+    return Header->Mips[FirstMip].Offset;
+}
+
+u64 TextureCookedRangeSize(const cooked_texture_header* Header, u32 FirstMip, u32 EndMip)
+{
+    return Header->Mips[EndMip - 1].Offset + Header->Mips[EndMip - 1].Size - Header->Mips[FirstMip].Offset;
+}
+
+// NOTE(milo): Takes ownership of Data, which holds mips FirstMip..EndMip as read from the file.
+void ImageFromCookedMips(rhi_image* Image, const cooked_texture_header* Header, u8* Data, u32 FirstMip, u32 EndMip)
+{
+    ImageFromCookedHeader(Image, Header);
+    Image->Data = Data;
+    for (u32 MipIndex = FirstMip; MipIndex < EndMip; MipIndex++) {
+        Image->Mips[MipIndex].Data = Data + (Header->Mips[MipIndex].Offset - Header->Mips[FirstMip].Offset);
+    }
+}
+
+// NOTE(milo): Levels are stored finest first, so any range of them is one contiguous read.
+bool ImageLoadCookedMips(rhi_image* Image, const char* Path, u32 FirstMip, u32 EndMip)
+{
+    cooked_texture_header Header;
+    if (!TextureReadCookedHeader(Path, &Header)) {
+        return false;
+    }
+
+    EndMip = EndMip < Header.MipCount ? EndMip : Header.MipCount;
+    if (FirstMip >= EndMip) {
+        LogError("Invalid mip range %u..%u for cooked texture: %s", FirstMip, EndMip, Path);
+        return false;
+    }
+
+    u64 Size = TextureCookedRangeSize(&Header, FirstMip, EndMip);
+    u8* Data = (u8*)malloc(Size);
+    bool Read = PackReadRange(Path, TextureCookedRangeOffset(&Header, FirstMip), Size, Data);
+
+    if (!Read) {
+        LogError("Failed to read cooked texture: %s", Path);
+        free(Data);
+        return false;
+    }
+
+    ImageFromCookedMips(Image, &Header, Data, FirstMip, EndMip);
+    Image->Path = Path;
+    return true;
+}
+
+bool ImageLoadCooked(rhi_image* Image, const char* Path)
+{
+    return ImageLoadCookedMips(Image, Path, 0, RHI_MAX_MIPS);
+}
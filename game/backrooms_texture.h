@@ -0,0 +1,61 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_rhi.h"
+
+#include <string>
+
+#define COOKED_TEXTURE_MAGIC 0x58455442 // NOTE(milo): "BTEX"
+#define COOKED_TEXTURE_VERSION 2 // NOTE(milo): 2 moved normal maps from BC5 to BC7, older files are rejected and re-cooked.
+#define TEXTURE_COOKER_VERSION 1 // NOTE(milo): Bump when the encoders change, it invalidates every cached texture.
+#define COOKED_TEXTURE_EXTENSION ".btex"
+#define COOKED_TEXTURE_BLOCK_ROWS 8
+
+enum texture_role
+{
+    TextureRole_Albedo,
+    TextureRole_Normal,
+    TextureRole_PBR
+};
+
+struct cooked_texture_mip
+{
+    u32 Width;
+    u32 Height;
+    u32 Pitch;
+    u32 Size;
+    u64 Offset;
+};
+
+struct cooked_texture_header
+{
+    u32 Magic;
+    u32 Version;
+    u32 Format;
+    u32 Role;
+    u32 Width;
+    u32 Height;
+    u32 MipCount;
+    u32 Pad;
+    cooked_texture_mip Mips[RHI_MAX_MIPS];
+};
+
+//~ NOTE(milo): Block compression
+void TextureEncodeBC1(const u8* Pixels, u8* Block);
+void TextureEncodeBC3(const u8* Pixels, u8* Block);
+void TextureEncodeBC4(const u8* Values, u8* Block);
+void TextureEncodeBC7(const u8* Pixels, u8* Block);
+
+//~ NOTE(milo): Cooker
+std::string TextureCookedPath(const std::string& SourcePath);
+bool TextureCook(const char* SourcePath, const char* CookedPath, texture_role Role);
+bool TextureCookPixels(const u8* Source, i32 Width, i32 Height, const char* CookedPath, texture_role Role, u32 MaxMips);
+
+//~ NOTE(milo): Cooked images
+bool TextureReadCookedHeader(const char* Path, cooked_texture_header* Header);
+void ImageFromCookedHeader(rhi_image* Image, const cooked_texture_header* Header);
+u64 TextureCookedRangeOffset(const cooked_texture_header* Header, u32 FirstMip);
+u64 TextureCookedRangeSize(const cooked_texture_header* Header, u32 FirstMip, u32 EndMip);
+void ImageFromCookedMips(rhi_image* Image, const cooked_texture_header* Header, u8* Data, u32 FirstMip, u32 EndMip);
+bool ImageLoadCookedMips(rhi_image* Image, const char* Path, u32 FirstMip, u32 EndMip);
+bool ImageLoadCooked(rhi_image* Image, const char* Path);
@@ -0,0 +1,101 @@
+#include "backrooms_texture_pool.h"
+#include "backrooms_texture.h"
+#include "backrooms_logger.h"
+
+#include <assert.h>
+#include <unordered_map>
+
+static std::vector<texture_pool_array*> Arrays;
+static std::unordered_map<std::string, texture_pool_slot> Slots;
+
+void TexturePoolExit()
+{
+    for (texture_pool_array* Array : Arrays) {
+        TextureFree(&Array->Texture);
+        delete Array;
+    }
+    Arrays.clear();
+    Slots.clear();
+}
+
+texture_pool_array* TexturePoolFind(rhi_image* Image, u32* Index)
+{
+    for (u32 ArrayIndex = 0; ArrayIndex < Arrays.size(); ArrayIndex++) {
+        rhi_texture* Texture = &Arrays[ArrayIndex]->Texture;
+        if (Texture->Width == Image->Width && Texture->Height == Image->Height && Texture->Format == Image->Format && Texture->MipCount == Image->MipCount) {
+            *Index = ArrayIndex;
+            return Arrays[ArrayIndex];
+        }
+    }
+
+    texture_pool_array* Array = new texture_pool_array();
+    Array->LayerCount = 0;
+    Array->LayerCapacity = TEXTURE_POOL_INITIAL_LAYERS;
+    TextureInit(&Array->Texture, Image->Width, Image->Height, Image->Format, TextureUsage_SRV, Array->LayerCapacity, Image->MipCount);
+    TextureInitSRV(&Array->Texture, Image->MipCount > 1);
+
+    *Index = (u32)Arrays.size();
+    Arrays.push_back(Array);
+    return Array;
+}
+
+// NOTE(milo): Only cooked images can be pooled, their whole mip chain is resident and they are not streamed. An image already in the
+// pool only gains a reference, it is not loaded again.
+bool TexturePoolAcquire(const std::string& CookedPath, texture_pool_slot* Slot)
+{
+    auto Found = Slots.find(CookedPath);
+    if (Found != Slots.end()) {
+        *Slot = Found->second;
+        Arrays[Slot->Array]->LayerReferences[Slot->Layer]++;
+        return true;
+    }
+
+    rhi_image Image = {};
+    if (!ImageLoadCooked(&Image, CookedPath.c_str())) {
+        return false;
+    }
+
+    u32 Index;
+    texture_pool_array* Array = TexturePoolFind(&Image, &Index);
+    Slot->Array = Index;
+    if (!Array->FreeLayers.empty()) {
+        Slot->Layer = Array->FreeLayers.back();
+        Array->FreeLayers.pop_back();
+    } else {
+        if (Array->LayerCount == Array->LayerCapacity) {
+            Array->LayerCapacity *= 2;
+            TextureResizeLayers(&Array->Texture, Array->LayerCapacity);
+        }
+        Slot->Layer = Array->LayerCount++;
+        Array->LayerPaths.emplace_back();
+        Array->LayerReferences.push_back(0);
+    }
+
+    Slot->UploadTicket = TextureUploadLayer(&Array->Texture, Slot->Layer, &Image);
+    ImageFree(&Image);
+
+    Array->LayerPaths[Slot->Layer] = CookedPath;
+    Array->LayerReferences[Slot->Layer] = 1;
+    Slots[CookedPath] = *Slot;
+    return true;
+}
+
+// NOTE(milo): The last release only frees the layer for reuse, arrays keep their size until TexturePoolExit.
+void TexturePoolRelease(texture_pool_slot Slot)
+{
+    assert(Slot.Array < Arrays.size());
+    texture_pool_array* Array = Arrays[Slot.Array];
+    assert(Slot.Layer < Array->LayerCount && Array->LayerReferences[Slot.Layer] > 0);
+
+    if (--Array->LayerReferences[Slot.Layer] == 0) {
+        Slots.erase(Array->LayerPaths[Slot.Layer]);
+        Array->LayerPaths[Slot.Layer].clear();
+        Array->FreeLayers.push_back(Slot.Layer);
+    }
+}
+
+rhi_texture* TexturePoolGet(u32 Array)
+{
+    assert(Array < Arrays.size());
+    return &Arrays[Array]->Texture;
+}
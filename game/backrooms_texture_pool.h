@@ -0,0 +1,36 @@
+#pragma once
+
+#include "backrooms_common.h"
+#include "backrooms_rhi.h"
+
+#include <string>
+#include <vector>
+
+#define TEXTURE_POOL_INITIAL_LAYERS 4
+
+// NOTE(milo): Cooked textures of the same size, format and mip count share one texture array, so draws only differ by the layer index.
+// Layers are counted per cooked file, materials sharing an image share its layer and released layers are reused.
+struct texture_pool_array
+{
+    rhi_texture Texture;
+    u32 LayerCount;
+    u32 LayerCapacity;
+
+    std::vector<std::string> LayerPaths;
+    std::vector<u32> LayerReferences;
+    std::vector<u32> FreeLayers;
+};
+
+// NOTE(milo): The layer can't be sampled until UploadTicket is done, every material sharing the layer shares its ticket.
+struct texture_pool_slot
+{
+    u32 Array;
+    u32 Layer;
+    u64 UploadTicket;
+};
+
+//~ NOTE(milo): Texture pool
+void TexturePoolExit();
+bool TexturePoolAcquire(const std::string& CookedPath, texture_pool_slot* Slot);
+void TexturePoolRelease(texture_pool_slot Slot);
+rhi_texture* TexturePoolGet(u32 Array);
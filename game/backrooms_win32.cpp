@@ -3,6 +3,10 @@
 #include "backrooms_input.h"
 #include "backrooms_audio.h"
 #include "backrooms_rhi.h"
+#include "backrooms_job.h"
+#include "backrooms_model.h"
+#include "backrooms_pack.h"
+#include "backrooms_shader_cache.h"
 #include "backrooms.h"
 
 #if defined(BACKROOMS_WINDOWS)
@@ -83,6 +87,187 @@ std::string PlatformReadFile(const char* Path)
     return StringStream.str();
 }
 
+bool PlatformCreateDirectory(const char* Path)
+{
+    // NOTE(milo): Creates every missing parent as well, like mkdir -p.
+    std::string Partial;
+    for (const char* Cursor = Path; *Cursor; Cursor++) {
+        Partial += *Cursor;
+        if (Cursor[1] == '/' || Cursor[1] == '\\' || Cursor[1] == '\0') {
+            if (!CreateDirectoryA(Partial.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+                LogError("Failed to create directory: %s", Partial.c_str());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void PlatformListFiles(const char* Directory, std::vector<std::string>* Files)
+{
+    WIN32_FIND_DATAA FindData;
+    std::string Pattern = std::string(Directory) + "/*";
+    HANDLE Find = FindFirstFileA(Pattern.c_str(), &FindData);
+    if (Find == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    do {
+        if (strcmp(FindData.cFileName, ".") == 0 || strcmp(FindData.cFileName, "..") == 0) {
+            continue;
+        }
+
+        std::string Path = std::string(Directory) + "/" + FindData.cFileName;
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            PlatformListFiles(Path.c_str(), Files);
+        } else {
+            Files->push_back(Path);
+        }
+    } while (FindNextFileA(Find, &FindData));
+
+    FindClose(Find);
+}
+
+bool PlatformFileMapOpen(platform_file_map* Map, const char* Path)
+{
+    Map->File = NULL;
+    Map->Mapping = NULL;
+    Map->Data = NULL;
+    Map->Size = 0;
+
+    HANDLE File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (File == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(File, &Size) || Size.QuadPart == 0) {
+        CloseHandle(File);
+        return false;
+    }
+
+    HANDLE Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!Mapping) {
+        LogError("Failed to create file mapping: %s", Path);
+        CloseHandle(File);
+        return false;
+    }
+
+    const void* Data = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!Data) {
+        LogError("Failed to map view of file: %s", Path);
+        CloseHandle(Mapping);
+        CloseHandle(File);
+        return false;
+    }
+
+    Map->File = (void*)File;
+    Map->Mapping = (void*)Mapping;
+    Map->Data = Data;
+    Map->Size = (u64)Size.QuadPart;
+    return true;
+}
+
+void PlatformFileMapClose(platform_file_map* Map)
+{
+    if (Map->Data) {
+        UnmapViewOfFile(Map->Data);
+    }
+    if (Map->Mapping) {
+        CloseHandle((HANDLE)Map->Mapping);
+    }
+    if (Map->File) {
+        CloseHandle((HANDLE)Map->File);
+    }
+
+    Map->File = NULL;
+    Map->Mapping = NULL;
+    Map->Data = NULL;
+    Map->Size = 0;
+}
+
+bool PlatformAsyncFileOpen(platform_async_file* File, const char* Path)
+{
+    HANDLE Handle = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+    if (Handle == INVALID_HANDLE_VALUE) {
+        File->Handle = NULL;
+        return false;
+    }
+
+    File->Handle = (void*)Handle;
+    return true;
+}
+
+void PlatformAsyncFileClose(platform_async_file* File)
+{
+    if (File->Handle) {
+        CloseHandle((HANDLE)File->Handle);
+        File->Handle = NULL;
+    }
+}
+
+void Win32AsyncReadFinish(platform_async_read* Read, bool Succeeded)
+{
+    OVERLAPPED* Overlapped = (OVERLAPPED*)Read->Internal;
+    CloseHandle(Overlapped->hEvent);
+    delete Overlapped;
+
+    Read->Internal = NULL;
+    Read->Succeeded = Succeeded;
+}
+
+bool PlatformAsyncRead(platform_async_file* File, u64 Offset, u64 Size, void* Destination, platform_async_read* Read)
+{
+    Read->Internal = NULL;
+    Read->Size = Size;
+    Read->Succeeded = false;
+
+    if (Size > 0xFFFFFFFF) {
+        LogError("Async read of %llu bytes is too large!", Size);
+        return false;
+    }
+
+    // NOTE(milo): Every read gets its own event, the file handle alone cannot tell several reads in flight apart.
+    OVERLAPPED* Overlapped = new OVERLAPPED();
+    Overlapped->Offset = (DWORD)(Offset & 0xFFFFFFFF);
+    Overlapped->OffsetHigh = (DWORD)(Offset >> 32);
+    Overlapped->hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    Read->Internal = (void*)Overlapped;
+
+    if (!ReadFile((HANDLE)File->Handle, Destination, (DWORD)Size, NULL, Overlapped) && GetLastError() != ERROR_IO_PENDING) {
+        Win32AsyncReadFinish(Read, false);
+        return false;
+    }
+    return true;
+}
+
+bool PlatformAsyncReadPoll(platform_async_file* File, platform_async_read* Read)
+{
+    if (!Read->Internal) {
+        return true;
+    }
+
+    OVERLAPPED* Overlapped = (OVERLAPPED*)Read->Internal;
+    if (!HasOverlappedIoCompleted(Overlapped)) {
+        return false;
+    }
+
+    DWORD Transferred = 0;
+    bool Succeeded = GetOverlappedResult((HANDLE)File->Handle, Overlapped, &Transferred, FALSE) && Transferred == Read->Size;
+    Win32AsyncReadFinish(Read, Succeeded);
+    return true;
+}
+
+bool PlatformAsyncReadWait(platform_async_file* File, platform_async_read* Read)
+{
+    if (Read->Internal) {
+        DWORD Transferred = 0;
+        bool Succeeded = GetOverlappedResult((HANDLE)File->Handle, (OVERLAPPED*)Read->Internal, &Transferred, TRUE) && Transferred == Read->Size;
+        Win32AsyncReadFinish(Read, Succeeded);
+    }
+    return Read->Succeeded;
+}
+
 void PlatformDLLInit(platform_dynamic_lib* Library, const char* Path)
 {
     Library->InternalHandle = LoadLibraryA(Path);
@@ -270,6 +455,8 @@ void Win32Create(HINSTANCE Instance)
     }
 
     PlatformTimerInit();
+    JobSystemInit();
+    PackMount(PACK_DEFAULT_PATH);
     AudioInit();
     VideoInit((void*)State.WindowHandle);
     GameInit();
@@ -374,6 +561,8 @@ void Win32Destroy()
     GameExit();
     VideoExit();
     AudioExit();
+    PackUnmount();
+    JobSystemExit();
 
     PlatformDLLExit(&State.AudioLibrary);
     PlatformDLLExit(&State.InputLibrary);
@@ -525,6 +714,36 @@ bool PlatformMutexUnlock(platform_mutex* Mutex)
     return Result != 0;
 }   
 
+void PlatformSemaphoreCreate(platform_semaphore* Semaphore, i32 InitialCount, i32 MaxCount)
+{
+    Semaphore->Internal = (void*)CreateSemaphoreA(0, InitialCount, MaxCount, 0);
+    if (!Semaphore->Internal) {
+        LogError("Failed to create semaphore!");
+        return;
+    }
+}
+
+void PlatformSemaphoreDestroy(platform_semaphore* Semaphore)
+{
+    if (Semaphore->Internal) {
+        CloseHandle((HANDLE)Semaphore->Internal);
+    }
+}
+
+void PlatformSemaphoreSignal(platform_semaphore* Semaphore, i32 Count)
+{
+    if (Semaphore->Internal) {
+        ReleaseSemaphore((HANDLE)Semaphore->Internal, Count, NULL);
+    }
+}
+
+void PlatformSemaphoreWait(platform_semaphore* Semaphore)
+{
+    if (Semaphore->Internal) {
+        WaitForSingleObject((HANDLE)Semaphore->Internal, INFINITE);
+    }
+}
+
 void AudioInit()
 {
     HRESULT Result = CoInitializeEx(NULL, COINIT_MULTITHREADED);
@@ -575,6 +794,7 @@ void AudioSourceCreate(audio_source* Source)
     Source->Volume = 1.0f;
     Source->Pitch = 1.0f;
     Source->Samples = nullptr;
+    Source->FileData = nullptr;
     Source->BackendData = nullptr;
 
     WAVEFORMATEX WaveFormat = {};
@@ -600,9 +820,17 @@ void AudioSourceLoad(audio_source* Source, const char* Path, audio_source_type T
 
     u64 TotalPCMFrameCount = 0;
 
+    // NOTE(milo): The decoders read from memory so sounds can come out of the pack, the file stays alive until the source is destroyed.
+    u64 FileSize = 0;
+    Source->FileData = PackReadFile(Path, &FileSize);
+    if (!Source->FileData) {
+        LogError("Failed to open audio file: %s", Path);
+        return;
+    }
+
     switch (Type) {
         case AudioSourceType_WAV: {
-            if (!drwav_init_file(&Source->Loaders.Wave, Path, NULL)) {
+            if (!drwav_init_memory(&Source->Loaders.Wave, Source->FileData, FileSize, NULL)) {
                 LogError("Failed to load wave file: %s", Path);
                 return;
             }
@@ -614,7 +842,7 @@ void AudioSourceLoad(audio_source* Source, const char* Path, audio_source_type T
             break;
         }
         case AudioSourceType_MP3: {
-            if (!drmp3_init_file(&Source->Loaders.MP3, Path, NULL)) {
+            if (!drmp3_init_memory(&Source->Loaders.MP3, Source->FileData, FileSize, NULL)) {
                 LogError("Failed to load mp3 file: %s", Path);
                 return;
             }
@@ -626,7 +854,7 @@ void AudioSourceLoad(audio_source* Source, const char* Path, audio_source_type T
             break;
         }
         case AudioSourceType_FLAC: {
-            Source->Loaders.Flac = drflac_open_file(Path, NULL);
+            Source->Loaders.Flac = drflac_open_memory(Source->FileData, FileSize, NULL);
             if (!Source->Loaders.Flac) {
                 LogCritical("Failed to load flac file: %s", Path);
             }
@@ -716,14 +944,43 @@ void AudioSourceDestroy(audio_source* Source)
         }
     }
 
+    if (Source->FileData) {
+        free(Source->FileData);
+        Source->FileData = NULL;
+    }
+
     if (Source->BackendData) {
         IXAudio2SourceVoice* SourceVoice = (IXAudio2SourceVoice*)Source->BackendData;
         SourceVoice->DestroyVoice();
     }
 }
 
-int main()
+int main(int ArgumentCount, char** Arguments)
 {
+    // NOTE(milo): Offline mode, "Backrooms.exe -cook <model.gltf>" compresses the model's textures and exits.
+    if (ArgumentCount == 3 && strcmp(Arguments[1], "-cook") == 0) {
+        PlatformTimerInit();
+        JobSystemInit();
+        GpuMeshCookTextures(Arguments[2]);
+        JobSystemExit();
+        return 0;
+    }
+
+    // NOTE(milo): "Backrooms.exe -pack" bundles the data directory into data.pack, ordered by the last recorded loose run.
+    if (ArgumentCount == 2 && strcmp(Arguments[1], "-pack") == 0) {
+        PlatformTimerInit();
+        JobSystemInit();
+        bool Packed = PackBuildDirectory(PACK_DEFAULT_PATH, PACK_SOURCE_DIRECTORY);
+        JobSystemExit();
+        return Packed ? 0 : 1;
+    }
+
+    // NOTE(milo): "Backrooms.exe -check-shader-cache" checks the shader cache keys and storage without creating a device.
+    if (ArgumentCount == 2 && strcmp(Arguments[1], "-check-shader-cache") == 0) {
+        PlatformTimerInit();
+        return ShaderCacheCheck() ? 0 : 1;
+    }
+
     Win32Create(GetModuleHandle(NULL));
     while (PlatformConfiguration.Running) {
         Win32Update();